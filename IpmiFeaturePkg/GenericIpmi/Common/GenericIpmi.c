@@ -8,6 +8,8 @@
 
 #include "GenericIpmi.h"
 #include <IndustryStandard/Ipmi.h>
+#include <Library/TimerLib.h>
+#include <Library/IpmiDeadlineLib.h>
 
 EFI_STATUS
 UpdateErrorStatus (
@@ -73,10 +75,10 @@ IpmiPrintCommand (
   IN CONST UINT8    Command,
   IN CONST UINT8    CompletionCode,
   IN CONST UINT8    *Data,
-  IN CONST UINT8    DataSize
+  IN CONST UINT32   DataSize
   )
 {
-  UINT8   Index;
+  UINT32  Index;
   CHAR16  *TypeString;
 
   TypeString = Response ? L"Response" : L"Command";
@@ -102,238 +104,1040 @@ IpmiPrintCommand (
 }
 
 /**
-  Send IPMI command to BMC
+  Arms the circuit breaker of an IPMI instance. Called once the BMC has been
+  initialized so that the retries of initialization are not cut short.
 
-  @param[in]      This              Pointer to IPMI protocol instance.
+  @param[in,out]  IpmiInstance    The IPMI instance.
+**/
+VOID
+IpmiCircuitBreakerInitialize (
+  IN OUT IPMI_BMC_INSTANCE_DATA  *IpmiInstance
+  )
+{
+  IPMI_CIRCUIT_BREAKER  *Breaker;
+  UINT64                Frequency;
+
+  Breaker   = &IpmiInstance->Breaker;
+  Frequency = GetPerformanceCounterProperties (&Breaker->CounterStart, &Breaker->CounterEnd);
+
+  //
+  // Without a performance counter the probe is due on every command, the BMC
+  // is still checked with a single command rather than the full retry path.
+  //
+  Breaker->State         = IpmiBreakerClosed;
+  Breaker->Failures      = 0;
+  Breaker->Threshold     = PcdGet8 (PcdIpmiCircuitBreakerThreshold);
+  Breaker->ProbeInterval = MultU64x32 (Frequency, PcdGet8 (PcdIpmiCircuitBreakerProbeSeconds));
+}
+
+/**
+  Updates the circuit breaker with the outcome of a transaction. The breaker
+  opens once Threshold consecutive transactions get no response, or at once
+  when a probe gets none, and closes when the BMC responds.
+
+  @param[in,out]  IpmiInstance    The IPMI instance.
+  @param[in]      Responded       TRUE if the BMC responded to the transaction.
+**/
+STATIC
+VOID
+IpmiCircuitBreakerUpdate (
+  IN OUT IPMI_BMC_INSTANCE_DATA  *IpmiInstance,
+  IN     BOOLEAN                 Responded
+  )
+{
+  IPMI_CIRCUIT_BREAKER  *Breaker;
+
+  Breaker = &IpmiInstance->Breaker;
+  if (Responded) {
+    if (Breaker->State != IpmiBreakerClosed) {
+      DEBUG ((DEBUG_INFO, "[IPMI] BMC responded, closing the circuit breaker.\n"));
+    }
+
+    Breaker->State    = IpmiBreakerClosed;
+    Breaker->Failures = 0;
+    return;
+  }
+
+  if (Breaker->Threshold == 0) {
+    return;
+  }
+
+  if (Breaker->Failures < MAX_UINT8) {
+    Breaker->Failures++;
+  }
+
+  if ((Breaker->State == IpmiBreakerHalfOpen) || (Breaker->Failures >= Breaker->Threshold)) {
+    if (Breaker->State == IpmiBreakerClosed) {
+      DEBUG ((DEBUG_WARN, "[IPMI] BMC not responding, opening the circuit breaker.\n"));
+    }
+
+    Breaker->State    = IpmiBreakerOpen;
+    Breaker->OpenTime = GetPerformanceCounter ();
+    if (IpmiInstance->BmcStatus != BMC_UPDATE_IN_PROGRESS) {
+      IpmiInstance->BmcStatus = BMC_HARDFAIL;
+    }
+  }
+}
+
+/**
+  Checks whether a request may be sent. While the circuit breaker is open the
+  request is refused, except that once the probe interval has passed a Get
+  Device ID probe is sent first and the request proceeds if it gets a
+  response.
+
+  @param[in,out]  IpmiInstance    The IPMI instance.
+
+  @retval   EFI_SUCCESS       The request may be sent.
+  @retval   EFI_NO_RESPONSE   The BMC is not responding.
+**/
+STATIC
+EFI_STATUS
+IpmiCircuitBreakerCheck (
+  IN OUT IPMI_BMC_INSTANCE_DATA  *IpmiInstance
+  )
+{
+  IPMI_CIRCUIT_BREAKER         *Breaker;
+  IPMI_GET_DEVICE_ID_RESPONSE  DeviceId;
+  UINT32                       DataSize;
+  UINT64                       Elapsed;
+  BOOLEAN                      Retry;
+  EFI_STATUS                   Status;
+
+  //
+  // Closed, or this is the probe itself.
+  //
+  Breaker = &IpmiInstance->Breaker;
+  if (Breaker->State != IpmiBreakerOpen) {
+    return EFI_SUCCESS;
+  }
+
+  Elapsed = IpmiCounterTicksBetween (
+              Breaker->CounterStart,
+              Breaker->CounterEnd,
+              Breaker->OpenTime,
+              GetPerformanceCounter ()
+              );
+
+  if (Elapsed < Breaker->ProbeInterval) {
+    return EFI_NO_RESPONSE;
+  }
+
+  DEBUG ((DEBUG_INFO, "[IPMI] Probing the BMC.\n"));
+  Breaker->State = IpmiBreakerHalfOpen;
+  Status         = IpmiSendRequest (IpmiInstance, IPMI_NETFN_APP, 0, IPMI_APP_GET_DEVICE_ID, NULL, 0);
+  if (!EFI_ERROR (Status)) {
+    DataSize = sizeof (DeviceId);
+    IpmiReceiveResponse (IpmiInstance, IPMI_NETFN_APP, IPMI_APP_GET_DEVICE_ID, (UINT8 *)&DeviceId, &DataSize, &Retry);
+  }
+
+  return (Breaker->State == IpmiBreakerClosed) ? EFI_SUCCESS : EFI_NO_RESPONSE;
+}
+
+/**
+  Sends an IPMI request to the BMC without waiting for the response. The
+  response must be collected with IpmiReceiveResponse.
+
+  @param[in]      IpmiInstance      The IPMI instance to send the request on.
   @param[in]      NetFunction       Net Function of command to send.
   @param[in]      Lun               LUN of command to send.
   @param[in]      Command           IPMI command to send.
   @param[in]      CommandData       Pointer to command data buffer, if needed.
   @param[in]      CommandDataSize   Size of command data buffer.
+
+  @retval   EFI_SUCCESS             The request was sent.
+  @retval   EFI_INVALID_PARAMETER   The command data is larger than the
+                                    transport can carry.
+  @retval   EFI_NO_RESPONSE         The circuit breaker is open.
+  @retval   Other                   The transport failed to send the request.
+**/
+EFI_STATUS
+EFIAPI
+IpmiSendRequest (
+  IN IPMI_BMC_INSTANCE_DATA  *IpmiInstance,
+  IN UINT8                   NetFunction,
+  IN UINT8                   Lun,
+  IN UINT8                   Command,
+  IN UINT8                   *CommandData,
+  IN UINT32                  CommandDataSize
+  )
+{
+  EFI_STATUS           Status;
+  IPMI_MESSAGE_HEADER  RequestHeader;
+  UINT32               MaxRequestSize;
+  UINT32               MaxResponseSize;
+
+  //
+  // Until a response is received there is no completion code to report.
+  //
+  IpmiInstance->LastCompletionCode = IPMI_COMP_CODE_UNSPECIFIED;
+
+  GetBmcMaxMessageSize (&MaxRequestSize, &MaxResponseSize);
+  if (CommandDataSize > MaxRequestSize) {
+    DEBUG ((DEBUG_ERROR, "[IPMI] Command data too large for the transport. (%d > %d)\n", CommandDataSize, MaxRequestSize));
+    return EFI_INVALID_PARAMETER;
+  }
+
+  //
+  // Fail at once rather than waiting out the timeout of a BMC that stopped
+  // responding.
+  //
+  Status = IpmiCircuitBreakerCheck (IpmiInstance);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  //
+  // Print out the command being sent for debugging.
+  //
+
+  IpmiPrintCommand (FALSE, NetFunction, Command, 0, CommandData, CommandDataSize);
+
+  //
+  // Send IPMI command to BMC. The header and the caller's command data are
+  // handed to the transport separately so the command data is not staged.
+  //
+  RequestHeader.Lun         = Lun;
+  RequestHeader.NetFunction = NetFunction;
+  RequestHeader.Command     = Command;
+
+  Status = SendDataToBmcPortEx (
+             IpmiInstance->IpmiTimeoutPeriod,
+             (UINT8 *)&RequestHeader,
+             IPMI_COMMAND_HEADER_SIZE,
+             CommandData,
+             CommandDataSize
+             );
+
+  if (Status != EFI_SUCCESS) {
+    DEBUG ((DEBUG_ERROR, "[IPMI] Generic - Softfail! (%r)\n", Status));
+    IpmiInstance->BmcStatus = BMC_SOFTFAIL;
+    IpmiInstance->SoftErrorCount++;
+    IpmiCircuitBreakerUpdate (IpmiInstance, FALSE);
+  }
+
+  return Status;
+}
+
+/**
+  Receives the BMC response to a request sent with IpmiSendRequest and checks
+  the completion code.
+
+  @param[in]      IpmiInstance      The IPMI instance the request was sent on.
+  @param[in]      NetFunction       Net Function of the command sent.
+  @param[in]      Command           IPMI command sent.
   @param[in,out]  ResponseData      Pointer to response data buffer. Optional depending on command being sent.
   @param[in,out]  ResponseDataSize  Pointer to response data buffer size. Optional depending on command being sent.
+  @param[out]     Retry             Set to TRUE when the response did not
+                                    belong to the request and the request
+                                    should be sent again.
 
-  @retval   EFI_INVALID_PARAMETER   One of the input values is bad.
   @retval   EFI_DEVICE_ERROR        IPMI command failed.
+  @retval   EFI_SECURITY_VIOLATION  The BMC denied the command.
+  @retval   EFI_UNSUPPORTED         The command failed while the BMC is in update mode.
   @retval   EFI_BUFFER_TOO_SMALL    Response buffer is too small.
   @retval   EFI_SUCCESS             Command completed successfully.
 **/
 EFI_STATUS
 EFIAPI
-IpmiSendCommandInternal (
-  IN      IPMI_TRANSPORT  *This,
-  IN      UINT8           NetFunction,
-  IN      UINT8           Lun,
-  IN      UINT8           Command,
-  IN      UINT8           *CommandData,
-  IN      UINT8           CommandDataSize,
-  IN OUT  UINT8           *ResponseData OPTIONAL,
-  IN OUT  UINT8           *ResponseDataSize OPTIONAL
+IpmiReceiveResponse (
+  IN      IPMI_BMC_INSTANCE_DATA  *IpmiInstance,
+  IN      UINT8                   NetFunction,
+  IN      UINT8                   Command,
+  IN OUT  UINT8                   *ResponseData OPTIONAL,
+  IN OUT  UINT32                  *ResponseDataSize OPTIONAL,
+  OUT     BOOLEAN                 *Retry
   )
 {
-  IPMI_BMC_INSTANCE_DATA  *IpmiInstance;
-  UINT8                   DataSize;
-  EFI_STATUS              Status;
-  IPMI_COMMAND            *IpmiCommand;
-  IPMI_RESPONSE           *IpmiResponse;
-  UINT8                   RetryCnt;
-  UINT8                   Index;
+  UINT32               DataSize;
+  UINT32               ReceivedSize;
+  EFI_STATUS           Status;
+  IPMI_MESSAGE_HEADER  ResponseHeader;
+  UINT8                *ResponseBuffer;
+  UINT32               ResponseBufferSize;
 
-  if ((CommandDataSize > 0) && (CommandData == NULL)) {
-    return EFI_INVALID_PARAMETER;
+  *Retry = FALSE;
+
+  //
+  // The response is received directly into the caller's buffer with the
+  // completion code in the first byte as required by the IPMI 2.0 spec. Only
+  // when the caller has no room for even the completion code is the instance
+  // buffer used, so that the completion code can still be evaluated.
+  //
+  if ((ResponseData != NULL) && (*ResponseDataSize > 0)) {
+    ResponseBuffer     = ResponseData;
+    ResponseBufferSize = *ResponseDataSize;
+  } else {
+    ResponseBuffer     = IpmiInstance->TempData;
+    ResponseBufferSize = sizeof (IpmiInstance->TempData);
   }
 
   //
-  // ResponseData and ResponseDataSize cannot be mismatched.
-  // Either both NULL are NULL or both are Non-Null, depending
-  // on the command being sent.
+  // Get Response to IPMI Command from BMC. The completion code and response
+  // data land in the response buffer, the NetFn and command in the header.
   //
-  if ((ResponseData != NULL) != (ResponseDataSize != NULL)) {
-    return EFI_INVALID_PARAMETER;
+  DataSize = ResponseBufferSize;
+  Status   = ReceiveBmcDataFromPortEx (
+               IpmiInstance->IpmiTimeoutPeriod,
+               (UINT8 *)&ResponseHeader,
+               IPMI_COMMAND_HEADER_SIZE,
+               ResponseBuffer,
+               &DataSize
+               );
+
+  if ((Status != EFI_SUCCESS) && (Status != EFI_BUFFER_TOO_SMALL)) {
+    DEBUG ((DEBUG_ERROR, "[IPMI] Generic - Softfail! (%r)\n", Status));
+    IpmiInstance->BmcStatus = BMC_SOFTFAIL;
+    IpmiInstance->SoftErrorCount++;
+    IpmiCircuitBreakerUpdate (IpmiInstance, FALSE);
+    return Status;
   }
 
-  RetryCnt     = PcdGet8 (PcdIpmiCommandMaxReties);
-  IpmiInstance = INSTANCE_FROM_SM_IPMI_BMC_THIS (This);
+  IpmiCircuitBreakerUpdate (IpmiInstance, TRUE);
 
   //
-  // Print out the command being sent for debugging.
+  // If we got this far without any error codes, but there is not even a
+  // completion code, then the command response failed, so do not continue.
   //
+  if (DataSize < (IPMI_RESPONSE_HEADER_SIZE - IPMI_COMMAND_HEADER_SIZE)) {
+    DEBUG ((DEBUG_ERROR, "[IPMI] Generic - DataSize too small! (%d)\n", DataSize + IPMI_COMMAND_HEADER_SIZE));
+    return EFI_DEVICE_ERROR;
+  }
 
-  IpmiPrintCommand (FALSE, NetFunction, Command, 0, CommandData, CommandDataSize);
+  IpmiInstance->LastCompletionCode = ResponseBuffer[0];
+
+  //
+  // Print out the response for debugging purposes.
+  //
 
-  while (RetryCnt--) {
+  ReceivedSize = MIN (DataSize, ResponseBufferSize);
+  IpmiPrintCommand (
+    TRUE,
+    ResponseHeader.NetFunction,
+    ResponseHeader.Command,
+    ResponseBuffer[0],
+    &ResponseBuffer[1],
+    ReceivedSize - 1
+    );
+
+  if ((ResponseBuffer[0] != IPMI_COMP_CODE_NORMAL) &&
+      (IpmiInstance->BmcStatus == BMC_UPDATE_IN_PROGRESS))
+  {
     //
-    // The TempData buffer is used for both sending command data and receiving
-    // response data.  Since the command format is different from the response
-    // format, the buffer is cast to both structure definitions.
+    // If the completion code is not normal and the BMC is in Force Update
+    // mode, then update the error status and return EFI_UNSUPPORTED.
     //
-    IpmiCommand  = (IPMI_COMMAND *)IpmiInstance->TempData;
-    IpmiResponse = (IPMI_RESPONSE *)IpmiInstance->TempData;
-
+    UpdateErrorStatus (
+      ResponseBuffer[0],
+      IpmiInstance
+      );
+    return EFI_UNSUPPORTED;
+  } else if (ResponseBuffer[0] != IPMI_COMP_CODE_NORMAL) {
     //
-    // Send IPMI command to BMC
+    // Otherwise if the BMC is in normal mode, but the completion code
+    // is not normal, then update the error status and return device error.
     //
-    IpmiCommand->Lun         = Lun;
-    IpmiCommand->NetFunction = NetFunction;
-    IpmiCommand->Command     = Command;
-
+    UpdateErrorStatus (
+      ResponseBuffer[0],
+      IpmiInstance
+      );
     //
-    // Ensure that the buffer is valid before attempting to copy the command data
-    // buffer into the IpmiCommand structure.
+    // Intel Server System Integrated Baseboard Management Controller (BMC) Firmware v0.62
+    // D4h C Insufficient privilege, in KCS channel this indicates KCS Policy Control Mode is Deny All.
+    // In authenticated channels this indicates invalid authentication/privilege.
     //
-    if (CommandDataSize > 0) {
-      CopyMem (
-        IpmiCommand->CommandData,
-        CommandData,
-        CommandDataSize
-        );
-    }
-
-    Status = SendDataToBmcPort (
-               IpmiInstance->IpmiTimeoutPeriod,
-               (UINT8 *)IpmiCommand,
-               (CommandDataSize + IPMI_COMMAND_HEADER_SIZE)
-               );
-
-    if (Status != EFI_SUCCESS) {
-      DEBUG ((DEBUG_ERROR, "[IPMI] Generic - Softfail! (%r)\n", Status));
-      IpmiInstance->BmcStatus = BMC_SOFTFAIL;
-      IpmiInstance->SoftErrorCount++;
-      return Status;
+    if (ResponseBuffer[0] == IPMI_COMP_CODE_INSUFFICIENT_PRIVILEGE) {
+      return EFI_SECURITY_VIOLATION;
+    } else {
+      return EFI_DEVICE_ERROR;
     }
+  }
 
+  //
+  // Verify the response data buffer passed in is big enough.
+  //
+  if ((ResponseDataSize != NULL) && (DataSize > *ResponseDataSize)) {
     //
-    // Get Response to IPMI Command from BMC.
-    // Subtract 1 from DataSize so memory past the end of the buffer can't be written
+    // Verify the response data matched with the cmd sent.
     //
-    DataSize = MAX_TEMP_DATA - 1;
-    Status   = ReceiveBmcDataFromPort (
-                 IpmiInstance->IpmiTimeoutPeriod,
-                 (UINT8 *)IpmiResponse,
-                 &DataSize
-                 );
-
-    if (Status != EFI_SUCCESS) {
-      DEBUG ((DEBUG_ERROR, "[IPMI] Generic - Softfail! (%r)\n", Status));
-      IpmiInstance->BmcStatus = BMC_SOFTFAIL;
-      IpmiInstance->SoftErrorCount++;
-      return Status;
+    if ((ResponseHeader.NetFunction != (NetFunction | 0x1)) || (ResponseHeader.Command != Command)) {
+      *Retry = TRUE;
+      return EFI_DEVICE_ERROR;
     }
 
     //
-    // If we got this far without any error codes, but the DataSize less than IPMI_RESPONSE_HEADER_SIZE, then the
-    // command response failed, so do not continue.
+    // return the required size, including the completion code.
     //
-    if (DataSize < IPMI_RESPONSE_HEADER_SIZE) {
-      DEBUG ((DEBUG_ERROR, "[IPMI] Generic - DataSize too small! (%d)\n", DataSize));
-      return EFI_DEVICE_ERROR;
-    }
 
+    *ResponseDataSize = DataSize;
+    return EFI_BUFFER_TOO_SMALL;
+  }
+
+  if ((ResponseData != NULL) && (ResponseDataSize != NULL)) {
     //
-    // Print out the response for debugging purposes.
+    // The data, with the completion code first, is already in place.
     //
+    *ResponseDataSize = DataSize;
+  }
 
-    IpmiPrintCommand (
-      TRUE,
-      IpmiResponse->NetFunction,
-      IpmiResponse->Command,
-      IpmiResponse->CompletionCode,
-      IpmiResponse->ResponseData,
-      DataSize - IPMI_RESPONSE_HEADER_SIZE
-      );
+  IpmiInstance->BmcStatus = BMC_OK;
+  return EFI_SUCCESS;
+}
+
+/**
+  Looks up the retry policy for the last completion code of a command and
+  returns the backoff to wait before the command is sent again.
 
-    if ((IpmiResponse->CompletionCode != IPMI_COMP_CODE_NORMAL) &&
-        (IpmiInstance->BmcStatus == BMC_UPDATE_IN_PROGRESS))
+  @param[in]  IpmiInstance    The IPMI instance.
+  @param[in]  NetFunction     The net function of the command.
+  @param[in]  Command         The command.
+  @param[in]  Attempt         The number of retries already made for the
+                              completion code policy.
+  @param[out] Backoff         The delay before the retry in microseconds.
+
+  @retval TRUE    The command should be sent again after Backoff.
+  @retval FALSE   The completion code is not retried, or the retries are used up.
+**/
+STATIC
+BOOLEAN
+IpmiRetryPolicyLookup (
+  IN  IPMI_BMC_INSTANCE_DATA  *IpmiInstance,
+  IN  UINT8                   NetFunction,
+  IN  UINT8                   Command,
+  IN  UINT8                   Attempt,
+  OUT UINT32                  *Backoff
+  )
+{
+  CONST IPMI_RETRY_POLICY  *Policy;
+  UINTN                    Count;
+  UINTN                    Index;
+  UINT32                   Delay;
+
+  Policy = (CONST IPMI_RETRY_POLICY *)PcdGetPtr (PcdIpmiRetryPolicy);
+  Count  = PcdGetSize (PcdIpmiRetryPolicy) / sizeof (IPMI_RETRY_POLICY);
+
+  for (Index = 0; Index < Count; Index++, Policy++) {
+    if ((Policy->CompletionCode == IpmiInstance->LastCompletionCode) &&
+        ((Policy->NetFunction == IPMI_RETRY_ANY) || (Policy->NetFunction == NetFunction)) &&
+        ((Policy->Command == IPMI_RETRY_ANY) || (Policy->Command == Command)))
     {
+      break;
+    }
+  }
+
+  //
+  // Anything without a matching entry is a permanent failure.
+  //
+  if ((Index == Count) || (Attempt >= Policy->Retries)) {
+    return FALSE;
+  }
+
+  Delay = (UINT32)Policy->Backoff * 1000;
+  Delay = Delay << MIN (Attempt, 8);
+  DEBUG ((
+    DEBUG_INFO,
+    "[IPMI] NetFn 0x%x Cmd 0x%x CC 0x%x, retry %d of %d in %d us\n",
+    NetFunction,
+    Command,
+    IpmiInstance->LastCompletionCode,
+    Attempt + 1,
+    Policy->Retries,
+    Delay
+    ));
+
+  *Backoff = Delay;
+  return TRUE;
+}
+
+/**
+  Saves the response to a command describing the BMC identity so that later
+  requests for it are answered without reaching the BMC. Responses to other
+  commands and unsuccessful responses are ignored.
+
+  @param[in,out]  IpmiInstance      The IPMI instance.
+  @param[in]      Command           The IPMI_NETFN_APP command the response is for.
+  @param[in]      CommandData       The request data of the command.
+  @param[in]      CommandDataSize   The size of the request data.
+  @param[in]      ResponseData      The response, starting with the completion code.
+  @param[in]      ResponseDataSize  The size of the response.
+**/
+VOID
+IpmiIdentitySave (
+  IN OUT IPMI_BMC_INSTANCE_DATA  *IpmiInstance,
+  IN     UINT8                   Command,
+  IN     UINT8                   *CommandData,
+  IN     UINT32                  CommandDataSize,
+  IN     UINT8                   *ResponseData,
+  IN     UINT32                  ResponseDataSize
+  )
+{
+  IPMI_BMC_IDENTITY  *Identity;
+
+  Identity = &IpmiInstance->Identity;
+  if ((ResponseDataSize == 0) || (ResponseData[0] != IPMI_COMP_CODE_NORMAL)) {
+    return;
+  }
+
+  switch (Command) {
+    case IPMI_APP_GET_DEVICE_ID:
+      if (ResponseDataSize <= sizeof (Identity->DeviceId)) {
+        CopyMem (&Identity->DeviceId, ResponseData, ResponseDataSize);
+        Identity->DeviceIdSize = (UINT8)ResponseDataSize;
+        Identity->Valid       |= IPMI_BMC_IDENTITY_DEVICE_ID;
+      }
+
+      break;
+
+    case IPMI_APP_GET_SELFTEST_RESULTS:
+      if (ResponseDataSize == sizeof (Identity->SelfTest)) {
+        CopyMem (&Identity->SelfTest, ResponseData, ResponseDataSize);
+        Identity->Valid |= IPMI_BMC_IDENTITY_SELF_TEST;
+      }
+
+      break;
+
+    case IPMI_APP_GET_SYSTEM_GUID:
+      if (ResponseDataSize == sizeof (Identity->SystemGuid)) {
+        CopyMem (&Identity->SystemGuid, ResponseData, ResponseDataSize);
+        Identity->Valid |= IPMI_BMC_IDENTITY_SYSTEM_GUID;
+      }
+
+      break;
+
+    case IPMI_APP_GET_SYSTEM_INTERFACE_CAPABILITIES:
+      if ((CommandDataSize > 0) && (ResponseDataSize <= sizeof (Identity->InterfaceCap))) {
+        CopyMem (&Identity->InterfaceCap, ResponseData, ResponseDataSize);
+        Identity->InterfaceCapSize = (UINT8)ResponseDataSize;
+        Identity->InterfaceType    = CommandData[0] & 0x0F;
+        Identity->Valid           |= IPMI_BMC_IDENTITY_INTERFACE_CAP;
+        IpmiTransportSetCapabilities (Identity->InterfaceType, ResponseData, ResponseDataSize);
+      }
+
+      break;
+
+    default:
+      break;
+  }
+}
+
+/**
+  Restores the BMC identity read by an earlier boot phase and hands the
+  interface capabilities in it to the transport.
+
+  @param[in,out]  IpmiInstance      The IPMI instance to restore the identity of.
+  @param[in]      Identity          The identity read by the earlier phase.
+**/
+VOID
+IpmiIdentityRestore (
+  IN OUT IPMI_BMC_INSTANCE_DATA  *IpmiInstance,
+  IN     IPMI_BMC_IDENTITY       *Identity
+  )
+{
+  CopyMem (&IpmiInstance->Identity, Identity, sizeof (IpmiInstance->Identity));
+  if ((Identity->Valid & IPMI_BMC_IDENTITY_INTERFACE_CAP) != 0) {
+    IpmiTransportSetCapabilities (
+      Identity->InterfaceType,
+      (UINT8 *)&Identity->InterfaceCap,
+      Identity->InterfaceCapSize
+      );
+  }
+}
+
+/**
+  Answers a command from the cached BMC identity.
+
+  @param[in,out]  IpmiInstance      The IPMI instance.
+  @param[in]      NetFunction       Net Function of the command.
+  @param[in]      Lun               LUN of the command.
+  @param[in]      Command           The IPMI command.
+  @param[in]      CommandData       The request data of the command.
+  @param[in]      CommandDataSize   The size of the request data.
+  @param[in,out]  ResponseData      Pointer to response data buffer. Optional depending on command being sent.
+  @param[in,out]  ResponseDataSize  Pointer to response data buffer size. Optional depending on command being sent.
+  @param[out]     Status            The status of the command when it was answered.
+
+  @retval TRUE    The command was answered from the cache.
+  @retval FALSE   The response is not cached, the command must be sent to the BMC.
+**/
+STATIC
+BOOLEAN
+IpmiIdentityLookup (
+  IN OUT  IPMI_BMC_INSTANCE_DATA  *IpmiInstance,
+  IN      UINT8                   NetFunction,
+  IN      UINT8                   Lun,
+  IN      UINT8                   Command,
+  IN      UINT8                   *CommandData,
+  IN      UINT32                  CommandDataSize,
+  IN OUT  UINT8                   *ResponseData OPTIONAL,
+  IN OUT  UINT32                  *ResponseDataSize OPTIONAL,
+  OUT     EFI_STATUS              *Status
+  )
+{
+  IPMI_BMC_IDENTITY  *Identity;
+  UINT32             Flag;
+  VOID               *Cached;
+  UINT32             Size;
+
+  Identity = &IpmiInstance->Identity;
+  if ((Identity->Valid == 0) || (NetFunction != IPMI_NETFN_APP) || (Lun != 0)) {
+    return FALSE;
+  }
+
+  switch (Command) {
+    case IPMI_APP_GET_DEVICE_ID:
+      Flag   = IPMI_BMC_IDENTITY_DEVICE_ID;
+      Cached = &Identity->DeviceId;
+      Size   = Identity->DeviceIdSize;
+      break;
+
+    case IPMI_APP_GET_SELFTEST_RESULTS:
+      Flag   = IPMI_BMC_IDENTITY_SELF_TEST;
+      Cached = &Identity->SelfTest;
+      Size   = sizeof (Identity->SelfTest);
+      break;
+
+    case IPMI_APP_GET_SYSTEM_GUID:
+      Flag   = IPMI_BMC_IDENTITY_SYSTEM_GUID;
+      Cached = &Identity->SystemGuid;
+      Size   = sizeof (Identity->SystemGuid);
+      break;
+
+    case IPMI_APP_GET_SYSTEM_INTERFACE_CAPABILITIES:
       //
-      // If the completion code is not normal and the BMC is in Force Update
-      // mode, then update the error status and return EFI_UNSUPPORTED.
-      //
-      UpdateErrorStatus (
-        IpmiResponse->CompletionCode,
-        IpmiInstance
-        );
-      return EFI_UNSUPPORTED;
-    } else if (IpmiResponse->CompletionCode != IPMI_COMP_CODE_NORMAL) {
-      //
-      // Otherwise if the BMC is in normal mode, but the completion code
-      // is not normal, then update the error status and return device error.
-      //
-      UpdateErrorStatus (
-        IpmiResponse->CompletionCode,
-        IpmiInstance
-        );
-      //
-      // Intel Server System Integrated Baseboard Management Controller (BMC) Firmware v0.62
-      // D4h C Insufficient privilege, in KCS channel this indicates KCS Policy Control Mode is Deny All.
-      // In authenticated channels this indicates invalid authentication/privilege.
+      // Only the capabilities of the interface that was asked for are cached.
       //
-      if (IpmiResponse->CompletionCode == IPMI_COMP_CODE_INSUFFICIENT_PRIVILEGE) {
-        return EFI_SECURITY_VIOLATION;
-      } else {
-        return EFI_DEVICE_ERROR;
+      if ((CommandDataSize == 0) || ((CommandData[0] & 0x0F) != Identity->InterfaceType)) {
+        return FALSE;
       }
+
+      Flag   = IPMI_BMC_IDENTITY_INTERFACE_CAP;
+      Cached = &Identity->InterfaceCap;
+      Size   = Identity->InterfaceCapSize;
+      break;
+
+    default:
+      return FALSE;
+  }
+
+  if ((Identity->Valid & Flag) == 0) {
+    return FALSE;
+  }
+
+  IpmiInstance->LastCompletionCode = IPMI_COMP_CODE_NORMAL;
+  if (ResponseData == NULL) {
+    *Status = EFI_SUCCESS;
+  } else if (*ResponseDataSize < Size) {
+    *ResponseDataSize = Size;
+    *Status           = EFI_BUFFER_TOO_SMALL;
+  } else {
+    CopyMem (ResponseData, Cached, Size);
+    *ResponseDataSize = Size;
+    *Status           = EFI_SUCCESS;
+  }
+
+  return TRUE;
+}
+
+/**
+  Completes a transaction, ending its transport session and recording it in
+  the trace. Commands answered from the cached BMC identity never reach the
+  BMC and are not traced, so they do not skew the latency statistics.
+
+  @param[in,out]  IpmiInstance    The IPMI instance the transaction is on.
+  @param[in,out]  Transaction     The transaction to complete.
+  @param[in]      Status          The result of the transaction.
+
+  @retval TRUE    Always, for the convenience of the callers.
+**/
+STATIC
+BOOLEAN
+IpmiTransactionFinish (
+  IN OUT IPMI_BMC_INSTANCE_DATA  *IpmiInstance,
+  IN OUT IPMI_TRANSACTION        *Transaction,
+  IN     EFI_STATUS              Status
+  )
+{
+  UINT32   ResponseSize;
+  BOOLEAN  Sent;
+
+  Sent = Transaction->Session;
+  if (Sent) {
+    IpmiTransportEndSession ();
+    Transaction->Session = FALSE;
+  }
+
+  Transaction->InFlight       = FALSE;
+  Transaction->Status         = Status;
+  Transaction->CompletionCode = IpmiInstance->LastCompletionCode;
+
+  //
+  // The identity of the BMC may change once it has been reset.
+  //
+  if (!EFI_ERROR (Status) && (Transaction->NetFunction == IPMI_NETFN_APP) &&
+      ((Transaction->Command == IPMI_APP_COLD_RESET) || (Transaction->Command == IPMI_APP_WARM_RESET)))
+  {
+    IpmiInstance->Identity.Valid = 0;
+  }
+
+  if (Sent && (IpmiInstance->Trace != NULL)) {
+    ResponseSize = 0;
+    if ((Transaction->ResponseDataSize != NULL) && (!EFI_ERROR (Status) || (Status == EFI_BUFFER_TOO_SMALL))) {
+      ResponseSize = *Transaction->ResponseDataSize;
     }
 
+    IpmiTraceRecord (
+      IpmiInstance->Trace,
+      Transaction->NetFunction,
+      Transaction->Command,
+      Transaction->CompletionCode,
+      Transaction->Resends,
+      Transaction->CommandDataSize,
+      ResponseSize,
+      Status,
+      Transaction->StartTime,
+      GetPerformanceCounter ()
+      );
+  }
+
+  return TRUE;
+}
+
+/**
+  Starts a transaction for an IPMI command. Commands answered from the cached
+  BMC identity, and invalid commands, complete at once. Otherwise the
+  transaction is advanced with IpmiTransactionStep.
+
+  @param[in,out]  IpmiInstance      The IPMI instance to send the command on.
+  @param[out]     Transaction       The transaction to start.
+  @param[in]      NetFunction       Net Function of command to send.
+  @param[in]      Lun               LUN of command to send.
+  @param[in]      Command           IPMI command to send.
+  @param[in]      CommandData       Pointer to command data buffer, if needed.
+  @param[in]      CommandDataSize   Size of command data buffer.
+  @param[in,out]  ResponseData      Pointer to response data buffer. Optional depending on command being sent.
+  @param[in,out]  ResponseDataSize  Pointer to response data buffer size. Optional depending on command being sent.
+
+  @retval   TRUE    The transaction is complete, its result is in Status.
+  @retval   FALSE   The request must be sent with IpmiTransactionStep.
+**/
+BOOLEAN
+IpmiTransactionStart (
+  IN OUT  IPMI_BMC_INSTANCE_DATA  *IpmiInstance,
+  OUT     IPMI_TRANSACTION        *Transaction,
+  IN      UINT8                   NetFunction,
+  IN      UINT8                   Lun,
+  IN      UINT8                   Command,
+  IN      UINT8                   *CommandData,
+  IN      UINT32                  CommandDataSize,
+  IN OUT  UINT8                   *ResponseData OPTIONAL,
+  IN OUT  UINT32                  *ResponseDataSize OPTIONAL
+  )
+{
+  EFI_STATUS  Status;
+
+  ZeroMem (Transaction, sizeof (*Transaction));
+  Transaction->CompletionCode = IPMI_COMP_CODE_UNSPECIFIED;
+  Transaction->Status         = EFI_INVALID_PARAMETER;
+  if ((CommandDataSize > 0) && (CommandData == NULL)) {
+    return TRUE;
+  }
+
+  //
+  // ResponseData and ResponseDataSize cannot be mismatched.
+  // Either both NULL are NULL or both are Non-Null, depending
+  // on the command being sent.
+  //
+  if ((ResponseData != NULL) != (ResponseDataSize != NULL)) {
+    return TRUE;
+  }
+
+  Transaction->NetFunction      = NetFunction;
+  Transaction->Lun              = Lun;
+  Transaction->Command          = Command;
+  Transaction->CommandData      = CommandData;
+  Transaction->CommandDataSize  = CommandDataSize;
+  Transaction->ResponseData     = ResponseData;
+  Transaction->ResponseDataSize = ResponseDataSize;
+  Transaction->RetryCount       = MAX (PcdGet8 (PcdIpmiCommandMaxReties), 1);
+  Transaction->StartTime        = (IpmiInstance->Trace != NULL) ? GetPerformanceCounter () : 0;
+
+  //
+  // The BMC identity is answered without reaching the BMC.
+  //
+  if (IpmiIdentityLookup (
+        IpmiInstance,
+        NetFunction,
+        Lun,
+        Command,
+        CommandData,
+        CommandDataSize,
+        ResponseData,
+        ResponseDataSize,
+        &Status
+        ))
+  {
+    return IpmiTransactionFinish (IpmiInstance, Transaction, Status);
+  }
+
+  //
+  // The request, its response and any resends share one transport session.
+  //
+  IpmiTransportBeginSession ();
+  Transaction->Session = TRUE;
+  return FALSE;
+}
+
+/**
+  Advances a transaction by one step. The request is sent if it is not in
+  flight, otherwise its response is received, blocking until the BMC has it
+  ready or the timeout passes. When the command must be sent again the
+  request is no longer in flight and Backoff holds the time the caller waits
+  before the next step.
+
+  @param[in,out]  IpmiInstance    The IPMI instance the transaction is on.
+  @param[in,out]  Transaction     The transaction to advance.
+
+  @retval   TRUE    The transaction is complete, its result is in Status.
+  @retval   FALSE   The transaction needs further steps.
+**/
+BOOLEAN
+IpmiTransactionStep (
+  IN OUT IPMI_BMC_INSTANCE_DATA  *IpmiInstance,
+  IN OUT IPMI_TRANSACTION        *Transaction
+  )
+{
+  EFI_STATUS  Status;
+  BOOLEAN     Retry;
+
+  Transaction->Backoff = 0;
+  if (!Transaction->InFlight) {
+    Status = IpmiSendRequest (
+               IpmiInstance,
+               Transaction->NetFunction,
+               Transaction->Lun,
+               Transaction->Command,
+               Transaction->CommandData,
+               Transaction->CommandDataSize
+               );
+
+    if (EFI_ERROR (Status)) {
+      return IpmiTransactionFinish (IpmiInstance, Transaction, Status);
+    }
+
+    Transaction->InFlight = TRUE;
+    return FALSE;
+  }
+
+  Transaction->InFlight = FALSE;
+  Status                = IpmiReceiveResponse (
+                            IpmiInstance,
+                            Transaction->NetFunction,
+                            Transaction->Command,
+                            Transaction->ResponseData,
+                            Transaction->ResponseDataSize,
+                            &Retry
+                            );
+
+  if (Retry) {
     //
-    // If we got this far without any error codes, but the DataSize is 0 then the
-    // command response failed, so do not continue.
+    // Send the command again if the response was for a different command.
     //
-    if (DataSize < IPMI_RESPONSE_HEADER_SIZE) {
-      return EFI_DEVICE_ERROR;
+    if (--Transaction->RetryCount == 0) {
+      return IpmiTransactionFinish (IpmiInstance, Transaction, Status);
     }
-
+  } else if ((Status == EFI_DEVICE_ERROR) || (Status == EFI_UNSUPPORTED)) {
     //
-    // Verify the response data buffer passed in is big enough.
+    // Send the command again if the completion code is a transient error.
     //
-    if ((ResponseDataSize != NULL) && ((DataSize - IPMI_RESPONSE_HEADER_SIZE) > *ResponseDataSize)) {
-      //
-      // Verify the response data matched with the cmd sent.
-      //
-      if ((IpmiResponse->NetFunction != (NetFunction | 0x1)) || (IpmiResponse->Command != Command)) {
-        if (0 == RetryCnt) {
-          return EFI_DEVICE_ERROR;
-        } else {
-          continue;
-        }
-      }
+    if (!IpmiRetryPolicyLookup (
+           IpmiInstance,
+           Transaction->NetFunction,
+           Transaction->Command,
+           Transaction->PolicyRetries,
+           &Transaction->Backoff
+           ))
+    {
+      return IpmiTransactionFinish (IpmiInstance, Transaction, Status);
+    }
 
-      //
-      // return the required size. Total size - header size  + 1 byte for
-      // completion code.
-      //
+    Transaction->PolicyRetries++;
+  } else {
+    return IpmiTransactionFinish (IpmiInstance, Transaction, Status);
+  }
+
+  if (Transaction->Resends < MAX_UINT8) {
+    Transaction->Resends++;
+  }
+
+  return FALSE;
+}
+
+/**
+  Runs a transaction to completion, waiting out the backoff between sends.
 
-      *ResponseDataSize = DataSize - IPMI_RESPONSE_HEADER_SIZE + 1;
-      return EFI_BUFFER_TOO_SMALL;
+  @param[in,out]  IpmiInstance    The IPMI instance the transaction is on.
+  @param[in,out]  Transaction     The started transaction.
+
+  @retval   The status of the transaction.
+**/
+EFI_STATUS
+IpmiTransactionRun (
+  IN OUT IPMI_BMC_INSTANCE_DATA  *IpmiInstance,
+  IN OUT IPMI_TRANSACTION        *Transaction
+  )
+{
+  while (!IpmiTransactionStep (IpmiInstance, Transaction)) {
+    if (Transaction->Backoff != 0) {
+      MicroSecondDelay (Transaction->Backoff);
     }
+  }
+
+  return Transaction->Status;
+}
+
+/**
+  Send IPMI command to BMC
+
+  @param[in]      This              Pointer to IPMI protocol instance.
+  @param[in]      NetFunction       Net Function of command to send.
+  @param[in]      Lun               LUN of command to send.
+  @param[in]      Command           IPMI command to send.
+  @param[in]      CommandData       Pointer to command data buffer, if needed.
+  @param[in]      CommandDataSize   Size of command data buffer.
+  @param[in,out]  ResponseData      Pointer to response data buffer. Optional depending on command being sent.
+  @param[in,out]  ResponseDataSize  Pointer to response data buffer size. Optional depending on command being sent.
 
-    break;
+  @retval   EFI_INVALID_PARAMETER   One of the input values is bad.
+  @retval   EFI_DEVICE_ERROR        IPMI command failed.
+  @retval   EFI_NO_RESPONSE         The BMC stopped responding and the command
+                                    was not sent.
+  @retval   EFI_BUFFER_TOO_SMALL    Response buffer is too small.
+  @retval   EFI_SUCCESS             Command completed successfully.
+**/
+EFI_STATUS
+EFIAPI
+IpmiSendCommandInternal (
+  IN      IPMI_TRANSPORT  *This,
+  IN      UINT8           NetFunction,
+  IN      UINT8           Lun,
+  IN      UINT8           Command,
+  IN      UINT8           *CommandData,
+  IN      UINT32          CommandDataSize,
+  IN OUT  UINT8           *ResponseData OPTIONAL,
+  IN OUT  UINT32          *ResponseDataSize OPTIONAL
+  )
+{
+  IPMI_BMC_INSTANCE_DATA  *IpmiInstance;
+  IPMI_TRANSACTION        Transaction;
+
+  IpmiInstance = INSTANCE_FROM_SM_IPMI_BMC_THIS (This);
+  if (IpmiTransactionStart (
+        IpmiInstance,
+        &Transaction,
+        NetFunction,
+        Lun,
+        Command,
+        CommandData,
+        CommandDataSize,
+        ResponseData,
+        ResponseDataSize
+        ))
+  {
+    return Transaction.Status;
   }
 
-  if ((ResponseData != NULL) && (ResponseDataSize != NULL)) {
+  return IpmiTransactionRun (IpmiInstance, &Transaction);
+}
+
+/**
+  Sends a list of IPMI commands to the BMC back-to-back. The status and
+  completion code of each command are returned in its entry.
+
+  @param[in]      This          Pointer to IPMI protocol instance.
+  @param[in,out]  Entries       The commands to send and their results.
+  @param[in]      EntryCount    The number of entries in Entries.
+  @param[in]      Flags         IPMI_BATCH_* flags controlling the batch.
+
+  @retval   EFI_SUCCESS             All entries completed successfully.
+  @retval   EFI_INVALID_PARAMETER   Entries is NULL or Flags is invalid.
+  @retval   Other                   The status of the first failed entry.
+**/
+EFI_STATUS
+EFIAPI
+IpmiSubmitBatchInternal (
+  IN      IPMI_TRANSPORT    *This,
+  IN OUT  IPMI_BATCH_ENTRY  *Entries,
+  IN      UINTN             EntryCount,
+  IN      UINT32            Flags
+  )
+{
+  IPMI_BMC_INSTANCE_DATA  *IpmiInstance;
+  IPMI_BATCH_ENTRY        *Entry;
+  EFI_STATUS              Status;
+  UINTN                   Index;
+  UINT32                  ResponseDataSize;
+
+  if (((Entries == NULL) && (EntryCount > 0)) || ((Flags & ~IPMI_BATCH_STOP_ON_ERROR) != 0)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  IpmiInstance = INSTANCE_FROM_SM_IPMI_BMC_THIS (This);
+  Status       = EFI_SUCCESS;
+
+  //
+  // The whole batch shares one transport session.
+  //
+  IpmiTransportBeginSession ();
+
+  for (Index = 0; Index < EntryCount; Index++) {
+    Entry = &Entries[Index];
+
     //
-    // Copy data over to the response data buffer.
+    // Once an entry has failed the rest of the batch is skipped if requested.
     //
-    *ResponseDataSize = DataSize - IPMI_RESPONSE_HEADER_SIZE;
-    CopyMem (
-      ResponseData,
-      IpmiResponse->ResponseData,
-      *ResponseDataSize
-      );
+    if (EFI_ERROR (Status) && ((Flags & IPMI_BATCH_STOP_ON_ERROR) != 0)) {
+      Entry->CompletionCode = IPMI_COMP_CODE_UNSPECIFIED;
+      Entry->Status         = EFI_ABORTED;
+      continue;
+    }
 
     //
-    // Add completion code in response data to meet the requirement of IPMI spec 2.0
+    // Commands without response data are sent with no response buffer.
     //
-    *ResponseDataSize += 1;   // Add one byte for Completion Code
-    for (Index = 1; Index < *ResponseDataSize; Index++) {
-      ResponseData[*ResponseDataSize - Index] = ResponseData[*ResponseDataSize - (Index + 1)];
-    }
+    ResponseDataSize                 = Entry->ResponseDataSize;
+    IpmiInstance->LastCompletionCode = IPMI_COMP_CODE_UNSPECIFIED;
+    Entry->Status                    = IpmiSendCommandInternal (
+                                         This,
+                                         Entry->NetFunction,
+                                         Entry->Lun,
+                                         Entry->Command,
+                                         Entry->CommandData,
+                                         Entry->CommandDataSize,
+                                         Entry->ResponseData,
+                                         (Entry->ResponseData != NULL) ? &ResponseDataSize : NULL
+                                         );
 
-    ResponseData[0] = IpmiResponse->CompletionCode;
+    Entry->ResponseDataSize = (Entry->ResponseData != NULL) ? ResponseDataSize : 0;
+    Entry->CompletionCode   = IpmiInstance->LastCompletionCode;
+
+    if (EFI_ERROR (Entry->Status)) {
+      DEBUG ((
+        DEBUG_ERROR,
+        "[IPMI] Batch entry %d (NetFn 0x%x Cmd 0x%x) failed. CC 0x%x (%r)\n",
+        Index,
+        Entry->NetFunction,
+        Entry->Command,
+        Entry->CompletionCode,
+        Entry->Status
+        ));
+
+      if (!EFI_ERROR (Status)) {
+        Status = Entry->Status;
+      }
+    }
   }
 
-  IpmiInstance->BmcStatus = BMC_OK;
-  return EFI_SUCCESS;
+  IpmiTransportEndSession ();
+  return Status;
 }
 
 /**
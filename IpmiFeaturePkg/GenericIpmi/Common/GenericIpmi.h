@@ -13,16 +13,24 @@
 #include <IndustryStandard/Ipmi.h>
 #include <Library/BaseMemoryLib.h>
 #include <Library/DebugLib.h>
-#include <Library/IpmiTransportLib.h>
+#include <Library/IpmiTransportExLib.h>
 #include <IpmiInterface.h>
 
 #include <IpmiHooks.h>
+#include <IpmiTrace.h>
 
 #define IPMI_DELAY_UNIT    50   // Unit is microseconds.
-#define MAX_TEMP_DATA      255
 #define BMC_SLAVE_ADDRESS  0x20
 #define MAX_SOFT_COUNT     10
 
+//
+// Size of the instance buffer holding the responses read while initializing
+// the BMC, and the completion code of commands sent without a response
+// buffer. Other responses are received straight into the caller's buffer, so
+// message sizes are only bounded by GetBmcMaxMessageSize of the transport.
+//
+#define IPMI_TEMP_DATA_SIZE  64
+
 #define COMPLETION_CODES \
   { \
     IPMI_COMP_CODE_NODE_BUSY, IPMI_COMP_CODE_TIMEOUT, IPMI_COMP_CODE_OUT_OF_SPACE, \
@@ -44,52 +52,124 @@
   SM_IPMI_BMC_SIGNATURE \
   )
 
+#define INSTANCE_FROM_SM_IPMI_BMC_THIS2(a) \
+  CR ( \
+  a, \
+  IPMI_BMC_INSTANCE_DATA, \
+  IpmiTransport2, \
+  SM_IPMI_BMC_SIGNATURE \
+  )
+
+//
+// States of the circuit breaker that stops commands from being sent to a BMC
+// that no longer responds. While open, commands fail at once until a probe
+// command gets a response. The probe is sent half-open.
+//
+typedef enum {
+  IpmiBreakerClosed,
+  IpmiBreakerOpen,
+  IpmiBreakerHalfOpen
+} IPMI_BREAKER_STATE;
+
+//
+// Circuit breaker of an IPMI instance. The breaker is disarmed while Threshold
+// is 0, which keeps BMC initialization from failing fast.
+//
+typedef struct {
+  IPMI_BREAKER_STATE    State;
+  UINT8                 Threshold;
+  UINT8                 Failures;
+  UINT64                CounterStart;   // Performance counter properties
+  UINT64                CounterEnd;
+  UINT64                OpenTime;       // Performance counter when opened
+  UINT64                ProbeInterval;  // Performance counter ticks
+} IPMI_CIRCUIT_BREAKER;
+
 //
 // Dxe Ipmi instance data
 //
 typedef struct {
-  UINTN             Signature;
-  UINT64            IpmiTimeoutPeriod;
-  UINT8             SlaveAddress;
-  UINT8             TempData[MAX_TEMP_DATA];
-  BMC_STATUS        BmcStatus;
-  UINT64            ErrorStatus;
-  UINT8             SoftErrorCount;
-  IPMI_TRANSPORT    IpmiTransport;
+  UINTN                   Signature;
+  UINT64                  IpmiTimeoutPeriod;        // Microseconds
+  UINT8                   SlaveAddress;
+  UINT8                   TempData[IPMI_TEMP_DATA_SIZE];
+  BMC_STATUS              BmcStatus;
+  UINT64                  ErrorStatus;
+  UINT8                   SoftErrorCount;
+  UINT8                   LastCompletionCode;
+  IPMI_TRANSPORT          IpmiTransport;
+  IPMI_TRANSPORT2         IpmiTransport2;
+  IPMI_TRACE_DATA         *Trace;
+  IPMI_CIRCUIT_BREAKER    Breaker;
+  IPMI_BMC_IDENTITY       Identity;
 } IPMI_BMC_INSTANCE_DATA;
 
 #pragma pack(1)
 
 //
-// Structure of IPMI Command buffer
+// Structure of the NetFn/LUN and command header shared by IPMI requests and
+// responses.
 //
-#define IPMI_COMMAND_HEADER_SIZE  2
-
 typedef struct {
   UINT8    Lun         : 2;
   UINT8    NetFunction : 6;
   UINT8    Command;
-  UINT8    CommandData[MAX_TEMP_DATA - IPMI_COMMAND_HEADER_SIZE];
-} IPMI_COMMAND;
+} IPMI_MESSAGE_HEADER;
 
 //
-// Structure of IPMI Command response buffer
+// Size of the header of a request, and of a response with its completion code.
 //
+#define IPMI_COMMAND_HEADER_SIZE   2
 #define IPMI_RESPONSE_HEADER_SIZE  3
 
+//
+// Entry of the completion code retry policy table in PcdIpmiRetryPolicy. The
+// first entry matching the completion code, NetFn and command of a response
+// decides how often the command is sent again. IPMI_RETRY_ANY matches any
+// NetFn or command. Backoff is the delay in milliseconds before the first
+// retry and doubles for every further retry.
+//
+#define IPMI_RETRY_ANY  0xFF
+
 typedef struct {
-  UINT8    Lun         : 2;
-  UINT8    NetFunction : 6;
-  UINT8    Command;
   UINT8    CompletionCode;
-  UINT8    ResponseData[MAX_TEMP_DATA - IPMI_RESPONSE_HEADER_SIZE];
-} IPMI_RESPONSE;
+  UINT8    NetFunction;
+  UINT8    Command;
+  UINT8    Retries;
+  UINT8    Backoff;
+} IPMI_RETRY_POLICY;
 
 #pragma pack()
 
+//
+// State of one IPMI command from its first send to its final response. The
+// same transaction drives the synchronous interfaces and the DXE asynchronous
+// queue, so both resend, back off, answer from the identity cache and hold
+// the transport session the same way.
+//
+typedef struct {
+  UINT8         NetFunction;
+  UINT8         Lun;
+  UINT8         Command;
+  UINT8         *CommandData;
+  UINT32        CommandDataSize;
+  UINT8         *ResponseData;
+  UINT32        *ResponseDataSize;
+  UINT8         RetryCount;       // Sends left for responses to other commands
+  UINT8         PolicyRetries;    // Resends made under PcdIpmiRetryPolicy
+  UINT8         Resends;          // Resends made for any reason
+  BOOLEAN       InFlight;         // The request was sent, the response is pending
+  BOOLEAN       Session;          // A transport session is held
+  UINT32        Backoff;          // Microseconds to wait before the next send
+  UINT64        StartTime;
+  UINT8         CompletionCode;
+  EFI_STATUS    Status;
+} IPMI_TRANSACTION;
+
 /**
   Initializes the IPMI state for the BMC. This includes performs platform
-  specific logic, getting the device ID, and checking self-test results.
+  specific logic, getting the device ID, checking self-test results and
+  caching the identity of the BMC.
 
   @param[in,out]  IpmiInstance    The IPMI instance being initialized.
 
@@ -102,6 +182,174 @@ IpmiInitializeBmc (
   IN IPMI_BMC_INSTANCE_DATA  *IpmiInstance
   );
 
+/**
+  Arms the circuit breaker of an IPMI instance. Called once the BMC has been
+  initialized so that the retries of initialization are not cut short.
+
+  @param[in,out]  IpmiInstance    The IPMI instance.
+**/
+VOID
+IpmiCircuitBreakerInitialize (
+  IN OUT IPMI_BMC_INSTANCE_DATA  *IpmiInstance
+  );
+
+/**
+  Saves the response to a command describing the BMC identity so that later
+  requests for it are answered without reaching the BMC. Responses to other
+  commands and unsuccessful responses are ignored.
+
+  @param[in,out]  IpmiInstance      The IPMI instance.
+  @param[in]      Command           The IPMI_NETFN_APP command the response is for.
+  @param[in]      CommandData       The request data of the command.
+  @param[in]      CommandDataSize   The size of the request data.
+  @param[in]      ResponseData      The response, starting with the completion code.
+  @param[in]      ResponseDataSize  The size of the response.
+**/
+VOID
+IpmiIdentitySave (
+  IN OUT IPMI_BMC_INSTANCE_DATA  *IpmiInstance,
+  IN     UINT8                   Command,
+  IN     UINT8                   *CommandData,
+  IN     UINT32                  CommandDataSize,
+  IN     UINT8                   *ResponseData,
+  IN     UINT32                  ResponseDataSize
+  );
+
+/**
+  Restores the BMC identity read by an earlier boot phase and hands the
+  interface capabilities in it to the transport.
+
+  @param[in,out]  IpmiInstance      The IPMI instance to restore the identity of.
+  @param[in]      Identity          The identity read by the earlier phase.
+**/
+VOID
+IpmiIdentityRestore (
+  IN OUT IPMI_BMC_INSTANCE_DATA  *IpmiInstance,
+  IN     IPMI_BMC_IDENTITY       *Identity
+  );
+
+/**
+  Sends an IPMI request to the BMC without waiting for the response. The
+  response must be collected with IpmiReceiveResponse.
+
+  @param[in]      IpmiInstance      The IPMI instance to send the request on.
+  @param[in]      NetFunction       Net Function of command to send.
+  @param[in]      Lun               LUN of command to send.
+  @param[in]      Command           IPMI command to send.
+  @param[in]      CommandData       Pointer to command data buffer, if needed.
+  @param[in]      CommandDataSize   Size of command data buffer.
+
+  @retval   EFI_SUCCESS             The request was sent.
+  @retval   EFI_INVALID_PARAMETER   The command data is larger than the
+                                    transport can carry.
+  @retval   EFI_NO_RESPONSE         The circuit breaker is open.
+  @retval   Other                   The transport failed to send the request.
+**/
+EFI_STATUS
+EFIAPI
+IpmiSendRequest (
+  IN IPMI_BMC_INSTANCE_DATA  *IpmiInstance,
+  IN UINT8                   NetFunction,
+  IN UINT8                   Lun,
+  IN UINT8                   Command,
+  IN UINT8                   *CommandData,
+  IN UINT32                  CommandDataSize
+  );
+
+/**
+  Receives the BMC response to a request sent with IpmiSendRequest and checks
+  the completion code.
+
+  @param[in]      IpmiInstance      The IPMI instance the request was sent on.
+  @param[in]      NetFunction       Net Function of the command sent.
+  @param[in]      Command           IPMI command sent.
+  @param[in,out]  ResponseData      Pointer to response data buffer. Optional depending on command being sent.
+  @param[in,out]  ResponseDataSize  Pointer to response data buffer size. Optional depending on command being sent.
+  @param[out]     Retry             Set to TRUE when the response did not
+                                    belong to the request and the request
+                                    should be sent again.
+
+  @retval   EFI_DEVICE_ERROR        IPMI command failed.
+  @retval   EFI_SECURITY_VIOLATION  The BMC denied the command.
+  @retval   EFI_UNSUPPORTED         The command failed while the BMC is in update mode.
+  @retval   EFI_BUFFER_TOO_SMALL    Response buffer is too small.
+  @retval   EFI_SUCCESS             Command completed successfully.
+**/
+EFI_STATUS
+EFIAPI
+IpmiReceiveResponse (
+  IN      IPMI_BMC_INSTANCE_DATA  *IpmiInstance,
+  IN      UINT8                   NetFunction,
+  IN      UINT8                   Command,
+  IN OUT  UINT8                   *ResponseData OPTIONAL,
+  IN OUT  UINT32                  *ResponseDataSize OPTIONAL,
+  OUT     BOOLEAN                 *Retry
+  );
+
+/**
+  Starts a transaction for an IPMI command. Commands answered from the cached
+  BMC identity, and invalid commands, complete at once. Otherwise the
+  transaction is advanced with IpmiTransactionStep.
+
+  @param[in,out]  IpmiInstance      The IPMI instance to send the command on.
+  @param[out]     Transaction       The transaction to start.
+  @param[in]      NetFunction       Net Function of command to send.
+  @param[in]      Lun               LUN of command to send.
+  @param[in]      Command           IPMI command to send.
+  @param[in]      CommandData       Pointer to command data buffer, if needed.
+  @param[in]      CommandDataSize   Size of command data buffer.
+  @param[in,out]  ResponseData      Pointer to response data buffer. Optional depending on command being sent.
+  @param[in,out]  ResponseDataSize  Pointer to response data buffer size. Optional depending on command being sent.
+
+  @retval   TRUE    The transaction is complete, its result is in Status.
+  @retval   FALSE   The request must be sent with IpmiTransactionStep.
+**/
+BOOLEAN
+IpmiTransactionStart (
+  IN OUT  IPMI_BMC_INSTANCE_DATA  *IpmiInstance,
+  OUT     IPMI_TRANSACTION        *Transaction,
+  IN      UINT8                   NetFunction,
+  IN      UINT8                   Lun,
+  IN      UINT8                   Command,
+  IN      UINT8                   *CommandData,
+  IN      UINT32                  CommandDataSize,
+  IN OUT  UINT8                   *ResponseData OPTIONAL,
+  IN OUT  UINT32                  *ResponseDataSize OPTIONAL
+  );
+
+/**
+  Advances a transaction by one step. The request is sent if it is not in
+  flight, otherwise its response is received, blocking until the BMC has it
+  ready or the timeout passes. When the command must be sent again the
+  request is no longer in flight and Backoff holds the time the caller waits
+  before the next step.
+
+  @param[in,out]  IpmiInstance    The IPMI instance the transaction is on.
+  @param[in,out]  Transaction     The transaction to advance.
+
+  @retval   TRUE    The transaction is complete, its result is in Status.
+  @retval   FALSE   The transaction needs further steps.
+**/
+BOOLEAN
+IpmiTransactionStep (
+  IN OUT IPMI_BMC_INSTANCE_DATA  *IpmiInstance,
+  IN OUT IPMI_TRANSACTION        *Transaction
+  );
+
+/**
+  Runs a transaction to completion, waiting out the backoff between sends.
+
+  @param[in,out]  IpmiInstance    The IPMI instance the transaction is on.
+  @param[in,out]  Transaction     The started transaction.
+
+  @retval   The status of the transaction.
+**/
+EFI_STATUS
+IpmiTransactionRun (
+  IN OUT IPMI_BMC_INSTANCE_DATA  *IpmiInstance,
+  IN OUT IPMI_TRANSACTION        *Transaction
+  );
+
 /**
   Send IPMI command to BMC
 
@@ -116,6 +364,8 @@ IpmiInitializeBmc (
 
   @retval   EFI_INVALID_PARAMETER   One of the input values is bad.
   @retval   EFI_DEVICE_ERROR        IPMI command failed.
+  @retval   EFI_NO_RESPONSE         The BMC stopped responding and the command
+                                    was not sent.
   @retval   EFI_BUFFER_TOO_SMALL    Response buffer is too small.
   @retval   EFI_SUCCESS             Command completed successfully.
 **/
@@ -127,9 +377,31 @@ IpmiSendCommandInternal (
   IN      UINT8           Lun,
   IN      UINT8           Command,
   IN      UINT8           *CommandData,
-  IN      UINT8           CommandDataSize,
+  IN      UINT32          CommandDataSize,
   IN OUT  UINT8           *ResponseData OPTIONAL,
-  IN OUT  UINT8           *ResponseDataSize OPTIONAL
+  IN OUT  UINT32          *ResponseDataSize OPTIONAL
+  );
+
+/**
+  Sends a list of IPMI commands to the BMC back-to-back. The status and
+  completion code of each command are returned in its entry.
+
+  @param[in]      This          Pointer to IPMI protocol instance.
+  @param[in,out]  Entries       The commands to send and their results.
+  @param[in]      EntryCount    The number of entries in Entries.
+  @param[in]      Flags         IPMI_BATCH_* flags controlling the batch.
+
+  @retval   EFI_SUCCESS             All entries completed successfully.
+  @retval   EFI_INVALID_PARAMETER   Entries is NULL or Flags is invalid.
+  @retval   Other                   The status of the first failed entry.
+**/
+EFI_STATUS
+EFIAPI
+IpmiSubmitBatchInternal (
+  IN      IPMI_TRANSPORT    *This,
+  IN OUT  IPMI_BATCH_ENTRY  *Entries,
+  IN      UINTN             EntryCount,
+  IN      UINT32            Flags
   );
 
 /**
@@ -58,9 +58,9 @@ Returns:
            Lun,
            Command,
            CommandData,
-           (UINT8)CommandDataSize,
+           CommandDataSize,
            ResponseData,
-           (UINT8 *)ResponseDataSize
+           ResponseDataSize
            );
 } // IpmiSendCommand()
 
@@ -96,3 +96,128 @@ Returns:
            ComAddress
            );
 }
+
+/**
+  Send IPMI command to BMC through the IPMI_TRANSPORT2 interface.
+
+  @param[in]      This              Pointer to IPMI protocol instance.
+  @param[in]      NetFunction       Net Function of command to send.
+  @param[in]      Lun               LUN of command to send.
+  @param[in]      Command           IPMI command to send.
+  @param[in]      CommandData       Pointer to command data buffer, if needed.
+  @param[in]      CommandDataSize   Size of command data buffer.
+  @param[in,out]  ResponseData      Pointer to response data buffer.
+  @param[in,out]  ResponseDataSize  Pointer to response data buffer size.
+
+  @retval   EFI_INVALID_PARAMETER   One of the input values is bad.
+  @retval   EFI_DEVICE_ERROR        IPMI command failed.
+  @retval   EFI_BUFFER_TOO_SMALL    Response buffer is too small.
+  @retval   EFI_UNSUPPORTED         Command is not supported by BMC.
+  @retval   EFI_SUCCESS             Command completed successfully.
+**/
+EFI_STATUS
+EFIAPI
+IpmiSendCommand2 (
+  IN      IPMI_TRANSPORT2  *This,
+  IN      UINT8            NetFunction,
+  IN      UINT8            Lun,
+  IN      UINT8            Command,
+  IN      UINT8            *CommandData,
+  IN      UINT32           CommandDataSize,
+  IN OUT  UINT8            *ResponseData,
+  IN OUT  UINT32           *ResponseDataSize
+  )
+{
+  IPMI_BMC_INSTANCE_DATA  *IpmiInstance;
+
+  IpmiInstance = INSTANCE_FROM_SM_IPMI_BMC_THIS2 (This);
+  return IpmiSendCommand (
+           &IpmiInstance->IpmiTransport,
+           NetFunction,
+           Lun,
+           Command,
+           CommandData,
+           CommandDataSize,
+           ResponseData,
+           ResponseDataSize
+           );
+}
+
+/**
+  Updates the BMC status and returns the Com Address through the
+  IPMI_TRANSPORT2 interface.
+
+  @param[in]  This            Pointer to IPMI protocol instance.
+  @param[out] BmcStatus       BMC status.
+  @param[out] ComAddress      Com Address.
+
+  @retval     EFI_SUCCESS     Success.
+**/
+EFI_STATUS
+EFIAPI
+IpmiGetBmcStatus2 (
+  IN IPMI_TRANSPORT2  *This,
+  OUT BMC_STATUS      *BmcStatus,
+  OUT SM_COM_ADDRESS  *ComAddress
+  )
+{
+  IPMI_BMC_INSTANCE_DATA  *IpmiInstance;
+
+  IpmiInstance = INSTANCE_FROM_SM_IPMI_BMC_THIS2 (This);
+  return IpmiBmcStatus (
+           &IpmiInstance->IpmiTransport,
+           BmcStatus,
+           ComAddress
+           );
+}
+
+/**
+  Sends a list of IPMI commands to the BMC back-to-back.
+
+  @param[in]      This          Pointer to IPMI protocol instance.
+  @param[in,out]  Entries       The commands to send and their results.
+  @param[in]      EntryCount    The number of entries in Entries.
+  @param[in]      Flags         IPMI_BATCH_* flags controlling the batch.
+
+  @retval   EFI_SUCCESS             All entries completed successfully.
+  @retval   EFI_INVALID_PARAMETER   Entries is NULL or Flags is invalid.
+  @retval   Other                   The status of the first failed entry.
+**/
+EFI_STATUS
+EFIAPI
+IpmiSubmitBatch (
+  IN      IPMI_TRANSPORT2   *This,
+  IN OUT  IPMI_BATCH_ENTRY  *Entries,
+  IN      UINTN             EntryCount,
+  IN      UINT32            Flags
+  )
+{
+  IPMI_BMC_INSTANCE_DATA  *IpmiInstance;
+
+  IpmiInstance = INSTANCE_FROM_SM_IPMI_BMC_THIS2 (This);
+  return IpmiSubmitBatchInternal (
+           &IpmiInstance->IpmiTransport,
+           Entries,
+           EntryCount,
+           Flags
+           );
+}
+
+/**
+  Asynchronous submission is only available in DXE, where a timer event can
+  drive the queued commands.
+
+  @param[in]      This        Pointer to IPMI protocol instance.
+  @param[in,out]  Token       The command to send and the event to signal.
+
+  @retval   EFI_UNSUPPORTED   Asynchronous submission is not supported.
+**/
+EFI_STATUS
+EFIAPI
+IpmiSubmitCommandAsync (
+  IN      IPMI_TRANSPORT2   *This,
+  IN OUT  IPMI_ASYNC_TOKEN  *Token
+  )
+{
+  return EFI_UNSUPPORTED;
+}
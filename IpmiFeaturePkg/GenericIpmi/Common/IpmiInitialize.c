@@ -118,6 +118,8 @@ GetSelfTest (
     return Status;
   } else {
     DEBUG ((DEBUG_INFO, "[IPMI] BMC self-test result: %02X-%02X\n", SelfTestResult->Result, SelfTestResult->Param));
+    IpmiIdentitySave (IpmiInstance, IPMI_APP_GET_SELFTEST_RESULTS, NULL, 0, IpmiInstance->TempData, DataSize);
+
     //
     // Copy the Self test results to Error Status.  Data will be copied as long as it
     // does not exceed the size of the ErrorStatus variable.
@@ -270,6 +272,7 @@ GetDeviceId (
   // At the very beginning of BMC power on, the status is 1 means BMC is in booting process and not ready. It is not the flag for force update mode.
   //
   if (pBmcInfo->UpdateMode == BMC_READY) {
+    IpmiIdentitySave (IpmiInstance, IPMI_APP_GET_DEVICE_ID, NULL, 0, IpmiInstance->TempData, DataSize);
     IpmiInstance->BmcStatus = BMC_OK;
     return EFI_SUCCESS;
   } else {
@@ -314,6 +317,7 @@ GetDeviceId (
           pBmcInfo = (SM_CTRL_INFO *)&IpmiInstance->TempData[0];
           DEBUG ((DEBUG_ERROR, "[IPMI] UpdateMode Retries: %d   pBmcInfo->UpdateMode:%x, Status: %r, Response Data: 0x%lx\n", Retries, pBmcInfo->UpdateMode, Status, IpmiInstance->TempData));
           if (pBmcInfo->UpdateMode == BMC_READY) {
+            IpmiIdentitySave (IpmiInstance, IPMI_APP_GET_DEVICE_ID, NULL, 0, IpmiInstance->TempData, DataSize);
             IpmiInstance->BmcStatus = BMC_OK;
             return EFI_SUCCESS;
           }
@@ -327,9 +331,93 @@ GetDeviceId (
   return Status;
 }
 
+/**
+  Reads the system GUID and the capabilities of the system interface into the
+  BMC identity cache. Both commands are optional, so a BMC that does not
+  support them is not an error.
+
+  @param[in,out]  IpmiInstance      Data structure describing BMC variables and
+                                    used for sending commands.
+**/
+VOID
+GetBmcIdentity (
+  IN OUT  IPMI_BMC_INSTANCE_DATA  *IpmiInstance
+  )
+{
+  EFI_STATUS                                    Status;
+  UINT32                                        DataSize;
+  IPMI_GET_SYSTEM_INTERFACE_CAPABILITY_REQUEST  CapabilityRequest;
+
+  DataSize = sizeof (IpmiInstance->TempData);
+  Status   = IpmiSendCommand (
+               &IpmiInstance->IpmiTransport,
+               IPMI_NETFN_APP,
+               0,
+               IPMI_APP_GET_SYSTEM_GUID,
+               NULL,
+               0,
+               IpmiInstance->TempData,
+               &DataSize
+               );
+
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_WARN, "[IPMI] BMC did not return the system GUID. %r\n", Status));
+  } else {
+    IpmiIdentitySave (IpmiInstance, IPMI_APP_GET_SYSTEM_GUID, NULL, 0, IpmiInstance->TempData, DataSize);
+  }
+
+  //
+  // Map the SPMI interface type onto the one of the capabilities command, which
+  // has no encoding for BT.
+  //
+  switch (PcdGet8 (PcdIpmiInterfaceType)) {
+    case 0x01:
+      CapabilityRequest.SystemInterfaceType = GetSystemInterfaceTypeKcs;
+      break;
+
+    case 0x02:
+      CapabilityRequest.SystemInterfaceType = GetSystemInterfaceTypeSmic;
+      break;
+
+    case 0x04:
+      CapabilityRequest.SystemInterfaceType = GetSystemInterfaceTypeSsif;
+      break;
+
+    default:
+      return;
+  }
+
+  CapabilityRequest.Reserved = 0;
+  DataSize                   = sizeof (IpmiInstance->TempData);
+  Status                     = IpmiSendCommand (
+                                 &IpmiInstance->IpmiTransport,
+                                 IPMI_NETFN_APP,
+                                 0,
+                                 IPMI_APP_GET_SYSTEM_INTERFACE_CAPABILITIES,
+                                 (UINT8 *)&CapabilityRequest,
+                                 sizeof (CapabilityRequest),
+                                 IpmiInstance->TempData,
+                                 &DataSize
+                                 );
+
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_WARN, "[IPMI] BMC did not return the interface capabilities. %r\n", Status));
+  } else {
+    IpmiIdentitySave (
+      IpmiInstance,
+      IPMI_APP_GET_SYSTEM_INTERFACE_CAPABILITIES,
+      (UINT8 *)&CapabilityRequest,
+      sizeof (CapabilityRequest),
+      IpmiInstance->TempData,
+      DataSize
+      );
+  }
+}
+
 /**
   Initializes the IPMI state for the BMC. This includes performs platform
-  specific logic, getting the device ID, and checking self-test results.
+  specific logic, getting the device ID, checking self-test results and
+  caching the identity of the BMC.
 
   @param[in,out]  IpmiInstance    The IPMI instance being initialized.
 
@@ -395,6 +483,15 @@ IpmiInitializeBmc (
     }
   }
 
+  //
+  // Cache the rest of the BMC identity for the later phases.
+  //
+  if ((IpmiInstance->BmcStatus != BMC_UPDATE_IN_PROGRESS) &&
+      (IpmiInstance->BmcStatus != BMC_HARDFAIL))
+  {
+    GetBmcIdentity (IpmiInstance);
+  }
+
   //
   // Iterate through the errors reporting them to the error manager.
   //
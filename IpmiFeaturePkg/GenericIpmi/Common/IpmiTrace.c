@@ -0,0 +1,292 @@
+/** @file
+  Trace of recent IPMI transactions and per command latency histograms.
+
+  Copyright (c) Microsoft Corporation
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/TimerLib.h>
+#include <Library/IpmiDeadlineLib.h>
+
+#include "IpmiTrace.h"
+
+/**
+  Converts a performance counter value to nanoseconds since the start of the
+  counter.
+
+  @param[in]  Trace     The trace state.
+  @param[in]  Ticks     The performance counter value.
+
+  @retval   The time in nanoseconds.
+**/
+STATIC
+UINT64
+IpmiTraceTicksToNs (
+  IN IPMI_TRACE_DATA  *Trace,
+  IN UINT64           Ticks
+  )
+{
+  return GetTimeInNanoSecond (
+           IpmiCounterTicksBetween (Trace->CounterStart, Trace->CounterEnd, Trace->CounterStart, Ticks)
+           );
+}
+
+/**
+  Finds the histogram for a NetFn/Cmd pair, creating it if there is room.
+
+  @param[in,out]  Trace         The trace state.
+  @param[in]      NetFunction   Net Function of the command.
+  @param[in]      Command       IPMI command.
+
+  @retval   The histogram, or NULL if the table is full.
+**/
+STATIC
+IPMI_LATENCY_HISTOGRAM *
+IpmiTraceFindHistogram (
+  IN OUT IPMI_TRACE_DATA  *Trace,
+  IN     UINT8            NetFunction,
+  IN     UINT8            Command
+  )
+{
+  IPMI_LATENCY_HISTOGRAM  *Histogram;
+  UINT32                  Index;
+
+  for (Index = 0; Index < Trace->HistogramCount; Index++) {
+    Histogram = &Trace->Histograms[Index];
+    if ((Histogram->NetFunction == NetFunction) && (Histogram->Command == Command)) {
+      return Histogram;
+    }
+  }
+
+  if (Trace->HistogramCount == IPMI_TRACE_HISTOGRAM_COUNT) {
+    return NULL;
+  }
+
+  Histogram              = &Trace->Histograms[Trace->HistogramCount++];
+  Histogram->NetFunction = NetFunction;
+  Histogram->Command     = Command;
+  return Histogram;
+}
+
+/**
+  Initializes the trace state and its protocol interface.
+
+  @param[out]   Trace     The trace state to initialize.
+**/
+VOID
+IpmiTraceInitialize (
+  OUT IPMI_TRACE_DATA  *Trace
+  )
+{
+  ZeroMem (Trace, sizeof (*Trace));
+  GetPerformanceCounterProperties (&Trace->CounterStart, &Trace->CounterEnd);
+
+  Trace->Signature              = IPMI_TRACE_SIGNATURE;
+  Trace->Protocol.GetRecords    = IpmiTraceGetRecords;
+  Trace->Protocol.GetHistograms = IpmiTraceGetHistograms;
+  Trace->Protocol.Reset         = IpmiTraceReset;
+}
+
+/**
+  Records a completed IPMI transaction in the trace and its NetFn/Cmd latency
+  histogram.
+
+  @param[in,out]  Trace           The trace state.
+  @param[in]      NetFunction     Net Function of the command sent.
+  @param[in]      Command         IPMI command sent.
+  @param[in]      CompletionCode  Completion code returned by the BMC.
+  @param[in]      Retries         Number of times the command was resent.
+  @param[in]      RequestSize     Size of the command data.
+  @param[in]      ResponseSize    Size of the response data.
+  @param[in]      Status          Status of the transaction.
+  @param[in]      StartTime       Performance counter when the command was sent.
+  @param[in]      EndTime         Performance counter when the command completed.
+**/
+VOID
+IpmiTraceRecord (
+  IN OUT IPMI_TRACE_DATA  *Trace,
+  IN     UINT8            NetFunction,
+  IN     UINT8            Command,
+  IN     UINT8            CompletionCode,
+  IN     UINT8            Retries,
+  IN     UINT32           RequestSize,
+  IN     UINT32           ResponseSize,
+  IN     EFI_STATUS       Status,
+  IN     UINT64           StartTime,
+  IN     UINT64           EndTime
+  )
+{
+  IPMI_TRACE_RECORD       *Record;
+  IPMI_LATENCY_HISTOGRAM  *Histogram;
+  UINT64                  Elapsed;
+  UINT64                  Microseconds;
+  UINTN                   Bucket;
+
+  Record                 = &Trace->Records[Trace->NextRecord];
+  Record->NetFunction    = NetFunction;
+  Record->Command        = Command;
+  Record->CompletionCode = CompletionCode;
+  Record->Retries        = Retries;
+  Record->RequestSize    = RequestSize;
+  Record->ResponseSize   = ResponseSize;
+  Record->Status         = Status;
+  Record->StartTime      = StartTime;
+  Record->EndTime        = EndTime;
+
+  Trace->NextRecord = (Trace->NextRecord + 1) % IPMI_TRACE_RECORD_COUNT;
+  Trace->TotalCount++;
+
+  Histogram = IpmiTraceFindHistogram (Trace, NetFunction, Command);
+  if (Histogram == NULL) {
+    Trace->OverflowCount++;
+    return;
+  }
+
+  Elapsed      = GetTimeInNanoSecond (
+                   IpmiCounterTicksBetween (Trace->CounterStart, Trace->CounterEnd, StartTime, EndTime)
+                   );
+  Microseconds = DivU64x32 (Elapsed, 1000);
+  if (Microseconds == 0) {
+    Bucket = 0;
+  } else {
+    Bucket = MIN ((UINTN)HighBitSet64 (Microseconds) + 1, IPMI_LATENCY_BUCKET_COUNT - 1);
+  }
+
+  Histogram->Buckets[Bucket]++;
+  Histogram->Count++;
+  Histogram->TotalTime += Elapsed;
+  Histogram->MaxTime    = MAX (Histogram->MaxTime, Elapsed);
+}
+
+/**
+  Retrieves the most recent IPMI transactions, oldest first.
+
+  @param[in]      This          Pointer to the IPMI trace protocol.
+  @param[out]     Records       Buffer to receive the records.
+  @param[in,out]  RecordCount   On input, the number of records Records can
+                                hold. On output, the number of records
+                                returned, or required if the buffer is too
+                                small.
+  @param[out]     TotalCount    If provided, receives the number of
+                                transactions recorded including those that
+                                have since been overwritten.
+
+  @retval   EFI_SUCCESS             The records were returned.
+  @retval   EFI_INVALID_PARAMETER   RecordCount is NULL, or Records is NULL and
+                                    *RecordCount is not 0.
+  @retval   EFI_BUFFER_TOO_SMALL    Records is too small to hold all records.
+**/
+EFI_STATUS
+EFIAPI
+IpmiTraceGetRecords (
+  IN      IPMI_TRACE_PROTOCOL  *This,
+  OUT     IPMI_TRACE_RECORD    *Records,
+  IN OUT  UINTN                *RecordCount,
+  OUT     UINT64               *TotalCount OPTIONAL
+  )
+{
+  IPMI_TRACE_DATA  *Trace;
+  UINTN            Count;
+  UINTN            First;
+  UINTN            Index;
+
+  if ((RecordCount == NULL) || ((Records == NULL) && (*RecordCount != 0))) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Trace = IPMI_TRACE_FROM_THIS (This);
+  if (TotalCount != NULL) {
+    *TotalCount = Trace->TotalCount;
+  }
+
+  Count = (UINTN)MIN (Trace->TotalCount, IPMI_TRACE_RECORD_COUNT);
+  if (*RecordCount < Count) {
+    *RecordCount = Count;
+    return EFI_BUFFER_TOO_SMALL;
+  }
+
+  //
+  // Once the ring has wrapped the oldest record is the next to be overwritten.
+  //
+  First = (Count < IPMI_TRACE_RECORD_COUNT) ? 0 : Trace->NextRecord;
+  for (Index = 0; Index < Count; Index++) {
+    CopyMem (&Records[Index], &Trace->Records[(First + Index) % IPMI_TRACE_RECORD_COUNT], sizeof (IPMI_TRACE_RECORD));
+    Records[Index].StartTime = IpmiTraceTicksToNs (Trace, Records[Index].StartTime);
+    Records[Index].EndTime   = IpmiTraceTicksToNs (Trace, Records[Index].EndTime);
+  }
+
+  *RecordCount = Count;
+  return EFI_SUCCESS;
+}
+
+/**
+  Retrieves the latency histogram of every NetFn/Cmd pair sent.
+
+  @param[in]      This            Pointer to the IPMI trace protocol.
+  @param[out]     Histograms      Buffer to receive the histograms.
+  @param[in,out]  HistogramCount  On input, the number of histograms
+                                  Histograms can hold. On output, the number
+                                  returned, or required if the buffer is too
+                                  small.
+  @param[out]     OverflowCount   If provided, receives the number of
+                                  transactions of NetFn/Cmd pairs that found
+                                  every histogram taken.
+
+  @retval   EFI_SUCCESS             The histograms were returned.
+  @retval   EFI_INVALID_PARAMETER   HistogramCount is NULL, or Histograms is
+                                    NULL and *HistogramCount is not 0.
+  @retval   EFI_BUFFER_TOO_SMALL    Histograms is too small to hold all
+                                    histograms.
+**/
+EFI_STATUS
+EFIAPI
+IpmiTraceGetHistograms (
+  IN      IPMI_TRACE_PROTOCOL     *This,
+  OUT     IPMI_LATENCY_HISTOGRAM  *Histograms,
+  IN OUT  UINTN                   *HistogramCount,
+  OUT     UINT64                  *OverflowCount OPTIONAL
+  )
+{
+  IPMI_TRACE_DATA  *Trace;
+
+  if ((HistogramCount == NULL) || ((Histograms == NULL) && (*HistogramCount != 0))) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Trace = IPMI_TRACE_FROM_THIS (This);
+  if (OverflowCount != NULL) {
+    *OverflowCount = Trace->OverflowCount;
+  }
+  if (*HistogramCount < Trace->HistogramCount) {
+    *HistogramCount = Trace->HistogramCount;
+    return EFI_BUFFER_TOO_SMALL;
+  }
+
+  CopyMem (Histograms, Trace->Histograms, Trace->HistogramCount * sizeof (IPMI_LATENCY_HISTOGRAM));
+  *HistogramCount = Trace->HistogramCount;
+  return EFI_SUCCESS;
+}
+
+/**
+  Discards all recorded transactions and histograms.
+
+  @param[in]  This    Pointer to the IPMI trace protocol.
+**/
+VOID
+EFIAPI
+IpmiTraceReset (
+  IN IPMI_TRACE_PROTOCOL  *This
+  )
+{
+  IPMI_TRACE_DATA  *Trace;
+
+  Trace                 = IPMI_TRACE_FROM_THIS (This);
+  Trace->TotalCount     = 0;
+  Trace->OverflowCount  = 0;
+  Trace->NextRecord     = 0;
+  Trace->HistogramCount = 0;
+  ZeroMem (Trace->Histograms, sizeof (Trace->Histograms));
+}
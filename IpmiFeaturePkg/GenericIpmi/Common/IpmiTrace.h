@@ -0,0 +1,150 @@
+/** @file
+  Definitions for the IPMI transaction trace and latency histograms.
+
+  Copyright (c) Microsoft Corporation
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef IPMI_TRACE_H_
+#define IPMI_TRACE_H_
+
+#include <Uefi.h>
+#include <Protocol/IpmiTraceProtocol.h>
+
+#define IPMI_TRACE_RECORD_COUNT     64
+#define IPMI_TRACE_HISTOGRAM_COUNT  32
+
+#define IPMI_TRACE_SIGNATURE  SIGNATURE_32 ('i', 'p', 'm', 't')
+#define IPMI_TRACE_FROM_THIS(a) \
+  CR ( \
+  a, \
+  IPMI_TRACE_DATA, \
+  Protocol, \
+  IPMI_TRACE_SIGNATURE \
+  )
+
+//
+// Trace state for an IPMI instance. Record times are kept in performance
+// counter ticks and converted to nanoseconds when read. Transactions of
+// NetFn/Cmd pairs that find every histogram taken are only counted in
+// OverflowCount.
+//
+typedef struct {
+  UINTN                     Signature;
+  IPMI_TRACE_PROTOCOL       Protocol;
+  UINT64                    CounterStart;
+  UINT64                    CounterEnd;
+  UINT64                    TotalCount;
+  UINT64                    OverflowCount;
+  UINT32                    NextRecord;
+  UINT32                    HistogramCount;
+  IPMI_TRACE_RECORD         Records[IPMI_TRACE_RECORD_COUNT];
+  IPMI_LATENCY_HISTOGRAM    Histograms[IPMI_TRACE_HISTOGRAM_COUNT];
+} IPMI_TRACE_DATA;
+
+/**
+  Initializes the trace state and its protocol interface.
+
+  @param[out]   Trace     The trace state to initialize.
+**/
+VOID
+IpmiTraceInitialize (
+  OUT IPMI_TRACE_DATA  *Trace
+  );
+
+/**
+  Records a completed IPMI transaction in the trace and its NetFn/Cmd latency
+  histogram.
+
+  @param[in,out]  Trace           The trace state.
+  @param[in]      NetFunction     Net Function of the command sent.
+  @param[in]      Command         IPMI command sent.
+  @param[in]      CompletionCode  Completion code returned by the BMC.
+  @param[in]      Retries         Number of times the command was resent.
+  @param[in]      RequestSize     Size of the command data.
+  @param[in]      ResponseSize    Size of the response data.
+  @param[in]      Status          Status of the transaction.
+  @param[in]      StartTime       Performance counter when the command was sent.
+  @param[in]      EndTime         Performance counter when the command completed.
+**/
+VOID
+IpmiTraceRecord (
+  IN OUT IPMI_TRACE_DATA  *Trace,
+  IN     UINT8            NetFunction,
+  IN     UINT8            Command,
+  IN     UINT8            CompletionCode,
+  IN     UINT8            Retries,
+  IN     UINT32           RequestSize,
+  IN     UINT32           ResponseSize,
+  IN     EFI_STATUS       Status,
+  IN     UINT64           StartTime,
+  IN     UINT64           EndTime
+  );
+
+/**
+  Retrieves the most recent IPMI transactions, oldest first.
+
+  @param[in]      This          Pointer to the IPMI trace protocol.
+  @param[out]     Records       Buffer to receive the records.
+  @param[in,out]  RecordCount   On input, the number of records Records can
+                                hold. On output, the number of records
+                                returned, or required if the buffer is too
+                                small.
+  @param[out]     TotalCount    If provided, receives the number of
+                                transactions recorded including those that
+                                have since been overwritten.
+
+  @retval   EFI_SUCCESS             The records were returned.
+  @retval   EFI_INVALID_PARAMETER   RecordCount is NULL, or Records is NULL and
+                                    *RecordCount is not 0.
+  @retval   EFI_BUFFER_TOO_SMALL    Records is too small to hold all records.
+**/
+EFI_STATUS
+EFIAPI
+IpmiTraceGetRecords (
+  IN      IPMI_TRACE_PROTOCOL  *This,
+  OUT     IPMI_TRACE_RECORD    *Records,
+  IN OUT  UINTN                *RecordCount,
+  OUT     UINT64               *TotalCount OPTIONAL
+  );
+
+/**
+  Retrieves the latency histogram of every NetFn/Cmd pair sent.
+
+  @param[in]      This            Pointer to the IPMI trace protocol.
+  @param[out]     Histograms      Buffer to receive the histograms.
+  @param[in,out]  HistogramCount  On input, the number of histograms
+                                  Histograms can hold. On output, the number
+                                  returned, or required if the buffer is too
+                                  small.
+  @param[out]     OverflowCount   If provided, receives the number of
+                                  transactions of NetFn/Cmd pairs that found
+                                  every histogram taken.
+
+  @retval   EFI_SUCCESS             The histograms were returned.
+  @retval   EFI_INVALID_PARAMETER   HistogramCount is NULL, or Histograms is
+                                    NULL and *HistogramCount is not 0.
+  @retval   EFI_BUFFER_TOO_SMALL    Histograms is too small to hold all
+                                    histograms.
+**/
+EFI_STATUS
+EFIAPI
+IpmiTraceGetHistograms (
+  IN      IPMI_TRACE_PROTOCOL     *This,
+  OUT     IPMI_LATENCY_HISTOGRAM  *Histograms,
+  IN OUT  UINTN                   *HistogramCount,
+  OUT     UINT64                  *OverflowCount OPTIONAL
+  );
+
+/**
+  Discards all recorded transactions and histograms.
+
+  @param[in]  This    Pointer to the IPMI trace protocol.
+**/
+VOID
+EFIAPI
+IpmiTraceReset (
+  IN IPMI_TRACE_PROTOCOL  *This
+  );
+
+#endif
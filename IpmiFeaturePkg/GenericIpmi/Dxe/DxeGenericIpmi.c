@@ -26,6 +26,8 @@
 #include <GenericIpmi.h>
 #include <Library/IpmiPlatformLib.h>
 
+#include "DxeIpmiAsync.h"
+
 //
 // Global state for the IPMI instance.
 //
@@ -64,23 +66,35 @@ DxeGenericIpmiEntry (
   }
 
   //
-  // Initialize the transaction timeout. Convert the seconds to microseconds
-  // then divide by the stall period.
+  // Initialize the transaction timeout in microseconds.
   //
 
-  mIpmiInstance->IpmiTimeoutPeriod =
-    (PcdGet8 (PcdIpmiCommandTimeoutSeconds) * (1000*1000)) / IPMI_DELAY_UNIT;
+  mIpmiInstance->IpmiTimeoutPeriod = MultU64x32 (PcdGet8 (PcdIpmiCommandTimeoutSeconds), 1000 * 1000);
 
   DEBUG ((DEBUG_INFO, "[IPMI] mIpmiInstance->IpmiTimeoutPeriod: 0x%llx\n", mIpmiInstance->IpmiTimeoutPeriod));
 
   //
   // Initialize IPMI IO Base.
   //
-  mIpmiInstance->Signature                       = SM_IPMI_BMC_SIGNATURE;
-  mIpmiInstance->SlaveAddress                    = BMC_SLAVE_ADDRESS;
-  mIpmiInstance->BmcStatus                       = BMC_NOTREADY;
-  mIpmiInstance->IpmiTransport.IpmiSubmitCommand = IpmiSendCommand;
-  mIpmiInstance->IpmiTransport.GetBmcStatus      = IpmiGetBmcStatus;
+  mIpmiInstance->Signature                         = SM_IPMI_BMC_SIGNATURE;
+  mIpmiInstance->SlaveAddress                      = BMC_SLAVE_ADDRESS;
+  mIpmiInstance->BmcStatus                         = BMC_NOTREADY;
+  mIpmiInstance->IpmiTransport.IpmiSubmitCommand   = IpmiSendCommand;
+  mIpmiInstance->IpmiTransport.GetBmcStatus        = IpmiGetBmcStatus;
+  mIpmiInstance->IpmiTransport2.Revision           = IPMI_TRANSPORT2_REVISION;
+  mIpmiInstance->IpmiTransport2.IpmiSubmitCommand  = IpmiSendCommand2;
+  mIpmiInstance->IpmiTransport2.GetBmcStatus       = IpmiGetBmcStatus2;
+  mIpmiInstance->IpmiTransport2.SubmitBatch        = IpmiSubmitBatch;
+  mIpmiInstance->IpmiTransport2.SubmitCommandAsync = IpmiSubmitCommandAsync;
+
+  //
+  // Trace the transactions from here on, including BMC initialization. The
+  // transport works without it if the allocation fails.
+  //
+  mIpmiInstance->Trace = AllocatePool (sizeof (*mIpmiInstance->Trace));
+  if (mIpmiInstance->Trace != NULL) {
+    IpmiTraceInitialize (mIpmiInstance->Trace);
+  }
 
   //
   // Initialize the transport layer.
@@ -111,6 +125,13 @@ DxeGenericIpmiEntry (
     BmcHob                   = (IPMI_BMC_HOB *)GET_GUID_HOB_DATA (GuidHob);
     mIpmiInstance->BmcStatus = BmcHob->BmcStatus;
     DEBUG ((DEBUG_INFO, "[IPMI] Found IPMI BMC HOB. BMC Status = 0x%d\n", BmcHob->BmcStatus));
+
+    //
+    // Answer the BMC identity from what PEI read, if the HOB carries it.
+    //
+    if (GET_GUID_HOB_DATA_SIZE (GuidHob) >= sizeof (IPMI_BMC_HOB)) {
+      IpmiIdentityRestore (mIpmiInstance, &BmcHob->Identity);
+    }
   }
 
   //
@@ -119,15 +140,38 @@ DxeGenericIpmiEntry (
   if ((mIpmiInstance->BmcStatus != BMC_HARDFAIL) &&
       (mIpmiInstance->BmcStatus != BMC_UPDATE_IN_PROGRESS))
   {
+    IpmiCircuitBreakerInitialize (mIpmiInstance);
+
+    //
+    // Asynchronous submission is optional, the synchronous interfaces remain
+    // usable without it.
+    //
+    Status = DxeIpmiAsyncInitialize (mIpmiInstance);
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_WARN, "[IPMI] Asynchronous submission unavailable. %r\n", Status));
+    }
+
     Handle = NULL;
     DEBUG ((DEBUG_INFO, "[IPMI] Installing DXE protocol!\n"));
-    Status = gBS->InstallProtocolInterface (
+    Status = gBS->InstallMultipleProtocolInterfaces (
                     &Handle,
                     &gIpmiTransportProtocolGuid,
-                    EFI_NATIVE_INTERFACE,
-                    &mIpmiInstance->IpmiTransport
+                    &mIpmiInstance->IpmiTransport,
+                    &gIpmiTransport2ProtocolGuid,
+                    &mIpmiInstance->IpmiTransport2,
+                    NULL
                     );
     ASSERT_EFI_ERROR (Status);
+
+    if (mIpmiInstance->Trace != NULL) {
+      Status = gBS->InstallMultipleProtocolInterfaces (
+                      &Handle,
+                      &gIpmiTraceProtocolGuid,
+                      &mIpmiInstance->Trace->Protocol,
+                      NULL
+                      );
+      ASSERT_EFI_ERROR (Status);
+    }
   }
 
   return EFI_SUCCESS;
@@ -0,0 +1,716 @@
+/** @file
+  Asynchronous IPMI command submission for DXE. Commands are queued by the
+  caller and driven by a periodic timer event. Each tick either sends the next
+  queued request or checks whether the BMC has the response for the request in
+  flight, so the caller is not blocked while the BMC processes the command.
+
+  The transport is owned by one user at a time, tracked by a busy flag that is
+  only changed at TPL_HIGH_LEVEL. The queue itself is only changed at
+  TPL_NOTIFY. Callers above TPL_NOTIFY, and transports that cannot tell
+  whether a response is ready without waiting for it, complete their commands
+  synchronously instead of queuing them.
+
+  Copyright (c) Microsoft Corporation
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/PcdLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+
+#include <IndustryStandard/Ipmi.h>
+
+#include "DxeIpmiAsync.h"
+
+//
+// State of the asynchronous queue.
+//
+
+STATIC IPMI_BMC_INSTANCE_DATA  *mAsyncIpmiInstance  = NULL;
+STATIC LIST_ENTRY              mAsyncQueue          = INITIALIZE_LIST_HEAD_VARIABLE (mAsyncQueue);
+STATIC IPMI_ASYNC_REQUEST      *mAsyncActiveRequest = NULL;
+STATIC EFI_EVENT               mAsyncTimerEvent     = NULL;
+STATIC BOOLEAN                 mAsyncTimerRunning   = FALSE;
+STATIC BOOLEAN                 mAsyncCanPoll        = FALSE;
+STATIC BOOLEAN                 mAsyncExited         = FALSE;
+STATIC BOOLEAN                 mTransportBusy       = FALSE;
+STATIC UINT64                  mAsyncTimeoutTicks   = 0;
+
+/**
+  Takes ownership of the transport if no other user has it. Safe to call at
+  any TPL.
+
+  @param[out] CallerTpl   The TPL of the caller.
+
+  @retval TRUE    The transport is owned by the caller until DxeIpmiAsyncUnlock.
+  @retval FALSE   The caller interrupted another user of the transport.
+**/
+STATIC
+BOOLEAN
+DxeIpmiAsyncLock (
+  OUT EFI_TPL  *CallerTpl
+  )
+{
+  BOOLEAN  Locked;
+
+  *CallerTpl = gBS->RaiseTPL (TPL_HIGH_LEVEL);
+  Locked     = (BOOLEAN) !mTransportBusy;
+  if (Locked) {
+    mTransportBusy = TRUE;
+  }
+
+  gBS->RestoreTPL (*CallerTpl);
+  return Locked;
+}
+
+/**
+  Gives up ownership of the transport taken with DxeIpmiAsyncLock.
+**/
+STATIC
+VOID
+DxeIpmiAsyncUnlock (
+  VOID
+  )
+{
+  ASSERT (mTransportBusy);
+  mTransportBusy = FALSE;
+}
+
+/**
+  Converts the backoff of a transaction that is to be sent again into timer
+  ticks.
+
+  @param[in,out]  Request     The request to be sent again.
+**/
+STATIC
+VOID
+DxeIpmiAsyncSetBackoff (
+  IN OUT IPMI_ASYNC_REQUEST  *Request
+  )
+{
+  Request->TicksWaited  = 0;
+  Request->BackoffTicks = DivU64x32 (
+                            MultU64x32 (Request->Transaction.Backoff, 10) + IPMI_ASYNC_POLL_PERIOD - 1,
+                            IPMI_ASYNC_POLL_PERIOD
+                            );
+}
+
+/**
+  Completes the active request, reports the results in its token and signals
+  the caller's event. Must be called at TPL_NOTIFY or below.
+**/
+STATIC
+VOID
+DxeIpmiAsyncComplete (
+  VOID
+  )
+{
+  IPMI_ASYNC_REQUEST  *Request;
+  IPMI_ASYNC_TOKEN    *Token;
+
+  Request             = mAsyncActiveRequest;
+  Token               = Request->Token;
+  mAsyncActiveRequest = NULL;
+
+  Token->Entry.CompletionCode = Request->Transaction.CompletionCode;
+  if (Token->Entry.ResponseData != NULL) {
+    Token->Entry.ResponseDataSize = Request->ResponseDataSize;
+  } else {
+    Token->Entry.ResponseDataSize = 0;
+  }
+
+  Token->Entry.Status = Request->Transaction.Status;
+
+  FreePool (Request);
+
+  gBS->SignalEvent (Token->Event);
+}
+
+/**
+  Starts the transaction for the next queued request.
+
+  @retval   TRUE    The request completed without being sent.
+  @retval   FALSE   The request is active and ready to be sent.
+**/
+STATIC
+BOOLEAN
+DxeIpmiAsyncStart (
+  VOID
+  )
+{
+  IPMI_ASYNC_REQUEST  *Request;
+  IPMI_BATCH_ENTRY    *Entry;
+
+  Request = IPMI_ASYNC_REQUEST_FROM_LINK (GetFirstNode (&mAsyncQueue));
+  RemoveEntryList (&Request->Link);
+  mAsyncActiveRequest = Request;
+
+  Entry = &Request->Token->Entry;
+  return IpmiTransactionStart (
+           mAsyncIpmiInstance,
+           &Request->Transaction,
+           Entry->NetFunction,
+           Entry->Lun,
+           Entry->Command,
+           Entry->CommandData,
+           Entry->CommandDataSize,
+           Entry->ResponseData,
+           (Entry->ResponseData != NULL) ? &Request->ResponseDataSize : NULL
+           );
+}
+
+/**
+  Advances the queue by one step. If a request is in flight its response is
+  collected once the BMC has it ready, otherwise the next request is sent once
+  its backoff has passed. Must be called at TPL_NOTIFY with the transport
+  owned.
+**/
+STATIC
+VOID
+DxeIpmiAsyncStep (
+  VOID
+  )
+{
+  IPMI_ASYNC_REQUEST  *Request;
+  IPMI_TRANSACTION    *Transaction;
+
+  if (mAsyncActiveRequest == NULL) {
+    if (IsListEmpty (&mAsyncQueue)) {
+      return;
+    }
+
+    if (DxeIpmiAsyncStart ()) {
+      DxeIpmiAsyncComplete ();
+      return;
+    }
+  }
+
+  Request     = mAsyncActiveRequest;
+  Transaction = &Request->Transaction;
+  if (Request->Done) {
+    DxeIpmiAsyncComplete ();
+    return;
+  }
+
+  if (Transaction->InFlight) {
+    //
+    // Once the timeout has passed the receive is left to fail and recover the
+    // transport.
+    //
+    Request->TicksWaited++;
+    if ((CheckBmcResponseReady () == EFI_NOT_READY) && (Request->TicksWaited < mAsyncTimeoutTicks)) {
+      return;
+    }
+  } else if (Request->BackoffTicks > 0) {
+    Request->BackoffTicks--;
+    return;
+  }
+
+  //
+  // A command sent again without a backoff is sent in the same tick as the
+  // response that caused it.
+  //
+  Request->TicksWaited = 0;
+  do {
+    if (IpmiTransactionStep (mAsyncIpmiInstance, Transaction)) {
+      DxeIpmiAsyncComplete ();
+      return;
+    }
+  } while (!Transaction->InFlight && (Transaction->Backoff == 0));
+
+  if (!Transaction->InFlight) {
+    DxeIpmiAsyncSetBackoff (Request);
+  }
+}
+
+/**
+  Runs every queued command to completion at the current TPL, waiting for
+  each response. Must be called at TPL_NOTIFY or below with the transport
+  owned.
+**/
+STATIC
+VOID
+DxeIpmiAsyncDrain (
+  VOID
+  )
+{
+  while ((mAsyncActiveRequest != NULL) || !IsListEmpty (&mAsyncQueue)) {
+    if ((mAsyncActiveRequest == NULL) && DxeIpmiAsyncStart ()) {
+      DxeIpmiAsyncComplete ();
+      continue;
+    }
+
+    if (!mAsyncActiveRequest->Done) {
+      IpmiTransactionRun (mAsyncIpmiInstance, &mAsyncActiveRequest->Transaction);
+    }
+
+    DxeIpmiAsyncComplete ();
+  }
+}
+
+/**
+  Starts or stops the polling timer depending on whether there is work queued.
+  Must be called at TPL_NOTIFY.
+**/
+STATIC
+VOID
+DxeIpmiAsyncUpdateTimer (
+  VOID
+  )
+{
+  BOOLEAN  Pending;
+
+  Pending = (BOOLEAN)((mAsyncActiveRequest != NULL) || !IsListEmpty (&mAsyncQueue));
+  if (Pending == mAsyncTimerRunning) {
+    return;
+  }
+
+  if (Pending) {
+    gBS->SetTimer (mAsyncTimerEvent, TimerPeriodic, IPMI_ASYNC_POLL_PERIOD);
+  } else {
+    gBS->SetTimer (mAsyncTimerEvent, TimerCancel, 0);
+  }
+
+  mAsyncTimerRunning = Pending;
+}
+
+/**
+  Timer notification that drives the queued commands.
+
+  @param[in]  Event     The timer event.
+  @param[in]  Context   Unused.
+**/
+STATIC
+VOID
+EFIAPI
+DxeIpmiAsyncTimerHandler (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  EFI_TPL  OldTpl;
+  EFI_TPL  CallerTpl;
+
+  //
+  // Leave the transport alone while a synchronous command is using it.
+  //
+  if (!DxeIpmiAsyncLock (&CallerTpl)) {
+    return;
+  }
+
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+  DxeIpmiAsyncStep ();
+  DxeIpmiAsyncUpdateTimer ();
+  gBS->RestoreTPL (OldTpl);
+
+  DxeIpmiAsyncUnlock ();
+}
+
+/**
+  Takes ownership of the transport for a synchronous command. A request in
+  flight has its response received first, at the caller's TPL, so that the
+  BMC is idle. The queue is left for the timer to complete the request.
+
+  @retval   EFI_SUCCESS     The transport is owned until DxeIpmiAsyncRelease.
+  @retval   EFI_NOT_READY   The caller interrupted another user of the
+                            transport.
+**/
+STATIC
+EFI_STATUS
+DxeIpmiAsyncAcquire (
+  VOID
+  )
+{
+  IPMI_ASYNC_REQUEST  *Request;
+  EFI_TPL             CallerTpl;
+
+  if (mAsyncExited) {
+    return EFI_SUCCESS;
+  }
+
+  if (!DxeIpmiAsyncLock (&CallerTpl)) {
+    DEBUG ((DEBUG_WARN, "[IPMI] Transport in use, command at TPL %d rejected.\n", CallerTpl));
+    return EFI_NOT_READY;
+  }
+
+  Request = mAsyncActiveRequest;
+  if ((Request != NULL) && Request->Transaction.InFlight) {
+    Request->Done = IpmiTransactionStep (mAsyncIpmiInstance, &Request->Transaction);
+    if (!Request->Done) {
+      DxeIpmiAsyncSetBackoff (Request);
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Releases the transport after a synchronous command.
+**/
+STATIC
+VOID
+DxeIpmiAsyncRelease (
+  VOID
+  )
+{
+  if (!mAsyncExited) {
+    DxeIpmiAsyncUnlock ();
+  }
+}
+
+/**
+  Completes every queued command before boot services are exited, since the
+  timer that drives the queue stops afterwards.
+
+  @param[in]  Event     The exit boot services event.
+  @param[in]  Context   Unused.
+**/
+STATIC
+VOID
+EFIAPI
+DxeIpmiAsyncExitBootServices (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  EFI_TPL  CallerTpl;
+
+  if (DxeIpmiAsyncLock (&CallerTpl)) {
+    gBS->SetTimer (mAsyncTimerEvent, TimerCancel, 0);
+    mAsyncTimerRunning = FALSE;
+    DxeIpmiAsyncDrain ();
+  } else {
+    DEBUG ((DEBUG_ERROR, "[IPMI] Transport in use at exit boot services, queue abandoned.\n"));
+  }
+
+  mAsyncExited = TRUE;
+}
+
+/**
+  Sends an asynchronous command synchronously and signals its event before
+  returning.
+
+  @param[in,out]  Token       The command to send and the event to signal.
+
+  @retval   EFI_SUCCESS             The command completed, its results are in
+                                    the token.
+  @retval   EFI_NOT_READY           The caller interrupted another user of the
+                                    transport, the command was not sent.
+**/
+STATIC
+EFI_STATUS
+DxeIpmiAsyncRunNow (
+  IN OUT IPMI_ASYNC_TOKEN  *Token
+  )
+{
+  IPMI_BATCH_ENTRY  *Entry;
+  IPMI_TRANSACTION  Transaction;
+  UINT32            ResponseDataSize;
+  EFI_STATUS        Status;
+
+  Status = DxeIpmiAsyncAcquire ();
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Entry            = &Token->Entry;
+  ResponseDataSize = Entry->ResponseDataSize;
+  if (!IpmiTransactionStart (
+         mAsyncIpmiInstance,
+         &Transaction,
+         Entry->NetFunction,
+         Entry->Lun,
+         Entry->Command,
+         Entry->CommandData,
+         Entry->CommandDataSize,
+         Entry->ResponseData,
+         (Entry->ResponseData != NULL) ? &ResponseDataSize : NULL
+         ))
+  {
+    IpmiTransactionRun (mAsyncIpmiInstance, &Transaction);
+  }
+
+  DxeIpmiAsyncRelease ();
+
+  Entry->CompletionCode   = Transaction.CompletionCode;
+  Entry->ResponseDataSize = (Entry->ResponseData != NULL) ? ResponseDataSize : 0;
+  Entry->Status           = Transaction.Status;
+
+  gBS->SignalEvent (Token->Event);
+  return EFI_SUCCESS;
+}
+
+/**
+  Queues an IPMI command to be sent to the BMC and returns without waiting for
+  the response. Commands submitted above TPL_NOTIFY, after boot services have
+  been exited, or on a transport that cannot tell whether a response is ready
+  are completed before returning.
+
+  @param[in]      This        Pointer to the IPMI transport instance.
+  @param[in,out]  Token       The command to send and the event to signal when
+                              it completes.
+
+  @retval   EFI_SUCCESS             The command was queued or completed.
+  @retval   EFI_INVALID_PARAMETER   Token or its event is NULL, or the command
+                                    is invalid.
+  @retval   EFI_NOT_READY           The command was submitted above TPL_NOTIFY
+                                    while the transport was in use.
+  @retval   EFI_OUT_OF_RESOURCES    The command could not be queued.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+DxeIpmiSubmitCommandAsync (
+  IN IPMI_TRANSPORT2       *This,
+  IN OUT IPMI_ASYNC_TOKEN  *Token
+  )
+{
+  IPMI_ASYNC_REQUEST  *Request;
+  IPMI_BATCH_ENTRY    *Entry;
+  EFI_TPL             OldTpl;
+
+  if ((Token == NULL) || (Token->Event == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Entry = &Token->Entry;
+  if ((Entry->CommandDataSize > 0) && (Entry->CommandData == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Entry->CompletionCode = IPMI_COMP_CODE_UNSPECIFIED;
+  Entry->Status         = EFI_NOT_READY;
+
+  if (mAsyncExited || !mAsyncCanPoll) {
+    return DxeIpmiAsyncRunNow (Token);
+  }
+
+  OldTpl = gBS->RaiseTPL (TPL_HIGH_LEVEL);
+  gBS->RestoreTPL (OldTpl);
+  if (OldTpl > TPL_NOTIFY) {
+    return DxeIpmiAsyncRunNow (Token);
+  }
+
+  Request = AllocateZeroPool (sizeof (*Request));
+  if (Request == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Request->Signature        = IPMI_ASYNC_REQUEST_SIGNATURE;
+  Request->Token            = Token;
+  Request->ResponseDataSize = Entry->ResponseDataSize;
+
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+  InsertTailList (&mAsyncQueue, &Request->Link);
+  DxeIpmiAsyncUpdateTimer ();
+  gBS->RestoreTPL (OldTpl);
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Synchronous IPMI_TRANSPORT submission serialized with the queue.
+
+  @param[in]      This              Pointer to IPMI protocol instance.
+  @param[in]      NetFunction       Net Function of command to send.
+  @param[in]      Lun               LUN of command to send.
+  @param[in]      Command           IPMI command to send.
+  @param[in]      CommandData       Pointer to command data buffer, if needed.
+  @param[in]      CommandDataSize   Size of command data buffer.
+  @param[in,out]  ResponseData      Pointer to response data buffer.
+  @param[in,out]  ResponseDataSize  Pointer to response data buffer size.
+
+  @retval   EFI_NOT_READY     The caller interrupted another user of the
+                              transport, the command was not sent.
+  @retval   Other             Status returned by IpmiSendCommand.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+DxeIpmiSendCommand (
+  IN      IPMI_TRANSPORT  *This,
+  IN      UINT8           NetFunction,
+  IN      UINT8           Lun,
+  IN      UINT8           Command,
+  IN      UINT8           *CommandData,
+  IN      UINT32          CommandDataSize,
+  IN OUT  UINT8           *ResponseData,
+  IN OUT  UINT32          *ResponseDataSize
+  )
+{
+  EFI_STATUS  Status;
+
+  Status = DxeIpmiAsyncAcquire ();
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = IpmiSendCommand (
+             This,
+             NetFunction,
+             Lun,
+             Command,
+             CommandData,
+             CommandDataSize,
+             ResponseData,
+             ResponseDataSize
+             );
+  DxeIpmiAsyncRelease ();
+
+  return Status;
+}
+
+/**
+  Synchronous IPMI_TRANSPORT2 submission serialized with the queue.
+
+  @param[in]      This              Pointer to IPMI protocol instance.
+  @param[in]      NetFunction       Net Function of command to send.
+  @param[in]      Lun               LUN of command to send.
+  @param[in]      Command           IPMI command to send.
+  @param[in]      CommandData       Pointer to command data buffer, if needed.
+  @param[in]      CommandDataSize   Size of command data buffer.
+  @param[in,out]  ResponseData      Pointer to response data buffer.
+  @param[in,out]  ResponseDataSize  Pointer to response data buffer size.
+
+  @retval   EFI_NOT_READY     The caller interrupted another user of the
+                              transport, the command was not sent.
+  @retval   Other             Status returned by IpmiSendCommand2.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+DxeIpmiSendCommand2 (
+  IN      IPMI_TRANSPORT2  *This,
+  IN      UINT8            NetFunction,
+  IN      UINT8            Lun,
+  IN      UINT8            Command,
+  IN      UINT8            *CommandData,
+  IN      UINT32           CommandDataSize,
+  IN OUT  UINT8            *ResponseData,
+  IN OUT  UINT32           *ResponseDataSize
+  )
+{
+  EFI_STATUS  Status;
+
+  Status = DxeIpmiAsyncAcquire ();
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = IpmiSendCommand2 (
+             This,
+             NetFunction,
+             Lun,
+             Command,
+             CommandData,
+             CommandDataSize,
+             ResponseData,
+             ResponseDataSize
+             );
+  DxeIpmiAsyncRelease ();
+
+  return Status;
+}
+
+/**
+  Batch submission serialized with the queue.
+
+  @param[in]      This          Pointer to IPMI protocol instance.
+  @param[in,out]  Entries       The commands to send and their results.
+  @param[in]      EntryCount    The number of entries in Entries.
+  @param[in]      Flags         IPMI_BATCH_* flags controlling the batch.
+
+  @retval   EFI_NOT_READY     The caller interrupted another user of the
+                              transport, no command was sent.
+  @retval   Other             Status returned by IpmiSubmitBatch.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+DxeIpmiSubmitBatch (
+  IN      IPMI_TRANSPORT2   *This,
+  IN OUT  IPMI_BATCH_ENTRY  *Entries,
+  IN      UINTN             EntryCount,
+  IN      UINT32            Flags
+  )
+{
+  EFI_STATUS  Status;
+
+  Status = DxeIpmiAsyncAcquire ();
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = IpmiSubmitBatch (This, Entries, EntryCount, Flags);
+  DxeIpmiAsyncRelease ();
+
+  return Status;
+}
+
+/**
+  Initializes the asynchronous submission queue for the IPMI instance and
+  hooks the synchronous interfaces so they are serialized with it.
+
+  @param[in,out]  IpmiInstance    The IPMI instance to submit commands on.
+
+  @retval   EFI_SUCCESS           The queue was initialized.
+  @retval   Other                 The events could not be created.
+**/
+EFI_STATUS
+DxeIpmiAsyncInitialize (
+  IN OUT IPMI_BMC_INSTANCE_DATA  *IpmiInstance
+  )
+{
+  EFI_STATUS  Status;
+  EFI_EVENT   ExitBootServicesEvent;
+
+  mAsyncIpmiInstance = IpmiInstance;
+  mAsyncTimeoutTicks = DivU64x32 (
+                         MultU64x32 (PcdGet8 (PcdIpmiCommandTimeoutSeconds), 10 * 1000 * 1000),
+                         IPMI_ASYNC_POLL_PERIOD
+                         );
+
+  //
+  // Responses are only polled for from the timer if the transport can tell
+  // that one is ready without waiting for it.
+  //
+  mAsyncCanPoll = (BOOLEAN)(CheckBmcResponseReady () != EFI_UNSUPPORTED);
+
+  Status = gBS->CreateEvent (
+                  EVT_TIMER | EVT_NOTIFY_SIGNAL,
+                  TPL_CALLBACK,
+                  DxeIpmiAsyncTimerHandler,
+                  NULL,
+                  &mAsyncTimerEvent
+                  );
+
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "[IPMI] Failed to create async timer event. %r\n", Status));
+    return Status;
+  }
+
+  Status = gBS->CreateEvent (
+                  EVT_SIGNAL_EXIT_BOOT_SERVICES,
+                  TPL_CALLBACK,
+                  DxeIpmiAsyncExitBootServices,
+                  NULL,
+                  &ExitBootServicesEvent
+                  );
+
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "[IPMI] Failed to create async exit boot services event. %r\n", Status));
+    gBS->CloseEvent (mAsyncTimerEvent);
+    mAsyncTimerEvent = NULL;
+    return Status;
+  }
+
+  IpmiInstance->IpmiTransport.IpmiSubmitCommand   = DxeIpmiSendCommand;
+  IpmiInstance->IpmiTransport2.IpmiSubmitCommand  = DxeIpmiSendCommand2;
+  IpmiInstance->IpmiTransport2.SubmitBatch        = DxeIpmiSubmitBatch;
+  IpmiInstance->IpmiTransport2.SubmitCommandAsync = DxeIpmiSubmitCommandAsync;
+
+  return EFI_SUCCESS;
+}
@@ -0,0 +1,61 @@
+/** @file
+  Definitions for asynchronous IPMI command submission in DXE.
+
+  Copyright (c) Microsoft Corporation
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef DXE_IPMI_ASYNC_H_
+#define DXE_IPMI_ASYNC_H_
+
+#include <GenericIpmi.h>
+
+//
+// Period of the timer that drives queued commands, in 100ns units.
+//
+#define IPMI_ASYNC_POLL_PERIOD  10000
+
+#define IPMI_ASYNC_REQUEST_SIGNATURE  SIGNATURE_32 ('i', 'p', 'm', 'a')
+
+//
+// A command queued for asynchronous submission. The command is sent as a
+// transaction, the same as a synchronous command, so it is retried and traced
+// the same way. TicksWaited counts the timer ticks spent waiting for the
+// response, BackoffTicks the ticks still to wait before it is sent again.
+// Done is set once the transaction has completed and the token is still to be
+// signaled.
+//
+typedef struct {
+  UINTN               Signature;
+  LIST_ENTRY          Link;
+  IPMI_ASYNC_TOKEN    *Token;
+  IPMI_TRANSACTION    Transaction;
+  UINT32              ResponseDataSize;
+  UINT64              TicksWaited;
+  UINT64              BackoffTicks;
+  BOOLEAN             Done;
+} IPMI_ASYNC_REQUEST;
+
+#define IPMI_ASYNC_REQUEST_FROM_LINK(a) \
+  CR ( \
+  a, \
+  IPMI_ASYNC_REQUEST, \
+  Link, \
+  IPMI_ASYNC_REQUEST_SIGNATURE \
+  )
+
+/**
+  Initializes the asynchronous submission queue for the IPMI instance and
+  hooks the synchronous interfaces so they are serialized with it.
+
+  @param[in,out]  IpmiInstance    The IPMI instance to submit commands on.
+
+  @retval   EFI_SUCCESS           The queue was initialized.
+  @retval   Other                 The events could not be created.
+**/
+EFI_STATUS
+DxeIpmiAsyncInitialize (
+  IN OUT IPMI_BMC_INSTANCE_DATA  *IpmiInstance
+  );
+
+#endif
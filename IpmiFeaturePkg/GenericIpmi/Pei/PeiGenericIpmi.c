@@ -10,6 +10,7 @@
 #include <Uefi.h>
 
 #include <Ppi/IpmiTransportPpi.h>
+#include <Ppi/IpmiTransport2Ppi.h>
 
 #include <Library/BaseLib.h>
 #include <Library/DebugLib.h>
@@ -57,9 +58,9 @@ PeimIpmiInterfaceInit (
   Status       = PeiServicesRegisterForShadow (FileHandle);
   if (!EFI_ERROR (Status)) {
     //
-    // Make one allocation for both the PPI descriptor and the Bmc Instance data
+    // Make one allocation for both PPI descriptors and the Bmc Instance data
     //
-    IpmiInstance = AllocateZeroPool (sizeof (IPMI_BMC_INSTANCE_DATA) + sizeof (EFI_PEI_PPI_DESCRIPTOR));
+    IpmiInstance = AllocateZeroPool (sizeof (IPMI_BMC_INSTANCE_DATA) + (2 * sizeof (EFI_PEI_PPI_DESCRIPTOR)));
     if (IpmiInstance == NULL) {
       DEBUG ((DEBUG_ERROR, "[IPMI] EFI_OUT_OF_RESOURCES of memory allocation\n"));
       return EFI_OUT_OF_RESOURCES;
@@ -68,28 +69,35 @@ PeimIpmiInterfaceInit (
     PeiIpmiBmcDataDesc = (EFI_PEI_PPI_DESCRIPTOR *)((UINT8 *)IpmiInstance + sizeof (IPMI_BMC_INSTANCE_DATA));
 
     //
-    // Calibrate TSC Counter.  Stall for 10ms, then multiply the resulting number of
-    // ticks in that period by 100 to get the number of ticks in a 1 second timeout
+    // Initialize the transaction timeout in microseconds.
     //
     DEBUG ((DEBUG_INFO, "[IPMI] IPMI STACK Initialization\n"));
-    IpmiInstance->IpmiTimeoutPeriod = (PcdGet8 (PcdIpmiCommandTimeoutSeconds) *1000*1000) / IPMI_DELAY_UNIT;
-    DEBUG ((DEBUG_INFO, "[IPMI] IpmiTimeoutPeriod = 0x%x\n", IpmiInstance->IpmiTimeoutPeriod));
+    IpmiInstance->IpmiTimeoutPeriod = MultU64x32 (PcdGet8 (PcdIpmiCommandTimeoutSeconds), 1000 * 1000);
+    DEBUG ((DEBUG_INFO, "[IPMI] IpmiTimeoutPeriod = 0x%lx\n", IpmiInstance->IpmiTimeoutPeriod));
 
     //
     // Initialize IPMI IO Base.
     //
-    IpmiInstance->Signature                       = SM_IPMI_BMC_SIGNATURE;
-    IpmiInstance->SlaveAddress                    = BMC_SLAVE_ADDRESS;
-    IpmiInstance->BmcStatus                       = BMC_NOTREADY;
-    IpmiInstance->IpmiTransport.IpmiSubmitCommand = IpmiSendCommand;
-    IpmiInstance->IpmiTransport.GetBmcStatus      = IpmiGetBmcStatus;
+    IpmiInstance->Signature                         = SM_IPMI_BMC_SIGNATURE;
+    IpmiInstance->SlaveAddress                      = BMC_SLAVE_ADDRESS;
+    IpmiInstance->BmcStatus                         = BMC_NOTREADY;
+    IpmiInstance->IpmiTransport.IpmiSubmitCommand   = IpmiSendCommand;
+    IpmiInstance->IpmiTransport.GetBmcStatus        = IpmiGetBmcStatus;
+    IpmiInstance->IpmiTransport2.Revision           = IPMI_TRANSPORT2_REVISION;
+    IpmiInstance->IpmiTransport2.IpmiSubmitCommand  = IpmiSendCommand2;
+    IpmiInstance->IpmiTransport2.GetBmcStatus       = IpmiGetBmcStatus2;
+    IpmiInstance->IpmiTransport2.SubmitBatch        = IpmiSubmitBatch;
+    IpmiInstance->IpmiTransport2.SubmitCommandAsync = IpmiSubmitCommandAsync;
 
     //
-    // Initialize the Ppi descriptor
+    // Initialize the Ppi descriptors
     //
-    PeiIpmiBmcDataDesc->Flags = EFI_PEI_PPI_DESCRIPTOR_PPI | EFI_PEI_PPI_DESCRIPTOR_TERMINATE_LIST;
-    PeiIpmiBmcDataDesc->Guid  = &gPeiIpmiTransportPpiGuid;
-    PeiIpmiBmcDataDesc->Ppi   = &IpmiInstance->IpmiTransport;
+    PeiIpmiBmcDataDesc[0].Flags = EFI_PEI_PPI_DESCRIPTOR_PPI;
+    PeiIpmiBmcDataDesc[0].Guid  = &gPeiIpmiTransportPpiGuid;
+    PeiIpmiBmcDataDesc[0].Ppi   = &IpmiInstance->IpmiTransport;
+    PeiIpmiBmcDataDesc[1].Flags = EFI_PEI_PPI_DESCRIPTOR_PPI | EFI_PEI_PPI_DESCRIPTOR_TERMINATE_LIST;
+    PeiIpmiBmcDataDesc[1].Guid  = &gPeiIpmiTransport2PpiGuid;
+    PeiIpmiBmcDataDesc[1].Ppi   = &IpmiInstance->IpmiTransport2;
 
     //
     // Initialize the transport layer.
@@ -120,6 +128,7 @@ PeimIpmiInterfaceInit (
     }
 
     BmcHob->BmcStatus = IpmiInstance->BmcStatus;
+    CopyMem (&BmcHob->Identity, &IpmiInstance->Identity, sizeof (BmcHob->Identity));
 
     //
     // Do not continue initialization if the BMC is in Force Update Mode.
@@ -128,8 +137,10 @@ PeimIpmiInterfaceInit (
       return EFI_UNSUPPORTED;
     }
 
+    IpmiCircuitBreakerInitialize (IpmiInstance);
+
     //
-    // Just produce PPI
+    // Just produce PPIs
     //
     Status = PeiServicesInstallPpi (PeiIpmiBmcDataDesc);
     if (EFI_ERROR (Status)) {
@@ -140,6 +151,8 @@ PeimIpmiInterfaceInit (
 
     IPMI_BMC_INSTANCE_DATA  *OldIpmiInstance;
     EFI_PEI_PPI_DESCRIPTOR  *OldPeiIpmiBmcDataDesc;
+    EFI_PEI_PPI_DESCRIPTOR  *OldPeiIpmiBmcData2Desc;
+    IPMI_TRANSPORT2         *OldIpmiTransport2;
     EFI_PEI_HOB_POINTERS    Hob;
 
     // Locate the existing PPI
@@ -158,17 +171,29 @@ PeimIpmiInterfaceInit (
             (OldIpmiInstance->Signature == SM_IPMI_BMC_SIGNATURE))
         {
           // Found the allocation, update the pointers to the shadowed memory locations
-          IpmiInstance                                  = OldIpmiInstance;
-          IpmiInstance->IpmiTransport.IpmiSubmitCommand = IpmiSendCommand;
-          IpmiInstance->IpmiTransport.GetBmcStatus      = IpmiGetBmcStatus;
+          IpmiInstance                                    = OldIpmiInstance;
+          IpmiInstance->IpmiTransport.IpmiSubmitCommand   = IpmiSendCommand;
+          IpmiInstance->IpmiTransport.GetBmcStatus        = IpmiGetBmcStatus;
+          IpmiInstance->IpmiTransport2.IpmiSubmitCommand  = IpmiSendCommand2;
+          IpmiInstance->IpmiTransport2.GetBmcStatus       = IpmiGetBmcStatus2;
+          IpmiInstance->IpmiTransport2.SubmitBatch        = IpmiSubmitBatch;
+          IpmiInstance->IpmiTransport2.SubmitCommandAsync = IpmiSubmitCommandAsync;
 
-          // The PPI descriptor is located after the IPMI instance data
-          PeiIpmiBmcDataDesc      = (EFI_PEI_PPI_DESCRIPTOR *)((UINT8 *)IpmiInstance + sizeof (IPMI_BMC_INSTANCE_DATA));
-          PeiIpmiBmcDataDesc->Ppi = (VOID *)&IpmiInstance->IpmiTransport;
+          // The PPI descriptors are located after the IPMI instance data
+          PeiIpmiBmcDataDesc        = (EFI_PEI_PPI_DESCRIPTOR *)((UINT8 *)IpmiInstance + sizeof (IPMI_BMC_INSTANCE_DATA));
+          PeiIpmiBmcDataDesc[0].Ppi = (VOID *)&IpmiInstance->IpmiTransport;
+          PeiIpmiBmcDataDesc[1].Ppi = (VOID *)&IpmiInstance->IpmiTransport2;
 
-          Status = PeiServicesReInstallPpi (OldPeiIpmiBmcDataDesc, PeiIpmiBmcDataDesc);
+          Status = PeiServicesReInstallPpi (OldPeiIpmiBmcDataDesc, &PeiIpmiBmcDataDesc[0]);
 
           DEBUG ((DEBUG_INFO, "%a - Reinstalling gPeiIpmiTransportPpiGuid - %r\n", __func__, Status));
+
+          Status = PeiServicesLocatePpi (&gPeiIpmiTransport2PpiGuid, 0, &OldPeiIpmiBmcData2Desc, (VOID **)&OldIpmiTransport2);
+          if (!EFI_ERROR (Status)) {
+            Status = PeiServicesReInstallPpi (OldPeiIpmiBmcData2Desc, &PeiIpmiBmcDataDesc[1]);
+          }
+
+          DEBUG ((DEBUG_INFO, "%a - Reinstalling gPeiIpmiTransport2PpiGuid - %r\n", __func__, Status));
           return EFI_SUCCESS;
         }
 
@@ -65,21 +65,25 @@ InitializeSmmGenericIpmi (
   }
 
   //
-  // Initialize the KCS transaction timeout. Assume delay unit is 1000 us.
+  // Initialize the transaction timeout in microseconds.
   //
-  mIpmiInstance->IpmiTimeoutPeriod =
-    (PcdGet8 (PcdIpmiCommandTimeoutSeconds) * 1000 * 1000) / IPMI_DELAY_UNIT;
+  mIpmiInstance->IpmiTimeoutPeriod = MultU64x32 (PcdGet8 (PcdIpmiCommandTimeoutSeconds), 1000 * 1000);
 
   //
   // Initialize IPMI IO Base, we still use SMS IO base to get device ID and
   // Self-test result since SMM IF may have different cmds supported.
   //
 
-  mIpmiInstance->Signature                       = SM_IPMI_BMC_SIGNATURE;
-  mIpmiInstance->SlaveAddress                    = BMC_SLAVE_ADDRESS;
-  mIpmiInstance->BmcStatus                       = BMC_NOTREADY;
-  mIpmiInstance->IpmiTransport.IpmiSubmitCommand = IpmiSendCommand;
-  mIpmiInstance->IpmiTransport.GetBmcStatus      = IpmiGetBmcStatus;
+  mIpmiInstance->Signature                         = SM_IPMI_BMC_SIGNATURE;
+  mIpmiInstance->SlaveAddress                      = BMC_SLAVE_ADDRESS;
+  mIpmiInstance->BmcStatus                         = BMC_NOTREADY;
+  mIpmiInstance->IpmiTransport.IpmiSubmitCommand   = IpmiSendCommand;
+  mIpmiInstance->IpmiTransport.GetBmcStatus        = IpmiGetBmcStatus;
+  mIpmiInstance->IpmiTransport2.Revision           = IPMI_TRANSPORT2_REVISION;
+  mIpmiInstance->IpmiTransport2.IpmiSubmitCommand  = IpmiSendCommand2;
+  mIpmiInstance->IpmiTransport2.GetBmcStatus       = IpmiGetBmcStatus2;
+  mIpmiInstance->IpmiTransport2.SubmitBatch        = IpmiSubmitBatch;
+  mIpmiInstance->IpmiTransport2.SubmitCommandAsync = IpmiSubmitCommandAsync;
 
   //
   // Check if PEI already initialized the BMC connection.
@@ -100,8 +104,17 @@ InitializeSmmGenericIpmi (
     BmcHob                   = (IPMI_BMC_HOB *)GET_GUID_HOB_DATA (GuidHob);
     mIpmiInstance->BmcStatus = BmcHob->BmcStatus;
     DEBUG ((DEBUG_INFO, "[IPMI] Found IPMI BMC HOB. BMC Status = 0x%d\n", BmcHob->BmcStatus));
+
+    //
+    // Answer the BMC identity from what PEI read, if the HOB carries it.
+    //
+    if (GET_GUID_HOB_DATA_SIZE (GuidHob) >= sizeof (IPMI_BMC_HOB)) {
+      IpmiIdentityRestore (mIpmiInstance, &BmcHob->Identity);
+    }
   }
 
+  IpmiCircuitBreakerInitialize (mIpmiInstance);
+
   Handle = NULL;
   DEBUG ((DEBUG_INFO, "[IPMI] Installing SMM protocol!\n"));
   Status = gSmst->SmmInstallProtocolInterface (
@@ -112,5 +125,13 @@ InitializeSmmGenericIpmi (
                     );
   ASSERT_EFI_ERROR (Status);
 
+  Status = gSmst->SmmInstallProtocolInterface (
+                    &Handle,
+                    &gSmmIpmiTransport2ProtocolGuid,
+                    EFI_NATIVE_INTERFACE,
+                    &mIpmiInstance->IpmiTransport2
+                    );
+  ASSERT_EFI_ERROR (Status);
+
   return EFI_SUCCESS;
 }
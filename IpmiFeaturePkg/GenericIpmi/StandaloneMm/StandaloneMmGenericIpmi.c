@@ -62,21 +62,25 @@ InitializeStandaloneMmGenericIpmi (
   }
 
   //
-  // Initialize the KCS transaction timeout. Assume delay unit is 1000 us.
+  // Initialize the transaction timeout in microseconds.
   //
-  mIpmiInstance->IpmiTimeoutPeriod =
-    (PcdGet8 (PcdIpmiCommandTimeoutSeconds) * 1000 * 1000) / IPMI_DELAY_UNIT;
+  mIpmiInstance->IpmiTimeoutPeriod = MultU64x32 (PcdGet8 (PcdIpmiCommandTimeoutSeconds), 1000 * 1000);
 
   //
   // Initialize IPMI IO Base, we still use SMS IO base to get device ID and
   // Self-test result since MM IF may have different cmds supported.
   //
 
-  mIpmiInstance->Signature                       = SM_IPMI_BMC_SIGNATURE;
-  mIpmiInstance->SlaveAddress                    = BMC_SLAVE_ADDRESS;
-  mIpmiInstance->BmcStatus                       = BMC_NOTREADY;
-  mIpmiInstance->IpmiTransport.IpmiSubmitCommand = IpmiSendCommand;
-  mIpmiInstance->IpmiTransport.GetBmcStatus      = IpmiGetBmcStatus;
+  mIpmiInstance->Signature                         = SM_IPMI_BMC_SIGNATURE;
+  mIpmiInstance->SlaveAddress                      = BMC_SLAVE_ADDRESS;
+  mIpmiInstance->BmcStatus                         = BMC_NOTREADY;
+  mIpmiInstance->IpmiTransport.IpmiSubmitCommand   = IpmiSendCommand;
+  mIpmiInstance->IpmiTransport.GetBmcStatus        = IpmiGetBmcStatus;
+  mIpmiInstance->IpmiTransport2.Revision           = IPMI_TRANSPORT2_REVISION;
+  mIpmiInstance->IpmiTransport2.IpmiSubmitCommand  = IpmiSendCommand2;
+  mIpmiInstance->IpmiTransport2.GetBmcStatus       = IpmiGetBmcStatus2;
+  mIpmiInstance->IpmiTransport2.SubmitBatch        = IpmiSubmitBatch;
+  mIpmiInstance->IpmiTransport2.SubmitCommandAsync = IpmiSubmitCommandAsync;
 
   //
   // Check if PEI already initialized the BMC connection.
@@ -97,8 +101,17 @@ InitializeStandaloneMmGenericIpmi (
     BmcHob                   = (IPMI_BMC_HOB *)GET_GUID_HOB_DATA (GuidHob);
     mIpmiInstance->BmcStatus = BmcHob->BmcStatus;
     DEBUG ((DEBUG_INFO, "[IPMI] Found IPMI BMC HOB. BMC Status = 0x%d\n", BmcHob->BmcStatus));
+
+    //
+    // Answer the BMC identity from what PEI read, if the HOB carries it.
+    //
+    if (GET_GUID_HOB_DATA_SIZE (GuidHob) >= sizeof (IPMI_BMC_HOB)) {
+      IpmiIdentityRestore (mIpmiInstance, &BmcHob->Identity);
+    }
   }
 
+  IpmiCircuitBreakerInitialize (mIpmiInstance);
+
   Handle = NULL;
   DEBUG ((DEBUG_INFO, "[IPMI] Installing MM protocol!\n"));
   Status = gMmst->MmInstallProtocolInterface (
@@ -109,5 +122,13 @@ InitializeStandaloneMmGenericIpmi (
                     );
   ASSERT_EFI_ERROR (Status);
 
+  Status = gMmst->MmInstallProtocolInterface (
+                    &Handle,
+                    &gSmmIpmiTransport2ProtocolGuid,
+                    EFI_NATIVE_INTERFACE,
+                    &mIpmiInstance->IpmiTransport2
+                    );
+  ASSERT_EFI_ERROR (Status);
+
   return Status;
 }
@@ -10,15 +10,74 @@
 #include <Library/BaseLib.h>
 #include <Library/DebugLib.h>
 #include <Library/BaseMemoryLib.h>
+#include <Library/TimerLib.h>
 #include <Library/UnitTestLib.h>
 #include <IndustryStandard/Ipmi.h>
+#include <IpmiFeature.h>
+#include <VirtualTimer.h>
 
 #include <GenericIpmi.h>
 
 #define UNIT_TEST_NAME     "Generic IPMI Unit Test"
 #define UNIT_TEST_VERSION  "1.0"
 
+//
+// A net function the mock BMC does not implement any commands for.
+//
+#define TEST_UNSUPPORTED_NETFN  0x30
+
 IPMI_BMC_INSTANCE_DATA  mIpmiInstance;
+IPMI_TRACE_DATA         mIpmiTrace;
+
+/**
+  Sets the status returned by the mock transport, simulating a BMC that does
+  not respond when an error is set. Implemented by the mock transport library.
+
+  @param[in]  Status    The status to return, EFI_SUCCESS for normal operation.
+**/
+VOID
+MockIpmiSetTransportStatus (
+  IN EFI_STATUS  Status
+  );
+
+/**
+  Answers the next IPMI requests with a completion code instead of handling
+  them. Implemented by the mock BMC.
+
+  @param[in]  CompletionCode    The completion code to respond with.
+  @param[in]  Count             The number of requests to answer, 0 to stop.
+**/
+VOID
+MockIpmiSetBusy (
+  IN UINT8  CompletionCode,
+  IN UINT8  Count
+  );
+
+/**
+  Sends Get Device ID through the IPMI transport of the test instance.
+
+  @retval   The status returned by the transport.
+**/
+EFI_STATUS
+SendGetDeviceId (
+  VOID
+  )
+{
+  IPMI_GET_DEVICE_ID_RESPONSE  DeviceId;
+  UINT32                       DataSize;
+
+  DataSize = sizeof (DeviceId);
+  return mIpmiInstance.IpmiTransport.IpmiSubmitCommand (
+                                       &mIpmiInstance.IpmiTransport,
+                                       IPMI_NETFN_APP,
+                                       0,
+                                       IPMI_APP_GET_DEVICE_ID,
+                                       NULL,
+                                       0,
+                                       (UINT8 *)&DeviceId,
+                                       &DataSize
+                                       );
+}
 
 /**
   Tests initializing the IPMI stack.
@@ -39,16 +98,123 @@ TestIpmiInit (
   EFI_STATUS  Status;
 
   ZeroMem (&mIpmiInstance, sizeof (mIpmiInstance));
-  mIpmiInstance.Signature                       = SM_IPMI_BMC_SIGNATURE;
-  mIpmiInstance.SlaveAddress                    = BMC_SLAVE_ADDRESS;
-  mIpmiInstance.BmcStatus                       = BMC_NOTREADY;
-  mIpmiInstance.IpmiTransport.IpmiSubmitCommand = IpmiSendCommand;
-  mIpmiInstance.IpmiTransport.GetBmcStatus      = IpmiGetBmcStatus;
+  mIpmiInstance.Signature                         = SM_IPMI_BMC_SIGNATURE;
+  mIpmiInstance.SlaveAddress                      = BMC_SLAVE_ADDRESS;
+  mIpmiInstance.BmcStatus                         = BMC_NOTREADY;
+  mIpmiInstance.IpmiTransport.IpmiSubmitCommand   = IpmiSendCommand;
+  mIpmiInstance.IpmiTransport.GetBmcStatus        = IpmiGetBmcStatus;
+  mIpmiInstance.IpmiTransport2.Revision           = IPMI_TRANSPORT2_REVISION;
+  mIpmiInstance.IpmiTransport2.IpmiSubmitCommand  = IpmiSendCommand2;
+  mIpmiInstance.IpmiTransport2.GetBmcStatus       = IpmiGetBmcStatus2;
+  mIpmiInstance.IpmiTransport2.SubmitBatch        = IpmiSubmitBatch;
+  mIpmiInstance.IpmiTransport2.SubmitCommandAsync = IpmiSubmitCommandAsync;
 
+  //
+  // A BMC that answers at once adds no delay to boot.
+  //
+  VirtualTimerReset ();
   Status = IpmiInitializeBmc (&mIpmiInstance);
   UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
   UT_ASSERT_EQUAL (mIpmiInstance.BmcStatus, BMC_OK);
   UT_ASSERT_EQUAL (mIpmiInstance.SoftErrorCount, 0);
+  UT_ASSERT_EQUAL (VirtualTimerGetDelay (NULL), 0);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Tests answering the BMC identity without reaching the BMC.
+
+  @param[in]  Context             UNUSED
+
+  @retval  UNIT_TEST_PASSED             The Unit test has completed and the test
+                                        case was successful.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A test case assertion has failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+TestIpmiIdentityCache (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+
+{
+  EFI_STATUS                                     Status;
+  IPMI_GET_DEVICE_ID_RESPONSE                    DeviceId;
+  IPMI_GET_SYSTEM_GUID_RESPONSE                  SystemGuid;
+  IPMI_GET_SYSTEM_INTERFACE_CAPABILITY_REQUEST   CapabilityRequest;
+  IPMI_GET_SYSTEM_INTERFACE_CAPABILITY_RESPONSE  Capability;
+  UINT32                                         DataSize;
+
+  UT_ASSERT_EQUAL (
+    mIpmiInstance.Identity.Valid,
+    IPMI_BMC_IDENTITY_DEVICE_ID | IPMI_BMC_IDENTITY_SELF_TEST | IPMI_BMC_IDENTITY_SYSTEM_GUID | IPMI_BMC_IDENTITY_INTERFACE_CAP
+    );
+
+  //
+  // A BMC that does not respond is not asked.
+  //
+  MockIpmiSetTransportStatus (EFI_TIMEOUT);
+
+  DataSize = sizeof (DeviceId);
+  Status   = IpmiSendCommand (&mIpmiInstance.IpmiTransport, IPMI_NETFN_APP, 0, IPMI_APP_GET_DEVICE_ID, NULL, 0, (UINT8 *)&DeviceId, &DataSize);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (DataSize, sizeof (DeviceId));
+  UT_ASSERT_EQUAL (DeviceId.CompletionCode, IPMI_COMP_CODE_NORMAL);
+  UT_ASSERT_EQUAL (DeviceId.DeviceId, 0xAB);
+
+  DataSize = sizeof (SystemGuid);
+  Status   = IpmiSendCommand (&mIpmiInstance.IpmiTransport, IPMI_NETFN_APP, 0, IPMI_APP_GET_SYSTEM_GUID, NULL, 0, (UINT8 *)&SystemGuid, &DataSize);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (SystemGuid.Guid.Data1, 0x12345678);
+
+  //
+  // The capabilities are only cached for the interface they were read for.
+  //
+  CapabilityRequest.SystemInterfaceType = GetSystemInterfaceTypeKcs;
+  CapabilityRequest.Reserved            = 0;
+  DataSize                              = sizeof (Capability);
+  Status                                = IpmiSendCommand (
+                                            &mIpmiInstance.IpmiTransport,
+                                            IPMI_NETFN_APP,
+                                            0,
+                                            IPMI_APP_GET_SYSTEM_INTERFACE_CAPABILITIES,
+                                            (UINT8 *)&CapabilityRequest,
+                                            sizeof (CapabilityRequest),
+                                            (UINT8 *)&Capability,
+                                            &DataSize
+                                            );
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (DataSize, sizeof (IPMI_GET_SYSTEM_INTERFACE_CAPABILITY_RESPONSE_KCS));
+
+  CapabilityRequest.SystemInterfaceType = GetSystemInterfaceTypeSsif;
+  DataSize                              = sizeof (Capability);
+  Status                                = IpmiSendCommand (
+                                            &mIpmiInstance.IpmiTransport,
+                                            IPMI_NETFN_APP,
+                                            0,
+                                            IPMI_APP_GET_SYSTEM_INTERFACE_CAPABILITIES,
+                                            (UINT8 *)&CapabilityRequest,
+                                            sizeof (CapabilityRequest),
+                                            (UINT8 *)&Capability,
+                                            &DataSize
+                                            );
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_TIMEOUT);
+
+  //
+  // An undersized buffer gets the size of the cached response.
+  //
+  DataSize = 2;
+  Status   = IpmiSendCommand (&mIpmiInstance.IpmiTransport, IPMI_NETFN_APP, 0, IPMI_APP_GET_DEVICE_ID, NULL, 0, (UINT8 *)&DeviceId, &DataSize);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_BUFFER_TOO_SMALL);
+  UT_ASSERT_EQUAL (DataSize, sizeof (DeviceId));
+
+  MockIpmiSetTransportStatus (EFI_SUCCESS);
+  mIpmiInstance.BmcStatus = BMC_OK;
+
+  //
+  // Let the following tests reach the mock BMC.
+  //
+  mIpmiInstance.Identity.Valid = 0;
 
   return UNIT_TEST_PASSED;
 }
@@ -224,8 +390,476 @@ TestIpmiBufferTooSmall (
 
   UT_ASSERT_STATUS_EQUAL (Status, EFI_BUFFER_TOO_SMALL);
   UT_ASSERT_EQUAL (DataSize, sizeof (IPMI_GET_DEVICE_ID_RESPONSE));
-  UT_ASSERT_MEM_EQUAL (&Response, &ZeroResponse, sizeof (Response));
 
+  //
+  // The response is received in place, so only the bytes past the provided
+  // size must be left untouched.
+  //
+  UT_ASSERT_EQUAL (Response.CompletionCode, IPMI_COMP_CODE_NORMAL);
+  UT_ASSERT_MEM_EQUAL ((UINT8 *)&Response + 4, (UINT8 *)&ZeroResponse + 4, sizeof (Response) - 4);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Tests that command data larger than the transport can carry is rejected
+  without being sent.
+
+  @param[in]  Context             UNUSED
+
+  @retval  UNIT_TEST_PASSED             The Unit test has completed and the test
+                                        case was successful.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A test case assertion has failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+TestIpmiCommandTooLarge (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+
+{
+  EFI_STATUS  Status;
+  UINT8       CommandData[MAX_UINT8 + 1];
+  UINT32      MaxRequestSize;
+  UINT32      MaxResponseSize;
+  UINT8       CompletionCode;
+  UINT32      DataSize;
+
+  GetBmcMaxMessageSize (&MaxRequestSize, &MaxResponseSize);
+  UT_ASSERT_TRUE (MaxRequestSize < sizeof (CommandData));
+
+  ZeroMem (CommandData, sizeof (CommandData));
+  DataSize = sizeof (CompletionCode);
+  Status   = mIpmiInstance.IpmiTransport.IpmiSubmitCommand (
+                                           &mIpmiInstance.IpmiTransport,
+                                           IPMI_NETFN_APP,
+                                           0,
+                                           IPMI_APP_GET_DEVICE_ID,
+                                           CommandData,
+                                           MaxRequestSize + 1,
+                                           &CompletionCode,
+                                           &DataSize
+                                           );
+
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_INVALID_PARAMETER);
+  UT_ASSERT_EQUAL (mIpmiInstance.LastCompletionCode, IPMI_COMP_CODE_UNSPECIFIED);
+
+  //
+  // A command larger than a UINT8 is not truncated to fit.
+  //
+  Status = mIpmiInstance.IpmiTransport.IpmiSubmitCommand (
+                                         &mIpmiInstance.IpmiTransport,
+                                         IPMI_NETFN_APP,
+                                         0,
+                                         IPMI_APP_GET_DEVICE_ID,
+                                         CommandData,
+                                         sizeof (CommandData),
+                                         &CompletionCode,
+                                         &DataSize
+                                         );
+
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_INVALID_PARAMETER);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Tests sending a batch of IPMI commands with and without stopping on the
+  first error.
+
+  @param[in]  Context             UNUSED
+
+  @retval  UNIT_TEST_PASSED             The Unit test has completed and the test
+                                        case was successful.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A test case assertion has failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+TestIpmiBatch (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+
+{
+  EFI_STATUS                      Status;
+  IPMI_BATCH_ENTRY                Entries[3];
+  IPMI_GET_DEVICE_ID_RESPONSE     DeviceId;
+  IPMI_SELF_TEST_RESULT_RESPONSE  SelfTest;
+  UINT8                           Unsupported[4];
+
+  ZeroMem (Entries, sizeof (Entries));
+  Entries[0].NetFunction = IPMI_NETFN_APP;
+  Entries[0].Command     = IPMI_APP_GET_DEVICE_ID;
+  Entries[1].NetFunction = TEST_UNSUPPORTED_NETFN;
+  Entries[1].Command     = 0x01;
+  Entries[2].NetFunction = IPMI_NETFN_APP;
+  Entries[2].Command     = IPMI_APP_GET_SELFTEST_RESULTS;
+
+  //
+  // Without stopping, every entry is run and the first failure is returned.
+  //
+  ZeroMem (&DeviceId, sizeof (DeviceId));
+  ZeroMem (&SelfTest, sizeof (SelfTest));
+  Entries[0].ResponseData     = (UINT8 *)&DeviceId;
+  Entries[0].ResponseDataSize = sizeof (DeviceId);
+  Entries[1].ResponseData     = Unsupported;
+  Entries[1].ResponseDataSize = sizeof (Unsupported);
+  Entries[2].ResponseData     = (UINT8 *)&SelfTest;
+  Entries[2].ResponseDataSize = sizeof (SelfTest);
+
+  Status = mIpmiInstance.IpmiTransport2.SubmitBatch (
+                                          &mIpmiInstance.IpmiTransport2,
+                                          Entries,
+                                          ARRAY_SIZE (Entries),
+                                          0
+                                          );
+
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_DEVICE_ERROR);
+  UT_ASSERT_STATUS_EQUAL (Entries[0].Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (Entries[0].CompletionCode, IPMI_COMP_CODE_NORMAL);
+  UT_ASSERT_EQUAL (Entries[0].ResponseDataSize, sizeof (DeviceId));
+  UT_ASSERT_EQUAL (DeviceId.DeviceId, 0xAB);
+  UT_ASSERT_STATUS_EQUAL (Entries[1].Status, EFI_DEVICE_ERROR);
+  UT_ASSERT_EQUAL (Entries[1].CompletionCode, IPMI_COMP_CODE_INVALID_COMMAND);
+  UT_ASSERT_STATUS_EQUAL (Entries[2].Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (Entries[2].CompletionCode, IPMI_COMP_CODE_NORMAL);
+  UT_ASSERT_EQUAL (Entries[2].ResponseDataSize, sizeof (SelfTest));
+  UT_ASSERT_EQUAL (SelfTest.Result, IPMI_APP_SELFTEST_NOT_IMPLEMENTED);
+
+  //
+  // When stopping on error, the entries after the failure are not run.
+  //
+  SetMem (&SelfTest, sizeof (SelfTest), 0xFF);
+  Entries[0].ResponseDataSize = sizeof (DeviceId);
+  Entries[1].ResponseDataSize = sizeof (Unsupported);
+  Entries[2].ResponseDataSize = sizeof (SelfTest);
+
+  Status = mIpmiInstance.IpmiTransport2.SubmitBatch (
+                                          &mIpmiInstance.IpmiTransport2,
+                                          Entries,
+                                          ARRAY_SIZE (Entries),
+                                          IPMI_BATCH_STOP_ON_ERROR
+                                          );
+
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_DEVICE_ERROR);
+  UT_ASSERT_STATUS_EQUAL (Entries[0].Status, EFI_SUCCESS);
+  UT_ASSERT_STATUS_EQUAL (Entries[1].Status, EFI_DEVICE_ERROR);
+  UT_ASSERT_STATUS_EQUAL (Entries[2].Status, EFI_ABORTED);
+  UT_ASSERT_EQUAL (Entries[2].CompletionCode, IPMI_COMP_CODE_UNSPECIFIED);
+  UT_ASSERT_EQUAL (SelfTest.CompletionCode, 0xFF);
+
+  //
+  // Invalid flags are rejected.
+  //
+  Status = mIpmiInstance.IpmiTransport2.SubmitBatch (
+                                          &mIpmiInstance.IpmiTransport2,
+                                          Entries,
+                                          ARRAY_SIZE (Entries),
+                                          BIT31
+                                          );
+
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_INVALID_PARAMETER);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Tests the transaction trace and latency histograms.
+
+  @param[in]  Context             UNUSED
+
+  @retval  UNIT_TEST_PASSED             The Unit test has completed and the test
+                                        case was successful.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A test case assertion has failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+TestIpmiTrace (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+
+{
+  EFI_STATUS                   Status;
+  IPMI_TRACE_PROTOCOL          *Trace;
+  IPMI_TRACE_RECORD            Records[IPMI_TRACE_RECORD_COUNT];
+  IPMI_LATENCY_HISTOGRAM       Histograms[IPMI_TRACE_HISTOGRAM_COUNT];
+  IPMI_GET_DEVICE_ID_RESPONSE  DeviceId;
+  UINT8                        Unsupported[4];
+  UINT32                       DataSize;
+  UINTN                        Count;
+  UINT64                       TotalCount;
+  UINT64                       OverflowCount;
+  UINTN                        Index;
+
+  IpmiTraceInitialize (&mIpmiTrace);
+  mIpmiInstance.Trace = &mIpmiTrace;
+  Trace               = &mIpmiTrace.Protocol;
+
+  DataSize = sizeof (DeviceId);
+  Status   = mIpmiInstance.IpmiTransport.IpmiSubmitCommand (
+                                           &mIpmiInstance.IpmiTransport,
+                                           IPMI_NETFN_APP,
+                                           0,
+                                           IPMI_APP_GET_DEVICE_ID,
+                                           NULL,
+                                           0,
+                                           (UINT8 *)&DeviceId,
+                                           &DataSize
+                                           );
+
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+
+  DataSize = sizeof (Unsupported);
+  Status   = mIpmiInstance.IpmiTransport.IpmiSubmitCommand (
+                                           &mIpmiInstance.IpmiTransport,
+                                           TEST_UNSUPPORTED_NETFN,
+                                           0,
+                                           0x01,
+                                           NULL,
+                                           0,
+                                           Unsupported,
+                                           &DataSize
+                                           );
+
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_DEVICE_ERROR);
+
+  //
+  // The required count is returned when the buffer is too small.
+  //
+  Count  = 0;
+  Status = Trace->GetRecords (Trace, NULL, &Count, NULL);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_BUFFER_TOO_SMALL);
+  UT_ASSERT_EQUAL (Count, 2);
+
+  Status = Trace->GetRecords (Trace, Records, &Count, &TotalCount);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (Count, 2);
+  UT_ASSERT_EQUAL (TotalCount, 2);
+  UT_ASSERT_EQUAL (Records[0].NetFunction, IPMI_NETFN_APP);
+  UT_ASSERT_EQUAL (Records[0].Command, IPMI_APP_GET_DEVICE_ID);
+  UT_ASSERT_EQUAL (Records[0].CompletionCode, IPMI_COMP_CODE_NORMAL);
+  UT_ASSERT_EQUAL (Records[0].ResponseSize, sizeof (DeviceId));
+  UT_ASSERT_STATUS_EQUAL (Records[0].Status, EFI_SUCCESS);
+  UT_ASSERT_TRUE (Records[0].EndTime > Records[0].StartTime);
+  UT_ASSERT_EQUAL (Records[1].NetFunction, TEST_UNSUPPORTED_NETFN);
+  UT_ASSERT_EQUAL (Records[1].CompletionCode, IPMI_COMP_CODE_INVALID_COMMAND);
+  UT_ASSERT_STATUS_EQUAL (Records[1].Status, EFI_DEVICE_ERROR);
+  UT_ASSERT_TRUE (Records[1].StartTime >= Records[0].EndTime);
+
+  //
+  // Once the ring wraps, only the most recent records are returned, oldest
+  // first.
+  //
+  for (Index = 0; Index < IPMI_TRACE_RECORD_COUNT; Index++) {
+    DataSize = sizeof (DeviceId);
+    Status   = mIpmiInstance.IpmiTransport.IpmiSubmitCommand (
+                                             &mIpmiInstance.IpmiTransport,
+                                             IPMI_NETFN_APP,
+                                             0,
+                                             IPMI_APP_GET_DEVICE_ID,
+                                             NULL,
+                                             0,
+                                             (UINT8 *)&DeviceId,
+                                             &DataSize
+                                             );
+
+    UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  }
+
+  Count  = ARRAY_SIZE (Records);
+  Status = Trace->GetRecords (Trace, Records, &Count, &TotalCount);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (Count, IPMI_TRACE_RECORD_COUNT);
+  UT_ASSERT_EQUAL (TotalCount, IPMI_TRACE_RECORD_COUNT + 2);
+  for (Index = 1; Index < Count; Index++) {
+    UT_ASSERT_EQUAL (Records[Index].NetFunction, IPMI_NETFN_APP);
+    UT_ASSERT_TRUE (Records[Index].StartTime >= Records[Index - 1].EndTime);
+  }
+
+  //
+  // Each NetFn/Cmd pair has its own histogram.
+  //
+  Count  = ARRAY_SIZE (Histograms);
+  Status = Trace->GetHistograms (Trace, Histograms, &Count, &OverflowCount);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (Count, 2);
+  UT_ASSERT_EQUAL (OverflowCount, 0);
+  UT_ASSERT_EQUAL (Histograms[0].NetFunction, IPMI_NETFN_APP);
+  UT_ASSERT_EQUAL (Histograms[0].Command, IPMI_APP_GET_DEVICE_ID);
+  UT_ASSERT_EQUAL (Histograms[0].Count, IPMI_TRACE_RECORD_COUNT + 1);
+  UT_ASSERT_EQUAL (Histograms[1].NetFunction, TEST_UNSUPPORTED_NETFN);
+  UT_ASSERT_EQUAL (Histograms[1].Count, 1);
+  UT_ASSERT_TRUE (Histograms[0].MaxTime > 0);
+  UT_ASSERT_TRUE (Histograms[0].TotalTime >= Histograms[0].MaxTime);
+
+  //
+  // Pairs that find every histogram taken are counted as overflow.
+  //
+  for (Index = 2; Index < IPMI_TRACE_HISTOGRAM_COUNT + 3; Index++) {
+    IpmiTraceRecord (&mIpmiTrace, IPMI_NETFN_OEM, (UINT8)Index, IPMI_COMP_CODE_NORMAL, 0, 0, 0, EFI_SUCCESS, 0, 1);
+  }
+
+  Count  = ARRAY_SIZE (Histograms);
+  Status = Trace->GetHistograms (Trace, Histograms, &Count, &OverflowCount);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (Count, IPMI_TRACE_HISTOGRAM_COUNT);
+  UT_ASSERT_EQUAL (OverflowCount, 3);
+
+  Trace->Reset (Trace);
+  Count  = 0;
+  Status = Trace->GetRecords (Trace, NULL, &Count, NULL);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (Count, 0);
+  Status = Trace->GetHistograms (Trace, NULL, &Count, &OverflowCount);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (Count, 0);
+  UT_ASSERT_EQUAL (OverflowCount, 0);
+
+  //
+  // Commands answered from the cached identity are not traced.
+  //
+  mIpmiInstance.Identity.Valid = IPMI_BMC_IDENTITY_DEVICE_ID;
+  DataSize                     = sizeof (DeviceId);
+  Status                       = mIpmiInstance.IpmiTransport.IpmiSubmitCommand (
+                                                               &mIpmiInstance.IpmiTransport,
+                                                               IPMI_NETFN_APP,
+                                                               0,
+                                                               IPMI_APP_GET_DEVICE_ID,
+                                                               NULL,
+                                                               0,
+                                                               (UINT8 *)&DeviceId,
+                                                               &DataSize
+                                                               );
+
+  mIpmiInstance.Identity.Valid = 0;
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  Count  = 0;
+  Status = Trace->GetRecords (Trace, NULL, &Count, &TotalCount);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (Count, 0);
+  UT_ASSERT_EQUAL (TotalCount, 0);
+
+  mIpmiInstance.Trace = NULL;
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Tests that the circuit breaker opens when the BMC stops responding, refuses
+  commands while open and closes once a probe gets a response.
+
+  @param[in]  Context             UNUSED
+
+  @retval  UNIT_TEST_PASSED             The Unit test has completed and the test
+                                        case was successful.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A test case assertion has failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+TestIpmiCircuitBreaker (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+
+{
+  EFI_STATUS  Status;
+  UINT8       Index;
+
+  IpmiCircuitBreakerInitialize (&mIpmiInstance);
+  UT_ASSERT_EQUAL (mIpmiInstance.Breaker.State, IpmiBreakerClosed);
+
+  //
+  // Keep the breaker from probing until the test allows it.
+  //
+  mIpmiInstance.Breaker.ProbeInterval = MAX_UINT64;
+  MockIpmiSetTransportStatus (EFI_TIMEOUT);
+  for (Index = 0; Index < PcdGet8 (PcdIpmiCircuitBreakerThreshold); Index++) {
+    UT_ASSERT_EQUAL (mIpmiInstance.Breaker.State, IpmiBreakerClosed);
+    Status = SendGetDeviceId ();
+    UT_ASSERT_STATUS_EQUAL (Status, EFI_TIMEOUT);
+  }
+
+  UT_ASSERT_EQUAL (mIpmiInstance.Breaker.State, IpmiBreakerOpen);
+  UT_ASSERT_EQUAL (mIpmiInstance.BmcStatus, BMC_HARDFAIL);
+
+  //
+  // While open, commands fail without reaching the transport.
+  //
+  Status = SendGetDeviceId ();
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_NO_RESPONSE);
+
+  //
+  // A probe that gets no response leaves the breaker open.
+  //
+  mIpmiInstance.Breaker.ProbeInterval = 0;
+  Status                              = SendGetDeviceId ();
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_NO_RESPONSE);
+  UT_ASSERT_EQUAL (mIpmiInstance.Breaker.State, IpmiBreakerOpen);
+
+  //
+  // Once the BMC responds to the probe the command is sent.
+  //
+  MockIpmiSetTransportStatus (EFI_SUCCESS);
+  Status = SendGetDeviceId ();
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (mIpmiInstance.Breaker.State, IpmiBreakerClosed);
+  UT_ASSERT_EQUAL (mIpmiInstance.BmcStatus, BMC_OK);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Tests retrying commands on transient completion codes.
+
+  @param[in]  Context             UNUSED
+
+  @retval  UNIT_TEST_PASSED             The Unit test has completed and the test
+                                        case was successful.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A test case assertion has failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+TestIpmiRetryPolicy (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+
+{
+  EFI_STATUS  Status;
+  UINT64      Start;
+  UINT64      Elapsed;
+
+  //
+  // A busy BMC is retried with a backoff of 1 and 2 milliseconds.
+  //
+  MockIpmiSetBusy (IPMI_COMP_CODE_NODE_BUSY, 2);
+  Start   = GetPerformanceCounter ();
+  Status  = SendGetDeviceId ();
+  Elapsed = GetTimeInNanoSecond (GetPerformanceCounter () - Start);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (mIpmiInstance.LastCompletionCode, IPMI_COMP_CODE_NORMAL);
+  UT_ASSERT_TRUE (Elapsed >= 3000000);
+
+  //
+  // The retries of an entry are limited.
+  //
+  MockIpmiSetBusy (IPMI_COMP_CODE_NODE_BUSY, MAX_UINT8);
+  Status = SendGetDeviceId ();
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_DEVICE_ERROR);
+  UT_ASSERT_EQUAL (mIpmiInstance.LastCompletionCode, IPMI_COMP_CODE_NODE_BUSY);
+
+  //
+  // Other completion codes fail at once, leaving the second response for the
+  // next command.
+  //
+  MockIpmiSetBusy (IPMI_COMP_CODE_INVALID_DATA_FIELD, 2);
+  Start   = GetPerformanceCounter ();
+  Status  = SendGetDeviceId ();
+  Elapsed = GetTimeInNanoSecond (GetPerformanceCounter () - Start);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_DEVICE_ERROR);
+  UT_ASSERT_TRUE (Elapsed < 1000000);
+  Status = SendGetDeviceId ();
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_DEVICE_ERROR);
+  Status = SendGetDeviceId ();
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+
+  MockIpmiSetBusy (0, 0);
   return UNIT_TEST_PASSED;
 }
 
@@ -270,9 +904,15 @@ GenericIpmiTestMain (
   }
 
   AddTestCase (IpmiTests, "Tests initializing IPMI stack", "TestIpmiInit", TestIpmiInit, NULL, NULL, NULL);
+  AddTestCase (IpmiTests, "Tests answering the BMC identity from the cache", "TestIpmiIdentityCache", TestIpmiIdentityCache, NULL, NULL, NULL);
   AddTestCase (IpmiTests, "Tests getting the BMC status", "TestIpmiGetBmcStatus", TestIpmiGetBmcStatus, NULL, NULL, NULL);
   AddTestCase (IpmiTests, "Tests sending and IPMI command", "TestIpmiCommand", TestIpmiCommand, NULL, NULL, NULL);
   AddTestCase (IpmiTests, "Tests sending a command with a undersized response buffer", "TestIpmiBufferTooSmall", TestIpmiBufferTooSmall, NULL, NULL, NULL);
+  AddTestCase (IpmiTests, "Tests sending a command larger than the transport can carry", "TestIpmiCommandTooLarge", TestIpmiCommandTooLarge, NULL, NULL, NULL);
+  AddTestCase (IpmiTests, "Tests sending a batch of IPMI commands", "TestIpmiBatch", TestIpmiBatch, NULL, NULL, NULL);
+  AddTestCase (IpmiTests, "Tests the IPMI transaction trace", "TestIpmiTrace", TestIpmiTrace, NULL, NULL, NULL);
+  AddTestCase (IpmiTests, "Tests the circuit breaker for an unresponsive BMC", "TestIpmiCircuitBreaker", TestIpmiCircuitBreaker, NULL, NULL, NULL);
+  AddTestCase (IpmiTests, "Tests retrying transient completion codes", "TestIpmiRetryPolicy", TestIpmiRetryPolicy, NULL, NULL, NULL);
 
   Status = RunAllTestSuites (Framework);
 
@@ -0,0 +1,46 @@
+/** @file
+  Contains definitions for the Block Transfer (BT) system interface transport
+  for IPMI.
+
+  Copyright (c) Microsoft Corporation
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef _BT_BMC_H
+#define _BT_BMC_H
+
+//
+// Index of the BT registers. With MMIO access they are PcdIpmiRegisterBitWidth
+// bits apart from PcdIpmiAddress, with port I/O they are consecutive ports from
+// PcdIpmiIoBaseAddress. The buffer register reads the BMC to host buffer and
+// writes the host to BMC buffer.
+//
+#define BT_CTRL_REGISTER     0
+#define BT_BUFFER_REGISTER   1
+#define BT_INTMASK_REGISTER  2
+
+//
+// Bits of the BT_CTRL register. Writing 1 performs the action described, and
+// writing 0 has no effect. B_BUSY is read only.
+//
+#define BT_CTRL_CLR_WR_PTR  BIT0            // Clears the host to BMC write pointer.
+#define BT_CTRL_CLR_RD_PTR  BIT1            // Clears the BMC to host read pointer.
+#define BT_CTRL_H2B_ATN     BIT2            // Sets, a request is in the buffer.
+#define BT_CTRL_B2H_ATN     BIT3            // Clears, a response is in the buffer.
+#define BT_CTRL_SMS_ATN     BIT4            // Clears, an SMS message is available.
+#define BT_CTRL_OEM0        BIT5
+#define BT_CTRL_H_BUSY      BIT6            // Toggles, the host is reading the buffer.
+#define BT_CTRL_B_BUSY      BIT7            // The BMC is busy with the buffer.
+
+//
+// A BT message starts with a length byte counting the bytes after it, followed
+// by the NetFn/LUN, the sequence number and the command. The transport hands
+// the NetFn/LUN and command to the caller as a 2 byte header and keeps the
+// sequence number to itself.
+//
+#define BT_MESSAGE_HEADER_SIZE  (3)
+#define BT_MAX_LENGTH           (255)
+#define BT_MAX_BODY_SIZE        (BT_MAX_LENGTH - BT_MESSAGE_HEADER_SIZE)
+
+#endif
@@ -50,11 +50,20 @@ typedef struct {
   UINT8    Reserved            : 4;     ///< Reserved.
 } IPMI_GET_SYSTEM_INTERFACE_CAPABILITY_REQUEST;
 
+//
+// Values of the TransactionSupport field of the SSIF capabilities.
+//
+#define IPMI_SSIF_TRANSACTION_SINGLE_PART      0x0 ///< Single-part reads and writes only
+#define IPMI_SSIF_TRANSACTION_START_END        0x1 ///< Multi-part with start and end transactions only
+#define IPMI_SSIF_TRANSACTION_START_MIDDLE_END 0x2 ///< Multi-part with start, middle and end transactions
+
 typedef struct {
   UINT8    CompletionCode;            ///< Completion code
   UINT8    Reserved;                  ///< Reserved (returned as 0x00)
-  UINT8    SsifVersion : 3;           ///< System Interface Version (000b is version 1)
-  UINT8    Reserved1   : 5;           ///< Reserved
+  UINT8    SsifVersion        : 3;    ///< System Interface Version (000b is version 1)
+  UINT8    PecSupport         : 1;    ///< PEC is supported
+  UINT8    Reserved1          : 2;    ///< Reserved
+  UINT8    TransactionSupport : 2;    ///< IPMI_SSIF_TRANSACTION_*
   UINT8    InputMessageSize;          ///< Maximum input Message Size that BMC can accept (in byte)
   UINT8    MaxMessageSize;            ///< Max Message Size (0xFF is 255 bytes)
 } IPMI_GET_SYSTEM_INTERFACE_CAPABILITY_RESPONSE_SSIF;
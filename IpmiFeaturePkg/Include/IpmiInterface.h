@@ -11,8 +11,10 @@
 #define _IPMI_INTERFACE_H_
 
 #include <ServerManagement.h>
+#include <IpmiFeature.h>
 
-typedef struct _IPMI_TRANSPORT IPMI_TRANSPORT;
+typedef struct _IPMI_TRANSPORT   IPMI_TRANSPORT;
+typedef struct _IPMI_TRANSPORT2  IPMI_TRANSPORT2;
 
 //
 // BMC status bit definitions.
@@ -25,14 +27,42 @@ typedef UINT32 BMC_STATUS;
 #define BMC_UPDATE_IN_PROGRESS  3
 #define BMC_NOTREADY            4
 
+//
+// Flags of the responses held by IPMI_BMC_IDENTITY.
+//
+#define IPMI_BMC_IDENTITY_DEVICE_ID      BIT0
+#define IPMI_BMC_IDENTITY_SELF_TEST      BIT1
+#define IPMI_BMC_IDENTITY_SYSTEM_GUID    BIT2
+#define IPMI_BMC_IDENTITY_INTERFACE_CAP  BIT3
+
 //
 // Structure to communicate BMC state from PEI to DXE.
 //
 
 #pragma pack(1)
 
+//
+// Responses describing the BMC that do not change while the system runs. They
+// are read once when the BMC is initialized and commands asking for them are
+// answered from here afterwards. Each response includes its completion code.
+//
+typedef struct {
+  UINT32                                           Valid;          // IPMI_BMC_IDENTITY_* flags
+  UINT8                                            DeviceIdSize;
+  IPMI_GET_DEVICE_ID_RESPONSE                      DeviceId;
+  IPMI_SELF_TEST_RESULT_RESPONSE                   SelfTest;
+  IPMI_GET_SYSTEM_GUID_RESPONSE                    SystemGuid;
+  UINT8                                            InterfaceType;  // GET_SYSTEM_INTEFACE_INTERFACE_TYPE
+  UINT8                                            InterfaceCapSize;
+  IPMI_GET_SYSTEM_INTERFACE_CAPABILITY_RESPONSE    InterfaceCap;
+} IPMI_BMC_IDENTITY;
+
+//
+// Identity is only present when the HOB data is large enough to hold it.
+//
 typedef struct _IPMI_BMC_HOB {
-  BMC_STATUS    BmcStatus;
+  BMC_STATUS           BmcStatus;
+  IPMI_BMC_IDENTITY    Identity;
 } IPMI_BMC_HOB;
 
 #pragma pack()
@@ -70,4 +100,125 @@ struct _IPMI_TRANSPORT {
   IPMI_GET_CHANNEL_STATUS    GetBmcStatus;
 };
 
+//
+// IPMI TRANSPORT2 batch definitions
+//
+
+#define IPMI_TRANSPORT2_REVISION  2
+
+//
+// Batch flags.
+//
+#define IPMI_BATCH_STOP_ON_ERROR  BIT0
+
+//
+// Describes a single command in a batch. The caller fills in the request
+// fields and the response buffer, the transport fills in the size of the
+// response, the completion code and the status of the individual command.
+// Entries that are not run because an earlier entry failed with
+// IPMI_BATCH_STOP_ON_ERROR set are returned with EFI_ABORTED.
+//
+typedef struct {
+  UINT8         NetFunction;
+  UINT8         Lun;
+  UINT8         Command;
+  UINT8         *CommandData;
+  UINT32        CommandDataSize;
+  UINT8         *ResponseData;
+  UINT32        ResponseDataSize;
+  UINT8         CompletionCode;
+  EFI_STATUS    Status;
+} IPMI_BATCH_ENTRY;
+
+typedef
+EFI_STATUS
+(EFIAPI *IPMI_SEND_COMMAND2)(
+  IN IPMI_TRANSPORT2                   *This,
+  IN UINT8                             NetFunction,
+  IN UINT8                             Lun,
+  IN UINT8                             Command,
+  IN UINT8                             *CommandData,
+  IN UINT32                            CommandDataSize,
+  OUT UINT8                            *ResponseData,
+  OUT UINT32                           *ResponseDataSize
+  );
+
+typedef
+EFI_STATUS
+(EFIAPI *IPMI_GET_CHANNEL_STATUS2)(
+  IN IPMI_TRANSPORT2                  *This,
+  OUT BMC_STATUS                      *BmcStatus,
+  OUT SM_COM_ADDRESS                  *ComAddress
+  );
+
+/**
+  Sends a list of IPMI commands to the BMC back-to-back.
+
+  @param[in]      This        Pointer to the IPMI transport instance.
+  @param[in,out]  Entries     The commands to send and their results.
+  @param[in]      EntryCount  The number of entries in Entries.
+  @param[in]      Flags       IPMI_BATCH_* flags controlling the batch.
+
+  @retval   EFI_SUCCESS             All entries completed successfully.
+  @retval   EFI_INVALID_PARAMETER   Entries is NULL or Flags is invalid.
+  @retval   Other                   The status of the first failed entry.
+**/
+typedef
+EFI_STATUS
+(EFIAPI *IPMI_SUBMIT_BATCH)(
+  IN IPMI_TRANSPORT2                  *This,
+  IN OUT IPMI_BATCH_ENTRY             *Entries,
+  IN UINTN                            EntryCount,
+  IN UINT32                           Flags
+  );
+
+//
+// Describes a command submitted asynchronously. Entry describes the command
+// and receives its results the same way as for a batch. Entry.Status is
+// EFI_NOT_READY until the command completes, at which point Event is
+// signaled. The token and the buffers it references must remain valid until
+// then.
+//
+typedef struct {
+  EFI_EVENT           Event;
+  IPMI_BATCH_ENTRY    Entry;
+} IPMI_ASYNC_TOKEN;
+
+/**
+  Queues an IPMI command to be sent to the BMC and returns without waiting for
+  the response. Commands submitted above TPL_NOTIFY, or on a transport that
+  cannot poll for the response, are completed and their event signaled before
+  returning.
+
+  @param[in]      This        Pointer to the IPMI transport instance.
+  @param[in,out]  Token       The command to send and the event to signal when
+                              it completes.
+
+  @retval   EFI_SUCCESS             The command was queued or completed.
+  @retval   EFI_INVALID_PARAMETER   Token or its event is NULL, or the command
+                                    is invalid.
+  @retval   EFI_NOT_READY           The submission interrupted another command
+                                    and could not be completed.
+  @retval   EFI_UNSUPPORTED         Asynchronous commands are not supported in
+                                    this phase.
+  @retval   EFI_OUT_OF_RESOURCES    The command could not be queued.
+**/
+typedef
+EFI_STATUS
+(EFIAPI *IPMI_SUBMIT_COMMAND_ASYNC)(
+  IN IPMI_TRANSPORT2                  *This,
+  IN OUT IPMI_ASYNC_TOKEN             *Token
+  );
+
+//
+// IPMI TRANSPORT2
+//
+struct _IPMI_TRANSPORT2 {
+  UINT64                       Revision;
+  IPMI_SEND_COMMAND2           IpmiSubmitCommand;
+  IPMI_GET_CHANNEL_STATUS2     GetBmcStatus;
+  IPMI_SUBMIT_BATCH            SubmitBatch;
+  IPMI_SUBMIT_COMMAND_ASYNC    SubmitCommandAsync;
+};
+
 #endif
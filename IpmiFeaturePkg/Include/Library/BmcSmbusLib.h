@@ -17,7 +17,9 @@
 // NOTE: This API is tentative and may be subject to change!
 
 /**
-  Opens the SMBus connection if needed.
+  Opens the SMBus connection if needed. Within a transport session the SSIF
+  transport keeps the connection open across several reads and writes, and
+  calls BmcSmbusClose before opening it again.
 
   @retval   EFI_SUCCESS           Them SMBus connection was successfully opened.
 **/
@@ -53,6 +55,22 @@ BmcSmbusBlockWrite (
   UINT8  BlockLength
   );
 
+/**
+  Waits for the BMC to assert SMBALERT#, which it does once a response is
+  ready to be read. Platforms that do not route SMBALERT# return
+  EFI_UNSUPPORTED, and the SSIF transport then polls with a delay instead.
+
+  @param[in]  Timeout             The longest time to wait in microseconds.
+
+  @retval   EFI_SUCCESS           SMBALERT# is asserted.
+  @retval   EFI_TIMEOUT           SMBALERT# was not asserted within Timeout.
+  @retval   EFI_UNSUPPORTED       The platform cannot wait for SMBALERT#.
+**/
+EFI_STATUS
+BmcSmbusWaitForAlert (
+  UINTN  Timeout
+  );
+
 /**
   Reads a message from the specified SMBus device.
 
@@ -0,0 +1,91 @@
+/** @file
+  Time budgets for IPMI transactions measured with the performance counter.
+  Counters that count down or wrap are handled. Without a performance counter
+  the delays made through IpmiDeadlineDelay are counted instead.
+
+  Copyright (c) Microsoft Corporation
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef IPMI_DEADLINE_LIB_H_
+#define IPMI_DEADLINE_LIB_H_
+
+//
+// Deadline of a transaction, measured in performance counter ticks or,
+// without a performance counter, in microseconds of delay. The fields are
+// private to the library.
+//
+typedef struct {
+  UINT64     CounterStart;
+  UINT64     CounterEnd;
+  UINT64     Last;
+  UINT64     Elapsed;
+  UINT64     Budget;
+  BOOLEAN    CountDelays;
+} IPMI_DEADLINE;
+
+/**
+  Starts a deadline.
+
+  @param[out] Deadline    The deadline to start.
+  @param[in]  TimeoutUs   The time budget in microseconds.
+**/
+VOID
+EFIAPI
+IpmiDeadlineStart (
+  OUT IPMI_DEADLINE  *Deadline,
+  IN  UINT64         TimeoutUs
+  );
+
+/**
+  Checks whether a deadline has passed. The elapsed time is accumulated on
+  every check, so counters that wrap within the budget are handled.
+
+  @param[in,out]  Deadline    The deadline to check.
+
+  @retval   TRUE      The time budget has been used.
+  @retval   FALSE     Time remains.
+**/
+BOOLEAN
+EFIAPI
+IpmiDeadlineExpired (
+  IN OUT IPMI_DEADLINE  *Deadline
+  );
+
+/**
+  Delays for a number of microseconds, counting the delay against the
+  deadline when there is no performance counter to measure it.
+
+  @param[in,out]  Deadline    The deadline the delay is made for.
+  @param[in]      DelayUs     The delay in microseconds.
+**/
+VOID
+EFIAPI
+IpmiDeadlineDelay (
+  IN OUT IPMI_DEADLINE  *Deadline,
+  IN     UINTN          DelayUs
+  );
+
+/**
+  Gets the performance counter ticks between two counter values, taking the
+  direction of the counter and a single wrap into account.
+
+  @param[in]  CounterStart    The start value of the counter, as returned by
+                              GetPerformanceCounterProperties.
+  @param[in]  CounterEnd      The end value of the counter, as returned by
+                              GetPerformanceCounterProperties.
+  @param[in]  Earlier         The earlier counter value.
+  @param[in]  Later           The later counter value.
+
+  @retval   The ticks from Earlier to Later.
+**/
+UINT64
+EFIAPI
+IpmiCounterTicksBetween (
+  IN UINT64  CounterStart,
+  IN UINT64  CounterEnd,
+  IN UINT64  Earlier,
+  IN UINT64  Later
+  );
+
+#endif
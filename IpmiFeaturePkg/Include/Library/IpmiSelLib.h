@@ -38,10 +38,31 @@ typedef struct _SEL_INFO {
   } OperationSupported;
 } SEL_INFO;
 
+//
+// Data of the OEM record added for system events that were coalesced. Count
+// duplicates of the event were not added to the SEL. Duplicates match in all
+// the fields of the summary, event data 2 and 3 are not compared. For events
+// dropped by the rate limit of their sensor type, SensorNumber, EventDirType
+// and EventData1 are SEL_COALESCE_RATE_LIMITED and Count events of the type
+// were not added.
+//
+
+#define SEL_COALESCE_RATE_LIMITED  0xFF
+
+typedef struct {
+  UINT8     SensorType;
+  UINT8     SensorNumber;
+  UINT8     EventDirType;
+  UINT8     EventData1;
+  UINT16    Count;
+} SEL_COALESCE_SUMMARY;
+
 #pragma pack()
 
 /**
-  Adds a system event to the SEL.
+  Adds a system event to the SEL. When RecordId is NULL, duplicates of a recent
+  event and events over the rate limit of their sensor type may be counted
+  into a summary record instead of being added.
 
   @param[in,out]  RecordId      If provided, receives the record ID of the entry.
   @param[in]      SensorType    The Sensor type for the event.
@@ -52,6 +73,8 @@ typedef struct _SEL_INFO {
   @param[in]      Data2         OEM defined data part 2.
 
   @retval   EFI_SUCCESS     Event was successfully added to the SEL.
+  @retval   EFI_NOT_READY   RecordId was provided while queued entries are
+                            being sent at a lower TPL.
   @retval   Other           And error was returned by IpmiAddSelEntry.
 **/
 EFI_STATUS
@@ -75,6 +98,8 @@ SelAddSystemEntry (
 
   @retval   EFI_SUCCESS             Event was successfully added to the SEL.
   @retval   EFI_INVALID_PARAMETER   Invalid RecordType was given.
+  @retval   EFI_NOT_READY           RecordId was provided while queued entries
+                                    are being sent at a lower TPL.
   @retval   Other                   And error was returned by a subroutine.
 **/
 EFI_STATUS
@@ -95,6 +120,8 @@ SelAddOemEntry (
 
   @retval   EFI_SUCCESS             Event was successfully added to the SEL.
   @retval   EFI_INVALID_PARAMETER   Invalid RecordType was given.
+  @retval   EFI_NOT_READY           RecordId was provided while queued entries
+                                    are being sent at a lower TPL.
   @retval   Other                   And error was returned by a subroutine.
 **/
 EFI_STATUS
@@ -115,6 +142,8 @@ SelAddOemEntryEx (
 
   @retval   EFI_SUCCESS             Event was successfully added to the SEL.
   @retval   EFI_INVALID_PARAMETER   Invalid RecordType was given.
+  @retval   EFI_NOT_READY           RecordId was provided while queued entries
+                                    are being sent at a lower TPL.
   @retval   Other                   And error was returned by a subroutine.
 **/
 EFI_STATUS
@@ -192,6 +221,8 @@ SelGetInfo (
 
   @retval   EFI_SUCCESS             The SEL entry was retrieved.
   @retval   EFI_INVALID_PARAMETER   Record pointer is NULL.
+  @retval   EFI_PROTOCOL_ERROR      The BMC refused the read or returned an
+                                    unexpected result size.
   @retval   Other                   The IPMI base library returned an error.
 **/
 EFI_STATUS
@@ -202,4 +233,89 @@ SelGetEntry (
   OUT UINT16      *NextRecordId OPTIONAL
   );
 
+/**
+  Starts a walk through the SEL. Records are read one at a time along the next
+  record IDs, filling the window with as many records as fit each time it is
+  consumed.
+
+  @param[out]   Iterator        Receives the state of the walk.
+  @param[in]    RecordId        The record ID to start at, 0 for the first entry.
+  @param[in]    Window          The buffer to fetch records into.
+  @param[in]    WindowSize      The number of records the window holds.
+
+  @retval   EFI_SUCCESS             The walk was started.
+  @retval   EFI_INVALID_PARAMETER   Iterator or Window is NULL, or WindowSize
+                                    is 0.
+  @retval   Other                   The IPMI base library returned an error.
+**/
+EFI_STATUS
+EFIAPI
+SelStartIterator (
+  OUT SEL_ITERATOR  *Iterator,
+  IN UINT16         RecordId,
+  IN SEL_RECORD     *Window,
+  IN UINT16         WindowSize
+  );
+
+/**
+  Gets the next entry of a walk through the SEL, fetching the following
+  entries into the window when it is empty.
+
+  @param[in,out]  Iterator      The state of the walk.
+  @param[out]     Record        Receives the record.
+
+  @retval   EFI_SUCCESS             The next SEL entry was retrieved.
+  @retval   EFI_NOT_FOUND           The walk reached the end of the SEL.
+  @retval   EFI_ABORTED             The BMC kept canceling the reservation of
+                                    the walk.
+  @retval   EFI_INVALID_PARAMETER   Iterator or Record pointer is NULL.
+  @retval   Other                   The IPMI base library returned an error.
+**/
+EFI_STATUS
+EFIAPI
+SelGetNextEntry (
+  IN OUT SEL_ITERATOR  *Iterator,
+  OUT SEL_RECORD       *Record
+  );
+
+/**
+  Adds the counts of coalesced system events to the SEL and sends all queued
+  entries to the BMC. Library instances that queue entries added without a
+  record ID also do this at ReadyToBoot and ExitBootServices. Other instances
+  that coalesce leave the last open windows to their caller, which must call
+  this when it stops adding events, such as at the end of SMM boot.
+
+  @retval   EFI_SUCCESS           All queued entries were added to the SEL.
+  @retval   EFI_ALREADY_STARTED   The queue is being drained at a lower TPL.
+  @retval   Other                 An entry failed to be added to the SEL.
+**/
+EFI_STATUS
+EFIAPI
+SelFlush (
+  VOID
+  );
+
+/**
+  Gets the number of entries that were dropped instead of being queued because
+  the queue was full.
+
+  @retval   The number of dropped entries.
+**/
+UINT32
+EFIAPI
+SelGetDroppedEntries (
+  VOID
+  );
+
+/**
+  Gets the number of queued entries the BMC failed to add to the SEL.
+
+  @retval   The number of failed entries.
+**/
+UINT32
+EFIAPI
+SelGetFailedEntries (
+  VOID
+  );
+
 #endif
@@ -0,0 +1,144 @@
+/** @file
+  Extended functions of the IPMI transport layer libraries used by the generic
+  IPMI drivers. The in-tree transport libraries implement this library class
+  along with IpmiTransportLib. Transports that only implement IpmiTransportLib
+  get it from IpmiTransportExLibDefault.
+
+  Copyright (c) Microsoft Corporation
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef IPMI_TRANSPORT_EX_LIB_H_
+#define IPMI_TRANSPORT_EX_LIB_H_
+
+/**
+  Send a message to the BMC where the message header and body are provided in
+  separate buffers. The bytes are sent as if the two buffers were contiguous,
+  which allows the caller to send its data without first staging it into a
+  single buffer.
+
+  @param[in]  TimeoutUs           The time budget for the transaction in
+                                  microseconds.
+  @param[in]  Header              The header bytes to send first. Optional if
+                                  HeaderSize is 0.
+  @param[in]  HeaderSize          The size of the header in bytes.
+  @param[in]  Data                The body bytes to send after the header.
+                                  Optional if DataSize is 0.
+  @param[in]  DataSize            The size of the body in bytes.
+
+  @retval   EFI_SUCCESS             The message was successfully sent.
+  @retval   EFI_INVALID_PARAMETER   The message is empty or larger than the
+                                    transport can carry.
+  @retval   Other                   A transport specific error occurred.
+**/
+EFI_STATUS
+SendDataToBmcPortEx (
+  UINT64  TimeoutUs,
+  UINT8   *Header,
+  UINT8   HeaderSize,
+  UINT8   *Data,
+  UINT32  DataSize
+  );
+
+/**
+  Receive a message from the BMC splitting it between a header buffer and a
+  body buffer. The first HeaderSize bytes of the message are written to Header
+  and the remaining bytes are written directly to Data. If the message is
+  shorter than HeaderSize then the remaining header bytes are not modified and
+  DataSize is returned as 0.
+
+  If the body does not fit in Data, the transaction is still completed with the
+  BMC, Data is filled to its capacity, and the full body size is returned in
+  DataSize with EFI_BUFFER_TOO_SMALL.
+
+  @param[in]      TimeoutUs           The time budget for the transaction in
+                                      microseconds.
+  @param[out]     Header              The buffer for the header bytes. Optional
+                                      if HeaderSize is 0.
+  @param[in]      HeaderSize          The size of the header in bytes.
+  @param[out]     Data                The buffer for the body bytes.
+  @param[in,out]  DataSize            On input, the size of Data. On output,
+                                      the size of the message body.
+
+  @retval   EFI_SUCCESS             The message was successfully received.
+  @retval   EFI_BUFFER_TOO_SMALL    The body did not fit in Data.
+  @retval   Other                   A transport specific error occurred.
+**/
+EFI_STATUS
+ReceiveBmcDataFromPortEx (
+  UINT64  TimeoutUs,
+  UINT8   *Header,
+  UINT8   HeaderSize,
+  UINT8   *Data,
+  UINT32  *DataSize
+  );
+
+/**
+  Gets the largest message bodies the transport can carry, not counting the
+  header. Larger requests are rejected without being sent, and larger
+  responses are treated as a protocol error.
+
+  @param[out]  MaxRequestSize     The largest request body in bytes.
+  @param[out]  MaxResponseSize    The largest response body in bytes,
+                                  including the completion code.
+**/
+VOID
+GetBmcMaxMessageSize (
+  OUT UINT32  *MaxRequestSize,
+  OUT UINT32  *MaxResponseSize
+  );
+
+/**
+  Checks without blocking whether the BMC has a response available to be
+  received with ReceiveBmcDataFromPortEx.
+
+  @retval   EFI_SUCCESS       The response is available.
+  @retval   EFI_NOT_READY     The BMC is still processing the request.
+  @retval   EFI_UNSUPPORTED   The transport cannot tell without starting the
+                              receive, which then waits for the response.
+**/
+EFI_STATUS
+CheckBmcResponseReady (
+  VOID
+  );
+
+/**
+  Begins a transport session. Until the matching IpmiTransportEndSession the
+  transport may keep what it set up for one send or receive, such as an open
+  bus connection, for the next. Sessions may be nested and must be ended
+  before the end of the boot phase they were begun in. Transports with nothing
+  to keep do nothing.
+**/
+VOID
+IpmiTransportBeginSession (
+  VOID
+  );
+
+/**
+  Ends a transport session begun with IpmiTransportBeginSession. When the
+  outermost session ends the transport releases what it kept.
+**/
+VOID
+IpmiTransportEndSession (
+  VOID
+  );
+
+/**
+  Hands the transport the response of Get System Interface Capabilities read
+  from the BMC. Transports that take their limits from it adjust the framing
+  and the sizes reported by GetBmcMaxMessageSize, others ignore it.
+
+  @param[in]  InterfaceType       The GET_SYSTEM_INTEFACE_INTERFACE_TYPE the
+                                  capabilities describe.
+  @param[in]  Capabilities        The response, starting with the completion
+                                  code, or NULL to return to the defaults.
+  @param[in]  CapabilitiesSize    The size of the response.
+**/
+VOID
+IpmiTransportSetCapabilities (
+  IN UINT8   InterfaceType,
+  IN UINT8   *Capabilities,
+  IN UINT32  CapabilitiesSize
+  );
+
+#endif
@@ -1,6 +1,10 @@
 /** @file
   External functions and definitions for the IPMI transport layer libraries.
 
+  The generic IPMI drivers reach the transport through IpmiTransportExLib.
+  Transports that implement only this library class are adapted to it by
+  IpmiTransportExLibDefault.
+
   Copyright 1999 - 2021 Intel Corporation.
   Copyright (c) Microsoft Corporation
   PDX-License-Identifier: BSD-2-Clause-Patent
@@ -10,10 +14,17 @@
 #ifndef _IPMI_TRANSPORT_H
 #define _IPMI_TRANSPORT_H
 
+//
+// Unit of the timeouts passed to SendDataToBmcPort and ReceiveBmcDataFromPort,
+// in microseconds.
+//
+#define IPMI_TRANSPORT_DELAY_UNIT  50
+
 /**
   Send data to BMC over the IPMI transport.
 
-  @param[in]  IpmiTimeoutPeriod   The timeout for the transaction.
+  @param[in]  IpmiTimeoutPeriod   The timeout for the transaction in units of
+                                  IPMI_TRANSPORT_DELAY_UNIT.
 
   @retval   EFI_SUCCESS                 <Description>
 **/
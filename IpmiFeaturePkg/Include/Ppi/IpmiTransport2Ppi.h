@@ -0,0 +1,22 @@
+/** @file
+  IPMI Transport2 PPI Header File.
+
+  Copyright (c) Microsoft Corporation
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef _IPMI_TRANSPORT2_PPI_H_
+#define _IPMI_TRANSPORT2_PPI_H_
+
+#include <IpmiInterface.h>
+
+typedef struct _IPMI_TRANSPORT2 PEI_IPMI_TRANSPORT2_PPI;
+
+#define PEI_IPMI_TRANSPORT2_PPI_GUID \
+  { \
+    0xc2f7d1e4, 0x8b36, 0x4f05, 0xb7, 0x1a, 0x5e, 0x92, 0x0c, 0x6d, 0xa3, 0x48 \
+  }
+
+extern EFI_GUID  gPeiIpmiTransport2PpiGuid;
+
+#endif
@@ -0,0 +1,162 @@
+/** @file
+
+  Definitions for the IPMI SEL2 Protocol. This protocol extends the IPMI SEL
+  Protocol with walks through the SEL and queries of its records, under its
+  own GUID so that consumers never call past the end of an IPMI SEL Protocol
+  instance. Later revisions only append members, and consumers check Revision
+  before calling a member added after IPMI_SEL2_PROTOCOL_REVISION_1.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef SEL2_PROTOCOL_H_
+#define SEL2_PROTOCOL_H_
+
+#include <Protocol/IpmiSelProtocol.h>
+
+// {81aeffe0-d51d-4eac-995c-b0ae9c5a7419}
+#define IPMI_SEL2_PROTOCOL_GUID \
+  { \
+    0x81aeffe0, 0xd51d, 0x4eac, { 0x99, 0x5c, 0xb0, 0xae, 0x9c, 0x5a, 0x74, 0x19 } \
+  }
+
+//
+// Revisions of the protocol. Each revision appends members to the last.
+//
+#define IPMI_SEL2_PROTOCOL_REVISION_1  0x00000001
+#define IPMI_SEL2_PROTOCOL_REVISION    IPMI_SEL2_PROTOCOL_REVISION_1
+
+typedef struct _IPMI_SEL2_PROTOCOL IPMI_SEL2_PROTOCOL;
+
+//
+// Fields of a SEL query that records must match. Sensor type, sensor number
+// and generator ID only match system event records, manufacturer ID only
+// matches timestamped OEM records, and the time stamp range only matches
+// timestamped records.
+//
+#define SEL_QUERY_RECORD_TYPE      BIT0
+#define SEL_QUERY_SENSOR_TYPE      BIT1
+#define SEL_QUERY_SENSOR_NUMBER    BIT2
+#define SEL_QUERY_GENERATOR_ID     BIT3
+#define SEL_QUERY_MANUFACTURER_ID  BIT4
+#define SEL_QUERY_TIME_STAMP       BIT5
+
+//
+// A query for SEL records. The caller sets Fields to the SEL_QUERY_* bits of
+// the criteria to match and fills in those criteria. The time stamp range
+// includes StartTime and EndTime. Private is reserved for the state of the
+// query.
+//
+typedef struct _SEL_QUERY {
+  UINT32    Fields;
+  UINT8     RecordType;
+  UINT8     SensorType;
+  UINT8     SensorNumber;
+  UINT16    GeneratorId;
+  UINT8     ManufacturerId[3];
+  UINT32    StartTime;
+  UINT32    EndTime;
+  UINT64    Private[2];
+} SEL_QUERY;
+
+/**
+  Starts a walk through the system event log. Records are fetched along the
+  next record IDs, filling the window with as many records as fit each time it
+  is consumed.
+
+  @param[out] Iterator      Receives the state of the walk.
+  @param[in]  RecordId      The record ID to start at. 0x0000 starts at the first
+                            entry.
+  @param[in]  Window        The buffer to fetch records into.
+  @param[in]  WindowSize    The number of records the window holds.
+
+  @retval   EFI_SUCCESS             The walk was started.
+  @retval   EFI_INVALID_PARAMETER   Iterator or Window is NULL, or WindowSize
+                                    is 0.
+  @retval   Other                   An error was returned by IPMI.
+**/
+typedef
+EFI_STATUS
+(EFIAPI *SEL_START_RECORD_ITERATOR)(
+  OUT SEL_ITERATOR  *Iterator,
+  IN  UINT16        RecordId,
+  IN  SEL_RECORD    *Window,
+  IN  UINT16        WindowSize
+  );
+
+/**
+  Retrieves the next record of a walk through the system event log, fetching
+  the following records into the window when it is empty.
+
+  @param[in,out]  Iterator  The state of the walk.
+  @param[out]     Record    Receives the record entry.
+
+  @retval   EFI_SUCCESS             The next SEL entry was retrieved.
+  @retval   EFI_NOT_FOUND           The walk reached the end of the SEL.
+  @retval   EFI_ABORTED             The BMC kept canceling the reservation of
+                                    the walk.
+  @retval   EFI_INVALID_PARAMETER   Iterator or Record pointer is NULL.
+  @retval   Other                   An error was returned by IPMI.
+**/
+typedef
+EFI_STATUS
+(EFIAPI *SEL_GET_NEXT_RECORD_ENTRY)(
+  IN OUT SEL_ITERATOR  *Iterator,
+  OUT    SEL_RECORD    *Record
+  );
+
+/**
+  Starts a query for the records of the system event log matching the
+  criteria. The query is answered from an index of the SEL held in memory, and
+  only visits the records indexed under its most selective criterion.
+
+  @param[in,out]  Query     The criteria to match, receives the state of the
+                            query.
+
+  @retval   EFI_SUCCESS             The query was started.
+  @retval   EFI_INVALID_PARAMETER   Query is NULL.
+  @retval   Other                   The SEL could not be read.
+**/
+typedef
+EFI_STATUS
+(EFIAPI *SEL_START_QUERY)(
+  IN OUT SEL_QUERY  *Query
+  );
+
+/**
+  Retrieves the next record of the system event log matching a query.
+
+  @param[in,out]  Query     The state of the query.
+  @param[out]     Record    Receives the record entry.
+
+  @retval   EFI_SUCCESS             The next matching SEL entry was retrieved.
+  @retval   EFI_NOT_FOUND           No more SEL entries match the query.
+  @retval   EFI_ABORTED             The SEL was cleared or reordered since the
+                                    query started.
+  @retval   EFI_INVALID_PARAMETER   Query or Record pointer is NULL.
+**/
+typedef
+EFI_STATUS
+(EFIAPI *SEL_GET_NEXT_MATCH)(
+  IN OUT SEL_QUERY   *Query,
+  OUT    SEL_RECORD  *Record
+  );
+
+//
+// IPMI SEL2 PROTOCOL
+//
+struct _IPMI_SEL2_PROTOCOL {
+  UINT32                       Revision;
+  SEL_GET_RECORD_ENTRY         GetRecordEntry;
+  SEL_ADD_RECORD_ENTRY         AddRecordEntry;
+  SEL_START_RECORD_ITERATOR    StartRecordIterator;
+  SEL_GET_NEXT_RECORD_ENTRY    GetNextRecordEntry;
+  SEL_START_QUERY              StartQuery;
+  SEL_GET_NEXT_MATCH           GetNextMatch;
+};
+
+extern EFI_GUID  gIpmiSel2ProtocolGuid;
+
+#endif
@@ -60,6 +60,20 @@ typedef struct _SEL_RECORD {
 
 #pragma pack()
 
+//
+// The record ID of the last entry, and the next record ID returned with it.
+//
+#define SEL_LAST_RECORD_ID  0xFFFF
+
+//
+// State of a walk through the SEL. The records are fetched into a window
+// provided by the caller, which must stay valid while the iterator is in use.
+// The contents are private to the implementation.
+//
+typedef struct _SEL_ITERATOR {
+  UINT64    Private[4];
+} SEL_ITERATOR;
+
 /**
   Retrieves a record from the system event log.
 
@@ -0,0 +1,137 @@
+/** @file
+  Definitions for the IPMI Trace Protocol. This protocol reports the recent
+  IPMI transactions sent by the DXE IPMI transport and per command latency
+  histograms, allowing the commands that consume boot time to be identified.
+  Commands answered from the cached BMC identity do not reach the BMC and are
+  not reported.
+
+  Copyright (c) Microsoft Corporation
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef IPMI_TRACE_PROTOCOL_H_
+#define IPMI_TRACE_PROTOCOL_H_
+
+// {e4a0c6f1-7b2d-4e63-9f18-3c5d2a8b61f7}
+#define IPMI_TRACE_PROTOCOL_GUID \
+  { \
+    0xe4a0c6f1, 0x7b2d, 0x4e63, { 0x9f, 0x18, 0x3c, 0x5d, 0x2a, 0x8b, 0x61, 0xf7 } \
+  }
+
+typedef struct _IPMI_TRACE_PROTOCOL IPMI_TRACE_PROTOCOL;
+
+//
+// Number of latency buckets in a histogram. Bucket 0 counts transactions that
+// took less than 1 microsecond. Bucket N, for 0 < N < IPMI_LATENCY_BUCKET_COUNT - 1,
+// counts transactions that took [2^(N-1), 2^N) microseconds. The last bucket
+// counts every transaction longer than that.
+//
+#define IPMI_LATENCY_BUCKET_COUNT  24
+
+//
+// A completed IPMI transaction. Times are in nanoseconds from the start of the
+// performance counter.
+//
+typedef struct {
+  UINT8         NetFunction;
+  UINT8         Command;
+  UINT8         CompletionCode;
+  UINT8         Retries;
+  UINT32        RequestSize;
+  UINT32        ResponseSize;
+  EFI_STATUS    Status;
+  UINT64        StartTime;
+  UINT64        EndTime;
+} IPMI_TRACE_RECORD;
+
+//
+// Latency distribution of all transactions for a NetFn/Cmd pair. Times are in
+// nanoseconds.
+//
+typedef struct {
+  UINT8     NetFunction;
+  UINT8     Command;
+  UINT32    Count;
+  UINT64    TotalTime;
+  UINT64    MaxTime;
+  UINT32    Buckets[IPMI_LATENCY_BUCKET_COUNT];
+} IPMI_LATENCY_HISTOGRAM;
+
+/**
+  Retrieves the most recent IPMI transactions, oldest first.
+
+  @param[in]      This          Pointer to the IPMI trace protocol.
+  @param[out]     Records       Buffer to receive the records.
+  @param[in,out]  RecordCount   On input, the number of records Records can
+                                hold. On output, the number of records
+                                returned, or required if the buffer is too
+                                small.
+  @param[out]     TotalCount    If provided, receives the number of
+                                transactions recorded including those that
+                                have since been overwritten.
+
+  @retval   EFI_SUCCESS             The records were returned.
+  @retval   EFI_INVALID_PARAMETER   RecordCount is NULL, or Records is NULL and
+                                    *RecordCount is not 0.
+  @retval   EFI_BUFFER_TOO_SMALL    Records is too small to hold all records.
+**/
+typedef
+EFI_STATUS
+(EFIAPI *IPMI_TRACE_GET_RECORDS)(
+  IN      IPMI_TRACE_PROTOCOL  *This,
+  OUT     IPMI_TRACE_RECORD    *Records,
+  IN OUT  UINTN                *RecordCount,
+  OUT     UINT64               *TotalCount OPTIONAL
+  );
+
+/**
+  Retrieves the latency histogram of every NetFn/Cmd pair sent.
+
+  @param[in]      This            Pointer to the IPMI trace protocol.
+  @param[out]     Histograms      Buffer to receive the histograms.
+  @param[in,out]  HistogramCount  On input, the number of histograms
+                                  Histograms can hold. On output, the number
+                                  returned, or required if the buffer is too
+                                  small.
+  @param[out]     OverflowCount   If provided, receives the number of
+                                  transactions of NetFn/Cmd pairs that found
+                                  every histogram taken.
+
+  @retval   EFI_SUCCESS             The histograms were returned.
+  @retval   EFI_INVALID_PARAMETER   HistogramCount is NULL, or Histograms is
+                                    NULL and *HistogramCount is not 0.
+  @retval   EFI_BUFFER_TOO_SMALL    Histograms is too small to hold all
+                                    histograms.
+**/
+typedef
+EFI_STATUS
+(EFIAPI *IPMI_TRACE_GET_HISTOGRAMS)(
+  IN      IPMI_TRACE_PROTOCOL     *This,
+  OUT     IPMI_LATENCY_HISTOGRAM  *Histograms,
+  IN OUT  UINTN                   *HistogramCount,
+  OUT     UINT64                  *OverflowCount OPTIONAL
+  );
+
+/**
+  Discards all recorded transactions and histograms.
+
+  @param[in]  This    Pointer to the IPMI trace protocol.
+**/
+typedef
+VOID
+(EFIAPI *IPMI_TRACE_RESET)(
+  IN IPMI_TRACE_PROTOCOL  *This
+  );
+
+//
+// IPMI TRACE PROTOCOL
+//
+struct _IPMI_TRACE_PROTOCOL {
+  IPMI_TRACE_GET_RECORDS       GetRecords;
+  IPMI_TRACE_GET_HISTOGRAMS    GetHistograms;
+  IPMI_TRACE_RESET             Reset;
+};
+
+extern EFI_GUID  gIpmiTraceProtocolGuid;
+
+#endif
@@ -0,0 +1,26 @@
+/** @file
+  IPMI Transport2 Protocol Header File.
+
+  Copyright (c) Microsoft Corporation
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef _IPMI_TRANSPORT2_PROTO_H_
+#define _IPMI_TRANSPORT2_PROTO_H_
+
+#include <IpmiInterface.h>
+
+#define IPMI_TRANSPORT2_PROTOCOL_GUID \
+  { \
+    0x3d1b5a5c, 0x4e2f, 0x4a8b, 0x9c, 0x61, 0x2f, 0x0e, 0x7a, 0x4b, 0xd8, 0x93 \
+  }
+
+#define SMM_IPMI_TRANSPORT2_PROTOCOL_GUID \
+{ \
+  0x9a6e2c07, 0x51d4, 0x4b3f, 0xa8, 0x2e, 0x6c, 0x13, 0xf5, 0x90, 0x4d, 0x7b \
+}
+
+extern EFI_GUID  gIpmiTransport2ProtocolGuid;
+extern EFI_GUID  gSmmIpmiTransport2ProtocolGuid;
+
+#endif
@@ -16,6 +16,16 @@
 #define SSIF_MAX_WRITE_BUFFER_SIZE  (64)
 #define SSIF_MAX_READ_BUFFER_SIZE   (64)
 
+//
+// Largest messages, including the NetFn/LUN and command header. Writes are
+// limited to 255 bytes. A multi-part read has a start block carrying 2 marker
+// bytes followed by up to 255 middle blocks and an end block, each carrying a
+// block number.
+//
+#define SSIF_MESSAGE_HEADER_SIZE     (2)
+#define SSIF_MAX_WRITE_MESSAGE_SIZE  (255)
+#define SSIF_MAX_READ_MESSAGE_SIZE   ((SSIF_MAX_READ_SIZE - 2) + (SSIF_READ_END_BLOCK + 1) * (SSIF_MAX_READ_SIZE - 1))
+
 #define SMBUS_RW_READ   (0)
 #define SMBUS_RW_WRITE  (1)
 
@@ -77,4 +87,20 @@ typedef struct _SSIF_MULTI_READ_MIDDLE {
 
 #define SSIF_READ_END_BLOCK  0xFF
 
+//
+// Times a middle or end block of a multi-part read that failed or arrived out
+// of order is requested again with SMBUS_CMD_MULT_READ_RETRY before the whole
+// response fails.
+//
+#define SSIF_MULT_READ_RETRY_COUNT  3
+
+//
+// The BMC NAKs the first read of a response until it is ready, and the first
+// write of a request while it is busy. The transaction is retried after a
+// delay in microseconds that starts at SSIF_POLL_INITIAL_DELAY and doubles up
+// to SSIF_POLL_MAX_DELAY, until the time budget of the send or receive is used.
+//
+#define SSIF_POLL_INITIAL_DELAY  100
+#define SSIF_POLL_MAX_DELAY      10000
+
 #endif
@@ -1,5 +1,5 @@
 /** @file
-  The DXE implementation of the IPMI SEL Protocol.
+  The DXE implementation of the IPMI SEL and IPMI SEL2 Protocols.
 
   Copyright (c) Microsoft Corporation.
   SPDX-License-Identifier: BSD-2-Clause-Patent
@@ -8,12 +8,28 @@
 
 #include <Uefi.h>
 #include <Library/UefiLib.h>
+#include <Library/BaseMemoryLib.h>
 #include <Library/DebugLib.h>
 #include <Library/UefiBootServicesTableLib.h>
 
-#include <Protocol/IpmiSelProtocol.h>
+#include <Protocol/IpmiSel2Protocol.h>
 #include <Library/IpmiSelLib.h>
 
+#include "IpmiSel.h"
+
+//
+// State of a walk through the SEL, kept in the SEL_ITERATOR of the caller.
+//
+typedef struct {
+  UINT16     NextRecordId;
+  BOOLEAN    EndOfLog;
+} SEL_WALK_STATE;
+
+STATIC_ASSERT (
+  sizeof (SEL_WALK_STATE) <= sizeof (((SEL_ITERATOR *)NULL)->Private),
+  "SEL walk state does not fit SEL_ITERATOR!"
+  );
+
 //
 // Protocol function prototypes.
 //
@@ -35,6 +51,35 @@ IpmiSelAddRecordEntry (
   IN  UINT8   Data[6]
   );
 
+EFI_STATUS
+EFIAPI
+IpmiSelStartRecordIterator (
+  OUT SEL_ITERATOR  *Iterator,
+  IN  UINT16        RecordId,
+  IN  SEL_RECORD    *Window,
+  IN  UINT16        WindowSize
+  );
+
+EFI_STATUS
+EFIAPI
+IpmiSelGetNextRecordEntry (
+  IN OUT SEL_ITERATOR  *Iterator,
+  OUT    SEL_RECORD    *Record
+  );
+
+EFI_STATUS
+EFIAPI
+IpmiSelStartQuery (
+  IN OUT SEL_QUERY  *Query
+  );
+
+EFI_STATUS
+EFIAPI
+IpmiSelGetNextMatch (
+  IN OUT SEL_QUERY   *Query,
+  OUT    SEL_RECORD  *Record
+  );
+
 //
 // Protocol definition.
 //
@@ -44,6 +89,16 @@ IPMI_SEL_PROTOCOL  mIpmiSelProtocol = {
   IpmiSelAddRecordEntry
 };
 
+IPMI_SEL2_PROTOCOL  mIpmiSel2Protocol = {
+  IPMI_SEL2_PROTOCOL_REVISION,
+  IpmiSelGetRecordEntry,
+  IpmiSelAddRecordEntry,
+  IpmiSelStartRecordIterator,
+  IpmiSelGetNextRecordEntry,
+  IpmiSelStartQuery,
+  IpmiSelGetNextMatch
+};
+
 /**
   Retrieves a record from the system event log.
 
@@ -66,7 +121,22 @@ IpmiSelGetRecordEntry (
   OUT UINT16      *NextRecordId OPTIONAL
   )
 {
-  return SelGetEntry (RecordId, Record, NextRecordId);
+  EFI_STATUS  Status;
+
+  if (Record == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  //
+  // Reads are answered from the SEL mirror, and only go to the BMC directly
+  // when the mirror cannot be brought up to date.
+  //
+  Status = SelMirrorGetEntry (RecordId, Record, NextRecordId);
+  if (EFI_ERROR (Status) && (Status != EFI_NOT_FOUND)) {
+    Status = SelGetEntry (RecordId, Record, NextRecordId);
+  }
+
+  return Status;
 }
 
 /**
@@ -94,16 +164,142 @@ IpmiSelAddRecordEntry (
   IN  UINT8   Data[6]
   )
 {
+  SelMirrorInvalidate ();
   return SelAddOemEntryEx (RecordId, RecordType, ManufacturerId, Data);
 }
 
+/**
+  Starts a walk through the system event log. Walks are answered from the SEL
+  mirror like single reads, so the window is not used.
+
+  @param[out] Iterator      Receives the state of the walk.
+  @param[in]  RecordId      The record ID to start at. 0x0000 starts at the first
+                            entry.
+  @param[in]  Window        The buffer to fetch records into.
+  @param[in]  WindowSize    The number of records the window holds.
+
+  @retval   EFI_SUCCESS             The walk was started.
+  @retval   EFI_INVALID_PARAMETER   Iterator or Window is NULL, or WindowSize
+                                    is 0.
+**/
+EFI_STATUS
+EFIAPI
+IpmiSelStartRecordIterator (
+  OUT SEL_ITERATOR  *Iterator,
+  IN  UINT16        RecordId,
+  IN  SEL_RECORD    *Window,
+  IN  UINT16        WindowSize
+  )
+{
+  SEL_WALK_STATE  *State;
+
+  if ((Iterator == NULL) || (Window == NULL) || (WindowSize == 0)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  ZeroMem (Iterator, sizeof (*Iterator));
+  State               = (SEL_WALK_STATE *)Iterator->Private;
+  State->NextRecordId = RecordId;
+  State->EndOfLog     = FALSE;
+  return EFI_SUCCESS;
+}
+
+/**
+  Retrieves the next record of a walk through the system event log from the
+  SEL mirror.
+
+  @param[in,out]  Iterator  The state of the walk.
+  @param[out]     Record    Receives the record entry.
+
+  @retval   EFI_SUCCESS             The next SEL entry was retrieved.
+  @retval   EFI_NOT_FOUND           The walk reached the end of the SEL.
+  @retval   EFI_INVALID_PARAMETER   Iterator or Record pointer is NULL.
+  @retval   Other                   An error was returned by IPMI.
+**/
+EFI_STATUS
+EFIAPI
+IpmiSelGetNextRecordEntry (
+  IN OUT SEL_ITERATOR  *Iterator,
+  OUT    SEL_RECORD    *Record
+  )
+{
+  EFI_STATUS      Status;
+  SEL_WALK_STATE  *State;
+  UINT16          NextRecordId;
+
+  if ((Iterator == NULL) || (Record == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  State = (SEL_WALK_STATE *)Iterator->Private;
+  if (State->EndOfLog) {
+    return EFI_NOT_FOUND;
+  }
+
+  Status = IpmiSelGetRecordEntry (State->NextRecordId, Record, &NextRecordId);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (NextRecordId == SEL_LAST_RECORD_ID) {
+    State->EndOfLog = TRUE;
+  } else {
+    State->NextRecordId = NextRecordId;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Starts a query for the records of the system event log matching the
+  criteria. The query is answered from an index of the SEL held in memory, and
+  only visits the records indexed under its most selective criterion.
+
+  @param[in,out]  Query     The criteria to match, receives the state of the
+                            query.
+
+  @retval   EFI_SUCCESS             The query was started.
+  @retval   EFI_INVALID_PARAMETER   Query is NULL.
+  @retval   Other                   The SEL could not be read.
+**/
+EFI_STATUS
+EFIAPI
+IpmiSelStartQuery (
+  IN OUT SEL_QUERY  *Query
+  )
+{
+  return SelMirrorStartQuery (Query);
+}
+
+/**
+  Retrieves the next record of the system event log matching a query.
+
+  @param[in,out]  Query     The state of the query.
+  @param[out]     Record    Receives the record entry.
+
+  @retval   EFI_SUCCESS             The next matching SEL entry was retrieved.
+  @retval   EFI_NOT_FOUND           No more SEL entries match the query.
+  @retval   EFI_ABORTED             The SEL was cleared or reordered since the
+                                    query started.
+  @retval   EFI_INVALID_PARAMETER   Query or Record pointer is NULL.
+**/
+EFI_STATUS
+EFIAPI
+IpmiSelGetNextMatch (
+  IN OUT SEL_QUERY   *Query,
+  OUT    SEL_RECORD  *Record
+  )
+{
+  return SelMirrorGetNextMatch (Query, Record);
+}
+
 /**
   Entry point to the IPMI SEL Protocol module.
 
   @param[in]    ImageHandle   The handle for this module image.
   @param[in]    SystemTable   Pointer to the UEFI system table.
 
-  @retval   EFI_SUCCESS   IPMI SEL Protocol successfully installed.
+  @retval   EFI_SUCCESS   IPMI SEL and SEL2 Protocols successfully installed.
   @retval   Other         An error was returned by a subroutine.
 **/
 EFI_STATUS
@@ -117,6 +313,8 @@ IpmiSelEntryPoint (
                 &ImageHandle,
                 &gIpmiSelProtocolGuid,
                 &mIpmiSelProtocol,
+                &gIpmiSel2ProtocolGuid,
+                &mIpmiSel2Protocol,
                 NULL
                 );
 }
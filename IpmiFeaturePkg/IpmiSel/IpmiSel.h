@@ -0,0 +1,142 @@
+/** @file
+  Internal definitions of the DXE implementation of the IPMI SEL Protocol.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef IPMI_SEL_H_
+#define IPMI_SEL_H_
+
+#include <Uefi.h>
+#include <Protocol/IpmiSel2Protocol.h>
+
+/**
+  Retrieves a record from the in-memory mirror of the system event log.
+
+  The mirror loads the SEL on first use and is brought up to date with the BMC
+  when a walk starts at the first or last entry, when a record is not in the
+  mirror, before the end of the SEL is reported, and after the SEL was changed
+  through this driver. Records added to the SEL since the last update are
+  appended, and the mirror is reloaded when the SEL was cleared. Other reads
+  are answered from memory.
+
+  @param[in]  RecordId      The record ID to retrieve. 0x0000 will always retrieve
+                            the first entry and 0xFFFF will always retrieve the
+                            last entry.
+  @param[out] Record        Receives the record entry if found.
+  @param[out] NextRecordId  If provided, receives the next record ID. Will be set
+                            to 0xFFFF if the retrieved record is the last entry.
+
+  @retval   EFI_SUCCESS             The SEL entry was retrieved.
+  @retval   EFI_NOT_FOUND           The SEL has no entry with the record ID.
+  @retval   EFI_INVALID_PARAMETER   Record pointer is NULL.
+  @retval   Other                   The mirror could not be brought up to date.
+**/
+EFI_STATUS
+SelMirrorGetEntry (
+  IN  UINT16      RecordId,
+  OUT SEL_RECORD  *Record,
+  OUT UINT16      *NextRecordId OPTIONAL
+  );
+
+/**
+  Marks the mirror of the system event log out of date, so that the next read
+  brings it up to date with the BMC.
+**/
+VOID
+SelMirrorInvalidate (
+  VOID
+  );
+
+/**
+  Starts a query for the records of the in-memory mirror of the system event
+  log matching the criteria, bringing the mirror up to date with the BMC first.
+
+  @param[in,out]  Query     The criteria to match, receives the state of the
+                            query.
+
+  @retval   EFI_SUCCESS             The query was started.
+  @retval   EFI_INVALID_PARAMETER   Query is NULL.
+  @retval   Other                   The mirror could not be brought up to date.
+**/
+EFI_STATUS
+SelMirrorStartQuery (
+  IN OUT SEL_QUERY  *Query
+  );
+
+/**
+  Retrieves the next record of the in-memory mirror of the system event log
+  matching a query.
+
+  @param[in,out]  Query     The state of the query.
+  @param[out]     Record    Receives the record entry.
+
+  @retval   EFI_SUCCESS             The next matching SEL entry was retrieved.
+  @retval   EFI_NOT_FOUND           No more SEL entries match the query.
+  @retval   EFI_ABORTED             The SEL was cleared or reordered since the
+                                    query started.
+  @retval   EFI_INVALID_PARAMETER   Query or Record pointer is NULL.
+**/
+EFI_STATUS
+SelMirrorGetNextMatch (
+  IN OUT SEL_QUERY  *Query,
+  OUT SEL_RECORD    *Record
+  );
+
+/**
+  Empties the index, invalidating all started queries.
+**/
+VOID
+SelIndexReset (
+  VOID
+  );
+
+/**
+  Adds the record appended to the mirror to the index.
+
+  @param[in]  Record    The record appended to the mirror.
+  @param[in]  Index     The index of the record in the mirror.
+
+  @retval   EFI_SUCCESS             The record was indexed.
+  @retval   EFI_OUT_OF_RESOURCES    The index could not be grown.
+**/
+EFI_STATUS
+SelIndexAppend (
+  IN CONST SEL_RECORD  *Record,
+  IN UINTN             Index
+  );
+
+/**
+  Starts a query on the index, choosing the criterion with the fewest records
+  to visit.
+
+  @param[in,out]  Query     The criteria to match, receives the state of the
+                            query.
+**/
+VOID
+SelIndexStartQuery (
+  IN OUT SEL_QUERY  *Query
+  );
+
+/**
+  Finds the next record of the mirror matching a query.
+
+  @param[in,out]  Query     The state of the query.
+  @param[in]      Records   The records of the mirror.
+  @param[out]     Index     Receives the index of the matching record.
+
+  @retval   EFI_SUCCESS     A matching record was found.
+  @retval   EFI_NOT_FOUND   No more records match the query.
+  @retval   EFI_ABORTED     The index changed in a way that invalidates the
+                            query.
+**/
+EFI_STATUS
+SelIndexNextMatch (
+  IN OUT SEL_QUERY     *Query,
+  IN CONST SEL_RECORD  *Records,
+  OUT UINTN            *Index
+  );
+
+#endif
@@ -0,0 +1,475 @@
+/** @file
+  Index of the in-memory mirror of the system event log. Records are chained by
+  record type and by sensor type, and timestamped records are kept in time
+  stamp order, so that a query only visits the records under its most
+  selective criterion.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+#include <Library/DebugLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+#include "IpmiSel.h"
+
+//
+// Marks the end of a chain, and records the index first allocates room for.
+//
+#define SEL_INDEX_NONE              0xFFFF
+#define SEL_INDEX_INITIAL_CAPACITY  64
+
+//
+// Records of the mirror the query visits.
+//
+typedef enum {
+  SelQueryAll,
+  SelQueryRecordType,
+  SelQuerySensorType,
+  SelQueryTimeStamp
+} SEL_QUERY_SOURCE;
+
+//
+// State of a query, kept in the private part of SEL_QUERY.
+//
+typedef struct {
+  UINT32    Generation;
+  UINT16    Position;
+  UINT16    End;
+  UINT8     Source;
+} SEL_QUERY_STATE;
+
+STATIC_ASSERT (
+  sizeof (SEL_QUERY_STATE) <= sizeof (((SEL_QUERY *)NULL)->Private),
+  "SEL query state does not fit SEL_QUERY!"
+  );
+
+//
+// Index entry of a record of the mirror.
+//
+typedef struct {
+  UINT32    TimeStamp;
+  UINT16    NextByRecordType;
+  UINT16    NextBySensorType;
+} SEL_INDEX_ENTRY;
+
+typedef struct {
+  UINT16    Head;
+  UINT16    Tail;
+  UINT16    Count;
+} SEL_INDEX_CHAIN;
+
+//
+// State of the index. Entries and ByTime grow with the mirror, Generation
+// changes whenever positions of a started query become invalid.
+//
+typedef struct {
+  SEL_INDEX_ENTRY    *Entries;
+  UINT16             *ByTime;
+  UINTN              Count;
+  UINTN              TimeCount;
+  UINTN              Capacity;
+  UINT32             Generation;
+  SEL_INDEX_CHAIN    RecordTypes[256];
+  SEL_INDEX_CHAIN    SensorTypes[256];
+} SEL_INDEX;
+
+STATIC SEL_INDEX  mSelIndex;
+
+/**
+  Checks whether a record carries a time stamp.
+
+  @param[in]  Record    The record.
+
+  @retval TRUE    The record is timestamped.
+  @retval FALSE   The record is an OEM non-timestamped record.
+**/
+STATIC
+BOOLEAN
+SelIndexIsTimestamped (
+  IN CONST SEL_RECORD  *Record
+  )
+{
+  return (BOOLEAN)(Record->RecordType < IPMI_SEL_OEM_NO_TIME_STAMP_RECORD_START);
+}
+
+/**
+  Finds the first position in time stamp order of a record stamped at or
+  after a time.
+
+  @param[in]  TimeStamp   The time.
+
+  @retval   The position.
+**/
+STATIC
+UINTN
+SelIndexLowerBound (
+  IN UINT32  TimeStamp
+  )
+{
+  UINTN  Low;
+  UINTN  High;
+  UINTN  Middle;
+
+  Low  = 0;
+  High = mSelIndex.TimeCount;
+  while (Low < High) {
+    Middle = (Low + High) / 2;
+    if (mSelIndex.Entries[mSelIndex.ByTime[Middle]].TimeStamp < TimeStamp) {
+      Low = Middle + 1;
+    } else {
+      High = Middle;
+    }
+  }
+
+  return Low;
+}
+
+/**
+  Finds the first position in time stamp order of a record stamped after a
+  time.
+
+  @param[in]  TimeStamp   The time.
+
+  @retval   The position.
+**/
+STATIC
+UINTN
+SelIndexUpperBound (
+  IN UINT32  TimeStamp
+  )
+{
+  if (TimeStamp == MAX_UINT32) {
+    return mSelIndex.TimeCount;
+  }
+
+  return SelIndexLowerBound (TimeStamp + 1);
+}
+
+/**
+  Checks a record against the criteria of a query.
+
+  @param[in]  Query     The query.
+  @param[in]  Record    The record.
+
+  @retval TRUE    The record matches the query.
+  @retval FALSE   The record does not match the query.
+**/
+STATIC
+BOOLEAN
+SelIndexMatch (
+  IN CONST SEL_QUERY   *Query,
+  IN CONST SEL_RECORD  *Record
+  )
+{
+  if (((Query->Fields & SEL_QUERY_RECORD_TYPE) != 0) &&
+      (Record->RecordType != Query->RecordType))
+  {
+    return FALSE;
+  }
+
+  if ((Query->Fields & (SEL_QUERY_SENSOR_TYPE | SEL_QUERY_SENSOR_NUMBER | SEL_QUERY_GENERATOR_ID)) != 0) {
+    if (Record->RecordType != IPMI_SEL_SYSTEM_RECORD) {
+      return FALSE;
+    }
+
+    if (((Query->Fields & SEL_QUERY_SENSOR_TYPE) != 0) &&
+        (Record->Record.System.SensorType != Query->SensorType))
+    {
+      return FALSE;
+    }
+
+    if (((Query->Fields & SEL_QUERY_SENSOR_NUMBER) != 0) &&
+        (Record->Record.System.SensorNumber != Query->SensorNumber))
+    {
+      return FALSE;
+    }
+
+    if (((Query->Fields & SEL_QUERY_GENERATOR_ID) != 0) &&
+        (Record->Record.System.GeneratorId != Query->GeneratorId))
+    {
+      return FALSE;
+    }
+  }
+
+  if ((Query->Fields & SEL_QUERY_MANUFACTURER_ID) != 0) {
+    if ((Record->RecordType < IPMI_SEL_OEM_TIME_STAMP_RECORD_START) ||
+        (Record->RecordType > IPMI_SEL_OEM_TIME_STAMP_RECORD_END) ||
+        (CompareMem (Record->Record.Oem.ManufacturerId, Query->ManufacturerId, sizeof (Query->ManufacturerId)) != 0))
+    {
+      return FALSE;
+    }
+  }
+
+  if ((Query->Fields & SEL_QUERY_TIME_STAMP) != 0) {
+    if (!SelIndexIsTimestamped (Record) ||
+        (Record->Record.System.TimeStamp < Query->StartTime) ||
+        (Record->Record.System.TimeStamp > Query->EndTime))
+    {
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+/**
+  Empties the index, invalidating all started queries.
+**/
+VOID
+SelIndexReset (
+  VOID
+  )
+{
+  UINTN  Index;
+
+  mSelIndex.Count     = 0;
+  mSelIndex.TimeCount = 0;
+  mSelIndex.Generation++;
+
+  for (Index = 0; Index < ARRAY_SIZE (mSelIndex.RecordTypes); Index++) {
+    mSelIndex.RecordTypes[Index].Count = 0;
+    mSelIndex.SensorTypes[Index].Count = 0;
+  }
+}
+
+/**
+  Adds the record appended to the mirror to the index.
+
+  @param[in]  Record    The record appended to the mirror.
+  @param[in]  Index     The index of the record in the mirror.
+
+  @retval   EFI_SUCCESS             The record was indexed.
+  @retval   EFI_OUT_OF_RESOURCES    The index could not be grown.
+**/
+EFI_STATUS
+SelIndexAppend (
+  IN CONST SEL_RECORD  *Record,
+  IN UINTN             Index
+  )
+{
+  SEL_INDEX_ENTRY  *Entries;
+  UINT16           *ByTime;
+  SEL_INDEX_ENTRY  *Entry;
+  SEL_INDEX_CHAIN  *Chain;
+  UINTN            Capacity;
+  UINTN            Position;
+
+  ASSERT (Index == mSelIndex.Count);
+  if (Index >= SEL_INDEX_NONE) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  if (mSelIndex.Count == mSelIndex.Capacity) {
+    Capacity = (mSelIndex.Capacity == 0) ? SEL_INDEX_INITIAL_CAPACITY : mSelIndex.Capacity * 2;
+    Entries  = ReallocatePool (
+                 mSelIndex.Capacity * sizeof (SEL_INDEX_ENTRY),
+                 Capacity * sizeof (SEL_INDEX_ENTRY),
+                 mSelIndex.Entries
+                 );
+
+    if (Entries == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+
+    mSelIndex.Entries = Entries;
+    ByTime            = ReallocatePool (
+                          mSelIndex.Capacity * sizeof (UINT16),
+                          Capacity * sizeof (UINT16),
+                          mSelIndex.ByTime
+                          );
+
+    if (ByTime == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+
+    mSelIndex.ByTime   = ByTime;
+    mSelIndex.Capacity = Capacity;
+  }
+
+  Entry                   = &mSelIndex.Entries[Index];
+  Entry->TimeStamp        = 0;
+  Entry->NextByRecordType = SEL_INDEX_NONE;
+  Entry->NextBySensorType = SEL_INDEX_NONE;
+  mSelIndex.Count++;
+
+  Chain = &mSelIndex.RecordTypes[Record->RecordType];
+  if (Chain->Count == 0) {
+    Chain->Head = (UINT16)Index;
+  } else {
+    mSelIndex.Entries[Chain->Tail].NextByRecordType = (UINT16)Index;
+  }
+
+  Chain->Tail = (UINT16)Index;
+  Chain->Count++;
+
+  if (Record->RecordType == IPMI_SEL_SYSTEM_RECORD) {
+    Chain = &mSelIndex.SensorTypes[Record->Record.System.SensorType];
+    if (Chain->Count == 0) {
+      Chain->Head = (UINT16)Index;
+    } else {
+      mSelIndex.Entries[Chain->Tail].NextBySensorType = (UINT16)Index;
+    }
+
+    Chain->Tail = (UINT16)Index;
+    Chain->Count++;
+  }
+
+  if (SelIndexIsTimestamped (Record)) {
+    //
+    // Records are mostly added in time order and land at the end. A record
+    // stamped earlier moves the positions of the later ones, which started
+    // queries rely on.
+    //
+    Entry->TimeStamp = Record->Record.System.TimeStamp;
+    Position         = SelIndexUpperBound (Entry->TimeStamp);
+    if (Position < mSelIndex.TimeCount) {
+      CopyMem (
+        &mSelIndex.ByTime[Position + 1],
+        &mSelIndex.ByTime[Position],
+        (mSelIndex.TimeCount - Position) * sizeof (UINT16)
+        );
+
+      mSelIndex.Generation++;
+    }
+
+    mSelIndex.ByTime[Position] = (UINT16)Index;
+    mSelIndex.TimeCount++;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Starts a query on the index, choosing the criterion with the fewest records
+  to visit.
+
+  @param[in,out]  Query     The criteria to match, receives the state of the
+                            query.
+**/
+VOID
+SelIndexStartQuery (
+  IN OUT SEL_QUERY  *Query
+  )
+{
+  SEL_QUERY_STATE  *State;
+  SEL_INDEX_CHAIN  *Chain;
+  UINTN            Lower;
+  UINTN            Upper;
+  UINTN            Visits;
+
+  State             = (SEL_QUERY_STATE *)Query->Private;
+  State->Source     = SelQueryAll;
+  State->Position   = 0;
+  State->End        = (UINT16)mSelIndex.Count;
+  State->Generation = mSelIndex.Generation;
+  Visits            = mSelIndex.Count;
+
+  Chain = NULL;
+  if ((Query->Fields & SEL_QUERY_RECORD_TYPE) != 0) {
+    Chain = &mSelIndex.RecordTypes[Query->RecordType];
+  } else if ((Query->Fields & (SEL_QUERY_SENSOR_TYPE | SEL_QUERY_SENSOR_NUMBER | SEL_QUERY_GENERATOR_ID)) != 0) {
+    Chain = &mSelIndex.RecordTypes[IPMI_SEL_SYSTEM_RECORD];
+  }
+
+  if ((Chain != NULL) && (Chain->Count < Visits)) {
+    State->Source   = SelQueryRecordType;
+    State->Position = (Chain->Count == 0) ? SEL_INDEX_NONE : Chain->Head;
+    Visits          = Chain->Count;
+  }
+
+  if ((Query->Fields & SEL_QUERY_SENSOR_TYPE) != 0) {
+    Chain = &mSelIndex.SensorTypes[Query->SensorType];
+    if (Chain->Count < Visits) {
+      State->Source   = SelQuerySensorType;
+      State->Position = (Chain->Count == 0) ? SEL_INDEX_NONE : Chain->Head;
+      Visits          = Chain->Count;
+    }
+  }
+
+  if ((Query->Fields & SEL_QUERY_TIME_STAMP) != 0) {
+    Lower = 0;
+    Upper = 0;
+    if (Query->StartTime <= Query->EndTime) {
+      Lower = SelIndexLowerBound (Query->StartTime);
+      Upper = SelIndexUpperBound (Query->EndTime);
+    }
+
+    if (Upper - Lower < Visits) {
+      State->Source   = SelQueryTimeStamp;
+      State->Position = (UINT16)Lower;
+      State->End      = (UINT16)Upper;
+    }
+  }
+}
+
+/**
+  Finds the next record of the mirror matching a query.
+
+  @param[in,out]  Query     The state of the query.
+  @param[in]      Records   The records of the mirror.
+  @param[out]     Index     Receives the index of the matching record.
+
+  @retval   EFI_SUCCESS     A matching record was found.
+  @retval   EFI_NOT_FOUND   No more records match the query.
+  @retval   EFI_ABORTED     The index changed in a way that invalidates the
+                            query.
+**/
+EFI_STATUS
+SelIndexNextMatch (
+  IN OUT SEL_QUERY     *Query,
+  IN CONST SEL_RECORD  *Records,
+  OUT UINTN            *Index
+  )
+{
+  SEL_QUERY_STATE  *State;
+  UINT16           Candidate;
+
+  State = (SEL_QUERY_STATE *)Query->Private;
+  if (State->Generation != mSelIndex.Generation) {
+    return EFI_ABORTED;
+  }
+
+  while (TRUE) {
+    switch (State->Source) {
+      case SelQueryRecordType:
+      case SelQuerySensorType:
+        if (State->Position == SEL_INDEX_NONE) {
+          return EFI_NOT_FOUND;
+        }
+
+        Candidate = State->Position;
+        if (State->Source == SelQueryRecordType) {
+          State->Position = mSelIndex.Entries[Candidate].NextByRecordType;
+        } else {
+          State->Position = mSelIndex.Entries[Candidate].NextBySensorType;
+        }
+
+        break;
+
+      case SelQueryTimeStamp:
+        if (State->Position >= State->End) {
+          return EFI_NOT_FOUND;
+        }
+
+        Candidate = mSelIndex.ByTime[State->Position++];
+        break;
+
+      default:
+        if (State->Position >= State->End) {
+          return EFI_NOT_FOUND;
+        }
+
+        Candidate = State->Position++;
+        break;
+    }
+
+    if (SelIndexMatch (Query, &Records[Candidate])) {
+      *Index = Candidate;
+      return EFI_SUCCESS;
+    }
+  }
+}
@@ -0,0 +1,512 @@
+/** @file
+  In-memory mirror of the system event log. The mirror is loaded from the BMC
+  once and then kept up to date incrementally, using the SEL information to
+  tell records appended to the SEL from a cleared SEL, so that repeated reads
+  of the SEL cost no BMC traffic. Records are indexed as they are mirrored to
+  answer queries. The mirror is only changed at TPL_NOTIFY or above, so code
+  interrupting a caller never finds it half updated.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+#include <Library/DebugLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/IpmiSelLib.h>
+
+#include "IpmiSel.h"
+
+//
+// Records the mirror first allocates room for, and records fetched from the
+// BMC at a time while loading.
+//
+#define SEL_MIRROR_INITIAL_CAPACITY  64
+#define SEL_MIRROR_FETCH_WINDOW      16
+
+//
+// TPL the mirror is accessed at.
+//
+#define SEL_MIRROR_TPL  TPL_NOTIFY
+
+//
+// State of the mirror.
+//
+typedef struct {
+  SEL_RECORD    *Records;
+  UINTN         Count;
+  UINTN         Capacity;
+  UINTN         LastIndex;            // Index of the record read last.
+  BOOLEAN       WalkChecked;          // The current walk has checked the BMC.
+  UINT32        LastAddTimeStamp;     // SEL information of the last update.
+  UINT32        LastEraseTimeStamp;
+  BOOLEAN       Loaded;
+  BOOLEAN       Stale;
+} SEL_MIRROR;
+
+STATIC SEL_MIRROR  mSelMirror;
+
+/**
+  Keeps the mirror from being changed by code interrupting the caller by
+  raising the TPL to SEL_MIRROR_TPL, unless it is already higher.
+
+  @retval   The TPL to pass to SelMirrorUnlock.
+**/
+STATIC
+EFI_TPL
+SelMirrorLock (
+  VOID
+  )
+{
+  EFI_TPL  OldTpl;
+
+  OldTpl = gBS->RaiseTPL (TPL_HIGH_LEVEL);
+  gBS->RestoreTPL (MAX (OldTpl, SEL_MIRROR_TPL));
+  return OldTpl;
+}
+
+/**
+  Allows the mirror to be changed again.
+
+  @param[in]  OldTpl    The TPL returned by SelMirrorLock.
+**/
+STATIC
+VOID
+SelMirrorUnlock (
+  IN EFI_TPL  OldTpl
+  )
+{
+  gBS->RestoreTPL (OldTpl);
+}
+
+/**
+  Appends a record to the mirror, growing it as needed.
+
+  @param[in]  Record    The record to append.
+
+  @retval   EFI_SUCCESS             The record was appended.
+  @retval   EFI_OUT_OF_RESOURCES    The mirror could not be grown.
+**/
+STATIC
+EFI_STATUS
+SelMirrorAppend (
+  IN SEL_RECORD  *Record
+  )
+{
+  SEL_RECORD  *Records;
+  UINTN       Capacity;
+  EFI_STATUS  Status;
+
+  if (mSelMirror.Count == mSelMirror.Capacity) {
+    Capacity = (mSelMirror.Capacity == 0) ? SEL_MIRROR_INITIAL_CAPACITY : mSelMirror.Capacity * 2;
+    Records  = ReallocatePool (
+                 mSelMirror.Capacity * sizeof (SEL_RECORD),
+                 Capacity * sizeof (SEL_RECORD),
+                 mSelMirror.Records
+                 );
+
+    if (Records == NULL) {
+      DEBUG ((DEBUG_ERROR, "%a: Failed to grow the SEL mirror to %d records.\n", __FUNCTION__, Capacity));
+      return EFI_OUT_OF_RESOURCES;
+    }
+
+    mSelMirror.Records  = Records;
+    mSelMirror.Capacity = Capacity;
+  }
+
+  Status = SelIndexAppend (Record, mSelMirror.Count);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "%a: Failed to index SEL record 0x%x. %r\n", __FUNCTION__, Record->RecordId, Status));
+    return Status;
+  }
+
+  CopyMem (&mSelMirror.Records[mSelMirror.Count], Record, sizeof (SEL_RECORD));
+  mSelMirror.Count++;
+  return EFI_SUCCESS;
+}
+
+/**
+  Fetches the records of the SEL that follow the mirrored ones, or the whole SEL
+  if the mirror is empty.
+
+  @retval   EFI_SUCCESS     The mirror holds all records of the SEL.
+  @retval   EFI_ABORTED     The SEL was cleared while it was read.
+  @retval   Other           The records could not be fetched.
+**/
+STATIC
+EFI_STATUS
+SelMirrorFetch (
+  VOID
+  )
+{
+  SEL_RECORD    Window[SEL_MIRROR_FETCH_WINDOW];
+  SEL_ITERATOR  Iterator;
+  SEL_RECORD    Record;
+  UINT16        RecordId;
+  BOOLEAN       Skip;
+  EFI_STATUS    Status;
+
+  //
+  // Appending starts at the last mirrored record, which now leads to the new
+  // ones.
+  //
+  RecordId = 0;
+  Skip     = FALSE;
+  if (mSelMirror.Count > 0) {
+    RecordId = mSelMirror.Records[mSelMirror.Count - 1].RecordId;
+    Skip     = TRUE;
+  }
+
+  Status = SelStartIterator (&Iterator, RecordId, Window, ARRAY_SIZE (Window));
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  while (TRUE) {
+    Status = SelGetNextEntry (&Iterator, &Record);
+    if (Status == EFI_NOT_FOUND) {
+      return EFI_SUCCESS;
+    }
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    if (Skip) {
+      Skip = FALSE;
+      if (Record.RecordId != RecordId) {
+        DEBUG ((DEBUG_WARN, "%a: SEL record 0x%x is gone.\n", __FUNCTION__, RecordId));
+        return EFI_ABORTED;
+      }
+
+      continue;
+    }
+
+    Status = SelMirrorAppend (&Record);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+}
+
+/**
+  Brings the mirror up to date with the BMC. Records added since the last
+  update are appended, and the mirror is reloaded when the SEL was cleared or
+  holds fewer entries than the mirror. If the records fetched do not add up to
+  the entries the SEL information reports, the mirror is reloaded once. A SEL
+  that still does not add up is being changed while it is read, so the mirror
+  is kept but left out of date.
+
+  @retval   EFI_SUCCESS     The mirror is up to date.
+  @retval   Other           The mirror could not be brought up to date.
+**/
+STATIC
+EFI_STATUS
+SelMirrorSync (
+  VOID
+  )
+{
+  SEL_INFO    SelInfo;
+  EFI_STATUS  Status;
+  BOOLEAN     Reload;
+  UINTN       Attempt;
+
+  Reload = FALSE;
+  for (Attempt = 0; Attempt < 2; Attempt++) {
+    Status = SelGetInfo (&SelInfo);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    if (Reload || !mSelMirror.Loaded ||
+        (SelInfo.LastEraseTimeStamp != mSelMirror.LastEraseTimeStamp) ||
+        (SelInfo.NumberOfEntries < mSelMirror.Count))
+    {
+      DEBUG ((DEBUG_INFO, "%a: Loading the SEL mirror.\n", __FUNCTION__));
+      mSelMirror.Count = 0;
+      SelIndexReset ();
+    } else if ((SelInfo.LastAddTimeStamp == mSelMirror.LastAddTimeStamp) &&
+               (SelInfo.NumberOfEntries == mSelMirror.Count))
+    {
+      mSelMirror.Stale = FALSE;
+      return EFI_SUCCESS;
+    }
+
+    mSelMirror.Loaded    = FALSE;
+    mSelMirror.LastIndex = 0;
+    Status               = SelMirrorFetch ();
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_WARN, "%a: Failed to update the SEL mirror. %r\n", __FUNCTION__, Status));
+      mSelMirror.Count = 0;
+      SelIndexReset ();
+      return Status;
+    }
+
+    mSelMirror.LastAddTimeStamp   = SelInfo.LastAddTimeStamp;
+    mSelMirror.LastEraseTimeStamp = SelInfo.LastEraseTimeStamp;
+    mSelMirror.Loaded             = TRUE;
+    mSelMirror.Stale              = FALSE;
+    if (mSelMirror.Count == SelInfo.NumberOfEntries) {
+      return EFI_SUCCESS;
+    }
+
+    DEBUG ((
+      DEBUG_WARN,
+      "%a: The SEL mirror holds %d records, the SEL %d.\n",
+      __FUNCTION__,
+      mSelMirror.Count,
+      SelInfo.NumberOfEntries
+      ));
+
+    Reload = TRUE;
+  }
+
+  mSelMirror.Stale = TRUE;
+  return EFI_SUCCESS;
+}
+
+/**
+  Finds a record in the mirror. Walks read the record following the one read
+  last, which is checked first.
+
+  @param[in]  RecordId      The record ID to find, 0x0000 for the first entry
+                            and 0xFFFF for the last entry.
+  @param[out] Index         Receives the index of the record.
+
+  @retval   TRUE    The record was found.
+  @retval   FALSE   The mirror has no record with the record ID.
+**/
+STATIC
+BOOLEAN
+SelMirrorFind (
+  IN  UINT16  RecordId,
+  OUT UINTN   *Index
+  )
+{
+  UINTN  Next;
+
+  if (mSelMirror.Count == 0) {
+    return FALSE;
+  }
+
+  if (RecordId == 0) {
+    *Index = 0;
+    return TRUE;
+  }
+
+  if (RecordId == SEL_LAST_RECORD_ID) {
+    *Index = mSelMirror.Count - 1;
+    return TRUE;
+  }
+
+  Next = mSelMirror.LastIndex + 1;
+  if ((Next < mSelMirror.Count) && (mSelMirror.Records[Next].RecordId == RecordId)) {
+    *Index = Next;
+    return TRUE;
+  }
+
+  for (Next = 0; Next < mSelMirror.Count; Next++) {
+    if (mSelMirror.Records[Next].RecordId == RecordId) {
+      *Index = Next;
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+/**
+  Retrieves a record from the in-memory mirror of the system event log.
+
+  The mirror loads the SEL on first use and is brought up to date with the BMC
+  when a walk starts at the first or last entry, when a record is not in the
+  mirror, before the end of the SEL is reported, and after the SEL was changed
+  through this driver. Records added to the SEL since the last update are
+  appended, and the mirror is reloaded when the SEL was cleared. Other reads
+  are answered from memory.
+
+  @param[in]  RecordId      The record ID to retrieve. 0x0000 will always retrieve
+                            the first entry and 0xFFFF will always retrieve the
+                            last entry.
+  @param[out] Record        Receives the record entry if found.
+  @param[out] NextRecordId  If provided, receives the next record ID. Will be set
+                            to 0xFFFF if the retrieved record is the last entry.
+
+  @retval   EFI_SUCCESS             The SEL entry was retrieved.
+  @retval   EFI_NOT_FOUND           The SEL has no entry with the record ID.
+  @retval   EFI_INVALID_PARAMETER   Record pointer is NULL.
+  @retval   Other                   The mirror could not be brought up to date.
+**/
+EFI_STATUS
+SelMirrorGetEntry (
+  IN  UINT16      RecordId,
+  OUT SEL_RECORD  *Record,
+  OUT UINT16      *NextRecordId OPTIONAL
+  )
+{
+  EFI_STATUS  Status;
+  BOOLEAN     Synced;
+  UINTN       Index;
+  EFI_TPL     OldTpl;
+
+  if (Record == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  OldTpl = SelMirrorLock ();
+
+  Synced = FALSE;
+  if (!mSelMirror.Loaded || mSelMirror.Stale ||
+      (RecordId == 0) || (RecordId == SEL_LAST_RECORD_ID))
+  {
+    Status = SelMirrorSync ();
+    if (EFI_ERROR (Status)) {
+      goto Exit;
+    }
+
+    Synced = TRUE;
+  }
+
+  if (!SelMirrorFind (RecordId, &Index)) {
+    if (Synced) {
+      Status = EFI_NOT_FOUND;
+      goto Exit;
+    }
+
+    Status = SelMirrorSync ();
+    if (EFI_ERROR (Status)) {
+      goto Exit;
+    }
+
+    Synced = TRUE;
+    if (!SelMirrorFind (RecordId, &Index)) {
+      Status = EFI_NOT_FOUND;
+      goto Exit;
+    }
+  }
+
+  //
+  // A walk that started after the first entry has not checked the BMC, so
+  // records added since the last update may follow the last mirrored one.
+  // Reads out of order are taken as the start of such a walk.
+  //
+  if (Synced) {
+    mSelMirror.WalkChecked = TRUE;
+  } else if (Index != mSelMirror.LastIndex + 1) {
+    mSelMirror.WalkChecked = FALSE;
+  }
+
+  if (!mSelMirror.WalkChecked && (Index + 1 == mSelMirror.Count)) {
+    Status = SelMirrorSync ();
+    if (EFI_ERROR (Status)) {
+      goto Exit;
+    }
+
+    mSelMirror.WalkChecked = TRUE;
+    if (!SelMirrorFind (RecordId, &Index)) {
+      Status = EFI_NOT_FOUND;
+      goto Exit;
+    }
+  }
+
+  CopyMem (Record, &mSelMirror.Records[Index], sizeof (SEL_RECORD));
+  if (NextRecordId != NULL) {
+    *NextRecordId = (Index + 1 < mSelMirror.Count) ? mSelMirror.Records[Index + 1].RecordId : SEL_LAST_RECORD_ID;
+  }
+
+  mSelMirror.LastIndex = Index;
+  Status               = EFI_SUCCESS;
+
+Exit:
+  SelMirrorUnlock (OldTpl);
+  return Status;
+}
+
+/**
+  Marks the mirror of the system event log out of date, so that the next read
+  brings it up to date with the BMC.
+**/
+VOID
+SelMirrorInvalidate (
+  VOID
+  )
+{
+  EFI_TPL  OldTpl;
+
+  OldTpl           = SelMirrorLock ();
+  mSelMirror.Stale = TRUE;
+  SelMirrorUnlock (OldTpl);
+}
+
+/**
+  Starts a query for the records of the in-memory mirror of the system event
+  log matching the criteria, bringing the mirror up to date with the BMC first.
+
+  @param[in,out]  Query     The criteria to match, receives the state of the
+                            query.
+
+  @retval   EFI_SUCCESS             The query was started.
+  @retval   EFI_INVALID_PARAMETER   Query is NULL.
+  @retval   Other                   The mirror could not be brought up to date.
+**/
+EFI_STATUS
+SelMirrorStartQuery (
+  IN OUT SEL_QUERY  *Query
+  )
+{
+  EFI_STATUS  Status;
+  EFI_TPL     OldTpl;
+
+  if (Query == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  OldTpl = SelMirrorLock ();
+  Status = SelMirrorSync ();
+  if (!EFI_ERROR (Status)) {
+    SelIndexStartQuery (Query);
+  }
+
+  SelMirrorUnlock (OldTpl);
+  return Status;
+}
+
+/**
+  Retrieves the next record of the in-memory mirror of the system event log
+  matching a query.
+
+  @param[in,out]  Query     The state of the query.
+  @param[out]     Record    Receives the record entry.
+
+  @retval   EFI_SUCCESS             The next matching SEL entry was retrieved.
+  @retval   EFI_NOT_FOUND           No more SEL entries match the query.
+  @retval   EFI_ABORTED             The SEL was cleared or reordered since the
+                                    query started.
+  @retval   EFI_INVALID_PARAMETER   Query or Record pointer is NULL.
+**/
+EFI_STATUS
+SelMirrorGetNextMatch (
+  IN OUT SEL_QUERY  *Query,
+  OUT SEL_RECORD    *Record
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       Index;
+  EFI_TPL     OldTpl;
+
+  if ((Query == NULL) || (Record == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  OldTpl = SelMirrorLock ();
+  Status = SelIndexNextMatch (Query, mSelMirror.Records, &Index);
+  if (!EFI_ERROR (Status)) {
+    CopyMem (Record, &mSelMirror.Records[Index], sizeof (SEL_RECORD));
+  }
+
+  SelMirrorUnlock (OldTpl);
+  return Status;
+}
@@ -0,0 +1,566 @@
+/** @file
+  Host based unit tests for the IPMI SEL module.
+
+  Copyright (c) Microsoft Corporation
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/DebugLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/UnitTestLib.h>
+#include <Library/IpmiSelLib.h>
+
+#include "../IpmiSel.h"
+
+#define UNIT_TEST_NAME     "IPMI SEL Unit Test"
+#define UNIT_TEST_VERSION  "1.0"
+
+//
+// Entries in the SEL when the tests start, and entries appended later.
+//
+#define TEST_SEL_ENTRIES   20
+#define TEST_SEL_APPENDED  5
+
+/**
+  Retrieves the number of IPMI requests the mock BMC has received. Implemented
+  by the mock BMC.
+
+  @retval   The number of requests since the start of the test.
+**/
+UINT32
+MockIpmiGetCommandCount (
+  VOID
+  );
+
+/**
+  Adds OEM entries to the SEL, numbering them in their data.
+
+  @param[in]  First     The number of the first entry.
+  @param[in]  Count     The number of entries to add.
+
+  @retval   EFI_SUCCESS   The entries were added.
+  @retval   Other         An entry could not be added.
+**/
+EFI_STATUS
+AddTestEntries (
+  IN UINT8  First,
+  IN UINT8  Count
+  )
+{
+  EFI_STATUS  Status;
+  UINT8       Data[13];
+  UINT8       Index;
+
+  ZeroMem (Data, sizeof (Data));
+  for (Index = First; Index < First + Count; Index++) {
+    Data[0] = Index;
+    Status  = SelAddOemEntryNoTimestamp (NULL, 0xE0, Data);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Walks the SEL through the mirror, checking that each entry carries the number
+  of its position.
+
+  @param[out]  Count    Receives the number of entries walked.
+
+  @retval   EFI_SUCCESS           The SEL was walked.
+  @retval   EFI_PROTOCOL_ERROR    An entry is out of order.
+  @retval   Other                 An entry could not be read.
+**/
+EFI_STATUS
+WalkMirror (
+  OUT UINT32  *Count
+  )
+{
+  EFI_STATUS  Status;
+  SEL_RECORD  Record;
+  UINT16      RecordId;
+
+  *Count   = 0;
+  RecordId = 0;
+  do {
+    Status = SelMirrorGetEntry (RecordId, &Record, &RecordId);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    if (Record.Record.OemNonTimestamped.Data[0] != *Count) {
+      return EFI_PROTOCOL_ERROR;
+    }
+
+    (*Count)++;
+  } while (RecordId != SEL_LAST_RECORD_ID);
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Tests that the mirror loads the SEL once and answers later walks from memory.
+
+  @param[in]  Context             UNUSED
+
+  @retval  UNIT_TEST_PASSED             The Unit test has completed and the test
+                                        case was successful.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A test case assertion has failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+TestSelMirrorLoad (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS  Status;
+  SEL_RECORD  Record;
+  UINT32      Commands;
+  UINT32      Count;
+
+  Status = SelClear (TRUE);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  Status = AddTestEntries (0, TEST_SEL_ENTRIES);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+
+  //
+  // The first walk loads the SEL: the SEL information and one read per entry.
+  //
+  Commands = MockIpmiGetCommandCount ();
+  Status   = WalkMirror (&Count);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (Count, TEST_SEL_ENTRIES);
+  UT_ASSERT_EQUAL (MockIpmiGetCommandCount () - Commands, 1 + TEST_SEL_ENTRIES);
+
+  //
+  // Later walks only check the SEL information.
+  //
+  Commands = MockIpmiGetCommandCount ();
+  Status   = WalkMirror (&Count);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (Count, TEST_SEL_ENTRIES);
+  UT_ASSERT_EQUAL (MockIpmiGetCommandCount () - Commands, 1);
+
+  //
+  // The last entry is found without a walk.
+  //
+  Status = SelMirrorGetEntry (SEL_LAST_RECORD_ID, &Record, NULL);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (Record.Record.OemNonTimestamped.Data[0], TEST_SEL_ENTRIES - 1);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Tests that entries added to the SEL are appended to the mirror.
+
+  @param[in]  Context             UNUSED
+
+  @retval  UNIT_TEST_PASSED             The Unit test has completed and the test
+                                        case was successful.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A test case assertion has failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+TestSelMirrorAppend (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS  Status;
+  SEL_RECORD  Record;
+  UINT8       Data[13];
+  UINT16      RecordId;
+  UINT16      NextRecordId;
+  UINT32      Commands;
+  UINT32      Count;
+
+  Status = WalkMirror (&Count);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+
+  Status = AddTestEntries (TEST_SEL_ENTRIES, TEST_SEL_APPENDED);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+
+  //
+  // Only the last known entry and the new ones are read.
+  //
+  Commands = MockIpmiGetCommandCount ();
+  Status   = WalkMirror (&Count);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (Count, TEST_SEL_ENTRIES + TEST_SEL_APPENDED);
+  UT_ASSERT_EQUAL (MockIpmiGetCommandCount () - Commands, 1 + 1 + TEST_SEL_APPENDED);
+
+  //
+  // An entry missing from the mirror is fetched when it is read by its
+  // record ID.
+  //
+  ZeroMem (Data, sizeof (Data));
+  Data[0] = TEST_SEL_ENTRIES + TEST_SEL_APPENDED;
+  Status  = SelAddOemEntryNoTimestamp (&RecordId, 0xE0, Data);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+
+  Status = SelMirrorGetEntry (RecordId, &Record, &NextRecordId);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (Record.RecordId, RecordId);
+  UT_ASSERT_EQUAL (Record.Record.OemNonTimestamped.Data[0], Data[0]);
+  UT_ASSERT_EQUAL (NextRecordId, SEL_LAST_RECORD_ID);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Tests that the mirror is reloaded when the SEL is cleared.
+
+  @param[in]  Context             UNUSED
+
+  @retval  UNIT_TEST_PASSED             The Unit test has completed and the test
+                                        case was successful.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A test case assertion has failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+TestSelMirrorClear (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS  Status;
+  SEL_RECORD  Record;
+  UINT32      Count;
+
+  Status = WalkMirror (&Count);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+
+  Status = SelClear (TRUE);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+
+  Status = SelMirrorGetEntry (0, &Record, NULL);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_NOT_FOUND);
+
+  Status = AddTestEntries (0, TEST_SEL_APPENDED);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+
+  Status = WalkMirror (&Count);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (Count, TEST_SEL_APPENDED);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Tests that a walk starting in the middle of the SEL finds the entries added
+  after the mirror was last brought up to date.
+
+  @param[in]  Context             UNUSED
+
+  @retval  UNIT_TEST_PASSED             The Unit test has completed and the test
+                                        case was successful.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A test case assertion has failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+TestSelMirrorMidLogWalk (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS  Status;
+  SEL_RECORD  Record;
+  UINT16      RecordId;
+  UINT32      Count;
+
+  Status = SelClear (TRUE);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  Status = AddTestEntries (0, TEST_SEL_APPENDED);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+
+  //
+  // Load the mirror and note the record ID of the second entry.
+  //
+  Status = SelMirrorGetEntry (0, &Record, &RecordId);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  Status = WalkMirror (&Count);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (Count, TEST_SEL_APPENDED);
+
+  Status = AddTestEntries (TEST_SEL_APPENDED, TEST_SEL_APPENDED);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+
+  Count = 1;
+  do {
+    Status = SelMirrorGetEntry (RecordId, &Record, &RecordId);
+    UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+    UT_ASSERT_EQUAL (Record.Record.OemNonTimestamped.Data[0], Count);
+    Count++;
+  } while (RecordId != SEL_LAST_RECORD_ID);
+
+  UT_ASSERT_EQUAL (Count, 2 * TEST_SEL_APPENDED);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Counts the records matching a query, checking that they are returned in
+  time stamp order when the query has a time stamp range.
+
+  @param[in,out]  Query     The query.
+  @param[out]     Count     Receives the number of matching records.
+
+  @retval   EFI_SUCCESS           The query was run.
+  @retval   EFI_PROTOCOL_ERROR    A record is out of time stamp order.
+  @retval   Other                 The query failed.
+**/
+EFI_STATUS
+CountMatches (
+  IN OUT SEL_QUERY  *Query,
+  OUT UINT32        *Count
+  )
+{
+  EFI_STATUS  Status;
+  SEL_RECORD  Record;
+  UINT32      TimeStamp;
+
+  *Count    = 0;
+  TimeStamp = 0;
+  Status    = SelMirrorStartQuery (Query);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  while (TRUE) {
+    Status = SelMirrorGetNextMatch (Query, &Record);
+    if (Status == EFI_NOT_FOUND) {
+      return EFI_SUCCESS;
+    }
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    if ((Query->Fields & SEL_QUERY_TIME_STAMP) != 0) {
+      if (Record.Record.System.TimeStamp < TimeStamp) {
+        return EFI_PROTOCOL_ERROR;
+      }
+
+      TimeStamp = Record.Record.System.TimeStamp;
+    }
+
+    (*Count)++;
+  }
+}
+
+/**
+  Tests querying the SEL by record type, sensor, manufacturer and time stamp.
+
+  @param[in]  Context             UNUSED
+
+  @retval  UNIT_TEST_PASSED             The Unit test has completed and the test
+                                        case was successful.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A test case assertion has failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+TestSelQuery (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS  Status;
+  SEL_QUERY   Query;
+  SEL_QUERY   Cleared;
+  SEL_RECORD  Record;
+  UINT8       ManufacturerA[3] = { 1, 2, 3 };
+  UINT8       ManufacturerB[3] = { 4, 5, 6 };
+  UINT8       Data[6] = { 0 };
+  UINT16      RecordId;
+  UINT32      TimeStamps[5];
+  UINT32      Commands;
+  UINT32      Count;
+  UINT8       Index;
+
+  Status = SelClear (TRUE);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+
+  //
+  // Five processor events on sensors 1 and 2, four memory events, three OEM
+  // events of two manufacturers and the usual non-timestamped entries.
+  //
+  for (Index = 0; Index < 5; Index++) {
+    Status = SelAddSystemEntry (&RecordId, 0x07, (Index < 3) ? 1 : 2, 0x6F, Index, 0, 0);
+    UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+    Status = SelMirrorGetEntry (RecordId, &Record, NULL);
+    UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+    TimeStamps[Index] = Record.Record.System.TimeStamp;
+  }
+
+  for (Index = 0; Index < 4; Index++) {
+    Status = SelAddSystemEntry (&RecordId, 0x0C, 3, 0x6F, Index, 0, 0);
+    UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  }
+
+  Status = SelAddOemEntryEx (&RecordId, 0xC1, ManufacturerA, Data);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  Status = SelAddOemEntryEx (&RecordId, 0xC1, ManufacturerB, Data);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  Status = SelAddOemEntryEx (&RecordId, 0xC2, ManufacturerA, Data);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  Status = AddTestEntries (0, TEST_SEL_APPENDED);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+
+  //
+  // Running a query only checks the SEL information.
+  //
+  ZeroMem (&Query, sizeof (Query));
+  Query.Fields     = SEL_QUERY_SENSOR_TYPE;
+  Query.SensorType = 0x07;
+  Status           = CountMatches (&Query, &Count);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (Count, 5);
+
+  Commands = MockIpmiGetCommandCount ();
+  Status   = CountMatches (&Query, &Count);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (Count, 5);
+  UT_ASSERT_EQUAL (MockIpmiGetCommandCount () - Commands, 1);
+
+  Query.Fields      |= SEL_QUERY_SENSOR_NUMBER | SEL_QUERY_GENERATOR_ID;
+  Query.SensorNumber = 2;
+  Query.GeneratorId  = IPMI_SOFTWARE_ID;
+  Status             = CountMatches (&Query, &Count);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (Count, 2);
+
+  Query.Fields     = SEL_QUERY_SENSOR_TYPE;
+  Query.SensorType = 0x55;
+  Status           = CountMatches (&Query, &Count);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (Count, 0);
+
+  ZeroMem (&Query, sizeof (Query));
+  Query.Fields = SEL_QUERY_MANUFACTURER_ID;
+  CopyMem (Query.ManufacturerId, ManufacturerA, sizeof (ManufacturerA));
+  Status = CountMatches (&Query, &Count);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (Count, 2);
+
+  Query.Fields    |= SEL_QUERY_RECORD_TYPE;
+  Query.RecordType = 0xC2;
+  Status           = CountMatches (&Query, &Count);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (Count, 1);
+
+  ZeroMem (&Query, sizeof (Query));
+  Query.Fields     = SEL_QUERY_RECORD_TYPE;
+  Query.RecordType = 0xE0;
+  Status           = CountMatches (&Query, &Count);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (Count, TEST_SEL_APPENDED);
+
+  //
+  // The time stamp range includes both ends and skips non-timestamped
+  // entries.
+  //
+  ZeroMem (&Query, sizeof (Query));
+  Query.Fields    = SEL_QUERY_TIME_STAMP;
+  Query.StartTime = TimeStamps[1];
+  Query.EndTime   = TimeStamps[3];
+  Status          = CountMatches (&Query, &Count);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (Count, 3);
+
+  Query.EndTime = MAX_UINT32;
+  Status        = CountMatches (&Query, &Count);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (Count, 12 - 1);
+
+  Query.Fields    |= SEL_QUERY_SENSOR_TYPE;
+  Query.SensorType = 0x0C;
+  Status           = CountMatches (&Query, &Count);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (Count, 4);
+
+  //
+  // A query started before the SEL was cleared is abandoned.
+  //
+  ZeroMem (&Cleared, sizeof (Cleared));
+  Status = SelMirrorStartQuery (&Cleared);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  Status = SelClear (TRUE);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  Status = CountMatches (&Query, &Count);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (Count, 0);
+  Status = SelMirrorGetNextMatch (&Cleared, &Record);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_ABORTED);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Initializes and configures the IPMI SEL module tests.
+
+  @retval  EFI_SUCCESS           All test cases were dispatched.
+  @retval  EFI_OUT_OF_RESOURCES  There are not enough resources available to
+                                 initialize the unit tests.
+**/
+EFI_STATUS
+EFIAPI
+IpmiSelTestMain (
+  VOID
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+  UNIT_TEST_SUITE_HANDLE      SelTests;
+
+  Framework = NULL;
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_NAME, UNIT_TEST_VERSION));
+
+  //
+  // Start setting up the test framework for running the tests.
+  //
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_NAME, gEfiCallerBaseName, UNIT_TEST_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  //
+  // Populate the IPMI SEL Module Test Suite.
+  //
+  Status = CreateUnitTestSuite (&SelTests, Framework, "IPMI SEL Module Tests", "IPMI.SEL.MODULE", NULL, NULL);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for SelTests\n"));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  AddTestCase (SelTests, "Tests loading the SEL mirror", "TestSelMirrorLoad", TestSelMirrorLoad, NULL, NULL, NULL);
+  AddTestCase (SelTests, "Tests appending to the SEL mirror", "TestSelMirrorAppend", TestSelMirrorAppend, NULL, NULL, NULL);
+  AddTestCase (SelTests, "Tests reloading the SEL mirror after a clear", "TestSelMirrorClear", TestSelMirrorClear, NULL, NULL, NULL);
+  AddTestCase (SelTests, "Tests a walk from the middle of the SEL finds new entries", "TestSelMirrorMidLogWalk", TestSelMirrorMidLogWalk, NULL, NULL, NULL);
+  AddTestCase (SelTests, "Tests querying the SEL through the index", "TestSelQuery", TestSelQuery, NULL, NULL, NULL);
+
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return Status;
+}
+
+/**
+  Standard POSIX C entry point for host based unit test execution.
+**/
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+{
+  return IpmiSelTestMain ();
+}
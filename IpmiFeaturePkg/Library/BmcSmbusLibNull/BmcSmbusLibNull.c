@@ -56,6 +56,21 @@ BmcSmbusBlockWrite (
   return EFI_SUCCESS;
 }
 
+/**
+  NULL implementation of the SMBALERT# wait.
+
+  @param[in]  Timeout             UNUSED.
+
+  @retval   EFI_UNSUPPORTED       Always.
+**/
+EFI_STATUS
+BmcSmbusWaitForAlert (
+  UINTN  Timeout
+  )
+{
+  return EFI_UNSUPPORTED;
+}
+
 /**
   NULL implementation of the SMBus read routine.
 
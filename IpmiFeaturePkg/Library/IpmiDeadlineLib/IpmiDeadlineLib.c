@@ -0,0 +1,130 @@
+/** @file
+  Time budgets for IPMI transactions measured with the performance counter.
+
+  Copyright (c) Microsoft Corporation
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include <Base.h>
+#include <Library/BaseLib.h>
+#include <Library/TimerLib.h>
+#include <Library/IpmiDeadlineLib.h>
+
+/**
+  Gets the performance counter ticks between two counter values, taking the
+  direction of the counter and a single wrap into account.
+
+  @param[in]  CounterStart    The start value of the counter, as returned by
+                              GetPerformanceCounterProperties.
+  @param[in]  CounterEnd      The end value of the counter, as returned by
+                              GetPerformanceCounterProperties.
+  @param[in]  Earlier         The earlier counter value.
+  @param[in]  Later           The later counter value.
+
+  @retval   The ticks from Earlier to Later.
+**/
+UINT64
+EFIAPI
+IpmiCounterTicksBetween (
+  IN UINT64  CounterStart,
+  IN UINT64  CounterEnd,
+  IN UINT64  Earlier,
+  IN UINT64  Later
+  )
+{
+  if (CounterEnd >= CounterStart) {
+    if (Later >= Earlier) {
+      return Later - Earlier;
+    }
+
+    return (CounterEnd - Earlier) + (Later - CounterStart) + 1;
+  }
+
+  if (Later <= Earlier) {
+    return Earlier - Later;
+  }
+
+  return (Earlier - CounterEnd) + (CounterStart - Later) + 1;
+}
+
+/**
+  Starts a deadline.
+
+  @param[out] Deadline    The deadline to start.
+  @param[in]  TimeoutUs   The time budget in microseconds.
+**/
+VOID
+EFIAPI
+IpmiDeadlineStart (
+  OUT IPMI_DEADLINE  *Deadline,
+  IN  UINT64         TimeoutUs
+  )
+{
+  UINT64  Frequency;
+
+  Frequency = GetPerformanceCounterProperties (&Deadline->CounterStart, &Deadline->CounterEnd);
+
+  Deadline->Elapsed = 0;
+  if (Frequency == 0) {
+    Deadline->CountDelays = TRUE;
+    Deadline->Budget      = TimeoutUs;
+    Deadline->Last        = 0;
+    return;
+  }
+
+  Deadline->CountDelays = FALSE;
+  if (TimeoutUs > DivU64x64Remainder (MAX_UINT64, Frequency, NULL)) {
+    Deadline->Budget = MAX_UINT64;
+  } else {
+    Deadline->Budget = DivU64x32 (MultU64x64 (TimeoutUs, Frequency), 1000 * 1000);
+  }
+
+  Deadline->Last = GetPerformanceCounter ();
+}
+
+/**
+  Checks whether a deadline has passed. The elapsed time is accumulated on
+  every check, so counters that wrap within the budget are handled.
+
+  @param[in,out]  Deadline    The deadline to check.
+
+  @retval   TRUE      The time budget has been used.
+  @retval   FALSE     Time remains.
+**/
+BOOLEAN
+EFIAPI
+IpmiDeadlineExpired (
+  IN OUT IPMI_DEADLINE  *Deadline
+  )
+{
+  UINT64  Now;
+
+  if (Deadline->CountDelays) {
+    return (BOOLEAN)(Deadline->Elapsed >= Deadline->Budget);
+  }
+
+  Now                = GetPerformanceCounter ();
+  Deadline->Elapsed += IpmiCounterTicksBetween (Deadline->CounterStart, Deadline->CounterEnd, Deadline->Last, Now);
+  Deadline->Last     = Now;
+  return (BOOLEAN)(Deadline->Elapsed >= Deadline->Budget);
+}
+
+/**
+  Delays for a number of microseconds, counting the delay against the
+  deadline when there is no performance counter to measure it.
+
+  @param[in,out]  Deadline    The deadline the delay is made for.
+  @param[in]      DelayUs     The delay in microseconds.
+**/
+VOID
+EFIAPI
+IpmiDeadlineDelay (
+  IN OUT IPMI_DEADLINE  *Deadline,
+  IN     UINTN          DelayUs
+  )
+{
+  MicroSecondDelay (DelayUs);
+  if (Deadline->CountDelays) {
+    Deadline->Elapsed += DelayUs;
+  }
+}
@@ -0,0 +1,470 @@
+/** @file
+  Coalescing of repeated system events added to the SEL. Duplicates of an event
+  within PcdIpmiSelCoalesceSeconds are counted instead of being added, and the
+  count is added afterwards as a single OEM summary record. Events of a sensor
+  type are further limited to a number per window by PcdIpmiSelRateLimits.
+  Windows that are over are summarized on the next event added, whatever its
+  key, and the windows still open by SelFlush.
+
+  Copyright (c) Microsoft Corporation
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/IpmiDeadlineLib.h>
+#include <Library/PcdLib.h>
+#include <Library/TimerLib.h>
+
+#include <IndustryStandard/Ipmi.h>
+
+#include "IpmiSelLibInternal.h"
+
+STATIC_ASSERT (
+  sizeof (SEL_COALESCE_SUMMARY) == 6,
+  "Unexpected SEL summary size!"
+  );
+
+//
+// Number of recent events and of sensor types tracked. Events are hashed into
+// the event slots, a different event hashing to a busy slot replaces it.
+//
+#define SEL_COALESCE_SLOTS  16
+#define SEL_RATE_SLOTS      8
+
+//
+// The most summaries a single event can complete, one for every slot.
+//
+#define SEL_COALESCE_MAX_SUMMARIES  (SEL_COALESCE_SLOTS + SEL_RATE_SLOTS)
+
+//
+// The fields identifying an event, all of which are kept in its summary.
+// Events with the same key are duplicates, so events differing only in event
+// data 2 and 3, such as the reading of a threshold event, are counted together.
+//
+typedef struct {
+  UINT8    SensorType;
+  UINT8    SensorNumber;
+  UINT8    EventDirType;
+  UINT8    EventData1;
+} SEL_COALESCE_KEY;
+
+typedef struct {
+  SEL_COALESCE_KEY    Key;
+  BOOLEAN             InUse;
+  UINT16              Suppressed;
+  UINT64              Start;
+} SEL_COALESCE_SLOT;
+
+typedef struct {
+  UINT8      SensorType;
+  BOOLEAN    InUse;
+  UINT16     Passed;
+  UINT16     Dropped;
+  UINT64     Start;
+} SEL_RATE_SLOT;
+
+typedef struct {
+  BOOLEAN              Initialized;
+  UINT64               CounterStart;
+  UINT64               CounterEnd;
+  UINT64               Window;
+  SEL_COALESCE_SLOT    Events[SEL_COALESCE_SLOTS];
+  SEL_RATE_SLOT        Rates[SEL_RATE_SLOTS];
+} SEL_COALESCE_STATE;
+
+STATIC SEL_COALESCE_STATE  mCoalesce;
+
+/**
+  Sets up the window from the performance counter. Without a performance
+  counter the window is 0 and no event is suppressed.
+**/
+STATIC
+VOID
+SelCoalesceInitialize (
+  VOID
+  )
+{
+  UINT64  Frequency;
+
+  Frequency = GetPerformanceCounterProperties (&mCoalesce.CounterStart, &mCoalesce.CounterEnd);
+
+  mCoalesce.Window      = MultU64x32 (Frequency, FixedPcdGet8 (PcdIpmiSelCoalesceSeconds));
+  mCoalesce.Initialized = TRUE;
+}
+
+/**
+  Gets the time passed since a performance counter value, for counters
+  counting in either direction and across a wrap of the counter.
+
+  @param[in]  Start   The earlier performance counter value.
+  @param[in]  Now     The current performance counter value.
+
+  @retval   The elapsed performance counter ticks.
+**/
+STATIC
+UINT64
+SelCoalesceElapsed (
+  IN UINT64  Start,
+  IN UINT64  Now
+  )
+{
+  return IpmiCounterTicksBetween (mCoalesce.CounterStart, mCoalesce.CounterEnd, Start, Now);
+}
+
+/**
+  Hashes an event key with FNV-1a.
+
+  @param[in]  Key   The event key.
+
+  @retval   The hash of the key.
+**/
+STATIC
+UINT32
+SelCoalesceHash (
+  IN CONST SEL_COALESCE_KEY  *Key
+  )
+{
+  CONST UINT8  *Bytes;
+  UINT32       Hash;
+  UINTN        Index;
+
+  Bytes = (CONST UINT8 *)Key;
+  Hash  = 0x811C9DC5;
+  for (Index = 0; Index < sizeof (*Key); Index++) {
+    Hash = (Hash ^ Bytes[Index]) * 0x01000193;
+  }
+
+  return Hash;
+}
+
+/**
+  Fills in a summary record.
+
+  @param[out] Summary       The summary to fill in.
+  @param[in]  SensorType    The sensor type of the events.
+  @param[in]  Key           The suppressed event, or NULL for events dropped by
+                            the rate limit of the sensor type.
+  @param[in]  Count         The number of events that were not added.
+**/
+STATIC
+VOID
+SelCoalesceSummarize (
+  OUT SEL_COALESCE_SUMMARY   *Summary,
+  IN UINT8                   SensorType,
+  IN CONST SEL_COALESCE_KEY  *Key OPTIONAL,
+  IN UINT16                  Count
+  )
+{
+  Summary->SensorType = SensorType;
+  Summary->Count      = Count;
+  if (Key != NULL) {
+    Summary->SensorNumber = Key->SensorNumber;
+    Summary->EventDirType = Key->EventDirType;
+    Summary->EventData1   = Key->EventData1;
+  } else {
+    Summary->SensorNumber = SEL_COALESCE_RATE_LIMITED;
+    Summary->EventDirType = SEL_COALESCE_RATE_LIMITED;
+    Summary->EventData1   = SEL_COALESCE_RATE_LIMITED;
+  }
+}
+
+/**
+  Adds summary records to the SEL.
+
+  @param[in]  Summaries     The summaries to add.
+  @param[in]  Count         The number of summaries.
+**/
+STATIC
+VOID
+SelCoalesceReport (
+  IN SEL_COALESCE_SUMMARY  *Summaries,
+  IN UINTN                 Count
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       Index;
+
+  for (Index = 0; Index < Count; Index++) {
+    DEBUG ((
+      DEBUG_INFO,
+      "%a: %d events of sensor type 0x%x number 0x%x were not added.\n",
+      __FUNCTION__,
+      Summaries[Index].Count,
+      Summaries[Index].SensorType,
+      Summaries[Index].SensorNumber
+      ));
+
+    Status = SelAddOemEntry (NULL, FixedPcdGet8 (PcdIpmiSelCoalesceRecordType), (UINT8 *)&Summaries[Index]);
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_ERROR, "%a: Failed to add SEL summary. %r\n", __FUNCTION__, Status));
+    }
+  }
+}
+
+/**
+  Closes windows, summarizing the events each of them did not add.
+
+  @param[in]      All           TRUE to close all windows, FALSE to only close
+                                the windows that are over.
+  @param[in]      Now           The current performance counter value.
+  @param[out]     Summaries     Receives the summaries of the closed windows.
+  @param[in,out]  SummaryCount  The number of summaries in Summaries.
+**/
+STATIC
+VOID
+SelCoalesceClose (
+  IN BOOLEAN                All,
+  IN UINT64                 Now,
+  OUT SEL_COALESCE_SUMMARY  *Summaries,
+  IN OUT UINTN              *SummaryCount
+  )
+{
+  SEL_COALESCE_SLOT  *Event;
+  SEL_RATE_SLOT      *Rate;
+  UINTN              Index;
+
+  for (Index = 0; Index < SEL_COALESCE_SLOTS; Index++) {
+    Event = &mCoalesce.Events[Index];
+    if (!Event->InUse || (!All && (SelCoalesceElapsed (Event->Start, Now) < mCoalesce.Window))) {
+      continue;
+    }
+
+    if (Event->Suppressed != 0) {
+      SelCoalesceSummarize (&Summaries[(*SummaryCount)++], Event->Key.SensorType, &Event->Key, Event->Suppressed);
+    }
+
+    Event->InUse = FALSE;
+  }
+
+  for (Index = 0; Index < SEL_RATE_SLOTS; Index++) {
+    Rate = &mCoalesce.Rates[Index];
+    if (!Rate->InUse || (!All && (SelCoalesceElapsed (Rate->Start, Now) < mCoalesce.Window))) {
+      continue;
+    }
+
+    if (Rate->Dropped != 0) {
+      SelCoalesceSummarize (&Summaries[(*SummaryCount)++], Rate->SensorType, NULL, Rate->Dropped);
+    }
+
+    Rate->InUse = FALSE;
+  }
+}
+
+/**
+  Finds the rate limit for a sensor type in PcdIpmiSelRateLimits.
+
+  @param[in]  SensorType    The sensor type.
+  @param[out] MaxEvents     Receives the events allowed per window.
+
+  @retval TRUE    The sensor type is rate limited.
+  @retval FALSE   The sensor type has no rate limit.
+**/
+STATIC
+BOOLEAN
+SelRateLimitLookup (
+  IN UINT8   SensorType,
+  OUT UINT8  *MaxEvents
+  )
+{
+  CONST SEL_RATE_LIMIT  *Limit;
+  UINTN                 Count;
+  UINTN                 Index;
+
+  Limit = (CONST SEL_RATE_LIMIT *)PcdGetPtr (PcdIpmiSelRateLimits);
+  Count = PcdGetSize (PcdIpmiSelRateLimits) / sizeof (SEL_RATE_LIMIT);
+
+  for (Index = 0; Index < Count; Index++, Limit++) {
+    if ((Limit->SensorType == SEL_RATE_LIMIT_ANY) || (Limit->SensorType == SensorType)) {
+      *MaxEvents = Limit->MaxEvents;
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+/**
+  Applies the rate limit of its sensor type to an event that is not a
+  duplicate.
+
+  @param[in]      SensorType    The sensor type of the event.
+  @param[in]      Now           The current performance counter value.
+  @param[out]     Summaries     Receives the summary of the window the event
+                                completes, if any.
+  @param[in,out]  SummaryCount  The number of summaries in Summaries.
+
+  @retval TRUE    The event is over the rate limit and must be dropped.
+  @retval FALSE   The event may be added.
+**/
+STATIC
+BOOLEAN
+SelRateLimitEntry (
+  IN UINT8                  SensorType,
+  IN UINT64                 Now,
+  OUT SEL_COALESCE_SUMMARY  *Summaries,
+  IN OUT UINTN              *SummaryCount
+  )
+{
+  SEL_RATE_SLOT  *Rate;
+  SEL_RATE_SLOT  *Slot;
+  UINT8          MaxEvents;
+  UINTN          Index;
+
+  if (!SelRateLimitLookup (SensorType, &MaxEvents)) {
+    return FALSE;
+  }
+
+  //
+  // Use the slot of the sensor type, or else a free slot, or else replace the
+  // slot with the oldest window.
+  //
+  Rate = NULL;
+  for (Index = 0; Index < SEL_RATE_SLOTS; Index++) {
+    Slot = &mCoalesce.Rates[Index];
+    if (Slot->InUse && (Slot->SensorType == SensorType)) {
+      Rate = Slot;
+      break;
+    }
+
+    if (!Slot->InUse && (Rate == NULL)) {
+      Rate = Slot;
+    }
+  }
+
+  if (Rate == NULL) {
+    Rate = &mCoalesce.Rates[0];
+    for (Index = 1; Index < SEL_RATE_SLOTS; Index++) {
+      Slot = &mCoalesce.Rates[Index];
+      if (SelCoalesceElapsed (Slot->Start, Now) > SelCoalesceElapsed (Rate->Start, Now)) {
+        Rate = Slot;
+      }
+    }
+  }
+
+  if (!Rate->InUse || (Rate->SensorType != SensorType)) {
+    if (Rate->InUse && (Rate->Dropped != 0)) {
+      SelCoalesceSummarize (&Summaries[(*SummaryCount)++], Rate->SensorType, NULL, Rate->Dropped);
+    }
+
+    Rate->SensorType = SensorType;
+    Rate->InUse      = TRUE;
+    Rate->Passed     = 0;
+    Rate->Dropped    = 0;
+    Rate->Start      = Now;
+  }
+
+  if (Rate->Passed >= MaxEvents) {
+    if (Rate->Dropped < MAX_UINT16) {
+      Rate->Dropped++;
+    }
+
+    return TRUE;
+  }
+
+  Rate->Passed++;
+  return FALSE;
+}
+
+/**
+  Checks whether a system event should be added to the SEL. Duplicates of an
+  event added within the window are counted instead, as are events over the
+  rate limit of their sensor type. Windows that are over get their counts
+  added to the SEL as summary records before the event is added.
+
+  @param[in]  Entry   The system event to be added to the SEL.
+
+  @retval TRUE    The event was counted and must not be added.
+  @retval FALSE   The event must be added.
+**/
+BOOLEAN
+SelCoalesceEntry (
+  IN SEL_RECORD  *Entry
+  )
+{
+  SEL_COALESCE_SUMMARY  Summaries[SEL_COALESCE_MAX_SUMMARIES];
+  UINTN                 SummaryCount;
+  SEL_COALESCE_KEY      Key;
+  SEL_COALESCE_SLOT     *Slot;
+  BOOLEAN               Suppress;
+  UINT64                Now;
+  UINTN                 Lock;
+
+  if (FixedPcdGet8 (PcdIpmiSelCoalesceSeconds) == 0) {
+    return FALSE;
+  }
+
+  Key.SensorType   = Entry->Record.System.SensorType;
+  Key.SensorNumber = Entry->Record.System.SensorNumber;
+  Key.EventDirType = Entry->Record.System.EventDirType;
+  Key.EventData1   = Entry->Record.System.Data[0];
+
+  SummaryCount = 0;
+  Suppress     = FALSE;
+
+  Lock = SelLock ();
+  if (!mCoalesce.Initialized) {
+    SelCoalesceInitialize ();
+  }
+
+  Now = GetPerformanceCounter ();
+  SelCoalesceClose (FALSE, Now, Summaries, &SummaryCount);
+
+  Slot = &mCoalesce.Events[SelCoalesceHash (&Key) % SEL_COALESCE_SLOTS];
+  if (Slot->InUse && (CompareMem (&Slot->Key, &Key, sizeof (Key)) == 0)) {
+    if (Slot->Suppressed < MAX_UINT16) {
+      Slot->Suppressed++;
+    }
+
+    Suppress = TRUE;
+  } else if (SelRateLimitEntry (Key.SensorType, Now, Summaries, &SummaryCount)) {
+    Suppress = TRUE;
+  } else {
+    //
+    // The event starts a new window in its slot, closing the window of the
+    // event that was there.
+    //
+    if (Slot->InUse && (Slot->Suppressed != 0)) {
+      SelCoalesceSummarize (&Summaries[SummaryCount++], Slot->Key.SensorType, &Slot->Key, Slot->Suppressed);
+    }
+
+    CopyMem (&Slot->Key, &Key, sizeof (Key));
+    Slot->InUse      = TRUE;
+    Slot->Suppressed = 0;
+    Slot->Start      = Now;
+  }
+
+  SelUnlock (Lock);
+
+  SelCoalesceReport (Summaries, SummaryCount);
+  return Suppress;
+}
+
+/**
+  Adds the counts of all open windows to the SEL as summary records and
+  forgets the recent events.
+**/
+VOID
+SelCoalesceFlush (
+  VOID
+  )
+{
+  SEL_COALESCE_SUMMARY  Summaries[SEL_COALESCE_MAX_SUMMARIES];
+  UINTN                 SummaryCount;
+  UINTN                 Lock;
+
+  if (FixedPcdGet8 (PcdIpmiSelCoalesceSeconds) == 0) {
+    return;
+  }
+
+  SummaryCount = 0;
+
+  Lock = SelLock ();
+  SelCoalesceClose (TRUE, 0, Summaries, &SummaryCount);
+  SelUnlock (Lock);
+
+  SelCoalesceReport (Summaries, SummaryCount);
+}
@@ -0,0 +1,38 @@
+/** @file
+  SEL event coalescing for modules that must not keep state between calls,
+  such as PEIMs running from ROM. Every system event is added to the SEL.
+
+  Copyright (c) Microsoft Corporation
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+
+#include "IpmiSelLibInternal.h"
+
+/**
+  Checks whether a system event should be added to the SEL.
+
+  @param[in]  Entry   The system event to be added to the SEL.
+
+  @retval FALSE   The event must be added.
+**/
+BOOLEAN
+SelCoalesceEntry (
+  IN SEL_RECORD  *Entry
+  )
+{
+  return FALSE;
+}
+
+/**
+  Adds the counts of all open windows to the SEL as summary records. No
+  events are ever counted.
+**/
+VOID
+SelCoalesceFlush (
+  VOID
+  )
+{
+}
@@ -16,6 +16,8 @@
 #include <Library/IpmiBaseLib.h>
 #include <Library/IpmiSelLib.h>
 
+#include "IpmiSelLibInternal.h"
+
 //
 // All SEL entries are the same size and exactly 16 bytes.
 //
@@ -41,6 +43,45 @@ STATIC_ASSERT (
   "Unexpected SEL entry size!"
   );
 
+//
+// The number of times a walk through the SEL reserves it again when a read
+// is refused for a canceled reservation, before giving up.
+//
+
+#define SEL_RESERVATION_RETRIES  (3)
+
+#pragma pack(1)
+
+//
+// Response of the reserve SEL command.
+//
+
+typedef struct {
+  UINT8     CompletionCode;
+  UINT16    ReservationId;
+} SEL_RESERVE_RESPONSE;
+
+#pragma pack()
+
+//
+// State of a walk through the SEL, kept in the private part of SEL_ITERATOR.
+//
+
+typedef struct {
+  SEL_RECORD    *Window;
+  UINT16        WindowSize;
+  UINT16        Count;
+  UINT16        Index;
+  UINT16        ReservationId;
+  UINT16        NextRecordId;
+  BOOLEAN       EndOfLog;
+} SEL_ITERATOR_STATE;
+
+STATIC_ASSERT (
+  sizeof (SEL_ITERATOR_STATE) <= sizeof (((SEL_ITERATOR *)NULL)->Private),
+  "SEL iterator state does not fit SEL_ITERATOR!"
+  );
+
 /**
   Converts a IPMI completion code to a EFI status code.
 
@@ -98,20 +139,67 @@ IpmiCompCodeToEfiStatus (
 }
 
 /**
-  Adds a generic entry to the SEL.
+  Checks the response of the BMC to an Add SEL Entry command.
+
+  @param[in]      Response    The response of the BMC.
+  @param[in]      DataSize    The size of the response.
+  @param[in,out]  RecordId    If provided, receives the record ID of the entry.
+
+  @retval   EFI_SUCCESS         The entry was successfully added.
+  @retval   EFI_PROTOCOL_ERROR  Unexpected result size.
+  @retval   Other               The BMC returned a failing completion code.
+**/
+EFI_STATUS
+SelCheckAddResponse (
+  IN IPMI_ADD_SEL_ENTRY_RESPONSE  *Response,
+  IN UINT32                       DataSize,
+  IN OUT UINT16                   *RecordId OPTIONAL
+  )
+{
+  EFI_STATUS  Status;
+
+  if (DataSize < sizeof (Response->CompletionCode)) {
+    DEBUG ((DEBUG_ERROR, "%a: Response too small for completion code!\n", __FUNCTION__));
+    return EFI_PROTOCOL_ERROR;
+  }
+
+  Status = IpmiCompCodeToEfiStatus (Response->CompletionCode);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((
+      DEBUG_ERROR,
+      "%a: Add SEL event returned failing completion code. (0x%x) %r\n",
+      __FUNCTION__,
+      Response->CompletionCode,
+      Status
+      ));
+
+    return Status;
+  }
+
+  if (DataSize < sizeof (*Response)) {
+    DEBUG ((DEBUG_ERROR, "%a: Response too small for add SEL entry response.\n", __FUNCTION__));
+    return EFI_PROTOCOL_ERROR;
+  }
+
+  if (RecordId != NULL) {
+    *RecordId = Response->RecordId;
+  }
+
+  return Status;
+}
+
+/**
+  Sends an entry to the BMC and waits for it to be added to the SEL.
 
   @param[in]      Entry       The entry to be added to the SEL.
-  @param[in]      EntrySize   The size of the entry in bytes.
   @param[in,out]  RecordId    If provided, receives the record ID of the entry.
 
   @retval   EFI_SUCCESS         The entry was successfully added.
   @retval   EFI_PROTOCOL_ERROR  Unexpected result size.
   @retval   Other               The IPMI base library returned an error.
 **/
-STATIC
 EFI_STATUS
-EFIAPI
-IpmiAddSelEntry (
+SelSendEntry (
   IN SEL_RECORD  *Entry,
   IN OUT UINT16  *RecordId OPTIONAL
   )
@@ -137,34 +225,69 @@ IpmiAddSelEntry (
     return Status;
   }
 
-  if (DataSize < sizeof (Response.CompletionCode)) {
-    DEBUG ((DEBUG_ERROR, "%a: Response too small for completion code!\n", __FUNCTION__));
-    return EFI_PROTOCOL_ERROR;
-  }
+  return SelCheckAddResponse (&Response, DataSize, RecordId);
+}
 
-  Status = IpmiCompCodeToEfiStatus (Response.CompletionCode);
-  if (EFI_ERROR (Status)) {
-    DEBUG ((
-      DEBUG_ERROR,
-      "%a: Add SEL event returned failing completion code. (0x%x) %r\n",
-      __FUNCTION__,
-      Response.CompletionCode,
-      Status
-      ));
+/**
+  Adds a generic entry to the SEL. Entries added without asking for the record
+  ID are queued if the library instance has a SEL entry queue.
+
+  @param[in]      Entry       The entry to be added to the SEL.
+  @param[in,out]  RecordId    If provided, receives the record ID of the entry.
+
+  @retval   EFI_SUCCESS           The entry was successfully added or queued.
+  @retval   EFI_OUT_OF_RESOURCES  The queue is full and the entry was dropped.
+  @retval   EFI_NOT_READY         The record ID was asked for while the queue
+                                  is being drained at a lower TPL.
+  @retval   EFI_PROTOCOL_ERROR    Unexpected result size.
+  @retval   Other                 The IPMI base library returned an error.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+IpmiAddSelEntry (
+  IN SEL_RECORD  *Entry,
+  IN OUT UINT16  *RecordId OPTIONAL
+  )
+{
+  EFI_STATUS  Status;
 
+  if ((RecordId == NULL) && SelQueueEntry (Entry, &Status)) {
     return Status;
   }
 
-  if (DataSize < sizeof (Response)) {
-    DEBUG ((DEBUG_ERROR, "%a: Response too small for add SEL entry response.\n", __FUNCTION__));
-    return EFI_PROTOCOL_ERROR;
+  //
+  // Send the queued entries first so the SEL keeps the order the entries
+  // were added in. An interrupted drain still owns the queue, and sending now
+  // would overtake its entries and reenter the transport in the middle of its
+  // transaction.
+  //
+
+  Status = SelQueueFlush ();
+  if (Status == EFI_ALREADY_STARTED) {
+    DEBUG ((DEBUG_WARN, "%a: SEL queue is being drained, entry not added.\n", __FUNCTION__));
+    return EFI_NOT_READY;
   }
 
-  if (RecordId != NULL) {
-    *RecordId = Response.RecordId;
-  }
+  return SelSendEntry (Entry, RecordId);
+}
 
-  return Status;
+/**
+  Adds the counts of coalesced events to the SEL and sends all queued entries
+  to the BMC.
+
+  @retval   EFI_SUCCESS           All queued entries were added to the SEL.
+  @retval   EFI_ALREADY_STARTED   The queue is being drained at a lower TPL.
+  @retval   Other                 An entry failed to be added to the SEL.
+**/
+EFI_STATUS
+EFIAPI
+SelFlush (
+  VOID
+  )
+{
+  SelCoalesceFlush ();
+  return SelQueueFlush ();
 }
 
 /**
@@ -179,6 +302,8 @@ IpmiAddSelEntry (
   @param[in]      Data2         OEM defined data part 2.
 
   @retval   EFI_SUCCESS     Event was successfully added to the SEL.
+  @retval   EFI_NOT_READY   RecordId was provided while queued entries are
+                            being sent at a lower TPL.
   @retval   Other           And error was returned by IpmiAddSelEntry.
 **/
 EFI_STATUS
@@ -207,6 +332,14 @@ SelAddSystemEntry (
   Entry.Record.System.Data[1]      = Data1;
   Entry.Record.System.Data[2]      = Data2;
 
+  //
+  // Only events added without asking for their record ID are coalesced, a
+  // suppressed event has no record ID to return.
+  //
+  if ((RecordId == NULL) && SelCoalesceEntry (&Entry)) {
+    return EFI_SUCCESS;
+  }
+
   return IpmiAddSelEntry (&Entry, RecordId);
 }
 
@@ -220,6 +353,8 @@ SelAddSystemEntry (
 
   @retval   EFI_SUCCESS             Event was successfully added to the SEL.
   @retval   EFI_INVALID_PARAMETER   Invalid RecordType was given.
+  @retval   EFI_NOT_READY           RecordId was provided while queued entries
+                                    are being sent at a lower TPL.
   @retval   Other                   And error was returned by IpmiAddSelEntry.
 **/
 EFI_STATUS
@@ -271,6 +406,8 @@ SelAddOemEntryEx (
 
   @retval   EFI_SUCCESS             Event was successfully added to the SEL.
   @retval   EFI_INVALID_PARAMETER   Invalid RecordType was given.
+  @retval   EFI_NOT_READY           RecordId was provided while queued entries
+                                    are being sent at a lower TPL.
   @retval   Other                   And error was returned by IpmiAddSelEntry.
 **/
 EFI_STATUS
@@ -296,6 +433,8 @@ SelAddOemEntry (
 
   @retval   EFI_SUCCESS             Event was successfully added to the SEL.
   @retval   EFI_INVALID_PARAMETER   Invalid RecordType was given.
+  @retval   EFI_NOT_READY           RecordId was provided while queued entries
+                                    are being sent at a lower TPL.
   @retval   Other                   And error was returned by IpmiAddSelEntry.
 **/
 EFI_STATUS
@@ -583,19 +722,25 @@ SelGetInfo (
 }
 
 /**
-  Gets information about the SEL.
+  Gets an entry of the SEL under a reservation.
 
+  A next record ID that points back at the entry read or at 0x0000 would walk
+  the SEL forever, so it is reported as SEL_LAST_RECORD_ID to end the walk.
+
+  @param[in]    ReservationId   The reservation ID, or 0 to read without one.
   @param[in]    RecordId        The record ID of the entry to retrieve.
   @param[out]   Record          Receives the record if found.
   @param[out]   NextRecordId    If provided, receives the next record ID.
 
   @retval   EFI_SUCCESS             The SEL entry was retrieved.
-  @retval   EFI_INVALID_PARAMETER   Record pointer is NULL.
+  @retval   EFI_ABORTED             The reservation was canceled.
+  @retval   EFI_PROTOCOL_ERROR      Unexpected result size.
   @retval   Other                   The IPMI base library returned an error.
 **/
+STATIC
 EFI_STATUS
-EFIAPI
-SelGetEntry (
+SelGetReservedEntry (
+  IN UINT16       ReservationId,
   IN UINT16       RecordId,
   OUT SEL_RECORD  *Record,
   OUT UINT16      *NextRecordId OPTIONAL
@@ -606,18 +751,14 @@ SelGetEntry (
   IPMI_GET_SEL_ENTRY_RESPONSE  Response;
   UINT32                       Size;
 
-  if (Record == NULL) {
-    DEBUG ((DEBUG_ERROR, "%a: Record parameter is NULL!\n", __FUNCTION__));
-    ASSERT (FALSE);
-    return EFI_INVALID_PARAMETER;
-  }
-
   ZeroMem (&Request, sizeof (Request));
   ZeroMem (&Response, sizeof (Response));
 
-  Request.SelRecID[0] = (UINT8)(RecordId & 0xFF);
-  Request.SelRecID[1] = (UINT8)((RecordId >> 8) & 0xFF);
-  Request.BytesToRead = 0xFF;
+  Request.ReserveId[0] = (UINT8)(ReservationId & 0xFF);
+  Request.ReserveId[1] = (UINT8)((ReservationId >> 8) & 0xFF);
+  Request.SelRecID[0]  = (UINT8)(RecordId & 0xFF);
+  Request.SelRecID[1]  = (UINT8)((RecordId >> 8) & 0xFF);
+  Request.BytesToRead  = 0xFF;
 
   Size   = sizeof (Response);
   Status = IpmiSubmitCommand (
@@ -634,6 +775,11 @@ SelGetEntry (
     return Status;
   }
 
+  if (Response.CompletionCode == IPMI_COMP_CODE_RESERVATION_CANCELED_OR_INVALID) {
+    DEBUG ((DEBUG_WARN, "%a: SEL reservation 0x%x was canceled.\n", __FUNCTION__, ReservationId));
+    return EFI_ABORTED;
+  }
+
   Status = IpmiCompCodeToEfiStatus (Response.CompletionCode);
   if (EFI_ERROR (Status)) {
     DEBUG ((
@@ -647,6 +793,27 @@ SelGetEntry (
     return Status;
   }
 
+  if (Size < sizeof (Response)) {
+    DEBUG ((DEBUG_ERROR, "%a: Response too small for get SEL entry response.\n", __FUNCTION__));
+    return EFI_PROTOCOL_ERROR;
+  }
+
+  if ((Response.NextSelRecordId != SEL_LAST_RECORD_ID) &&
+      ((Response.NextSelRecordId == 0) ||
+       (Response.NextSelRecordId == RecordId) ||
+       (Response.NextSelRecordId == Response.RecordData.RecordId)))
+  {
+    DEBUG ((
+      DEBUG_ERROR,
+      "%a: SEL entry 0x%x points back to 0x%x, ending the walk.\n",
+      __FUNCTION__,
+      Response.RecordData.RecordId,
+      Response.NextSelRecordId
+      ));
+
+    Response.NextSelRecordId = SEL_LAST_RECORD_ID;
+  }
+
   CopyMem (Record, &Response.RecordData, sizeof (SEL_RECORD));
   if (NextRecordId != NULL) {
     *NextRecordId = Response.NextSelRecordId;
@@ -654,3 +821,258 @@ SelGetEntry (
 
   return Status;
 }
+
+/**
+  Gets information about the SEL.
+
+  @param[in]    RecordId        The record ID of the entry to retrieve.
+  @param[out]   Record          Receives the record if found.
+  @param[out]   NextRecordId    If provided, receives the next record ID.
+
+  @retval   EFI_SUCCESS             The SEL entry was retrieved.
+  @retval   EFI_INVALID_PARAMETER   Record pointer is NULL.
+  @retval   EFI_PROTOCOL_ERROR      The BMC refused the read or returned an
+                                    unexpected result size.
+  @retval   Other                   The IPMI base library returned an error.
+**/
+EFI_STATUS
+EFIAPI
+SelGetEntry (
+  IN UINT16       RecordId,
+  OUT SEL_RECORD  *Record,
+  OUT UINT16      *NextRecordId OPTIONAL
+  )
+{
+  EFI_STATUS  Status;
+
+  if (Record == NULL) {
+    DEBUG ((DEBUG_ERROR, "%a: Record parameter is NULL!\n", __FUNCTION__));
+    ASSERT (FALSE);
+    return EFI_INVALID_PARAMETER;
+  }
+
+  //
+  // Single reads have no reservation to renew, so a canceled reservation
+  // stays a protocol error as it was before walks retried it.
+  //
+  Status = SelGetReservedEntry (0, RecordId, Record, NextRecordId);
+  if (Status == EFI_ABORTED) {
+    Status = EFI_PROTOCOL_ERROR;
+  }
+
+  return Status;
+}
+
+/**
+  Reserves the SEL for reads that the BMC only accepts under a reservation.
+
+  @param[out]   ReservationId   Receives the reservation ID.
+
+  @retval   EFI_SUCCESS         The SEL was reserved.
+  @retval   EFI_UNSUPPORTED     The BMC does not support reserving the SEL.
+  @retval   EFI_PROTOCOL_ERROR  Unexpected result size.
+  @retval   Other               The IPMI base library returned an error.
+**/
+STATIC
+EFI_STATUS
+SelReserve (
+  OUT UINT16  *ReservationId
+  )
+{
+  SEL_RESERVE_RESPONSE  Response;
+  EFI_STATUS            Status;
+  UINT32                DataSize;
+
+  DataSize                = sizeof (Response);
+  Response.CompletionCode = IPMI_COMP_CODE_UNSPECIFIED;
+  Status                  = IpmiSubmitCommand (
+                              IPMI_NETFN_STORAGE,
+                              IPMI_STORAGE_RESERVE_SEL,
+                              NULL,
+                              0,
+                              (VOID *)&Response,
+                              &DataSize
+                              );
+
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "%a: Failed to send reserve SEL command. %r\n", __FUNCTION__, Status));
+    return Status;
+  }
+
+  Status = IpmiCompCodeToEfiStatus (Response.CompletionCode);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (DataSize < sizeof (Response)) {
+    DEBUG ((DEBUG_ERROR, "%a: Response too small for reserve SEL response.\n", __FUNCTION__));
+    return EFI_PROTOCOL_ERROR;
+  }
+
+  *ReservationId = Response.ReservationId;
+  return EFI_SUCCESS;
+}
+
+/**
+  Reads the next records of a walk through the SEL into the window.
+
+  IPMI has no command returning several SEL entries and each read needs the
+  next record ID of the previous one, so the records are still read one at a
+  time. The window only groups those reads ahead of the caller consuming them.
+
+  Records are read whole, which needs no reservation. A BMC that refuses the
+  read with a canceled reservation is given a new one, and the walk resumes at
+  the same record, up to SEL_RESERVATION_RETRIES times per window. Records
+  fetched before an error are kept and the error is returned, so it is only
+  reported once they have been consumed.
+
+  @param[in,out]  State         The state of the walk.
+
+  @retval   EFI_SUCCESS             At least one record was read.
+  @retval   Other                   No record could be read.
+**/
+STATIC
+EFI_STATUS
+SelFillWindow (
+  IN OUT SEL_ITERATOR_STATE  *State
+  )
+{
+  EFI_STATUS  Status;
+  UINT8       Retries;
+
+  State->Count = 0;
+  State->Index = 0;
+  Retries      = 0;
+  Status       = EFI_SUCCESS;
+  while ((State->Count < State->WindowSize) && !State->EndOfLog) {
+    Status = SelGetReservedEntry (
+               State->ReservationId,
+               State->NextRecordId,
+               &State->Window[State->Count],
+               &State->NextRecordId
+               );
+
+    if ((Status == EFI_ABORTED) && (Retries < SEL_RESERVATION_RETRIES)) {
+      Retries++;
+      Status = SelReserve (&State->ReservationId);
+      if (EFI_ERROR (Status)) {
+        break;
+      }
+
+      continue;
+    }
+
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+
+    State->Count++;
+    State->EndOfLog = (State->NextRecordId == SEL_LAST_RECORD_ID);
+  }
+
+  if (State->Count > 0) {
+    return EFI_SUCCESS;
+  }
+
+  //
+  // A missing record ends the walk, including the first one of an empty SEL.
+  //
+  if (Status == EFI_NOT_FOUND) {
+    State->EndOfLog = TRUE;
+  }
+
+  return Status;
+}
+
+/**
+  Starts a walk through the SEL. Records are read one at a time along the next
+  record IDs, filling the window with as many records as fit each time it is
+  consumed.
+
+  @param[out]   Iterator        Receives the state of the walk.
+  @param[in]    RecordId        The record ID to start at, 0 for the first entry.
+  @param[in]    Window          The buffer to fetch records into.
+  @param[in]    WindowSize      The number of records the window holds.
+
+  @retval   EFI_SUCCESS             The walk was started.
+  @retval   EFI_INVALID_PARAMETER   Iterator or Window is NULL, or WindowSize
+                                    is 0.
+**/
+EFI_STATUS
+EFIAPI
+SelStartIterator (
+  OUT SEL_ITERATOR  *Iterator,
+  IN UINT16         RecordId,
+  IN SEL_RECORD     *Window,
+  IN UINT16         WindowSize
+  )
+{
+  SEL_ITERATOR_STATE  *State;
+
+  if ((Iterator == NULL) || (Window == NULL) || (WindowSize == 0)) {
+    DEBUG ((DEBUG_ERROR, "%a: Invalid parameter!\n", __FUNCTION__));
+    ASSERT (FALSE);
+    return EFI_INVALID_PARAMETER;
+  }
+
+  ZeroMem (Iterator, sizeof (*Iterator));
+  State               = (SEL_ITERATOR_STATE *)Iterator->Private;
+  State->Window       = Window;
+  State->WindowSize   = WindowSize;
+  State->NextRecordId = RecordId;
+
+  //
+  // Whole records are read without a reservation, so that another requester
+  // reserving the SEL does not end the walk.
+  //
+  State->ReservationId = 0;
+  return EFI_SUCCESS;
+}
+
+/**
+  Gets the next entry of a walk through the SEL, fetching the following
+  entries into the window when it is empty.
+
+  @param[in,out]  Iterator      The state of the walk.
+  @param[out]     Record        Receives the record.
+
+  @retval   EFI_SUCCESS             The next SEL entry was retrieved.
+  @retval   EFI_NOT_FOUND           The walk reached the end of the SEL.
+  @retval   EFI_ABORTED             The BMC kept canceling the reservation of
+                                    the walk.
+  @retval   EFI_INVALID_PARAMETER   Iterator or Record pointer is NULL.
+  @retval   Other                   The IPMI base library returned an error.
+**/
+EFI_STATUS
+EFIAPI
+SelGetNextEntry (
+  IN OUT SEL_ITERATOR  *Iterator,
+  OUT SEL_RECORD       *Record
+  )
+{
+  SEL_ITERATOR_STATE  *State;
+  EFI_STATUS          Status;
+
+  if ((Iterator == NULL) || (Record == NULL)) {
+    DEBUG ((DEBUG_ERROR, "%a: Invalid parameter!\n", __FUNCTION__));
+    ASSERT (FALSE);
+    return EFI_INVALID_PARAMETER;
+  }
+
+  State = (SEL_ITERATOR_STATE *)Iterator->Private;
+
+  if (State->Index == State->Count) {
+    if (State->EndOfLog) {
+      return EFI_NOT_FOUND;
+    }
+
+    Status = SelFillWindow (State);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  CopyMem (Record, &State->Window[State->Index], sizeof (SEL_RECORD));
+  State->Index++;
+  return EFI_SUCCESS;
+}
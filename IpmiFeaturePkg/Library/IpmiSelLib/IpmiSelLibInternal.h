@@ -0,0 +1,140 @@
+/** @file
+  Internal definitions shared between the SEL library and its SEL entry queue
+  implementations.
+
+  Copyright (c) Microsoft Corporation
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef IPMI_SEL_LIB_INTERNAL_H_
+#define IPMI_SEL_LIB_INTERNAL_H_
+
+#include <Library/IpmiSelLib.h>
+
+#pragma pack(1)
+
+//
+// Entry of the sensor type rate limit table in PcdIpmiSelRateLimits. The first
+// entry matching the sensor type of a system event sets how many events of
+// the type are added per coalescing window. SEL_RATE_LIMIT_ANY matches any
+// sensor type.
+//
+#define SEL_RATE_LIMIT_ANY  0xFF
+
+typedef struct {
+  UINT8    SensorType;
+  UINT8    MaxEvents;
+} SEL_RATE_LIMIT;
+
+#pragma pack()
+
+/**
+  Checks the response of the BMC to an Add SEL Entry command.
+
+  @param[in]      Response    The response of the BMC.
+  @param[in]      DataSize    The size of the response.
+  @param[in,out]  RecordId    If provided, receives the record ID of the entry.
+
+  @retval   EFI_SUCCESS         The entry was successfully added.
+  @retval   EFI_PROTOCOL_ERROR  Unexpected result size.
+  @retval   Other               The BMC returned a failing completion code.
+**/
+EFI_STATUS
+SelCheckAddResponse (
+  IN IPMI_ADD_SEL_ENTRY_RESPONSE  *Response,
+  IN UINT32                       DataSize,
+  IN OUT UINT16                   *RecordId OPTIONAL
+  );
+
+/**
+  Sends an entry to the BMC and waits for it to be added to the SEL.
+
+  @param[in]      Entry       The entry to be added to the SEL.
+  @param[in,out]  RecordId    If provided, receives the record ID of the entry.
+
+  @retval   EFI_SUCCESS         The entry was successfully added.
+  @retval   EFI_PROTOCOL_ERROR  Unexpected result size.
+  @retval   Other               The IPMI base library returned an error.
+**/
+EFI_STATUS
+SelSendEntry (
+  IN SEL_RECORD  *Entry,
+  IN OUT UINT16  *RecordId OPTIONAL
+  );
+
+/**
+  Queues an entry to be added to the SEL later.
+
+  @param[in]    Entry     The entry to be added to the SEL.
+  @param[out]   Status    Receives the result of queueing the entry if it was
+                          taken by the queue.
+
+  @retval   TRUE    The queue took the entry, Status is set.
+  @retval   FALSE   The queue is not active, the entry must be sent at once.
+**/
+BOOLEAN
+SelQueueEntry (
+  IN SEL_RECORD   *Entry,
+  OUT EFI_STATUS  *Status
+  );
+
+/**
+  Sends all queued entries to the BMC.
+
+  @retval   EFI_SUCCESS           All queued entries were added to the SEL.
+  @retval   EFI_ALREADY_STARTED   The queue is being drained at a lower TPL.
+  @retval   Other                 An entry failed to be added to the SEL.
+**/
+EFI_STATUS
+SelQueueFlush (
+  VOID
+  );
+
+/**
+  Keeps the SEL library state from being changed by code interrupting the
+  caller, until SelUnlock is called.
+
+  @retval   The state to pass to SelUnlock.
+**/
+UINTN
+SelLock (
+  VOID
+  );
+
+/**
+  Allows the SEL library state to be changed again.
+
+  @param[in]  State   The state returned by SelLock.
+**/
+VOID
+SelUnlock (
+  IN UINTN  State
+  );
+
+/**
+  Checks whether a system event should be added to the SEL. Duplicates of an
+  event added within the window are counted instead, as are events over the
+  rate limit of their sensor type. Windows that are over get their counts
+  added to the SEL as summary records before the event is added.
+
+  @param[in]  Entry   The system event to be added to the SEL.
+
+  @retval TRUE    The event was counted and must not be added.
+  @retval FALSE   The event must be added.
+**/
+BOOLEAN
+SelCoalesceEntry (
+  IN SEL_RECORD  *Entry
+  );
+
+/**
+  Adds the counts of all open windows to the SEL as summary records and
+  forgets the recent events.
+**/
+VOID
+SelCoalesceFlush (
+  VOID
+  );
+
+#endif
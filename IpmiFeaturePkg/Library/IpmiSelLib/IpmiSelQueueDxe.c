@@ -0,0 +1,543 @@
+/** @file
+  Write-behind queue for SEL entries in DXE. Entries added without asking for
+  their record ID are copied into a preallocated ring at TPL_HIGH_LEVEL and
+  sent to the BMC from a TPL_CALLBACK event, so callers such as status code
+  handlers do not wait for an IPMI round trip per entry. Queued entries are
+  sent in batches through IPMI_TRANSPORT2 when it is available, and one at a
+  time through the IPMI base library otherwise. The queue belongs to
+  the module linking the library, so its entries are not visible to readers of
+  the SEL until they are sent.
+
+  Copyright (c) Microsoft Corporation
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+#include <Protocol/IpmiTransport2Protocol.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/PcdLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiLib.h>
+
+#include "IpmiSelLibInternal.h"
+
+//
+// Maximum number of queued entries sent to the BMC in one batch.
+//
+#define SEL_QUEUE_BATCH_SIZE  8
+
+//
+// Ring of queued entries. The ring and its indices are only accessed at
+// TPL_HIGH_LEVEL.
+//
+
+STATIC SEL_RECORD  *mSelQueue      = NULL;
+STATIC UINT16      mSelQueueSize   = 0;
+STATIC UINT16      mSelQueueHead   = 0;
+STATIC UINT16      mSelQueueCount  = 0;
+STATIC UINT32      mDroppedEntries = 0;
+STATIC UINT32      mFailedEntries  = 0;
+STATIC BOOLEAN     mQueueActive    = FALSE;
+STATIC BOOLEAN     mDraining       = FALSE;
+
+//
+// Set once ExitBootServices is signaled and the TPL may no longer be raised.
+//
+
+STATIC BOOLEAN  mBootServicesDone = FALSE;
+
+STATIC EFI_EVENT  mDrainEvent            = NULL;
+STATIC EFI_EVENT  mReadyToBootEvent      = NULL;
+STATIC EFI_EVENT  mExitBootServicesEvent = NULL;
+
+STATIC IPMI_TRANSPORT2  *mIpmiTransport2 = NULL;
+
+/**
+  Queues an entry to be added to the SEL later.
+
+  @param[in]    Entry     The entry to be added to the SEL.
+  @param[out]   Status    Receives the result of queueing the entry if it was
+                          taken by the queue.
+
+  @retval   TRUE    The queue took the entry, Status is set.
+  @retval   FALSE   The queue is not active, the entry must be sent at once.
+**/
+BOOLEAN
+SelQueueEntry (
+  IN SEL_RECORD   *Entry,
+  OUT EFI_STATUS  *Status
+  )
+{
+  EFI_TPL  OldTpl;
+  UINT16   Tail;
+
+  if (!mQueueActive) {
+    return FALSE;
+  }
+
+  OldTpl = gBS->RaiseTPL (TPL_HIGH_LEVEL);
+  if (mSelQueueCount == mSelQueueSize) {
+    mDroppedEntries++;
+    *Status = EFI_OUT_OF_RESOURCES;
+  } else {
+    Tail = (UINT16)((mSelQueueHead + mSelQueueCount) % mSelQueueSize);
+    CopyMem (&mSelQueue[Tail], Entry, sizeof (SEL_RECORD));
+    mSelQueueCount++;
+    *Status = EFI_SUCCESS;
+  }
+
+  gBS->RestoreTPL (OldTpl);
+
+  if (EFI_ERROR (*Status)) {
+    DEBUG ((DEBUG_WARN, "%a: SEL queue full, entry dropped.\n", __FUNCTION__));
+  } else {
+    gBS->SignalEvent (mDrainEvent);
+  }
+
+  return TRUE;
+}
+
+/**
+  Gets the IPMI_TRANSPORT2 instance used to send queued entries in batches.
+  The protocol is only looked for at or below TPL_NOTIFY.
+
+  @retval   The transport, or NULL if it is not available or does not support
+            batches.
+**/
+STATIC
+IPMI_TRANSPORT2 *
+SelQueueGetTransport2 (
+  VOID
+  )
+{
+  EFI_STATUS  Status;
+
+  if ((mIpmiTransport2 == NULL) && (EfiGetCurrentTpl () <= TPL_NOTIFY)) {
+    Status = gBS->LocateProtocol (&gIpmiTransport2ProtocolGuid, NULL, (VOID **)&mIpmiTransport2);
+    if (EFI_ERROR (Status)) {
+      mIpmiTransport2 = NULL;
+    }
+  }
+
+  if ((mIpmiTransport2 == NULL) ||
+      (mIpmiTransport2->Revision < IPMI_TRANSPORT2_REVISION) ||
+      (mIpmiTransport2->SubmitBatch == NULL))
+  {
+    return NULL;
+  }
+
+  return mIpmiTransport2;
+}
+
+/**
+  Sends entries taken from the queue to the BMC, as one batch if a transport
+  is given and one at a time otherwise.
+
+  @param[in]    Transport2  The transport to send the batch on, or NULL.
+  @param[in]    Entries     The entries to be added to the SEL.
+  @param[in]    Count       The number of entries, at most
+                            SEL_QUEUE_BATCH_SIZE if Transport2 is given.
+  @param[out]   Failed      Receives the number of entries the BMC failed to
+                            add.
+
+  @retval   EFI_SUCCESS   All entries were added to the SEL.
+  @retval   Other         The status of the first entry that failed.
+**/
+STATIC
+EFI_STATUS
+SelQueueSend (
+  IN  IPMI_TRANSPORT2  *Transport2 OPTIONAL,
+  IN  SEL_RECORD       *Entries,
+  IN  UINTN            Count,
+  OUT UINT32           *Failed
+  )
+{
+  EFI_STATUS                   Status;
+  EFI_STATUS                   EntryStatus;
+  UINTN                        Index;
+  IPMI_BATCH_ENTRY             Batch[SEL_QUEUE_BATCH_SIZE];
+  IPMI_ADD_SEL_ENTRY_RESPONSE  Responses[SEL_QUEUE_BATCH_SIZE];
+
+  ASSERT ((Transport2 == NULL) || (Count <= SEL_QUEUE_BATCH_SIZE));
+
+  if (Transport2 != NULL) {
+    ZeroMem (Batch, sizeof (Batch));
+    for (Index = 0; Index < Count; Index++) {
+      Responses[Index].CompletionCode = IPMI_COMP_CODE_UNSPECIFIED;
+      Batch[Index].NetFunction        = IPMI_NETFN_STORAGE;
+      Batch[Index].Command            = IPMI_STORAGE_ADD_SEL_ENTRY;
+      Batch[Index].CommandData        = (UINT8 *)&Entries[Index];
+      Batch[Index].CommandDataSize    = sizeof (SEL_RECORD);
+      Batch[Index].ResponseData       = (UINT8 *)&Responses[Index];
+      Batch[Index].ResponseDataSize   = sizeof (Responses[Index]);
+    }
+
+    Transport2->SubmitBatch (Transport2, Batch, Count, 0);
+  }
+
+  Status  = EFI_SUCCESS;
+  *Failed = 0;
+  for (Index = 0; Index < Count; Index++) {
+    if (Transport2 == NULL) {
+      EntryStatus = SelSendEntry (&Entries[Index], NULL);
+    } else if (EFI_ERROR (Batch[Index].Status)) {
+      EntryStatus = Batch[Index].Status;
+    } else {
+      EntryStatus = SelCheckAddResponse (&Responses[Index], Batch[Index].ResponseDataSize, NULL);
+    }
+
+    if (EFI_ERROR (EntryStatus)) {
+      DEBUG ((DEBUG_ERROR, "%a: Failed to add queued SEL entry. %r\n", __FUNCTION__, EntryStatus));
+      (*Failed)++;
+      if (!EFI_ERROR (Status)) {
+        Status = EntryStatus;
+      }
+    }
+  }
+
+  return Status;
+}
+
+/**
+  Sends the queued entries to the BMC until the queue is empty. Entries the
+  BMC fails to add are counted as failed.
+
+  @retval   EFI_SUCCESS           All queued entries were added to the SEL.
+  @retval   EFI_ALREADY_STARTED   The queue is being drained at a lower TPL.
+  @retval   Other                 An entry failed to be added to the SEL.
+**/
+STATIC
+EFI_STATUS
+SelQueueDrain (
+  VOID
+  )
+{
+  EFI_STATUS       Status;
+  EFI_STATUS       SendStatus;
+  EFI_TPL          OldTpl;
+  IPMI_TRANSPORT2  *Transport2;
+  SEL_RECORD       Entries[SEL_QUEUE_BATCH_SIZE];
+  UINTN            BatchSize;
+  UINTN            Count;
+  UINT32           Failed;
+
+  OldTpl = gBS->RaiseTPL (TPL_HIGH_LEVEL);
+  if (mDraining) {
+    gBS->RestoreTPL (OldTpl);
+    return EFI_ALREADY_STARTED;
+  }
+
+  mDraining = TRUE;
+  gBS->RestoreTPL (OldTpl);
+
+  Transport2 = SelQueueGetTransport2 ();
+  BatchSize  = (Transport2 != NULL) ? SEL_QUEUE_BATCH_SIZE : 1;
+
+  Status = EFI_SUCCESS;
+  while (TRUE) {
+    OldTpl = gBS->RaiseTPL (TPL_HIGH_LEVEL);
+    if (mSelQueueCount == 0) {
+      mDraining = FALSE;
+      gBS->RestoreTPL (OldTpl);
+      break;
+    }
+
+    for (Count = 0; (Count < BatchSize) && (mSelQueueCount > 0); Count++) {
+      CopyMem (&Entries[Count], &mSelQueue[mSelQueueHead], sizeof (SEL_RECORD));
+      mSelQueueHead = (UINT16)((mSelQueueHead + 1) % mSelQueueSize);
+      mSelQueueCount--;
+    }
+
+    gBS->RestoreTPL (OldTpl);
+
+    SendStatus = SelQueueSend (Transport2, Entries, Count, &Failed);
+    if (EFI_ERROR (SendStatus)) {
+      OldTpl          = gBS->RaiseTPL (TPL_HIGH_LEVEL);
+      mFailedEntries += Failed;
+      gBS->RestoreTPL (OldTpl);
+      if (!EFI_ERROR (Status)) {
+        Status = SendStatus;
+      }
+    }
+  }
+
+  return Status;
+}
+
+/**
+  Sends all queued entries to the BMC. Called before an entry is added
+  synchronously so entries reach the SEL in the order they were added.
+
+  @retval   EFI_SUCCESS           All queued entries were added to the SEL.
+  @retval   EFI_ALREADY_STARTED   The queue is being drained at a lower TPL.
+  @retval   Other                 An entry failed to be added to the SEL.
+**/
+EFI_STATUS
+SelQueueFlush (
+  VOID
+  )
+{
+  if (!mQueueActive) {
+    return EFI_SUCCESS;
+  }
+
+  return SelQueueDrain ();
+}
+
+/**
+  Keeps the SEL library state from being changed by code interrupting the
+  caller by raising the TPL to TPL_HIGH_LEVEL. After ExitBootServices the TPL
+  is left alone.
+
+  @retval   The state to pass to SelUnlock.
+**/
+UINTN
+SelLock (
+  VOID
+  )
+{
+  if (mBootServicesDone) {
+    return TPL_HIGH_LEVEL;
+  }
+
+  return gBS->RaiseTPL (TPL_HIGH_LEVEL);
+}
+
+/**
+  Allows the SEL library state to be changed again.
+
+  @param[in]  State   The state returned by SelLock.
+**/
+VOID
+SelUnlock (
+  IN UINTN  State
+  )
+{
+  if (!mBootServicesDone) {
+    gBS->RestoreTPL ((EFI_TPL)State);
+  }
+}
+
+/**
+  Gets the number of entries that were dropped because the queue was full.
+
+  @retval   The number of dropped entries.
+**/
+UINT32
+EFIAPI
+SelGetDroppedEntries (
+  VOID
+  )
+{
+  return mDroppedEntries;
+}
+
+/**
+  Gets the number of queued entries the BMC failed to add to the SEL.
+
+  @retval   The number of failed entries.
+**/
+UINT32
+EFIAPI
+SelGetFailedEntries (
+  VOID
+  )
+{
+  return mFailedEntries;
+}
+
+/**
+  Event callback to send the queued entries to the BMC.
+
+  @param[in]  Event     The event that was signaled.
+  @param[in]  Context   Not used.
+**/
+STATIC
+VOID
+EFIAPI
+SelQueueDrainCallback (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  SelQueueFlush ();
+}
+
+/**
+  ReadyToBoot callback to make sure all queued entries are in the SEL before
+  a boot option is started.
+
+  @param[in]  Event     The event that was signaled.
+  @param[in]  Context   Not used.
+**/
+STATIC
+VOID
+EFIAPI
+SelQueueReadyToBootCallback (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  SelFlush ();
+}
+
+/**
+  ExitBootServices callback to send the queued entries to the BMC and stop
+  queueing, as boot services are no longer available to drain the queue.
+
+  @param[in]  Event     The event that was signaled.
+  @param[in]  Context   Not used.
+**/
+STATIC
+VOID
+EFIAPI
+SelQueueExitBootServicesCallback (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  SelFlush ();
+  mQueueActive      = FALSE;
+  mBootServicesDone = TRUE;
+
+  if (mDroppedEntries != 0) {
+    DEBUG ((DEBUG_WARN, "%a: %d SEL entries were dropped.\n", __FUNCTION__, mDroppedEntries));
+  }
+
+  if (mFailedEntries != 0) {
+    DEBUG ((DEBUG_WARN, "%a: The BMC failed to add %d SEL entries.\n", __FUNCTION__, mFailedEntries));
+  }
+}
+
+/**
+  Closes the queue events and frees the ring.
+**/
+STATIC
+VOID
+SelQueueFree (
+  VOID
+  )
+{
+  mQueueActive = FALSE;
+
+  if (mDrainEvent != NULL) {
+    gBS->CloseEvent (mDrainEvent);
+    mDrainEvent = NULL;
+  }
+
+  if (mReadyToBootEvent != NULL) {
+    gBS->CloseEvent (mReadyToBootEvent);
+    mReadyToBootEvent = NULL;
+  }
+
+  if (mExitBootServicesEvent != NULL) {
+    gBS->CloseEvent (mExitBootServicesEvent);
+    mExitBootServicesEvent = NULL;
+  }
+
+  if (mSelQueue != NULL) {
+    FreePool (mSelQueue);
+    mSelQueue = NULL;
+  }
+}
+
+/**
+  Allocates the SEL entry queue and creates the events used to drain it. If
+  the queue cannot be set up, entries are sent to the BMC at once.
+
+  @param[in]  ImageHandle   The firmware allocated handle for the EFI image.
+  @param[in]  SystemTable   A pointer to the EFI System Table.
+
+  @retval   EFI_SUCCESS   Always.
+**/
+EFI_STATUS
+EFIAPI
+IpmiSelLibDxeConstructor (
+  IN EFI_HANDLE        ImageHandle,
+  IN EFI_SYSTEM_TABLE  *SystemTable
+  )
+{
+  EFI_STATUS  Status;
+
+  mSelQueueSize = FixedPcdGet16 (PcdIpmiSelQueueSize);
+  if (mSelQueueSize == 0) {
+    return EFI_SUCCESS;
+  }
+
+  mSelQueue = AllocateZeroPool (mSelQueueSize * sizeof (SEL_RECORD));
+  if (mSelQueue == NULL) {
+    DEBUG ((DEBUG_ERROR, "%a: Failed to allocate SEL queue.\n", __FUNCTION__));
+    return EFI_SUCCESS;
+  }
+
+  Status = gBS->CreateEvent (
+                  EVT_NOTIFY_SIGNAL,
+                  TPL_CALLBACK,
+                  SelQueueDrainCallback,
+                  NULL,
+                  &mDrainEvent
+                  );
+
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "%a: Failed to create SEL queue event! %r\n", __FUNCTION__, Status));
+    goto Exit;
+  }
+
+  Status = EfiCreateEventReadyToBootEx (
+             TPL_CALLBACK,
+             SelQueueReadyToBootCallback,
+             NULL,
+             &mReadyToBootEvent
+             );
+
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "%a: Failed to create ReadyToBoot event for SEL queue! %r\n", __FUNCTION__, Status));
+    goto Exit;
+  }
+
+  Status = gBS->CreateEvent (
+                  EVT_SIGNAL_EXIT_BOOT_SERVICES,
+                  TPL_CALLBACK,
+                  SelQueueExitBootServicesCallback,
+                  NULL,
+                  &mExitBootServicesEvent
+                  );
+
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "%a: Failed to create ExitBootServices event for SEL queue! %r\n", __FUNCTION__, Status));
+    goto Exit;
+  }
+
+  mQueueActive = TRUE;
+
+Exit:
+  if (EFI_ERROR (Status)) {
+    SelQueueFree ();
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Sends the queued entries to the BMC and frees the queue when the image using
+  the library is unloaded.
+
+  @param[in]  ImageHandle   The firmware allocated handle for the EFI image.
+  @param[in]  SystemTable   A pointer to the EFI System Table.
+
+  @retval   EFI_SUCCESS   Always.
+**/
+EFI_STATUS
+EFIAPI
+IpmiSelLibDxeDestructor (
+  IN EFI_HANDLE        ImageHandle,
+  IN EFI_SYSTEM_TABLE  *SystemTable
+  )
+{
+  SelFlush ();
+  SelQueueFree ();
+  return EFI_SUCCESS;
+}
@@ -0,0 +1,98 @@
+/** @file
+  SEL entry queue for phases without a lower TPL to send queued entries from.
+  Every entry is sent to the BMC at once.
+
+  Copyright (c) Microsoft Corporation
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+
+#include "IpmiSelLibInternal.h"
+
+/**
+  Queues an entry to be added to the SEL later.
+
+  @param[in]    Entry     The entry to be added to the SEL.
+  @param[out]   Status    Receives the result of queueing the entry if it was
+                          taken by the queue.
+
+  @retval   FALSE   The queue is not active, the entry must be sent at once.
+**/
+BOOLEAN
+SelQueueEntry (
+  IN SEL_RECORD   *Entry,
+  OUT EFI_STATUS  *Status
+  )
+{
+  return FALSE;
+}
+
+/**
+  Sends all queued entries to the BMC.
+
+  @retval   EFI_SUCCESS   No entries are queued.
+**/
+EFI_STATUS
+SelQueueFlush (
+  VOID
+  )
+{
+  return EFI_SUCCESS;
+}
+
+/**
+  Keeps the SEL library state from being changed by code interrupting the
+  caller. Without boot services there is nothing that interrupts the caller.
+
+  @retval   The state to pass to SelUnlock.
+**/
+UINTN
+SelLock (
+  VOID
+  )
+{
+  return 0;
+}
+
+/**
+  Allows the SEL library state to be changed again.
+
+  @param[in]  State   The state returned by SelLock.
+**/
+VOID
+SelUnlock (
+  IN UINTN  State
+  )
+{
+}
+
+/**
+  Gets the number of entries that were dropped instead of being added to the
+  SEL.
+
+  @retval   The number of dropped entries, always 0.
+**/
+UINT32
+EFIAPI
+SelGetDroppedEntries (
+  VOID
+  )
+{
+  return 0;
+}
+
+/**
+  Gets the number of queued entries the BMC failed to add to the SEL.
+
+  @retval   The number of failed entries, always 0.
+**/
+UINT32
+EFIAPI
+SelGetFailedEntries (
+  VOID
+  )
+{
+  return 0;
+}
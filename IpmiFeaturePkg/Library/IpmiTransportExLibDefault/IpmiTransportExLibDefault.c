@@ -0,0 +1,197 @@
+/** @file
+  Implements IpmiTransportExLib on top of the SendDataToBmcPort and
+  ReceiveBmcDataFromPort functions of IpmiTransportLib, for transports that
+  only implement those. Messages are staged in a buffer of the size those
+  functions can carry, timeouts are converted to IPMI_TRANSPORT_DELAY_UNIT,
+  and the optional functions do nothing.
+
+  Copyright (c) Microsoft Corporation
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/IpmiTransportLib.h>
+#include <Library/IpmiTransportExLib.h>
+
+//
+// IpmiTransportLib carries messages of up to MAX_UINT8 bytes, including the
+// NetFn/LUN and command bytes of the header.
+//
+#define IPMI_DEFAULT_MESSAGE_SIZE  MAX_UINT8
+#define IPMI_DEFAULT_HEADER_SIZE   2
+
+/**
+  Converts a time budget in microseconds to the unit of IpmiTransportLib.
+
+  @param[in]  TimeoutUs   The time budget in microseconds.
+
+  @retval   The time budget in units of IPMI_TRANSPORT_DELAY_UNIT.
+**/
+STATIC
+UINT64
+IpmiDefaultTimeout (
+  IN UINT64  TimeoutUs
+  )
+{
+  return DivU64x32 (TimeoutUs, IPMI_TRANSPORT_DELAY_UNIT) + 1;
+}
+
+/**
+  Sends a message to the BMC with SendDataToBmcPort after staging the header
+  and body into one buffer.
+
+  @param[in]  TimeoutUs           The time budget for the transaction in
+                                  microseconds.
+  @param[in]  Header              The header bytes to send first. Optional if
+                                  HeaderSize is 0.
+  @param[in]  HeaderSize          The size of the header in bytes.
+  @param[in]  Data                The body bytes to send after the header.
+                                  Optional if DataSize is 0.
+  @param[in]  DataSize            The size of the body in bytes.
+
+  @retval   EFI_SUCCESS             The message was successfully sent.
+  @retval   EFI_INVALID_PARAMETER   The message is empty or larger than
+                                    IpmiTransportLib can carry.
+  @retval   Other                   Returned by SendDataToBmcPort.
+**/
+EFI_STATUS
+SendDataToBmcPortEx (
+  UINT64  TimeoutUs,
+  UINT8   *Header,
+  UINT8   HeaderSize,
+  UINT8   *Data,
+  UINT32  DataSize
+  )
+{
+  UINT8  Message[IPMI_DEFAULT_MESSAGE_SIZE];
+
+  if (((HeaderSize == 0) && (DataSize == 0)) || (DataSize > sizeof (Message) - HeaderSize)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  CopyMem (Message, Header, HeaderSize);
+  CopyMem (&Message[HeaderSize], Data, DataSize);
+  return SendDataToBmcPort (
+           IpmiDefaultTimeout (TimeoutUs),
+           Message,
+           (UINT8)(HeaderSize + DataSize)
+           );
+}
+
+/**
+  Receives a message from the BMC with ReceiveBmcDataFromPort and splits it
+  between the header and body buffers.
+
+  @param[in]      TimeoutUs           The time budget for the transaction in
+                                      microseconds.
+  @param[out]     Header              The buffer for the header bytes. Optional
+                                      if HeaderSize is 0.
+  @param[in]      HeaderSize          The size of the header in bytes.
+  @param[out]     Data                The buffer for the body bytes.
+  @param[in,out]  DataSize            On input, the size of Data. On output,
+                                      the size of the message body.
+
+  @retval   EFI_SUCCESS             The message was successfully received.
+  @retval   EFI_BUFFER_TOO_SMALL    The body did not fit in Data.
+  @retval   Other                   Returned by ReceiveBmcDataFromPort.
+**/
+EFI_STATUS
+ReceiveBmcDataFromPortEx (
+  UINT64  TimeoutUs,
+  UINT8   *Header,
+  UINT8   HeaderSize,
+  UINT8   *Data,
+  UINT32  *DataSize
+  )
+{
+  EFI_STATUS  Status;
+  UINT8       Message[IPMI_DEFAULT_MESSAGE_SIZE];
+  UINT8       MessageSize;
+  UINT32      BodySize;
+
+  MessageSize = sizeof (Message);
+  Status      = ReceiveBmcDataFromPort (IpmiDefaultTimeout (TimeoutUs), Message, &MessageSize);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  CopyMem (Header, Message, MIN (HeaderSize, MessageSize));
+  BodySize = (MessageSize > HeaderSize) ? (UINT32)(MessageSize - HeaderSize) : 0;
+  CopyMem (Data, &Message[MIN (HeaderSize, MessageSize)], MIN (BodySize, *DataSize));
+  if (BodySize > *DataSize) {
+    *DataSize = BodySize;
+    return EFI_BUFFER_TOO_SMALL;
+  }
+
+  *DataSize = BodySize;
+  return EFI_SUCCESS;
+}
+
+/**
+  Gets the largest message bodies IpmiTransportLib can carry.
+
+  @param[out]  MaxRequestSize     The largest request body in bytes.
+  @param[out]  MaxResponseSize    The largest response body in bytes,
+                                  including the completion code.
+**/
+VOID
+GetBmcMaxMessageSize (
+  OUT UINT32  *MaxRequestSize,
+  OUT UINT32  *MaxResponseSize
+  )
+{
+  *MaxRequestSize  = IPMI_DEFAULT_MESSAGE_SIZE - IPMI_DEFAULT_HEADER_SIZE;
+  *MaxResponseSize = IPMI_DEFAULT_MESSAGE_SIZE - IPMI_DEFAULT_HEADER_SIZE;
+}
+
+/**
+  IpmiTransportLib has no way to check for a response without receiving it.
+
+  @retval   EFI_UNSUPPORTED   Always, the receive waits for the response.
+**/
+EFI_STATUS
+CheckBmcResponseReady (
+  VOID
+  )
+{
+  return EFI_UNSUPPORTED;
+}
+
+/**
+  Default implementation of IpmiTransportBeginSession. Nothing is kept.
+**/
+VOID
+IpmiTransportBeginSession (
+  VOID
+  )
+{
+}
+
+/**
+  Default implementation of IpmiTransportEndSession.
+**/
+VOID
+IpmiTransportEndSession (
+  VOID
+  )
+{
+}
+
+/**
+  Default implementation of IpmiTransportSetCapabilities. The capabilities are
+  ignored.
+
+  @param[in]  InterfaceType         UNUSED.
+  @param[in]  Capabilities          UNUSED.
+  @param[in]  CapabilitiesSize      UNUSED.
+**/
+VOID
+IpmiTransportSetCapabilities (
+  IN UINT8   InterfaceType,
+  IN UINT8   *Capabilities,
+  IN UINT32  CapabilitiesSize
+  )
+{
+}
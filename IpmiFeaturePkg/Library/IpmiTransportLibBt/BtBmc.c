@@ -0,0 +1,479 @@
+/** @file
+  Implements the Block Transfer (BT) system interface transport code for IPMI.
+
+  Copyright (c) Microsoft Corporation
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/IoLib.h>
+#include <Library/DebugLib.h>
+#include <Library/TimerLib.h>
+#include <Library/IpmiDeadlineLib.h>
+#include <Library/IpmiPlatformLib.h>
+#include <Library/IpmiTransportLib.h>
+#include <Library/IpmiTransportExLib.h>
+#include <IndustryStandard/Acpi.h>
+#include <BtBmc.h>
+
+//
+// Delay between reads of the BT_CTRL register while waiting, in microseconds.
+//
+#define BT_DELAY_UNIT  (50)
+
+//
+// Size of the header the caller splits messages at: NetFn/LUN and command.
+//
+#define BT_CALLER_HEADER_SIZE  (2)
+
+//
+// Sequence number of the last request sent. A response carrying another
+// sequence number belongs to an earlier request that timed out and is
+// discarded. Where module globals are read only, as in PEI executing in place,
+// every request is sent with the same sequence number and stale responses are
+// left to the NetFn and command checks of the caller.
+//
+STATIC UINT8  mBtSequence = 0;
+
+/**
+  Returns the MMIO address of a BT register. Registers are spaced by
+  PcdIpmiRegisterBitWidth as advertised in the SPMI table and SMBIOS type 38.
+
+  @param[in]  Register    The index of the BT register.
+
+  @retval   The address of the register.
+**/
+STATIC
+UINTN
+BtMmioAddress (
+  IN UINT8  Register
+  )
+{
+  return (UINTN)PcdGet64 (PcdIpmiAddress) + Register * MAX (PcdGet8 (PcdIpmiRegisterBitWidth) / 8, 1);
+}
+
+/**
+  Reads a BT register through port I/O or MMIO, as selected by
+  PcdIpmiAddressSpaceId.
+
+  @param[in]  Register    The index of the BT register.
+
+  @retval   The value of the register.
+**/
+STATIC
+UINT8
+BtRegisterRead (
+  IN UINT8  Register
+  )
+{
+  if (PcdGet8 (PcdIpmiAddressSpaceId) == EFI_ACPI_5_0_SYSTEM_MEMORY) {
+    return MmioRead8 (BtMmioAddress (Register));
+  }
+
+  return IoRead8 (PcdGet16 (PcdIpmiIoBaseAddress) + Register);
+}
+
+/**
+  Writes a BT register through port I/O or MMIO, as selected by
+  PcdIpmiAddressSpaceId.
+
+  @param[in]  Register    The index of the BT register.
+  @param[in]  Value       The value to write.
+**/
+STATIC
+VOID
+BtRegisterWrite (
+  IN UINT8  Register,
+  IN UINT8  Value
+  )
+{
+  if (PcdGet8 (PcdIpmiAddressSpaceId) == EFI_ACPI_5_0_SYSTEM_MEMORY) {
+    MmioWrite8 (BtMmioAddress (Register), Value);
+    return;
+  }
+
+  IoWrite8 (PcdGet16 (PcdIpmiIoBaseAddress) + Register, Value);
+}
+
+/**
+  Waits for the bits of the BT_CTRL register selected by Mask to read as
+  Expected. The register is read at once and then every BT_DELAY_UNIT until
+  the time budget of the transaction has been used. The budget is measured
+  with the performance counter, so the cost of the register reads counts.
+
+  @param[in,out]  Deadline    The time budget of the transaction.
+  @param[in]      Mask        The bits of BT_CTRL to check.
+  @param[in]      Expected    The value the bits must have.
+  @param[out]     Control     The BT_CTRL value that ended the wait.
+
+  @retval   EFI_SUCCESS         The bits have the expected value.
+  @retval   EFI_DEVICE_ERROR    The interface is not present.
+  @retval   EFI_TIMEOUT         The time budget has been used.
+**/
+STATIC
+EFI_STATUS
+BtWaitControl (
+  IN OUT IPMI_DEADLINE  *Deadline,
+  IN     UINT8          Mask,
+  IN     UINT8          Expected,
+  OUT    UINT8          *Control
+  )
+{
+  while (TRUE) {
+    *Control = BtRegisterRead (BT_CTRL_REGISTER);
+    if (*Control == 0xFF) {
+      return EFI_DEVICE_ERROR;
+    }
+
+    if ((*Control & Mask) == Expected) {
+      return EFI_SUCCESS;
+    }
+
+    if (IpmiDeadlineExpired (Deadline)) {
+      return EFI_TIMEOUT;
+    }
+
+    IpmiDeadlineDelay (Deadline, BT_DELAY_UNIT);
+  }
+}
+
+/**
+  Begins a transport session. BT keeps nothing between transactions.
+**/
+VOID
+IpmiTransportBeginSession (
+  VOID
+  )
+{
+}
+
+/**
+  Ends a transport session. BT keeps nothing between transactions.
+**/
+VOID
+IpmiTransportEndSession (
+  VOID
+  )
+{
+}
+
+/**
+  Takes the capabilities of the system interface read from the BMC. The BT
+  limits are fixed by the interface, so they are not used.
+
+  @param[in]  InterfaceType       The interface type the capabilities describe.
+  @param[in]  Capabilities        The response, or NULL.
+  @param[in]  CapabilitiesSize    The size of the response.
+**/
+VOID
+IpmiTransportSetCapabilities (
+  IN UINT8   InterfaceType,
+  IN UINT8   *Capabilities,
+  IN UINT32  CapabilitiesSize
+  )
+{
+}
+
+/**
+  Initializing hardware for the IPMI transport. A host BUSY left set by an
+  earlier boot stage would keep the BMC from posting responses, so it is
+  cleared here.
+
+  @retval   EFI_SUCCESS     Hardware was successfully initialized.
+  @retval   Other           An error was returned from PlatformIpmiIoRangeSet.
+**/
+EFI_STATUS
+InitializeIpmiTransportHardware (
+  VOID
+  )
+{
+  EFI_STATUS  Status;
+  UINT8       Control;
+
+  if (PcdGet8 (PcdIpmiAddressSpaceId) == EFI_ACPI_5_0_SYSTEM_MEMORY) {
+    DEBUG ((DEBUG_INFO, "IPMI: BT registers at MMIO 0x%lx, %d bits apart\n", PcdGet64 (PcdIpmiAddress), PcdGet8 (PcdIpmiRegisterBitWidth)));
+    Status = EFI_SUCCESS;
+  } else {
+    Status = PlatformIpmiIoRangeSet (PcdGet16 (PcdIpmiIoBaseAddress));
+    DEBUG ((DEBUG_INFO, "IPMI: PlatformIpmiIoRangeSet - %r!\n", Status));
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  Control = BtRegisterRead (BT_CTRL_REGISTER);
+  if ((Control != 0xFF) && ((Control & BT_CTRL_H_BUSY) != 0)) {
+    BtRegisterWrite (BT_CTRL_REGISTER, BT_CTRL_H_BUSY);
+  }
+
+  return Status;
+}
+
+/**
+  Sends an IPMI request to the BMC over the BT interface. The whole message is
+  written to the host to BMC buffer and handed over with a single H2B_ATN.
+
+  @param[in]  TimeoutUs             The time budget for the transaction in
+                                    microseconds.
+  @param[in]  Header                The header bytes to send first. Optional if
+                                    HeaderSize is 0.
+  @param[in]  HeaderSize            The size of the header in bytes.
+  @param[in]  Data                  The body bytes to send after the header.
+                                    Optional if DataSize is 0.
+  @param[in]  DataSize              The size of the body in bytes.
+
+  @retval   EFI_SUCCESS             The message was successfully sent.
+  @retval   EFI_INVALID_PARAMETER   The message has no NetFn and command, or is
+                                    larger than a BT message.
+  @retval   EFI_DEVICE_ERROR        The interface is not present.
+  @retval   EFI_TIMEOUT             The BMC did not free the buffer in time.
+**/
+EFI_STATUS
+SendDataToBmcPortEx (
+  UINT64  TimeoutUs,
+  UINT8   *Header,
+  UINT8   HeaderSize,
+  UINT8   *Data,
+  UINT32  DataSize
+  )
+{
+  EFI_STATUS     Status;
+  IPMI_DEADLINE  Deadline;
+  UINT8          Control;
+  UINT32         TotalSize;
+  UINT32         Index;
+
+  if (DataSize > BT_MAX_BODY_SIZE + BT_CALLER_HEADER_SIZE) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  TotalSize = HeaderSize + DataSize;
+  if ((TotalSize < BT_CALLER_HEADER_SIZE) || (TotalSize > BT_MAX_BODY_SIZE + BT_CALLER_HEADER_SIZE)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  IpmiDeadlineStart (&Deadline, TimeoutUs);
+
+  //
+  // The buffer belongs to the BMC until it has taken the previous request and
+  // is no longer busy.
+  //
+  Status = BtWaitControl (&Deadline, BT_CTRL_B_BUSY | BT_CTRL_H2B_ATN, 0, &Control);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "IPMI: BT send - %r waiting for the buffer, BT_CTRL 0x%02x\n", Status, Control));
+    return Status;
+  }
+
+  mBtSequence++;
+
+  BtRegisterWrite (BT_CTRL_REGISTER, BT_CTRL_CLR_WR_PTR);
+  BtRegisterWrite (BT_BUFFER_REGISTER, (UINT8)(TotalSize + 1));
+  for (Index = 0; Index < TotalSize; Index++) {
+    if (Index == 1) {
+      BtRegisterWrite (BT_BUFFER_REGISTER, mBtSequence);
+    }
+
+    BtRegisterWrite (BT_BUFFER_REGISTER, (Index < HeaderSize) ? Header[Index] : Data[Index - HeaderSize]);
+  }
+
+  BtRegisterWrite (BT_CTRL_REGISTER, BT_CTRL_H2B_ATN);
+
+  DEBUG ((DEBUG_VERBOSE, "IPMI: BT send - sequence %d, %d bytes\n", mBtSequence, TotalSize + 1));
+  return EFI_SUCCESS;
+}
+
+/**
+  Sends an IPMI request to the BMC over the BT interface.
+
+  @param[in]  IpmiTimeoutPeriod     The timeout in units of
+                                    IPMI_TRANSPORT_DELAY_UNIT.
+  @param[in]  Data                  The message to send, starting with the
+                                    NetFn/LUN and command.
+  @param[in]  DataSize              The size of the message in bytes.
+
+  @retval   EFI_SUCCESS             The message was successfully sent.
+  @retval   Other                   See SendDataToBmcPortEx.
+**/
+EFI_STATUS
+SendDataToBmcPort (
+  UINT64  IpmiTimeoutPeriod,
+  UINT8   *Data,
+  UINT8   DataSize
+  )
+{
+  return SendDataToBmcPortEx (MultU64x32 (IpmiTimeoutPeriod, IPMI_TRANSPORT_DELAY_UNIT), NULL, 0, Data, DataSize);
+}
+
+/**
+  Receives the response to the last request from the BMC over the BT
+  interface. The whole message is read from the BMC to host buffer while the
+  host holds H_BUSY. Responses carrying the sequence number of an earlier
+  request are discarded and the wait continues.
+
+  @param[in]      TimeoutUs           The time budget for the transaction in
+                                      microseconds.
+  @param[out]     Header              The buffer for the header bytes. Optional
+                                      if HeaderSize is 0.
+  @param[in]      HeaderSize          The size of the header in bytes.
+  @param[out]     Data                The buffer for the body bytes.
+  @param[in,out]  DataSize            On input, the size of Data. On output,
+                                      the size of the message body.
+
+  @retval   EFI_SUCCESS             The message was successfully received.
+  @retval   EFI_BUFFER_TOO_SMALL    The body did not fit in Data.
+  @retval   EFI_DEVICE_ERROR        The interface is not present or the
+                                    response is malformed.
+  @retval   EFI_TIMEOUT             No response arrived in time.
+**/
+EFI_STATUS
+ReceiveBmcDataFromPortEx (
+  UINT64  TimeoutUs,
+  UINT8   *Header,
+  UINT8   HeaderSize,
+  UINT8   *Data,
+  UINT32  *DataSize
+  )
+{
+  EFI_STATUS     Status;
+  IPMI_DEADLINE  Deadline;
+  UINT8          Control;
+  UINT8          Length;
+  UINT8          NetFn;
+  UINT8          Sequence;
+  UINT8          Value;
+  UINT32         Count;
+  UINT32         Index;
+  UINT32         BodySize;
+
+  IpmiDeadlineStart (&Deadline, TimeoutUs);
+
+  while (TRUE) {
+    Status = BtWaitControl (&Deadline, BT_CTRL_B2H_ATN, BT_CTRL_B2H_ATN, &Control);
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_ERROR, "IPMI: BT receive - %r waiting for the response, BT_CTRL 0x%02x\n", Status, Control));
+      return Status;
+    }
+
+    if ((Control & BT_CTRL_H_BUSY) == 0) {
+      BtRegisterWrite (BT_CTRL_REGISTER, BT_CTRL_H_BUSY);
+    }
+
+    BtRegisterWrite (BT_CTRL_REGISTER, BT_CTRL_B2H_ATN);
+    BtRegisterWrite (BT_CTRL_REGISTER, BT_CTRL_CLR_RD_PTR);
+
+    Length = BtRegisterRead (BT_BUFFER_REGISTER);
+    if (Length < BT_MESSAGE_HEADER_SIZE) {
+      BtRegisterWrite (BT_CTRL_REGISTER, BT_CTRL_H_BUSY);
+      DEBUG ((DEBUG_ERROR, "IPMI: BT receive - response length %d too short\n", Length));
+      return EFI_DEVICE_ERROR;
+    }
+
+    NetFn    = BtRegisterRead (BT_BUFFER_REGISTER);
+    Sequence = BtRegisterRead (BT_BUFFER_REGISTER);
+    if (Sequence == mBtSequence) {
+      break;
+    }
+
+    BtRegisterWrite (BT_CTRL_REGISTER, BT_CTRL_H_BUSY);
+    DEBUG ((DEBUG_WARN, "IPMI: BT receive - discarding response to sequence %d, expecting %d\n", Sequence, mBtSequence));
+  }
+
+  //
+  // Hand the message to the caller without the sequence number, splitting it
+  // at HeaderSize. Bytes that do not fit in Data are still read so the size
+  // can be returned.
+  //
+  Count = Length - 1;
+  for (Index = 0; Index < Count; Index++) {
+    Value = (Index == 0) ? NetFn : BtRegisterRead (BT_BUFFER_REGISTER);
+    if (Index < HeaderSize) {
+      Header[Index] = Value;
+    } else if ((Index - HeaderSize) < *DataSize) {
+      Data[Index - HeaderSize] = Value;
+    }
+  }
+
+  BtRegisterWrite (BT_CTRL_REGISTER, BT_CTRL_H_BUSY);
+
+  BodySize = (Count > HeaderSize) ? (Count - HeaderSize) : 0;
+  if (BodySize > *DataSize) {
+    *DataSize = BodySize;
+    return EFI_BUFFER_TOO_SMALL;
+  }
+
+  *DataSize = BodySize;
+  DEBUG ((DEBUG_VERBOSE, "IPMI: BT receive - sequence %d, %d bytes\n", Sequence, Length + 1));
+  return EFI_SUCCESS;
+}
+
+/**
+  Receives the response to the last request from the BMC over the BT
+  interface.
+
+  @param[in]      IpmiTimeoutPeriod   The timeout in units of
+                                      IPMI_TRANSPORT_DELAY_UNIT.
+  @param[out]     Data                The buffer for the message, starting with
+                                      the NetFn/LUN and command.
+  @param[in,out]  DataSize            On input, the size of Data. On output,
+                                      the size of the message.
+
+  @retval   EFI_SUCCESS             The message was successfully received.
+  @retval   Other                   See ReceiveBmcDataFromPortEx.
+**/
+EFI_STATUS
+ReceiveBmcDataFromPort (
+  UINT64  IpmiTimeoutPeriod,
+  UINT8   *Data,
+  UINT8   *DataSize
+  )
+{
+  EFI_STATUS  Status;
+  UINT32      Size;
+
+  Size      = *DataSize;
+  Status    = ReceiveBmcDataFromPortEx (MultU64x32 (IpmiTimeoutPeriod, IPMI_TRANSPORT_DELAY_UNIT), NULL, 0, Data, &Size);
+  *DataSize = (UINT8)MIN (Size, MAX_UINT8);
+  return Status;
+}
+
+/**
+  Gets the largest message bodies the BT transport can carry, not counting the
+  NetFn/LUN and command.
+
+  @param[out]  MaxRequestSize     The largest request body in bytes.
+  @param[out]  MaxResponseSize    The largest response body in bytes,
+                                  including the completion code.
+**/
+VOID
+GetBmcMaxMessageSize (
+  OUT UINT32  *MaxRequestSize,
+  OUT UINT32  *MaxResponseSize
+  )
+{
+  *MaxRequestSize  = BT_MAX_BODY_SIZE;
+  *MaxResponseSize = BT_MAX_BODY_SIZE;
+}
+
+/**
+  Checks without blocking whether the BMC has posted a response. An absent
+  interface is reported as ready so that the receive fails at once.
+
+  @retval   EFI_SUCCESS     The response is available.
+  @retval   EFI_NOT_READY   The BMC is still processing the request.
+**/
+EFI_STATUS
+CheckBmcResponseReady (
+  VOID
+  )
+{
+  UINT8  Control;
+
+  Control = BtRegisterRead (BT_CTRL_REGISTER);
+  if ((Control == 0xFF) || ((Control & BT_CTRL_B2H_ATN) != 0)) {
+    return EFI_SUCCESS;
+  }
+
+  return EFI_NOT_READY;
+}
@@ -22,6 +22,11 @@ InitializeIpmiTransportHardware (
 {
   EFI_STATUS  Status;
 
+  if (PcdGet8 (PcdIpmiAddressSpaceId) == EFI_ACPI_5_0_SYSTEM_MEMORY) {
+    DEBUG ((DEBUG_INFO, "IPMI: KCS registers at MMIO 0x%lx, %d bits apart\n", PcdGet64 (PcdIpmiAddress), PcdGet8 (PcdIpmiRegisterBitWidth)));
+    return EFI_SUCCESS;
+  }
+
   //
   // Enable OEM specific southbridge SIO KCS I/O address range 0xCA0 to 0xCAF at here
   // if the the I/O address range has not been enabled.
@@ -31,6 +36,43 @@ InitializeIpmiTransportHardware (
   return Status;
 }
 
+/**
+  Begins a transport session. KCS keeps nothing between transactions.
+**/
+VOID
+IpmiTransportBeginSession (
+  VOID
+  )
+{
+}
+
+/**
+  Ends a transport session. KCS keeps nothing between transactions.
+**/
+VOID
+IpmiTransportEndSession (
+  VOID
+  )
+{
+}
+
+/**
+  Takes the capabilities of the system interface read from the BMC. The KCS
+  limits are fixed by the interface, so they are not used.
+
+  @param[in]  InterfaceType       The interface type the capabilities describe.
+  @param[in]  Capabilities        The response, or NULL.
+  @param[in]  CapabilitiesSize    The size of the response.
+**/
+VOID
+IpmiTransportSetCapabilities (
+  IN UINT8   InterfaceType,
+  IN UINT8   *Capabilities,
+  IN UINT32  CapabilitiesSize
+  )
+{
+}
+
 /**
   The constructor function initializing global state for the KCS library.
 
@@ -46,20 +88,235 @@ BmcKcsConstructor (
   return EFI_SUCCESS;
 }
 
+/**
+  Returns the MMIO address of a KCS register. Registers are spaced by
+  PcdIpmiRegisterBitWidth as advertised in the SPMI table and SMBIOS type 38.
+
+  @param[in]  Register    KCS_DATA_REGISTER or KCS_STATUS_REGISTER.
+
+  @retval   The address of the register.
+**/
+STATIC
+UINTN
+KcsMmioAddress (
+  IN UINT8  Register
+  )
+{
+  return (UINTN)PcdGet64 (PcdIpmiAddress) + Register * MAX (PcdGet8 (PcdIpmiRegisterBitWidth) / 8, 1);
+}
+
+/**
+  Reads a KCS register through port I/O or MMIO, as selected by
+  PcdIpmiAddressSpaceId.
+
+  @param[in]  Register    KCS_DATA_REGISTER or KCS_STATUS_REGISTER.
+
+  @retval   The value of the register.
+**/
+UINT8
+KcsRegisterRead (
+  IN UINT8  Register
+  )
+{
+  if (PcdGet8 (PcdIpmiAddressSpaceId) == EFI_ACPI_5_0_SYSTEM_MEMORY) {
+    return MmioRead8 (KcsMmioAddress (Register));
+  }
+
+  return IoRead8 ((Register == KCS_DATA_REGISTER) ? PcdGet16 (PcdIpmiIoBaseAddress) : PcdGet16 (PcdIpmiIoCmdRegister));
+}
+
+/**
+  Writes a KCS register through port I/O or MMIO, as selected by
+  PcdIpmiAddressSpaceId.
+
+  @param[in]  Register    KCS_DATA_REGISTER or KCS_STATUS_REGISTER.
+  @param[in]  Value       The value to write.
+**/
+VOID
+KcsRegisterWrite (
+  IN UINT8  Register,
+  IN UINT8  Value
+  )
+{
+  if (PcdGet8 (PcdIpmiAddressSpaceId) == EFI_ACPI_5_0_SYSTEM_MEMORY) {
+    MmioWrite8 (KcsMmioAddress (Register), Value);
+    return;
+  }
+
+  IoWrite8 ((Register == KCS_DATA_REGISTER) ? PcdGet16 (PcdIpmiIoBaseAddress) : PcdGet16 (PcdIpmiIoCmdRegister), Value);
+}
+
+/**
+  Starts the deadline of a KCS transaction. Time is measured with the
+  performance counter so the budget holds regardless of the cost of each poll.
+  If the platform has no performance counter the time spent in poll delays is
+  counted instead.
+
+  @param[out] Deadline            The deadline to start.
+  @param[in]  IpmiTimeoutPeriod   The time budget in microseconds.
+**/
+VOID
+KcsStartDeadline (
+  OUT KCS_DEADLINE  *Deadline,
+  IN  UINT64        IpmiTimeoutPeriod
+  )
+{
+  IpmiDeadlineStart (&Deadline->Time, IpmiTimeoutPeriod);
+  Deadline->StatusReads  = 0;
+  Deadline->IoOperations = 0;
+}
+
+/**
+  Reads the KCS status register for a wait of a transaction. The fixed policy
+  delays IPMI_DELAY_UNIT before every read. The adaptive policy reads at once,
+  spins for PcdIpmiKcsPollSpinCount more reads and then delays 1, 2, 4, ...
+  microseconds up to PcdIpmiKcsPollMaxDelay, so a responsive BMC is not held
+  back by the delay.
+
+  @param[in,out]  Deadline    The deadline of the transaction.
+  @param[in]      Poll        The number of reads already made by this wait.
+
+  @retval   The value of the status register.
+**/
+UINT8
+KcsPollStatus (
+  IN OUT KCS_DEADLINE  *Deadline,
+  IN     UINT32        Poll
+  )
+{
+  UINT32  Delay;
+  UINT32  Backoff;
+
+  Delay = 0;
+  if (PcdGet8 (PcdIpmiKcsPollPolicy) == KCS_POLL_POLICY_ADAPTIVE) {
+    if (Poll > PcdGet8 (PcdIpmiKcsPollSpinCount)) {
+      Backoff = Poll - PcdGet8 (PcdIpmiKcsPollSpinCount) - 1;
+      Delay   = (Backoff < 16) ? (1 << Backoff) : MAX_UINT16;
+      Delay   = MIN (Delay, PcdGet16 (PcdIpmiKcsPollMaxDelay));
+    }
+  } else {
+    Delay = IPMI_DELAY_UNIT;
+  }
+
+  if (Delay != 0) {
+    IpmiDeadlineDelay (&Deadline->Time, Delay);
+  }
+
+  Deadline->StatusReads++;
+  Deadline->IoOperations++;
+  return KcsRegisterRead (KCS_STATUS_REGISTER);
+}
+
+/**
+  Reads the KCS data register.
+
+  @param[in,out]  Deadline    The deadline of the transaction.
+
+  @retval   The value of the data register.
+**/
+UINT8
+KcsReadData (
+  IN OUT KCS_DEADLINE  *Deadline
+  )
+{
+  Deadline->IoOperations++;
+  return KcsRegisterRead (KCS_DATA_REGISTER);
+}
+
+/**
+  Writes the KCS data register.
+
+  @param[in,out]  Deadline    The deadline of the transaction.
+  @param[in]      Value       The value to write.
+**/
+VOID
+KcsWriteData (
+  IN OUT KCS_DEADLINE  *Deadline,
+  IN     UINT8         Value
+  )
+{
+  Deadline->IoOperations++;
+  KcsRegisterWrite (KCS_DATA_REGISTER, Value);
+}
+
+/**
+  Writes the KCS command register.
+
+  @param[in,out]  Deadline    The deadline of the transaction.
+  @param[in]      Value       The control code to write.
+**/
+VOID
+KcsWriteCommand (
+  IN OUT KCS_DEADLINE  *Deadline,
+  IN     UINT8         Value
+  )
+{
+  Deadline->IoOperations++;
+  KcsRegisterWrite (KCS_STATUS_REGISTER, Value);
+}
+
+/**
+  Waits for the BMC to take the last byte written to the interface. The wait
+  ends once IBF is clear and, if WaitObf is set, OBF is set or the interface
+  has left the read and idle states. A BMC that keeps up therefore costs a
+  single status read per byte transition.
+
+  @param[in,out]  Deadline    The deadline of the transaction.
+  @param[in]      WaitObf     TRUE to also wait for a byte from the BMC.
+  @param[out]     KcsStatus   The status read that ended the wait.
+
+  @retval   EFI_SUCCESS         The interface is ready for the next transition.
+  @retval   EFI_DEVICE_ERROR    The interface is not present or the deadline
+                                has passed.
+**/
+EFI_STATUS
+KcsWaitStatus (
+  IN OUT KCS_DEADLINE  *Deadline,
+  IN     BOOLEAN       WaitObf,
+  OUT    KCS_STATUS    *KcsStatus
+  )
+{
+  UINT32  Poll;
+
+  Poll = 0;
+  while (TRUE) {
+    KcsStatus->RawData = KcsPollStatus (Deadline, Poll++);
+    if (KcsStatus->RawData == 0xFF) {
+      return EFI_DEVICE_ERROR;
+    }
+
+    if (!KcsStatus->Status.Ibf &&
+        (!WaitObf || KcsStatus->Status.Obf ||
+         ((KcsStatus->Status.State != KcsReadState) && (KcsStatus->Status.State != KcsIdleState))))
+    {
+      return EFI_SUCCESS;
+    }
+
+    if (IpmiDeadlineExpired (&Deadline->Time)) {
+      return EFI_DEVICE_ERROR;
+    }
+  }
+}
+
 EFI_STATUS
 KcsErrorExit (
-  UINT64  IpmiTimeoutPeriod
+  KCS_DEADLINE  *Deadline,
+  UINT64        TimeoutUs
   )
 
 /**
 
 Routine Description:
 
-  Check the KCS error status
+  Abort the current KCS transaction and check the KCS error status. The abort
+  sequence runs under its own deadline, since it usually follows a transaction
+  whose deadline has already passed.
 
 Arguments:
 
-  IpmiTimeoutPeriod     - The period wait before timeout
+  Deadline              - The deadline of the transaction; the accesses of the
+                          abort sequence are added to its counters
+  TimeoutUs             - The budget of the abort sequence in microseconds
 
 Returns:
 
@@ -68,112 +325,85 @@ Returns:
 
 **/
 {
-  EFI_STATUS  Status;
-  UINT8       KcsData;
-  KCS_STATUS  KcsStatus;
-  UINT16      KcsPort;
-  UINT16      KcsCmdReg;
-  UINT8       RetryCount;
-  UINT64      TimeOut;
-
-  KcsPort    = PcdGet16 (PcdIpmiIoBaseAddress);
-  KcsCmdReg  = PcdGet16 (PcdIpmiIoCmdRegister);
-  TimeOut    = 0;
+  EFI_STATUS    Status;
+  KCS_STATUS    KcsStatus;
+  UINT8         RetryCount;
+  UINT32        Poll;
+  KCS_DEADLINE  Abort;
+
+  KcsStartDeadline (&Abort, TimeoutUs);
+
   RetryCount = 0;
   while (RetryCount < KCS_ABORT_RETRY_COUNT) {
-    TimeOut = 0;
+    Poll = 0;
     do {
-      MicroSecondDelay (IPMI_DELAY_UNIT);
-      KcsStatus.RawData = IoRead8 (KcsCmdReg);
-      if ((KcsStatus.RawData == 0xFF) || (TimeOut >= IpmiTimeoutPeriod)) {
+      KcsStatus.RawData = KcsPollStatus (&Abort, Poll++);
+      if ((KcsStatus.RawData == 0xFF) || IpmiDeadlineExpired (&Abort.Time)) {
         RetryCount = KCS_ABORT_RETRY_COUNT;
         break;
       }
-
-      TimeOut++;
     } while (KcsStatus.Status.Ibf);
 
     if (RetryCount >= KCS_ABORT_RETRY_COUNT) {
       break;
     }
 
-    KcsData = KCS_ABORT;
-    IoWrite8 ((KcsCmdReg), KcsData);
+    KcsWriteCommand (&Abort, KCS_ABORT);
 
-    TimeOut = 0;
+    Poll = 0;
     do {
-      MicroSecondDelay (IPMI_DELAY_UNIT);
-      KcsStatus.RawData = IoRead8 (KcsCmdReg);
-      if ((KcsStatus.RawData == 0xFF) || (TimeOut >= IpmiTimeoutPeriod)) {
+      KcsStatus.RawData = KcsPollStatus (&Abort, Poll++);
+      if ((KcsStatus.RawData == 0xFF) || IpmiDeadlineExpired (&Abort.Time)) {
         Status = EFI_DEVICE_ERROR;
         goto LabelError;
       }
-
-      TimeOut++;
     } while (KcsStatus.Status.Ibf);
 
-    KcsData = IoRead8 (KcsPort);
-
-    KcsData = 0x0;
-    IoWrite8 (KcsPort, KcsData);
+    KcsReadData (&Abort);
+    KcsWriteData (&Abort, 0x0);
 
-    TimeOut = 0;
+    Poll = 0;
     do {
-      MicroSecondDelay (IPMI_DELAY_UNIT);
-      KcsStatus.RawData = IoRead8 (KcsCmdReg);
-      if ((KcsStatus.RawData == 0xFF) || (TimeOut >= IpmiTimeoutPeriod)) {
+      KcsStatus.RawData = KcsPollStatus (&Abort, Poll++);
+      if ((KcsStatus.RawData == 0xFF) || IpmiDeadlineExpired (&Abort.Time)) {
         Status = EFI_DEVICE_ERROR;
         goto LabelError;
       }
-
-      TimeOut++;
     } while (KcsStatus.Status.Ibf);
 
     if (KcsStatus.Status.State == KcsReadState) {
-      TimeOut = 0;
+      Poll = 0;
       do {
-        MicroSecondDelay (IPMI_DELAY_UNIT);
-        KcsStatus.RawData = IoRead8 (KcsCmdReg);
-        if ((KcsStatus.RawData == 0xFF) || (TimeOut >= IpmiTimeoutPeriod)) {
+        KcsStatus.RawData = KcsPollStatus (&Abort, Poll++);
+        if ((KcsStatus.RawData == 0xFF) || IpmiDeadlineExpired (&Abort.Time)) {
           Status = EFI_DEVICE_ERROR;
           goto LabelError;
         }
-
-        TimeOut++;
       } while (!KcsStatus.Status.Obf);
 
-      // BmcStatus = IoRead8 (KcsPort);   // MU_CHANGE
-      IoRead8 (KcsPort);                  // MU_CHANGE
-
-      KcsData = KCS_READ;
-      IoWrite8 (KcsPort, KcsData);
+      KcsReadData (&Abort);
+      KcsWriteData (&Abort, KCS_READ);
 
-      TimeOut = 0;
+      Poll = 0;
       do {
-        MicroSecondDelay (IPMI_DELAY_UNIT);
-        KcsStatus.RawData = IoRead8 (KcsCmdReg);
-        if ((KcsStatus.RawData == 0xFF) || (TimeOut >= IpmiTimeoutPeriod)) {
+        KcsStatus.RawData = KcsPollStatus (&Abort, Poll++);
+        if ((KcsStatus.RawData == 0xFF) || IpmiDeadlineExpired (&Abort.Time)) {
           Status = EFI_DEVICE_ERROR;
           goto LabelError;
         }
-
-        TimeOut++;
       } while (KcsStatus.Status.Ibf);
 
       if (KcsStatus.Status.State == KcsIdleState) {
-        TimeOut = 0;
+        Poll = 0;
         do {
-          MicroSecondDelay (IPMI_DELAY_UNIT);
-          KcsStatus.RawData = IoRead8 (KcsCmdReg);
-          if ((KcsStatus.RawData == 0xFF) || (TimeOut >= IpmiTimeoutPeriod)) {
+          KcsStatus.RawData = KcsPollStatus (&Abort, Poll++);
+          if ((KcsStatus.RawData == 0xFF) || IpmiDeadlineExpired (&Abort.Time)) {
             Status = EFI_DEVICE_ERROR;
             goto LabelError;
           }
-
-          TimeOut++;
         } while (!KcsStatus.Status.Obf);
 
-        KcsData = IoRead8 (KcsPort);
+        KcsReadData (&Abort);
         break;
       } else {
         RetryCount++;
@@ -190,241 +420,313 @@ Returns:
     goto LabelError;
   }
 
-  return EFI_SUCCESS;
+  Status = EFI_SUCCESS;
 
 LabelError:
+  Deadline->StatusReads  += Abort.StatusReads;
+  Deadline->IoOperations += Abort.IoOperations;
   return Status;
 }
 
 EFI_STATUS
-KcsCheckStatus (
-  UINT64     IpmiTimeoutPeriod,
-  KCS_STATE  KcsState,
-  BOOLEAN    *Idle
+SendDataToBmc (
+  KCS_DEADLINE  *Deadline,
+  UINT8         *Header,
+  UINT8         HeaderSize,
+  UINT8         *Data,
+  UINT32        DataSize
   )
 
 /**
 
 Routine Description:
 
-  Ckeck KCS status
+  Send data to BMC. The header bytes are sent first followed by the data bytes.
 
 Arguments:
 
-  IpmiTimeoutPeriod  - The period to wait before timeout
-  KcsState           - The state of KCS to be checked
-  Idle               - If the KCS is idle
+  Deadline           - The deadline of the transaction
+  Header             - The header pointer to be sent
+  HeaderSize         - The header size
+  Data               - The data pointer to be sent
+  DataSize           - The data size
 
 Returns:
 
-  @retval EFI_SUCCESS   - Checked the KCS status successfully
+  @retval EFI_SUCCESS   - Send out the data successfully
 
 **/
 {
-  EFI_STATUS  Status;
-  KCS_STATUS  KcsStatus;
-  UINT16      KcsPort;
-  UINT16      KcsCmdReg;
-  UINT64      TimeOut;
+  KCS_STATUS      KcsStatus;
+  KCS_SEND_PHASE  Phase;
+  EFI_STATUS      Status;
+  UINT32          i;
+  UINT32          TotalSize;
 
-  if (Idle == NULL) {
-    return EFI_INVALID_PARAMETER;
-  }
+  TotalSize = HeaderSize + DataSize;
+  i         = 0;
+  Phase     = KcsSendStart;
 
-  *Idle = FALSE;
+  //
+  // Every transition writes one control code or byte after a single wait for
+  // IBF. From WRITE_START on the interface must stay in the write state, and
+  // OBF is only cleared when the same status read shows it set.
+  //
+  while (Phase != KcsSendDone) {
+    Status = KcsWaitStatus (Deadline, FALSE, &KcsStatus);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
 
-  TimeOut   = 0;
-  KcsPort   = PcdGet16 (PcdIpmiIoBaseAddress);
-  KcsCmdReg = PcdGet16 (PcdIpmiIoCmdRegister);
-  do {
-    MicroSecondDelay (IPMI_DELAY_UNIT);
-    KcsStatus.RawData = IoRead8 (KcsCmdReg);
-    if ((KcsStatus.RawData == 0xFF) || (TimeOut >= IpmiTimeoutPeriod)) {
-      Status = EFI_DEVICE_ERROR;
-      goto LabelError;
+    if ((Phase != KcsSendStart) && (KcsStatus.Status.State != KcsWriteState)) {
+      return EFI_DEVICE_ERROR;
     }
 
-    TimeOut++;
-  } while (KcsStatus.Status.Ibf);
+    if (KcsStatus.Status.Obf) {
+      KcsReadData (Deadline);
+    }
 
-  if (KcsState == KcsWriteState) {
-    // KcsData = IoRead8 (KcsPort);   // MU_CHANGE
-    IoRead8 (KcsPort);                // MU_CHANGE
-  }
+    switch (Phase) {
+      case KcsSendStart:
+        KcsWriteCommand (Deadline, KCS_WRITE_START);
+        Phase = (TotalSize > 1) ? KcsSendByte : KcsSendEnd;
+        break;
 
-  if (KcsStatus.Status.State != KcsState) {
-    if ((KcsStatus.Status.State == KcsIdleState) && (KcsState == KcsReadState)) {
-      *Idle = TRUE;
-    } else {
-      Status = KcsErrorExit (IpmiTimeoutPeriod);
-      goto LabelError;
-    }
-  }
+      case KcsSendByte:
+        KcsWriteData (Deadline, (i < HeaderSize) ? Header[i] : Data[i - HeaderSize]);
+        i++;
+        if (i == (TotalSize - 1)) {
+          Phase = KcsSendEnd;
+        }
 
-  if (KcsState == KcsReadState) {
-    TimeOut = 0;
-    do {
-      MicroSecondDelay (IPMI_DELAY_UNIT);
-      KcsStatus.RawData = IoRead8 (KcsCmdReg);
-      if ((KcsStatus.RawData == 0xFF) || (TimeOut >= IpmiTimeoutPeriod)) {
-        Status = EFI_DEVICE_ERROR;
-        goto LabelError;
-      }
+        break;
 
-      TimeOut++;
-    } while (!KcsStatus.Status.Obf);
-  }
+      case KcsSendEnd:
+        KcsWriteCommand (Deadline, KCS_WRITE_END);
+        Phase = KcsSendLast;
+        break;
 
-  if ((KcsState == KcsWriteState) || (*Idle == TRUE)) {
-    // KcsData = IoRead8 (KcsPort);   // MU_CHANGE
-    IoRead8 (KcsPort);                // MU_CHANGE
+      default:
+        KcsWriteData (Deadline, (i < HeaderSize) ? Header[i] : Data[i - HeaderSize]);
+        Phase = KcsSendDone;
+        break;
+    }
   }
 
   return EFI_SUCCESS;
-
-LabelError:
-  return Status;
 }
 
 EFI_STATUS
-SendDataToBmc (
-  UINT64  IpmiTimeoutPeriod,
-  UINT8   *Data,
-  UINT8   DataSize
+ReceiveBmcData (
+  KCS_DEADLINE  *Deadline,
+  UINT8         *Header,
+  UINT8         HeaderSize,
+  UINT8         *Data,
+  UINT32        *DataSize
   )
 
 /**
 
 Routine Description:
 
-  Send data to BMC
+  Receive data from BMC. The first HeaderSize bytes are stored in Header and
+  the rest are stored directly in Data. Bytes that do not fit in Data are
+  drained from the BMC so the transaction still completes.
 
 Arguments:
 
-  IpmiTimeoutPeriod  - The period to wait before timeout
-  Data               - The data pointer to be sent
-  DataSize           - The data size
+  Deadline           - The deadline of the transaction
+  Header             - The header buffer pointer
+  HeaderSize         - The header buffer size
+  Data               - The buffer pointer
+  DataSize           - The buffer size on input, the received data size on output
 
 Returns:
 
-  @retval EFI_SUCCESS   - Send out the data successfully
+  @retval EFI_SUCCESS           - Received data successfully
+  @retval EFI_BUFFER_TOO_SMALL  - The data did not fit in the buffer, DataSize
+                                  is the required size
 
 **/
 {
-  KCS_STATUS  KcsStatus;
   UINT8       KcsData;
-  UINT16      KcsIoBase;
-  UINT16      KcsCmdReg;
+  KCS_STATUS  KcsStatus;
   EFI_STATUS  Status;
-  UINT8       i;
-  BOOLEAN     Idle;
-  UINT64      TimeOut;
-
-  KcsIoBase = PcdGet16 (PcdIpmiIoBaseAddress);
-  KcsCmdReg = PcdGet16 (PcdIpmiIoCmdRegister);
-  TimeOut   = 0;
-
-  do {
-    MicroSecondDelay (IPMI_DELAY_UNIT);
-    KcsStatus.RawData = IoRead8 (KcsCmdReg);
-    if ((KcsStatus.RawData == 0xFF) || (TimeOut >= IpmiTimeoutPeriod)) {
-      if ((Status = KcsErrorExit (IpmiTimeoutPeriod)) != EFI_SUCCESS) {
-        return Status;
-      }
-    }
+  UINT32      Count;
+  UINT32      BodySize;
 
-    TimeOut++;
-  } while (KcsStatus.Status.Ibf);
+  Count = 0;
 
-  KcsData = KCS_WRITE_START;
-  IoWrite8 ((KcsCmdReg), KcsData);
-  if ((Status = KcsCheckStatus (IpmiTimeoutPeriod, KcsWriteState, &Idle)) != EFI_SUCCESS) {
-    return Status;
-  }
+  //
+  // Every transition takes one byte after a single wait for IBF clear and OBF
+  // set. The read state hands out a byte of the response, the idle state a
+  // dummy byte that ends it.
+  //
+  while (TRUE) {
+    Status = KcsWaitStatus (Deadline, TRUE, &KcsStatus);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
 
-  for (i = 0; i < DataSize; i++) {
-    if (i == (DataSize - 1)) {
-      if ((Status = KcsCheckStatus (IpmiTimeoutPeriod, KcsWriteState, &Idle)) != EFI_SUCCESS) {
-        return Status;
-      }
+    if (KcsStatus.Status.State == KcsIdleState) {
+      KcsReadData (Deadline);
+      break;
+    }
 
-      KcsData = KCS_WRITE_END;
-      IoWrite8 ((KcsCmdReg), KcsData);
+    if (KcsStatus.Status.State != KcsReadState) {
+      return EFI_DEVICE_ERROR;
     }
 
-    Status = KcsCheckStatus (IpmiTimeoutPeriod, KcsWriteState, &Idle);
-    if (EFI_ERROR (Status)) {
-      return Status;
+    //
+    // A body longer than the KCS limit is a protocol error from the BMC.
+    //
+    if (Count >= (UINT32)HeaderSize + KCS_MAX_MESSAGE_SIZE) {
+      return EFI_DEVICE_ERROR;
     }
 
-    IoWrite8 (KcsIoBase, Data[i]);
+    KcsData = KcsReadData (Deadline);
+    if (Count < HeaderSize) {
+      Header[Count] = KcsData;
+    } else if ((Count - HeaderSize) < *DataSize) {
+      Data[Count - HeaderSize] = KcsData;
+    }
+
+    Count++;
+
+    KcsWriteData (Deadline, KCS_READ);
   }
 
+  BodySize = (Count > HeaderSize) ? (Count - HeaderSize) : 0;
+  if (BodySize > *DataSize) {
+    *DataSize = BodySize;
+    return EFI_BUFFER_TOO_SMALL;
+  }
+
+  *DataSize = BodySize;
   return EFI_SUCCESS;
 }
 
 EFI_STATUS
-ReceiveBmcData (
-  UINT64  IpmiTimeoutPeriod,
-  UINT8   *Data,
-  UINT8   *DataSize
+CheckBmcResponseReady (
+  VOID
   )
 
 /**
 
 Routine Description:
 
-  Routine Description:
+  Check without waiting whether the BMC has started returning the response.
+  Error states are also reported as ready so that the receive handles them.
 
-  Receive data from BMC
+Returns:
+
+  @retval EFI_SUCCESS     - The response can be received
+  @retval EFI_NOT_READY   - The BMC is still processing the request
+
+**/
+{
+  KCS_STATUS  KcsStatus;
+
+  KcsStatus.RawData = KcsRegisterRead (KCS_STATUS_REGISTER);
+  if ((KcsStatus.RawData == 0xFF) || (KcsStatus.Status.State == KcsErrorState)) {
+    return EFI_SUCCESS;
+  }
+
+  if ((KcsStatus.Status.Obf == 1) && (KcsStatus.Status.Ibf == 0)) {
+    return EFI_SUCCESS;
+  }
+
+  return EFI_NOT_READY;
+}
+
+VOID
+GetBmcMaxMessageSize (
+  OUT UINT32  *MaxRequestSize,
+  OUT UINT32  *MaxResponseSize
+  )
+
+/**
+
+Routine Description:
+
+  Get the largest message bodies the KCS transport carries
 
 Arguments:
 
-  IpmiTimeoutPeriod  - The period to wait before timeout
-  Data               - The buffer pointer
+  MaxRequestSize     - The largest request body in bytes
+  MaxResponseSize    - The largest response body in bytes
+
+**/
+{
+  *MaxRequestSize  = KCS_MAX_MESSAGE_SIZE;
+  *MaxResponseSize = KCS_MAX_MESSAGE_SIZE;
+}
+
+EFI_STATUS
+ReceiveBmcDataFromPortEx (
+  UINT64  TimeoutUs,
+  UINT8   *Header,
+  UINT8   HeaderSize,
+  UINT8   *Data,
+  UINT32  *DataSize
+  )
+
+/**
+
+Routine Description:
+
+  Receive data from BMC, splitting the message between a header buffer and a
+  data buffer.
+
+Arguments:
+
+  TimeoutUs          - The time budget in microseconds
+  Header             - The buffer pointer to receive the header
+  HeaderSize         - The header size
+  Data               - The buffer pointer to receive data
   DataSize           - The buffer size
 
 Returns:
 
-  @retval EFI_SUCCESS   - Received data successfully
+  @retval EFI_SUCCESS           - Received the data successfully
+  @retval EFI_BUFFER_TOO_SMALL  - The data did not fit in the buffer
 
 **/
 {
-  UINT8       KcsData;
-  UINT16      KcsIoBase;
-  EFI_STATUS  Status;
-  BOOLEAN     Idle;
-  UINT8       Count;
+  EFI_STATUS    Status;
+  UINT8         i;
+  UINT32        MyDataSize;
+  KCS_DEADLINE  Deadline;
 
-  Count     = 0;
-  KcsIoBase = PcdGet16 (PcdIpmiIoBaseAddress);
+  MyDataSize = *DataSize;
+  KcsStartDeadline (&Deadline, TimeoutUs);
 
-  while (TRUE) {
-    if ((Status = KcsCheckStatus (IpmiTimeoutPeriod, KcsReadState, &Idle)) != EFI_SUCCESS) {
-      return Status;
+  Status = EFI_DEVICE_ERROR;
+  for (i = 0; i < KCS_ABORT_RETRY_COUNT; i++) {
+    Status = ReceiveBmcData (&Deadline, Header, HeaderSize, Data, DataSize);
+    if (!EFI_ERROR (Status) || (Status == EFI_BUFFER_TOO_SMALL)) {
+      break;
     }
 
-    if (Idle) {
-      *DataSize = Count;
+    if ((Status = KcsErrorExit (&Deadline, TimeoutUs)) != EFI_SUCCESS) {
       break;
     }
 
     //
-    // Need to check Data Size -1 to account for array access
+    // The abort leaves the interface idle, but there is no time left to retry
+    // the transaction in.
     //
-    if (Count >= *DataSize) {
-      return EFI_DEVICE_ERROR;
+    if (IpmiDeadlineExpired (&Deadline.Time)) {
+      Status = EFI_DEVICE_ERROR;
+      break;
     }
 
-    Data[Count] = IoRead8 (KcsIoBase);
-
-    Count++;
-
-    KcsData = KCS_READ;
-    IoWrite8 (KcsIoBase, KcsData);
+    *DataSize = MyDataSize;
+    Status    = EFI_DEVICE_ERROR;
   }
 
-  return EFI_SUCCESS;
+  DEBUG ((DEBUG_VERBOSE, "IPMI: KCS receive - %r after %d status reads, %d I/O operations\n", Status, Deadline.StatusReads, Deadline.IoOperations));
+  return Status;
 }
 
 EFI_STATUS
@@ -442,7 +744,7 @@ Routine Description:
 
 Arguments:
 
-  IpmiTimeoutPeriod  - The period to wait before timeout
+  IpmiTimeoutPeriod  - The timeout in units of IPMI_TRANSPORT_DELAY_UNIT
   Data               - The buffer pointer to receive data
   DataSize           - The buffer size
 
@@ -453,25 +755,78 @@ Returns:
 **/
 {
   EFI_STATUS  Status;
-  UINT8       i;
-  UINT8       MyDataSize;
+  UINT32      Size;
 
-  MyDataSize = *DataSize;
+  Size      = *DataSize;
+  Status    = ReceiveBmcDataFromPortEx (MultU64x32 (IpmiTimeoutPeriod, IPMI_TRANSPORT_DELAY_UNIT), NULL, 0, Data, &Size);
+  *DataSize = (UINT8)MIN (Size, MAX_UINT8);
+  return Status;
+}
+
+EFI_STATUS
+SendDataToBmcPortEx (
+  UINT64  TimeoutUs,
+  UINT8   *Header,
+  UINT8   HeaderSize,
+  UINT8   *Data,
+  UINT32  DataSize
+  )
+
+/**
+
+Routine Description:
+
+  Send data to BMC, taking the header and the data from separate buffers
+
+Arguments:
+
+  TimeoutUs          - The time budget in microseconds
+  Header             - The header pointer to be sent
+  HeaderSize         - The header size
+  Data               - The data pointer to be sent
+  DataSize           - The data size
+
+Returns:
+
+  @retval EFI_SUCCESS   - Send out the data successfully
 
+**/
+{
+  EFI_STATUS    Status;
+  UINT8         i;
+  KCS_DEADLINE  Deadline;
+
+  if (((HeaderSize == 0) && (DataSize == 0)) || (DataSize > KCS_MAX_MESSAGE_SIZE)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  KcsStartDeadline (&Deadline, TimeoutUs);
+
+  Status = EFI_DEVICE_ERROR;
   for (i = 0; i < KCS_ABORT_RETRY_COUNT; i++) {
-    Status = ReceiveBmcData (IpmiTimeoutPeriod, Data, DataSize);
-    if (EFI_ERROR (Status)) {
-      if ((Status = KcsErrorExit (IpmiTimeoutPeriod)) != EFI_SUCCESS) {
-        return Status;
-      }
+    Status = SendDataToBmc (&Deadline, Header, HeaderSize, Data, DataSize);
+    if (!EFI_ERROR (Status)) {
+      break;
+    }
 
-      *DataSize = MyDataSize;
-    } else {
-      return Status;
+    if ((Status = KcsErrorExit (&Deadline, TimeoutUs)) != EFI_SUCCESS) {
+      break;
     }
+
+    //
+    // The abort leaves the interface idle, but there is no time left to retry
+    // the transaction in.
+    //
+    if (IpmiDeadlineExpired (&Deadline.Time)) {
+      Status = EFI_DEVICE_ERROR;
+      break;
+    }
+
+    Status = EFI_DEVICE_ERROR;
   }
 
-  return EFI_DEVICE_ERROR;
+  DEBUG ((DEBUG_VERBOSE, "IPMI: KCS send - %r after %d status reads, %d I/O operations\n", Status, Deadline.StatusReads, Deadline.IoOperations));
+  return Status;
 }
 
 EFI_STATUS
@@ -489,7 +844,7 @@ Routine Description:
 
 Arguments:
 
-  IpmiTimeoutPeriod  - The period to wait before timeout
+  IpmiTimeoutPeriod  - The timeout in units of IPMI_TRANSPORT_DELAY_UNIT
   Data               - The data pointer to be sent
   DataSize           - The data size
 
@@ -499,19 +854,5 @@ Returns:
 
 **/
 {
-  EFI_STATUS  Status;
-  UINT8       i;
-
-  for (i = 0; i < KCS_ABORT_RETRY_COUNT; i++) {
-    Status = SendDataToBmc (IpmiTimeoutPeriod, Data, DataSize);
-    if (EFI_ERROR (Status)) {
-      if ((Status = KcsErrorExit (IpmiTimeoutPeriod)) != EFI_SUCCESS) {
-        return Status;
-      }
-    } else {
-      return Status;
-    }
-  }
-
-  return EFI_DEVICE_ERROR;
+  return SendDataToBmcPortEx (MultU64x32 (IpmiTimeoutPeriod, IPMI_TRANSPORT_DELAY_UNIT), NULL, 0, Data, DataSize);
 }
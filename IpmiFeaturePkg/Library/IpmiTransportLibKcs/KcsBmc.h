@@ -14,14 +14,39 @@
 #include <Library/IoLib.h>
 #include <Library/DebugLib.h>
 #include <Library/TimerLib.h>
+#include <Library/IpmiDeadlineLib.h>
 #include <Library/IpmiPlatformLib.h>
+#include <Library/IpmiTransportLib.h>
+#include <Library/IpmiTransportExLib.h>
+#include <IndustryStandard/Acpi.h>
 
 #define KCS_WRITE_START  0x61
 #define KCS_WRITE_END    0x62
 #define KCS_READ         0x68
 #define KCS_GET_STATUS   0x60
 #define KCS_ABORT        0x60
-#define IPMI_DELAY_UNIT  50        // [s] Each KSC IO delay
+#define IPMI_DELAY_UNIT  50        // [us] Each KSC IO delay
+
+//
+// Index of the KCS registers. With MMIO access they are PcdIpmiRegisterBitWidth
+// bits apart from PcdIpmiAddress, with port I/O they are at PcdIpmiIoBaseAddress
+// and PcdIpmiIoCmdRegister. The status register is written as the command
+// register.
+//
+#define KCS_DATA_REGISTER    0
+#define KCS_STATUS_REGISTER  1
+
+//
+// KCS itself does not limit the message size. This bounds the message bodies
+// accepted in either direction, and the bytes drained from a misbehaving BMC.
+//
+#define KCS_MAX_MESSAGE_SIZE  SIZE_4KB
+
+//
+// Values of PcdIpmiKcsPollPolicy.
+//
+#define KCS_POLL_POLICY_FIXED     0
+#define KCS_POLL_POLICY_ADAPTIVE  1
 
 //
 // In OpenBMC, UpdateMode: the bit 7 of byte 4 in get device id command is used for the BMC status:
@@ -53,46 +78,116 @@ typedef union {
   } Status;
 } KCS_STATUS;
 
-EFI_STATUS
-KcsCheckStatus (
-  UINT64     IpmiTimeoutPeriod,
-  KCS_STATE  KcsState,
-  BOOLEAN    *Idle
-  )
+//
+// Deadline of a KCS transaction. StatusReads counts the status register reads
+// made by the transaction and IoOperations all of its port accesses.
+//
+typedef struct {
+  IPMI_DEADLINE    Time;
+  UINT32           StatusReads;
+  UINT32           IoOperations;
+} KCS_DEADLINE;
 
-/*++
+//
+// Transitions of the KCS write phase.
+//
+typedef enum {
+  KcsSendStart,
+  KcsSendByte,
+  KcsSendEnd,
+  KcsSendLast,
+  KcsSendDone
+} KCS_SEND_PHASE;
+
+/**
+  Starts the deadline of a KCS transaction.
+
+  @param[out] Deadline            The deadline to start.
+  @param[in]  IpmiTimeoutPeriod   The time budget in microseconds.
+**/
+VOID
+KcsStartDeadline (
+  OUT KCS_DEADLINE  *Deadline,
+  IN  UINT64        IpmiTimeoutPeriod
+  );
 
-Routine Description:
+/**
+  Reads a KCS register through port I/O or MMIO, as selected by
+  PcdIpmiAddressSpaceId.
 
-  Ckeck KCS status
+  @param[in]  Register    KCS_DATA_REGISTER or KCS_STATUS_REGISTER.
 
-Arguments:
+  @retval   The value of the register.
+**/
+UINT8
+KcsRegisterRead (
+  IN UINT8  Register
+  );
 
-  IpmiInstance  - The pointer of IPMI_BMC_INSTANCE_DATA
-  KcsState      - The state of KCS to be checked
-  Idle          - If the KCS is idle
+/**
+  Writes a KCS register through port I/O or MMIO, as selected by
+  PcdIpmiAddressSpaceId.
 
-Returns:
+  @param[in]  Register    KCS_DATA_REGISTER or KCS_STATUS_REGISTER.
+  @param[in]  Value       The value to write.
+**/
+VOID
+KcsRegisterWrite (
+  IN UINT8  Register,
+  IN UINT8  Value
+  );
 
-  EFI_SUCCESS   - Checked the KCS status successfully
+/**
+  Reads the KCS status register for a wait of a transaction, delaying first as
+  required by PcdIpmiKcsPollPolicy.
 
---*/
-;
+  @param[in,out]  Deadline    The deadline of the transaction.
+  @param[in]      Poll        The number of reads already made by this wait.
+
+  @retval   The value of the status register.
+**/
+UINT8
+KcsPollStatus (
+  IN OUT KCS_DEADLINE  *Deadline,
+  IN     UINT32        Poll
+  );
+
+/**
+  Waits for the BMC to take the last byte written to the interface. The wait
+  ends once IBF is clear and, if WaitObf is set, OBF is set or the interface
+  has left the read and idle states.
+
+  @param[in,out]  Deadline    The deadline of the transaction.
+  @param[in]      WaitObf     TRUE to also wait for a byte from the BMC.
+  @param[out]     KcsStatus   The status read that ended the wait.
+
+  @retval   EFI_SUCCESS         The interface is ready for the next transition.
+  @retval   EFI_DEVICE_ERROR    The interface is not present or the deadline
+                                has passed.
+**/
+EFI_STATUS
+KcsWaitStatus (
+  IN OUT KCS_DEADLINE  *Deadline,
+  IN     BOOLEAN       WaitObf,
+  OUT    KCS_STATUS    *KcsStatus
+  );
 
 EFI_STATUS
 KcsErrorExit (
-  UINT64  IpmiTimeoutPeriod
+  KCS_DEADLINE  *Deadline,
+  UINT64        TimeoutUs
   )
 
 /*++
 
 Routine Description:
 
-  Check the KCS error status
+  Abort the current KCS transaction and check the KCS error status
 
 Arguments:
 
-  IpmiInstance     - The pointer of IPMI_BMC_INSTANCE_DATA
+  Deadline         - The deadline of the transaction
+  TimeoutUs        - The budget of the abort sequence in microseconds
 
 Returns:
 
@@ -104,9 +199,11 @@ Returns:
 
 EFI_STATUS
 SendDataToBmc (
-  UINT64  IpmiTimeoutPeriod,
-  UINT8   *Data,
-  UINT8   DataSize
+  KCS_DEADLINE  *Deadline,
+  UINT8         *Header,
+  UINT8         HeaderSize,
+  UINT8         *Data,
+  UINT32        DataSize
   )
 
 /*++
@@ -117,7 +214,9 @@ Routine Description:
 
 Arguments:
 
-  IpmiInstance  - The pointer of IPMI_BMC_INSTANCE_DATA
+  Deadline      - The deadline of the transaction
+  Header        - The header pointer to be sent
+  HeaderSize    - The header size
   Data          - The data pointer to be sent
   DataSize      - The data size
 
@@ -130,9 +229,11 @@ Returns:
 
 EFI_STATUS
 ReceiveBmcData (
-  UINT64  IpmiTimeoutPeriod,
-  UINT8   *Data,
-  UINT8   *DataSize
+  KCS_DEADLINE  *Deadline,
+  UINT8         *Header,
+  UINT8         HeaderSize,
+  UINT8         *Data,
+  UINT32        *DataSize
   )
 
 /*++
@@ -145,13 +246,16 @@ Routine Description:
 
 Arguments:
 
-  IpmiInstance  - The pointer of IPMI_BMC_INSTANCE_DATA
+  Deadline      - The deadline of the transaction
+  Header        - The header buffer pointer
+  HeaderSize    - The header buffer size
   Data          - The buffer pointer
   DataSize      - The buffer size
 
 Returns:
 
-  EFI_SUCCESS   - Received data successfully
+  EFI_SUCCESS           - Received data successfully
+  EFI_BUFFER_TOO_SMALL  - The data did not fit in the buffer
 
 --*/
 ;
@@ -7,6 +7,8 @@
 **/
 
 #include <Uefi.h>
+#include <Library/IpmiTransportLib.h>
+#include <Library/IpmiTransportExLib.h>
 
 /**
   Null implementation of SendDataToBmcPort.
@@ -46,6 +48,117 @@ ReceiveBmcDataFromPort (
   return EFI_SUCCESS;
 }
 
+/**
+  Null implementation of SendDataToBmcPortEx.
+
+  @param[in]  TimeoutUs             UNUSED.
+  @param[in]  Header                UNUSED.
+  @param[in]  HeaderSize            UNUSED.
+  @param[in]  Data                  UNUSED.
+  @param[in]  DataSize              UNUSED.
+
+  @retval   EFI_SUCCESS             Always.
+**/
+EFI_STATUS
+SendDataToBmcPortEx (
+  UINT64  TimeoutUs,
+  UINT8   *Header,
+  UINT8   HeaderSize,
+  UINT8   *Data,
+  UINT32  DataSize
+  )
+{
+  return EFI_SUCCESS;
+}
+
+/**
+  Null implementation of ReceiveBmcDataFromPortEx.
+
+  @param[in]  TimeoutUs             UNUSED.
+  @param[out] Header                UNUSED.
+  @param[in]  HeaderSize            UNUSED.
+  @param[out] Data                  UNUSED.
+  @param[out] DataSize              UNUSED.
+
+  @retval   EFI_SUCCESS             Always.
+**/
+EFI_STATUS
+ReceiveBmcDataFromPortEx (
+  UINT64  TimeoutUs,
+  UINT8   *Header,
+  UINT8   HeaderSize,
+  UINT8   *Data,
+  UINT32  *DataSize
+  )
+{
+  return EFI_SUCCESS;
+}
+
+/**
+  Null implementation of GetBmcMaxMessageSize. No limit is imposed.
+
+  @param[out]  MaxRequestSize     Set to MAX_UINT32.
+  @param[out]  MaxResponseSize    Set to MAX_UINT32.
+**/
+VOID
+GetBmcMaxMessageSize (
+  OUT UINT32  *MaxRequestSize,
+  OUT UINT32  *MaxResponseSize
+  )
+{
+  *MaxRequestSize  = MAX_UINT32;
+  *MaxResponseSize = MAX_UINT32;
+}
+
+/**
+  Null implementation of CheckBmcResponseReady.
+
+  @retval   EFI_UNSUPPORTED   Always.
+**/
+EFI_STATUS
+CheckBmcResponseReady (
+  VOID
+  )
+{
+  return EFI_UNSUPPORTED;
+}
+
+/**
+  Null implementation of IpmiTransportBeginSession.
+**/
+VOID
+IpmiTransportBeginSession (
+  VOID
+  )
+{
+}
+
+/**
+  Null implementation of IpmiTransportEndSession.
+**/
+VOID
+IpmiTransportEndSession (
+  VOID
+  )
+{
+}
+
+/**
+  Null implementation of IpmiTransportSetCapabilities.
+
+  @param[in]  InterfaceType         UNUSED.
+  @param[in]  Capabilities          UNUSED.
+  @param[in]  CapabilitiesSize      UNUSED.
+**/
+VOID
+IpmiTransportSetCapabilities (
+  IN UINT8   InterfaceType,
+  IN UINT8   *Capabilities,
+  IN UINT32  CapabilitiesSize
+  )
+{
+}
+
 /**
   Null implementation of InitializeIpmiTransportHardware.
 
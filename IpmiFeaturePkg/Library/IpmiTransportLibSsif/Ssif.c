@@ -11,42 +11,214 @@
 #include <Library/TimerLib.h>
 #include <Library/BaseMemoryLib.h>
 #include <Library/BmcSmbusLib.h>
+#include <Library/IpmiTransportLib.h>
+#include <Library/IpmiTransportExLib.h>
+#include <Library/IpmiDeadlineLib.h>
+#include <IpmiFeature.h>
 #include <Ssif.h>
 
+//
+// Nesting depth of transport sessions and whether the SMBus connection is
+// open. Outside a session the connection is opened and closed around every
+// send and receive. Where module globals are read only, as in PEI executing in
+// place, the depth stays 0 and every send and receive still closes it.
+//
+STATIC UINT32   mSsifSessionDepth = 0;
+STATIC BOOLEAN  mSsifBusOpen      = FALSE;
+
+//
+// Limits negotiated with the BMC through Get System Interface Capabilities,
+// counting the NetFn/LUN and command header. Until the BMC reports them, or
+// where module globals are read only, the limits of a BMC supporting start,
+// middle and end transactions are assumed.
+//
+STATIC UINT32   mSsifMaxWriteMessageSize = SSIF_MAX_WRITE_MESSAGE_SIZE;
+STATIC UINT32   mSsifMaxReadMessageSize  = SSIF_MAX_READ_MESSAGE_SIZE;
+STATIC BOOLEAN  mSsifMultiPartRead       = TRUE;
+
 /**
-  Sends an IPMI command message to the BMC over the SSIF transport.
+  Opens the SMBus connection for a send or receive unless a session already
+  holds it open.
 
-  @param[in]  IpmiTimeoutPeriod     The timeout of the IPMI send.
-  @param[in]  Command               The IMPI command to be sent.
-  @param[in]  DataSize              The size of the data in the IPMI command.
+  @retval   EFI_SUCCESS     The connection is open.
+  @retval   Other           An error was returned by BmcSmbusOpen.
+**/
+STATIC
+EFI_STATUS
+SsifBusOpen (
+  VOID
+  )
+{
+  EFI_STATUS  Status;
+
+  if (mSsifBusOpen) {
+    return EFI_SUCCESS;
+  }
+
+  Status = BmcSmbusOpen ();
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "[SSIF] Failed to open SMBus connection. %r\n", Status));
+    return Status;
+  }
+
+  mSsifBusOpen = TRUE;
+  return EFI_SUCCESS;
+}
+
+/**
+  Closes the SMBus connection after a send or receive unless a session holds
+  it open. After an SMBus error it is closed regardless, so the next
+  transaction starts from a fresh connection.
+
+  @param[in]  Status    The status of the send or receive.
+**/
+STATIC
+VOID
+SsifBusDone (
+  IN EFI_STATUS  Status
+  )
+{
+  if ((mSsifSessionDepth == 0) || (EFI_ERROR (Status) && (Status != EFI_BUFFER_TOO_SMALL))) {
+    BmcSmbusClose ();
+    mSsifBusOpen = FALSE;
+  }
+}
+
+/**
+  Gets a pointer to a contiguous block of message data that may span the header
+  and data buffers. If the block lies entirely within one buffer a pointer into
+  that buffer is returned, otherwise the block is gathered into the provided
+  scratch buffer.
+
+  @param[in]  Header          The message header bytes.
+  @param[in]  HeaderSize      The size of the message header.
+  @param[in]  Data            The message data bytes.
+  @param[in]  Offset          The offset of the block in the message.
+  @param[in]  Size            The size of the block.
+  @param[in]  Scratch         Scratch buffer of at least Size bytes.
+
+  @retval   A pointer to the contiguous block.
+**/
+STATIC
+UINT8 *
+SsifGetMessageBlock (
+  IN UINT8  *Header,
+  IN UINT8  HeaderSize,
+  IN UINT8  *Data,
+  IN UINT8  Offset,
+  IN UINT8  Size,
+  IN UINT8  *Scratch
+  )
+{
+  UINT8  HeaderPart;
+
+  if (Offset >= HeaderSize) {
+    return &Data[Offset - HeaderSize];
+  }
+
+  if ((Offset + Size) <= HeaderSize) {
+    return &Header[Offset];
+  }
+
+  HeaderPart = (UINT8)(HeaderSize - Offset);
+  CopyMem (Scratch, &Header[Offset], HeaderPart);
+  CopyMem (&Scratch[HeaderPart], Data, Size - HeaderPart);
+  return Scratch;
+}
+
+/**
+  Waits before the first read of a response is tried again. The wait ends early
+  when the platform signals through SMBALERT# that the response is ready.
+
+  @param[in,out]  Deadline    The time budget of the transaction.
+  @param[in]      Delay       The longest time to wait in microseconds.
+  @param[in,out]  UseAlert    TRUE to wait for SMBALERT#. Cleared if the
+                              platform does not support it.
+**/
+STATIC
+VOID
+SsifWaitForResponse (
+  IN OUT IPMI_DEADLINE  *Deadline,
+  IN     UINTN          Delay,
+  IN OUT BOOLEAN        *UseAlert
+  )
+{
+  if (*UseAlert) {
+    if (BmcSmbusWaitForAlert (Delay) != EFI_UNSUPPORTED) {
+      return;
+    }
+
+    *UseAlert = FALSE;
+  }
+
+  IpmiDeadlineDelay (Deadline, Delay);
+}
+
+/**
+  Checks whether SMBALERT# can be waited for under a deadline. A wait for
+  SMBALERT# may end early, so it can only be counted against the deadline
+  when the performance counter measures it.
+
+  @retval   TRUE      SMBALERT# may be waited for.
+  @retval   FALSE     The poll delays must be used.
+**/
+STATIC
+BOOLEAN
+SsifCanWaitForAlert (
+  VOID
+  )
+{
+  return (BOOLEAN)(GetPerformanceCounterProperties (NULL, NULL) != 0);
+}
+
+/**
+  Sends an IPMI command message to the BMC over the SSIF transport where the
+  message header and body are provided in separate buffers. A BMC that is busy
+  NAKs the first write, which is then tried again until the time budget of the
+  send is used.
+
+  @param[in]  TimeoutUs             The timeout of the IPMI send in microseconds.
+  @param[in]  Header                The message header to be sent first.
+  @param[in]  HeaderSize            The size of the message header.
+  @param[in]  Data                  The message body to be sent.
+  @param[in]  DataSize              The size of the message body.
 
   @retval   EFI_SUCCESS             The message was successfully sent.
   @retval   EFI_INVALID_PARAMETER   The command was invalid.
   @retval   Other errors            And error was returned by the SMBus stack.
 **/
 EFI_STATUS
-SendDataToBmcPort (
-  UINT64  IpmiTimeoutPeriod,
+SendDataToBmcPortEx (
+  UINT64  TimeoutUs,
+  UINT8   *Header,
+  UINT8   HeaderSize,
   UINT8   *Data,
-  UINT8   DataSize
+  UINT32  DataSize
   )
 {
-  UINT8       RemainingSize;
+  UINT32      MessageSize;
+  UINT32      RemainingSize;
   UINT8       DataOffset;
   UINT8       SMBusCmd;
   UINT8       WriteSize;
-  EFI_STATUS  Status;
-
-  if (DataSize == 0) {
+  UINT8          Scratch[SSIF_MAX_WRITE_SIZE];
+  EFI_STATUS     Status;
+  IPMI_DEADLINE  Deadline;
+  UINTN          Delay;
+  BOOLEAN        UseAlert;
+
+  MessageSize = HeaderSize + DataSize;
+  if ((MessageSize == 0) || (DataSize > mSsifMaxWriteMessageSize) || (MessageSize > mSsifMaxWriteMessageSize)) {
     return EFI_INVALID_PARAMETER;
   }
 
   //
   // Determine if this message will require multiple packets or not. If so,
-  // start with the multi write command.
+  // start with the multi write command. The negotiated size limit keeps
+  // messages to the transactions the BMC supports.
   //
 
-  if (DataSize > SSIF_MAX_WRITE_SIZE) {
+  if (MessageSize > SSIF_MAX_WRITE_SIZE) {
     SMBusCmd = SMBUS_CMD_MULT_WRITE_START;
   } else {
     SMBusCmd = SMBUS_CMD_WRITE;
@@ -58,34 +230,47 @@ SendDataToBmcPort (
     "[SSIF]     Send type: %a\n"
     "[SSIF]     DataSize: %d\n",
     (SMBusCmd == SMBUS_CMD_MULT_WRITE_START) ? "MULTI-WRITE" : "WRITE",
-    DataSize
+    MessageSize
     ));
 
-  Status = BmcSmbusOpen ();
+  Status = SsifBusOpen ();
   if (EFI_ERROR (Status)) {
-    DEBUG ((DEBUG_ERROR, "[SSIF] Failed to open SMBus connection. %r\n", Status));
     return Status;
   }
 
+  IpmiDeadlineStart (&Deadline, TimeoutUs);
   DataOffset    = 0;
-  RemainingSize = DataSize;
+  RemainingSize = MessageSize;
+  Delay         = SSIF_POLL_INITIAL_DELAY;
+  UseAlert      = FALSE;
 
   //
   // Continue sending packets so long as more data remains.
   //
 
   while (RemainingSize > 0) {
-    WriteSize = (RemainingSize < SSIF_MAX_WRITE_SIZE) ? RemainingSize : SSIF_MAX_WRITE_SIZE;
+    WriteSize = (RemainingSize < SSIF_MAX_WRITE_SIZE) ? (UINT8)RemainingSize : SSIF_MAX_WRITE_SIZE;
 
     DEBUG ((DEBUG_VERBOSE, "[SSIF]     Sending 0x%x bytes. Cmd: 0x%x\n", WriteSize, SMBusCmd));
-    Status = BmcSmbusBlockWrite (SMBusCmd, &Data[DataOffset], WriteSize);
+    Status = BmcSmbusBlockWrite (
+               SMBusCmd,
+               SsifGetMessageBlock (Header, HeaderSize, Data, DataOffset, WriteSize, &Scratch[0]),
+               WriteSize
+               );
+
+    if (EFI_ERROR (Status) && (DataOffset == 0) && !IpmiDeadlineExpired (&Deadline)) {
+      SsifWaitForResponse (&Deadline, (UINTN)MIN (Delay, TimeoutUs), &UseAlert);
+      Delay = MIN (Delay * 2, SSIF_POLL_MAX_DELAY);
+      continue;
+    }
+
     if (EFI_ERROR (Status)) {
       DEBUG ((DEBUG_ERROR, "[SSIF] Failed to write SMBus block. Cmd: 0x%x Size: 0x%x (%r)\n", SMBusCmd, WriteSize, Status));
       goto Exit;
     }
 
     DataOffset   += WriteSize;
-    RemainingSize = DataSize - DataOffset;
+    RemainingSize = MessageSize - DataOffset;
     if (SMBusCmd == SMBUS_CMD_MULT_WRITE_START) {
       //
       // After the first write, switch to the middle commands. This may later be
@@ -102,55 +287,131 @@ SendDataToBmcPort (
   }
 
 Exit:
-  BmcSmbusClose ();
+  SsifBusDone (Status);
   return Status;
 }
 
 /**
-  Receives an IPMI command message from the BMC over the SSIF transport.
+  Sends an IPMI command message to the BMC over the SSIF transport.
 
-  @param[in]  IpmiTimeoutPeriod     The timeout of the IPMI receive.
-  @param[out] Response              The IMPI response received.
-  @param[out] DataSize              The size of the data in the IPMI response.
+  @param[in]  IpmiTimeoutPeriod     The timeout in units of
+                                    IPMI_TRANSPORT_DELAY_UNIT.
+  @param[in]  Command               The IMPI command to be sent.
+  @param[in]  DataSize              The size of the data in the IPMI command.
 
   @retval   EFI_SUCCESS             The message was successfully sent.
-  @retval   EFI_DEVICE_ERROR        Received an unexpected message from BMC.
-  @retval   EFI_BUFFER_TOO_SMALL    The provided buffer could not fit the full
-                                    message
+  @retval   EFI_INVALID_PARAMETER   The command was invalid.
   @retval   Other errors            And error was returned by the SMBus stack.
 **/
 EFI_STATUS
-ReceiveBmcDataFromPort (
+SendDataToBmcPort (
   UINT64  IpmiTimeoutPeriod,
   UINT8   *Data,
-  UINT8   *DataSize
+  UINT8   DataSize
   )
 {
-  UINT8       DataOffset;
-  UINT8       SMBusCmd;
-  UINT8       BlockBuffer[SSIF_MAX_READ_BUFFER_SIZE];
-  UINT8       BlockDataOffset;
-  UINT8       BlockDataSize;
-  UINT8       BlockNumber;
-  EFI_STATUS  Status;
-  UINT8       ReadSize;
-  BOOLEAN     Done;
+  return SendDataToBmcPortEx (MultU64x32 (IpmiTimeoutPeriod, IPMI_TRANSPORT_DELAY_UNIT), NULL, 0, Data, DataSize);
+}
+
+/**
+  Receives an IPMI command message from the BMC over the SSIF transport. The
+  first HeaderSize bytes of the message are stored in Header and the rest are
+  stored directly in Data.
+
+  @param[in]      TimeoutUs           The timeout of the IPMI receive in
+                                      microseconds.
+  @param[out]     Header              The buffer for the message header.
+  @param[in]      HeaderSize          The size of the message header.
+  @param[out]     Data                The buffer for the message body.
+  @param[in,out]  DataSize            On input the size of Data, on output the
+                                      size of the message body.
 
-  DataOffset = 0;
-  Done       = FALSE;
-  SMBusCmd   = SMBUS_CMD_READ;
+  @retval   EFI_SUCCESS             The message was successfully sent.
+  @retval   EFI_DEVICE_ERROR        Received an unexpected message from BMC.
+  @retval   EFI_BUFFER_TOO_SMALL    The provided buffer could not fit the full
+                                    message, DataSize is the required size.
+  @retval   Other errors            And error was returned by the SMBus stack.
+**/
+EFI_STATUS
+ReceiveBmcDataFromPortEx (
+  UINT64  TimeoutUs,
+  UINT8   *Header,
+  UINT8   HeaderSize,
+  UINT8   *Data,
+  UINT32  *DataSize
+  )
+{
+  UINT32         MessageOffset;
+  UINT32         BodyOffset;
+  UINT8          SMBusCmd;
+  UINT8          BlockBuffer[SSIF_MAX_READ_BUFFER_SIZE];
+  UINT8          BlockDataOffset;
+  UINT8          BlockNumber;
+  EFI_STATUS     Status;
+  UINT8          ReadSize;
+  UINT8          CopySize;
+  UINT8          Retries;
+  BOOLEAN        Done;
+  BOOLEAN        UseAlert;
+  IPMI_DEADLINE  Deadline;
+  UINTN          Delay;
+
+  MessageOffset   = 0;
+  BlockDataOffset = 0;
+  BlockNumber     = 0;
+  Retries         = 0;
+  Done            = FALSE;
+  SMBusCmd        = SMBUS_CMD_READ;
+  UseAlert        = SsifCanWaitForAlert ();
+  Delay           = SSIF_POLL_INITIAL_DELAY;
 
   DEBUG ((DEBUG_VERBOSE, "[SSIF] Reading IPMI Message - \n"));
-  Status = BmcSmbusOpen ();
+  Status = SsifBusOpen ();
   if (EFI_ERROR (Status)) {
-    DEBUG ((DEBUG_ERROR, "[SSIF] Failed to open SMBus connection. %r\n", Status));
     return Status;
   }
 
+  IpmiDeadlineStart (&Deadline, TimeoutUs);
   while (!Done) {
     ReadSize = SSIF_MAX_READ_BUFFER_SIZE;
     Status   = BmcSmbusBlockRead (SMBusCmd, &BlockBuffer[0], &ReadSize);
+    if (EFI_ERROR (Status) && (SMBusCmd == SMBUS_CMD_READ) && !IpmiDeadlineExpired (&Deadline)) {
+      //
+      // The response is not ready yet. Read again after the poll delay, or as
+      // soon as the BMC signals SMBALERT#, until the time budget is used.
+      //
+      SsifWaitForResponse (&Deadline, (UINTN)MIN (Delay, TimeoutUs), &UseAlert);
+      Delay = MIN (Delay * 2, SSIF_POLL_MAX_DELAY);
+      continue;
+    }
+
+    if (!EFI_ERROR (Status) && (SMBusCmd != SMBUS_CMD_READ)) {
+      //
+      // In multi-part read the first byte will be the block number. 0xFF
+      // indicates this is the final block.
+      //
+
+      if (ReadSize == 0) {
+        DEBUG ((DEBUG_ERROR, "[SSIF] Empty SMBus block! Expected %d.\n", BlockNumber));
+        Status = EFI_DEVICE_ERROR;
+      } else if ((BlockBuffer[0] != SSIF_READ_END_BLOCK) && (BlockBuffer[0] != BlockNumber)) {
+        DEBUG ((DEBUG_ERROR, "[SSIF] SMBus block out of order! Expected %d, Received %d.\n", BlockNumber, BlockBuffer[0]));
+        Status = EFI_DEVICE_ERROR;
+      }
+    }
+
     if (EFI_ERROR (Status)) {
+      //
+      // The BMC resends the last middle or end block on the retry command, so
+      // only that block is read again rather than the whole response.
+      //
+      if ((SMBusCmd != SMBUS_CMD_READ) && (Retries < SSIF_MULT_READ_RETRY_COUNT)) {
+        Retries++;
+        SMBusCmd = SMBUS_CMD_MULT_READ_RETRY;
+        DEBUG ((DEBUG_WARN, "[SSIF] Retrying SMBus block %d, attempt %d.\n", BlockNumber, Retries));
+        continue;
+      }
+
       DEBUG ((DEBUG_ERROR, "[SSIF] Failed to read SMBus block. Cmd: 0x%x Offset: 0x%x (%r)\n", SMBusCmd, BlockDataOffset, Status));
       goto Exit;
     }
@@ -162,13 +423,13 @@ ReceiveBmcDataFromPort (
       // beginning of a multi-part message.
       //
 
-      if ((BlockBuffer[0] == 0) && (BlockBuffer[1] == 1)) {
+      if (mSsifMultiPartRead && (ReadSize >= 2) && (BlockBuffer[0] == 0) && (BlockBuffer[1] == 1)) {
         DEBUG ((DEBUG_VERBOSE, "[SSIF]     Multi-read detected.\n"));
         //
         // Trim off the indicator and copy the data over. Set the multi-command
         // for the next loop.
         //
-        ASSERT (DataOffset == 0);
+        ASSERT (MessageOffset == 0);
         SMBusCmd        = SMBUS_CMD_MULT_READ;
         BlockNumber     = 0;
         BlockDataOffset = 2;
@@ -177,42 +438,228 @@ ReceiveBmcDataFromPort (
         Done            = TRUE;
       }
     } else {
-      //
-      // In multi-part read the first byte will be the block number. 0xFF
-      // indicates this is the final block.
-      //
-
       BlockDataOffset = 1;
-      if (BlockBuffer[0] == 0xFF) {
+      Retries         = 0;
+      SMBusCmd        = SMBUS_CMD_MULT_READ;
+      if (BlockBuffer[0] == SSIF_READ_END_BLOCK) {
         Done = TRUE;
       } else {
-        if (BlockBuffer[0] != BlockNumber) {
-          DEBUG ((DEBUG_ERROR, "[SSIF] SMBus block out of order! Expected %d, Received %d.\n", BlockNumber, BlockBuffer[0]));
+        BlockNumber = BlockBuffer[0] + 1;
+      }
+    }
+
+    //
+    // Scatter the block into the header and then the caller's buffer. Data
+    // past the end of the caller's buffer is dropped but still counted so the
+    // required size can be reported.
+    //
+
+    while (BlockDataOffset < ReadSize) {
+      if (MessageOffset < HeaderSize) {
+        CopySize = (UINT8)MIN (ReadSize - BlockDataOffset, HeaderSize - MessageOffset);
+        CopyMem (&Header[MessageOffset], &BlockBuffer[BlockDataOffset], CopySize);
+      } else {
+        CopySize   = (UINT8)(ReadSize - BlockDataOffset);
+        BodyOffset = MessageOffset - HeaderSize;
+        if (MessageOffset + CopySize > mSsifMaxReadMessageSize) {
+          DEBUG ((DEBUG_ERROR, "[SSIF] Message too large!\n"));
           Status = EFI_DEVICE_ERROR;
           goto Exit;
         }
 
-        BlockNumber = BlockBuffer[0] + 1;
+        if (BodyOffset < *DataSize) {
+          CopyMem (&Data[BodyOffset], &BlockBuffer[BlockDataOffset], MIN (CopySize, *DataSize - BodyOffset));
+        }
       }
-    }
 
-    BlockDataSize = ReadSize - BlockDataOffset;
-    if (DataOffset + BlockDataSize > *DataSize) {
-      DEBUG ((DEBUG_ERROR, "[SSIF] Buffer too small! Buffer size: 0x%x\n", *DataSize));
-      Status = EFI_BUFFER_TOO_SMALL;
-      goto Exit;
+      BlockDataOffset += CopySize;
+      MessageOffset   += CopySize;
     }
+  }
 
-    CopyMem (&Data[DataOffset], &BlockBuffer[BlockDataOffset], BlockDataSize);
-    DataOffset += BlockDataSize;
+  BodyOffset = (MessageOffset > HeaderSize) ? (MessageOffset - HeaderSize) : 0;
+  if (BodyOffset > *DataSize) {
+    DEBUG ((DEBUG_ERROR, "[SSIF] Buffer too small! Buffer size: 0x%x\n", *DataSize));
+    Status = EFI_BUFFER_TOO_SMALL;
   }
 
-  *DataSize = DataOffset;
+  *DataSize = BodyOffset;
 Exit:
-  BmcSmbusClose ();
+  SsifBusDone (Status);
+  return Status;
+}
+
+/**
+  Receives an IPMI command message from the BMC over the SSIF transport.
+
+  @param[in]  IpmiTimeoutPeriod     The timeout in units of
+                                    IPMI_TRANSPORT_DELAY_UNIT.
+  @param[out] Response              The IMPI response received.
+  @param[out] DataSize              The size of the data in the IPMI response.
+
+  @retval   EFI_SUCCESS             The message was successfully sent.
+  @retval   EFI_DEVICE_ERROR        Received an unexpected message from BMC.
+  @retval   EFI_BUFFER_TOO_SMALL    The provided buffer could not fit the full
+                                    message
+  @retval   Other errors            And error was returned by the SMBus stack.
+**/
+EFI_STATUS
+ReceiveBmcDataFromPort (
+  UINT64  IpmiTimeoutPeriod,
+  UINT8   *Data,
+  UINT8   *DataSize
+  )
+{
+  EFI_STATUS  Status;
+  UINT32      Size;
+
+  Size      = *DataSize;
+  Status    = ReceiveBmcDataFromPortEx (MultU64x32 (IpmiTimeoutPeriod, IPMI_TRANSPORT_DELAY_UNIT), NULL, 0, Data, &Size);
+  *DataSize = (UINT8)MIN (Size, MAX_UINT8);
   return Status;
 }
 
+/**
+  Gets the largest message bodies the SSIF transport can carry, as negotiated
+  with the BMC. Responses may be larger than requests as they can span a full
+  multi-part read.
+
+  @param[out]  MaxRequestSize     The largest request body in bytes.
+  @param[out]  MaxResponseSize    The largest response body in bytes.
+**/
+VOID
+GetBmcMaxMessageSize (
+  OUT UINT32  *MaxRequestSize,
+  OUT UINT32  *MaxResponseSize
+  )
+{
+  *MaxRequestSize  = mSsifMaxWriteMessageSize - SSIF_MESSAGE_HEADER_SIZE;
+  *MaxResponseSize = mSsifMaxReadMessageSize - SSIF_MESSAGE_HEADER_SIZE;
+}
+
+/**
+  Checks whether the BMC has a response available. SSIF has no status to poll
+  without starting a read, so the receive is left to wait for the response.
+
+  @retval   EFI_UNSUPPORTED   Always.
+**/
+EFI_STATUS
+CheckBmcResponseReady (
+  VOID
+  )
+{
+  return EFI_UNSUPPORTED;
+}
+
+/**
+  Begins a transport session. The SMBus connection opened by the next send or
+  receive is kept open until the outermost session ends.
+**/
+VOID
+IpmiTransportBeginSession (
+  VOID
+  )
+{
+  mSsifSessionDepth++;
+}
+
+/**
+  Ends a transport session, closing the SMBus connection when the outermost
+  session ends.
+**/
+VOID
+IpmiTransportEndSession (
+  VOID
+  )
+{
+  if (mSsifSessionDepth > 0) {
+    mSsifSessionDepth--;
+  }
+
+  if ((mSsifSessionDepth == 0) && mSsifBusOpen) {
+    BmcSmbusClose ();
+    mSsifBusOpen = FALSE;
+  }
+}
+
+/**
+  Takes the SSIF capabilities read from the BMC. The transactions the BMC
+  supports bound the message sizes, and with them whether multi-part framing
+  is used, and the input and output message sizes bound them further.
+  Capabilities that are not for SSIF or are malformed are ignored.
+
+  @param[in]  InterfaceType       The interface type the capabilities describe.
+  @param[in]  Capabilities        The response, starting with the completion
+                                  code, or NULL to return to the defaults.
+  @param[in]  CapabilitiesSize    The size of the response.
+**/
+VOID
+IpmiTransportSetCapabilities (
+  IN UINT8   InterfaceType,
+  IN UINT8   *Capabilities,
+  IN UINT32  CapabilitiesSize
+  )
+{
+  IPMI_GET_SYSTEM_INTERFACE_CAPABILITY_RESPONSE_SSIF  *SsifCapabilities;
+  UINT32                                              MaxWriteSize;
+  UINT32                                              MaxReadSize;
+
+  if (Capabilities == NULL) {
+    mSsifMaxWriteMessageSize = SSIF_MAX_WRITE_MESSAGE_SIZE;
+    mSsifMaxReadMessageSize  = SSIF_MAX_READ_MESSAGE_SIZE;
+    mSsifMultiPartRead       = TRUE;
+    return;
+  }
+
+  SsifCapabilities = (IPMI_GET_SYSTEM_INTERFACE_CAPABILITY_RESPONSE_SSIF *)Capabilities;
+  if ((InterfaceType != GetSystemInterfaceTypeSsif) ||
+      (CapabilitiesSize < sizeof (*SsifCapabilities)) ||
+      (SsifCapabilities->CompletionCode != IPMI_COMP_CODE_NORMAL) ||
+      (SsifCapabilities->InputMessageSize <= SSIF_MESSAGE_HEADER_SIZE) ||
+      (SsifCapabilities->MaxMessageSize <= SSIF_MESSAGE_HEADER_SIZE))
+  {
+    return;
+  }
+
+  switch (SsifCapabilities->TransactionSupport) {
+    case IPMI_SSIF_TRANSACTION_SINGLE_PART:
+      MaxWriteSize = SSIF_MAX_WRITE_SIZE;
+      MaxReadSize  = SSIF_MAX_READ_SIZE;
+      break;
+
+    case IPMI_SSIF_TRANSACTION_START_END:
+      MaxWriteSize = 2 * SSIF_MAX_WRITE_SIZE;
+      MaxReadSize  = (SSIF_MAX_READ_SIZE - 2) + (SSIF_MAX_READ_SIZE - 1);
+      break;
+
+    case IPMI_SSIF_TRANSACTION_START_MIDDLE_END:
+      MaxWriteSize = SSIF_MAX_WRITE_MESSAGE_SIZE;
+      MaxReadSize  = SSIF_MAX_READ_MESSAGE_SIZE;
+      break;
+
+    default:
+      DEBUG ((DEBUG_WARN, "[SSIF] Unknown transaction support %d, keeping defaults.\n", SsifCapabilities->TransactionSupport));
+      return;
+  }
+
+  mSsifMaxWriteMessageSize = MIN (MaxWriteSize, SsifCapabilities->InputMessageSize);
+  mSsifMaxReadMessageSize  = MIN (MaxReadSize, SsifCapabilities->MaxMessageSize);
+  mSsifMultiPartRead       = (BOOLEAN)(SsifCapabilities->TransactionSupport != IPMI_SSIF_TRANSACTION_SINGLE_PART);
+
+  //
+  // BmcSmbusLib owns the SMBus transactions, so PEC is left to the platform
+  // and only reported here.
+  //
+  DEBUG ((
+    DEBUG_INFO,
+    "[SSIF] BMC capabilities - Transactions: %d Write: %d Read: %d PEC: %d\n",
+    SsifCapabilities->TransactionSupport,
+    mSsifMaxWriteMessageSize,
+    mSsifMaxReadMessageSize,
+    SsifCapabilities->PecSupport
+    ));
+}
+
 /**
   Initializing hardware for the IPMI transport.
 
@@ -0,0 +1,557 @@
+/** @file
+  Implements an SMBus library that simulates the SSIF endpoint of a BMC for host
+  based tests and benchmarks. Block writes and reads follow the single and
+  multi-part framing of the IPMI specification and requests are answered by the
+  mock IPMI handlers. Reads are refused until the response is ready, every
+  transaction takes a configurable time on the virtual clock of the timer
+  library, and single transactions can be failed on the bus.
+
+  Copyright (c) Microsoft Corporation
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "MockIpmi.h"
+#include <Library/TimerLib.h>
+#include <Library/BmcSmbusLib.h>
+#include <Ssif.h>
+#include <MockSsifBmc.h>
+
+//
+// Bytes on the bus besides the data of a block: the address, command and count
+// of a write, and the address, command, repeated address and count of a read.
+// A refused read ends after the repeated address.
+//
+#define MOCK_SSIF_WRITE_OVERHEAD  3
+#define MOCK_SSIF_READ_OVERHEAD   4
+#define MOCK_SSIF_NAK_OVERHEAD    3
+
+#define MOCK_SSIF_NO_BLOCK  MAX_UINT32
+
+//
+// State of the simulated endpoint. Times are in nanoseconds on the virtual
+// clock.
+//
+STATIC BOOLEAN  mSsifOpen;
+STATIC BOOLEAN  mSsifWriteOpen;
+STATIC BOOLEAN  mSsifResponseValid;
+STATIC BOOLEAN  mSsifReadOpen;
+STATIC UINT64   mSsifResponseTime;
+STATIC UINT8    mSsifBlockNumber;
+
+STATIC UINT8   mSsifRequest[SSIF_MAX_WRITE_MESSAGE_SIZE];
+STATIC UINT32  mSsifRequestSize;
+STATIC UINT8   mSsifResponse[sizeof (IPMI_RESPONSE_DATA) + 1];
+STATIC UINT32  mSsifResponseSize;
+STATIC UINT32  mSsifResponseOffset;
+
+//
+// The last multi-part read block, resent on a retry.
+//
+STATIC UINT8    mSsifBlock[SSIF_MAX_READ_SIZE];
+STATIC UINT8    mSsifBlockSize;
+STATIC BOOLEAN  mSsifBlockValid;
+
+//
+// Configured behavior of the BMC and the bus.
+//
+STATIC UINT32   mSsifTransactionTime;
+STATIC UINT32   mSsifByteTime;
+STATIC UINT32   mSsifResponseLatency;
+STATIC UINT32   mSsifBlocks;
+STATIC UINT32   mSsifErrorBlock = MOCK_SSIF_NO_BLOCK;
+STATIC BOOLEAN  mSsifAlertSupported;
+
+STATIC MOCK_SSIF_STATISTICS  mSsifStatistics;
+
+/**
+  Reads the virtual clock.
+
+  @retval   The time in nanoseconds.
+**/
+STATIC
+UINT64
+MockSsifNow (
+  VOID
+  )
+{
+  return GetTimeInNanoSecond (GetPerformanceCounter ());
+}
+
+/**
+  Resets the simulated SSIF BMC to the idle state with no latency, errors or
+  SMBALERT# support, and clears its counters.
+**/
+VOID
+MockSsifReset (
+  VOID
+  )
+{
+  mSsifOpen            = FALSE;
+  mSsifWriteOpen       = FALSE;
+  mSsifResponseValid   = FALSE;
+  mSsifReadOpen        = FALSE;
+  mSsifResponseTime    = 0;
+  mSsifBlockNumber     = 0;
+  mSsifRequestSize     = 0;
+  mSsifResponseSize    = 0;
+  mSsifResponseOffset  = 0;
+  mSsifBlockSize       = 0;
+  mSsifBlockValid      = FALSE;
+  mSsifTransactionTime = 0;
+  mSsifByteTime        = 0;
+  mSsifResponseLatency = 0;
+  mSsifBlocks          = 0;
+  mSsifErrorBlock      = MOCK_SSIF_NO_BLOCK;
+  mSsifAlertSupported  = FALSE;
+  ZeroMem (&mSsifStatistics, sizeof (mSsifStatistics));
+}
+
+/**
+  Sets how long SMBus transactions take on the bus and how long the BMC takes
+  to prepare a response.
+
+  @param[in]  TransactionTime   The time in microseconds of every transaction.
+  @param[in]  ByteTime          The additional time in microseconds of every
+                                byte on the bus, including the address,
+                                command and count bytes.
+  @param[in]  ResponseLatency   The time in microseconds from the last block of
+                                a request until the response can be read.
+**/
+VOID
+MockSsifSetLatency (
+  IN UINT32  TransactionTime,
+  IN UINT32  ByteTime,
+  IN UINT32  ResponseLatency
+  )
+{
+  mSsifTransactionTime = TransactionTime;
+  mSsifByteTime        = ByteTime;
+  mSsifResponseLatency = ResponseLatency;
+}
+
+/**
+  Fails a later block transferred on the bus once. Blocks are counted across
+  writes and reads, but reads refused because no response is ready transfer no
+  block and are not counted. A failed write block is not taken by the BMC. A
+  failed read block is lost on the bus, so a start block is read again and a
+  multi-part read block is resent on a retry.
+
+  @param[in]  Block   The block to fail, 0 for the next one.
+**/
+VOID
+MockSsifSetError (
+  IN UINT32  Block
+  )
+{
+  mSsifErrorBlock = mSsifBlocks + Block;
+}
+
+/**
+  Sets whether the platform supports waiting for SMBALERT#, which the BMC
+  asserts once a response is ready.
+
+  @param[in]  Supported   TRUE to support SMBALERT#.
+**/
+VOID
+MockSsifSetAlert (
+  IN BOOLEAN  Supported
+  )
+{
+  mSsifAlertSupported = Supported;
+}
+
+/**
+  Retrieves the counters of the simulated SMBus endpoint.
+
+  @param[out]  Statistics   The counters since the last reset.
+**/
+VOID
+MockSsifGetStatistics (
+  OUT MOCK_SSIF_STATISTICS  *Statistics
+  )
+{
+  CopyMem (Statistics, &mSsifStatistics, sizeof (*Statistics));
+}
+
+/**
+  Spends the bus time of a transaction.
+
+  @param[in]  Bytes   The bytes on the bus.
+**/
+STATIC
+VOID
+MockSsifTransaction (
+  IN UINT32  Bytes
+  )
+{
+  MicroSecondDelay (mSsifTransactionTime + Bytes * mSsifByteTime);
+}
+
+/**
+  Spends the bus time of a transaction transferring a block and decides
+  whether the block is lost.
+
+  @param[in]  Size      The size of the block.
+  @param[in]  Overhead  The bytes on the bus besides the block.
+
+  @retval   TRUE      The block fails on the bus.
+  @retval   FALSE     The block is transferred.
+**/
+STATIC
+BOOLEAN
+MockSsifBlockFails (
+  IN UINT32  Size,
+  IN UINT32  Overhead
+  )
+{
+  BOOLEAN  Fail;
+
+  MockSsifTransaction (Size + Overhead);
+
+  Fail = (BOOLEAN)(mSsifBlocks == mSsifErrorBlock);
+  mSsifBlocks++;
+  if (Fail) {
+    mSsifStatistics.Errors++;
+  }
+
+  return Fail;
+}
+
+/**
+  Refuses a transaction that breaks the SSIF framing and abandons the request
+  being written.
+
+  @retval   EFI_DEVICE_ERROR    Always.
+**/
+STATIC
+EFI_STATUS
+MockSsifFramingError (
+  VOID
+  )
+{
+  mSsifWriteOpen = FALSE;
+  mSsifStatistics.Errors++;
+  return EFI_DEVICE_ERROR;
+}
+
+/**
+  Hands the complete request to the mock IPMI handlers and schedules the
+  response.
+
+  @retval   EFI_SUCCESS         The request was taken.
+  @retval   EFI_DEVICE_ERROR    The request is too short to be an IPMI message.
+**/
+STATIC
+EFI_STATUS
+MockSsifDispatch (
+  VOID
+  )
+{
+  UINT8  Size;
+
+  mSsifWriteOpen = FALSE;
+  if (mSsifRequestSize < sizeof (IPMI_COMMAND)) {
+    return MockSsifFramingError ();
+  }
+
+  mSsifStatistics.Requests++;
+  MockIpmiCommand ((IPMI_COMMAND *)mSsifRequest, (UINT8)mSsifRequestSize);
+  Size = sizeof (mSsifResponse);
+  MockIpmiResponse ((IPMI_RESPONSE *)mSsifResponse, &Size);
+
+  mSsifResponseSize   = Size;
+  mSsifResponseOffset = 0;
+  mSsifResponseValid  = TRUE;
+  mSsifResponseTime   = MockSsifNow () + MultU64x32 (mSsifResponseLatency, 1000);
+  return EFI_SUCCESS;
+}
+
+/**
+  Opens the SMBus connection if needed. Within a transport session the SSIF
+  transport keeps the connection open across several reads and writes, and
+  calls BmcSmbusClose before opening it again.
+
+  @retval   EFI_SUCCESS           Them SMBus connection was successfully opened.
+**/
+EFI_STATUS
+BmcSmbusOpen (
+  VOID
+  )
+{
+  mSsifOpen = TRUE;
+  return EFI_SUCCESS;
+}
+
+/**
+  Opens the SMBus connection if needed.
+
+  @retval   EFI_SUCCESS           Them SMBus connection was successfully closed.
+**/
+EFI_STATUS
+BmcSmbusClose (
+  VOID
+  )
+{
+  mSsifOpen = FALSE;
+  return EFI_SUCCESS;
+}
+
+/**
+  Writes the provided SMBus message to the BMC.
+
+  @param[in]  Command             The SMBus command value.
+  @param[in]  WriteBlock          The message data block.
+  @param[in]  BlockLength         The length of the message data.
+
+  @retval   EFI_SUCCESS           The message was successfully sent.
+  @retval   EFI_NOT_READY         The SMBus connection is not open.
+  @retval   EFI_INVALID_PARAMETER The block is empty or larger than an SMBus
+                                  block.
+  @retval   EFI_DEVICE_ERROR      The transaction failed on the bus or broke
+                                  the SSIF framing.
+**/
+EFI_STATUS
+BmcSmbusBlockWrite (
+  UINT8  Command,
+  UINT8  *WriteBlock,
+  UINT8  BlockLength
+  )
+{
+  if (!mSsifOpen) {
+    return EFI_NOT_READY;
+  }
+
+  if ((BlockLength == 0) || (BlockLength > SSIF_MAX_WRITE_SIZE)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  mSsifStatistics.Writes++;
+  if (MockSsifBlockFails (BlockLength, MOCK_SSIF_WRITE_OVERHEAD)) {
+    return EFI_DEVICE_ERROR;
+  }
+
+  //
+  // A new request drops any response the host has not read.
+  //
+  if ((Command == SMBUS_CMD_WRITE) || (Command == SMBUS_CMD_MULT_WRITE_START)) {
+    mSsifResponseValid = FALSE;
+    mSsifReadOpen      = FALSE;
+    mSsifBlockValid    = FALSE;
+    mSsifRequestSize   = 0;
+  }
+
+  switch (Command) {
+    case SMBUS_CMD_WRITE:
+      CopyMem (mSsifRequest, WriteBlock, BlockLength);
+      mSsifRequestSize = BlockLength;
+      return MockSsifDispatch ();
+
+    case SMBUS_CMD_MULT_WRITE_START:
+    case SMBUS_CMD_MULT_WRITE_MIDDLE:
+      if ((BlockLength != SSIF_MAX_WRITE_SIZE) ||
+          ((Command == SMBUS_CMD_MULT_WRITE_MIDDLE) && !mSsifWriteOpen) ||
+          (mSsifRequestSize + BlockLength > sizeof (mSsifRequest)))
+      {
+        return MockSsifFramingError ();
+      }
+
+      CopyMem (&mSsifRequest[mSsifRequestSize], WriteBlock, BlockLength);
+      mSsifRequestSize += BlockLength;
+      mSsifWriteOpen    = TRUE;
+      return EFI_SUCCESS;
+
+    case SMBUS_CMD_MULT_WRITE_END:
+      if (!mSsifWriteOpen || (mSsifRequestSize + BlockLength > sizeof (mSsifRequest))) {
+        return MockSsifFramingError ();
+      }
+
+      CopyMem (&mSsifRequest[mSsifRequestSize], WriteBlock, BlockLength);
+      mSsifRequestSize += BlockLength;
+      return MockSsifDispatch ();
+
+    default:
+      return MockSsifFramingError ();
+  }
+}
+
+/**
+  Waits for the BMC to assert SMBALERT#, which it does once a response is
+  ready to be read. The wait advances the virtual clock.
+
+  @param[in]  Timeout             The longest time to wait in microseconds.
+
+  @retval   EFI_SUCCESS           SMBALERT# is asserted.
+  @retval   EFI_TIMEOUT           SMBALERT# was not asserted within Timeout.
+  @retval   EFI_UNSUPPORTED       SMBALERT# support is not enabled.
+**/
+EFI_STATUS
+BmcSmbusWaitForAlert (
+  UINTN  Timeout
+  )
+{
+  UINT64  Now;
+
+  if (!mSsifAlertSupported) {
+    return EFI_UNSUPPORTED;
+  }
+
+  mSsifStatistics.Alerts++;
+  Now = MockSsifNow ();
+  if (mSsifResponseValid && !mSsifReadOpen &&
+      (mSsifResponseTime <= Now + MultU64x32 (Timeout, 1000)))
+  {
+    if (mSsifResponseTime > Now) {
+      MicroSecondDelay ((UINTN)DivU64x32 (mSsifResponseTime - Now + 999, 1000));
+    }
+
+    return EFI_SUCCESS;
+  }
+
+  MicroSecondDelay (Timeout);
+  return EFI_TIMEOUT;
+}
+
+/**
+  Prepares the next block of a multi-part read, which is also kept to be
+  resent on a retry. The end block completes the response.
+**/
+STATIC
+VOID
+MockSsifNextBlock (
+  VOID
+  )
+{
+  UINT32  Remaining;
+  UINT8   Size;
+
+  Remaining = mSsifResponseSize - mSsifResponseOffset;
+  if (Remaining <= SSIF_MAX_READ_SIZE - 1) {
+    mSsifBlock[0]      = SSIF_READ_END_BLOCK;
+    Size               = (UINT8)Remaining;
+    mSsifReadOpen      = FALSE;
+    mSsifResponseValid = FALSE;
+  } else {
+    mSsifBlock[0] = mSsifBlockNumber++;
+    Size          = SSIF_MAX_READ_SIZE - 1;
+  }
+
+  CopyMem (&mSsifBlock[1], &mSsifResponse[mSsifResponseOffset], Size);
+  mSsifResponseOffset += Size;
+  mSsifBlockSize       = (UINT8)(Size + 1);
+  mSsifBlockValid      = TRUE;
+}
+
+/**
+  Reads a message from the specified SMBus device.
+
+  @param[in]      Command           The SMBus read command.
+  @param[out]     ReadBlock         The message data block.
+  @param[in,out]  BlockLength       Input specifies the buffer size.
+                                    Output specifies the read size.
+
+  @retval   EFI_SUCCESS           The message was successfully sent.
+  @retval   EFI_NOT_READY         The SMBus connection is not open.
+  @retval   EFI_BUFFER_TOO_SMALL  The provided buffer was not large enough for
+                                  the received message.
+  @retval   EFI_DEVICE_ERROR      The BMC refused the read because no response
+                                  is ready, the transaction failed on the bus
+                                  or broke the SSIF framing.
+**/
+EFI_STATUS
+BmcSmbusBlockRead (
+  UINT8  Command,
+  UINT8  *ReadBlock,
+  UINT8  *BlockLength
+  )
+{
+  UINT8  *Block;
+  UINT8  Size;
+  UINT8  StartBlock[SSIF_MAX_READ_SIZE];
+
+  if (!mSsifOpen) {
+    return EFI_NOT_READY;
+  }
+
+  mSsifStatistics.Reads++;
+  switch (Command) {
+    case SMBUS_CMD_READ:
+      if (!mSsifResponseValid || mSsifReadOpen || (MockSsifNow () < mSsifResponseTime)) {
+        mSsifStatistics.Naks++;
+        MockSsifTransaction (MOCK_SSIF_NAK_OVERHEAD);
+        return EFI_DEVICE_ERROR;
+      }
+
+      //
+      // Responses longer than a block start a multi-part read, marked by a
+      // start block beginning with 0 and 1.
+      //
+      Block = StartBlock;
+      if (mSsifResponseSize <= SSIF_MAX_READ_SIZE) {
+        Size = (UINT8)mSsifResponseSize;
+        CopyMem (StartBlock, mSsifResponse, Size);
+      } else {
+        Size          = SSIF_MAX_READ_SIZE;
+        StartBlock[0] = 0;
+        StartBlock[1] = 1;
+        CopyMem (&StartBlock[2], mSsifResponse, Size - 2);
+      }
+
+      if (MockSsifBlockFails (Size, MOCK_SSIF_READ_OVERHEAD)) {
+        return EFI_DEVICE_ERROR;
+      }
+
+      if (mSsifResponseSize <= SSIF_MAX_READ_SIZE) {
+        mSsifResponseValid = FALSE;
+      } else {
+        mSsifResponseOffset = Size - 2;
+        mSsifBlockNumber    = 0;
+        mSsifReadOpen       = TRUE;
+      }
+
+      break;
+
+    case SMBUS_CMD_MULT_READ:
+      if (!mSsifReadOpen) {
+        MockSsifTransaction (MOCK_SSIF_NAK_OVERHEAD);
+        return MockSsifFramingError ();
+      }
+
+      MockSsifNextBlock ();
+      Block = mSsifBlock;
+      Size  = mSsifBlockSize;
+      if (MockSsifBlockFails (Size, MOCK_SSIF_READ_OVERHEAD)) {
+        return EFI_DEVICE_ERROR;
+      }
+
+      break;
+
+    case SMBUS_CMD_MULT_READ_RETRY:
+      if (!mSsifBlockValid) {
+        MockSsifTransaction (MOCK_SSIF_NAK_OVERHEAD);
+        return MockSsifFramingError ();
+      }
+
+      mSsifStatistics.ReadRetries++;
+      Block = mSsifBlock;
+      Size  = mSsifBlockSize;
+      if (MockSsifBlockFails (Size, MOCK_SSIF_READ_OVERHEAD)) {
+        return EFI_DEVICE_ERROR;
+      }
+
+      break;
+
+    default:
+      MockSsifTransaction (MOCK_SSIF_NAK_OVERHEAD);
+      return MockSsifFramingError ();
+  }
+
+  if (*BlockLength < Size) {
+    *BlockLength = Size;
+    return EFI_BUFFER_TOO_SMALL;
+  }
+
+  CopyMem (ReadBlock, Block, Size);
+  *BlockLength = Size;
+  return EFI_SUCCESS;
+}
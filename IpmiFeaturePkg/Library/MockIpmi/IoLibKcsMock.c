@@ -0,0 +1,564 @@
+/** @file
+  Implements an I/O library that simulates the KCS interface of a BMC for host
+  based tests and benchmarks. The registers follow the KCS state machine of
+  the IPMI specification and requests are answered by the mock IPMI handlers.
+  Each write of the host holds IBF set for a configurable time on the virtual
+  clock of the timer library, and single writes can be stalled or answered
+  with the error state. Every register access can be given a cost on the
+  virtual clock.
+
+  Copyright (c) Microsoft Corporation
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "MockIpmi.h"
+#include <Library/IoLib.h>
+#include <Library/PcdLib.h>
+#include <Library/TimerLib.h>
+#include <MockKcsBmc.h>
+
+//
+// KCS control codes and status register layout.
+//
+#define MOCK_KCS_GET_STATUS   0x60
+#define MOCK_KCS_WRITE_START  0x61
+#define MOCK_KCS_WRITE_END    0x62
+#define MOCK_KCS_READ         0x68
+
+#define MOCK_KCS_STATUS_OBF  BIT0
+#define MOCK_KCS_STATUS_IBF  BIT1
+#define MOCK_KCS_STATUS_CD   BIT3
+
+#define MOCK_KCS_STATE_IDLE   0x0
+#define MOCK_KCS_STATE_READ   0x1
+#define MOCK_KCS_STATE_WRITE  0x2
+#define MOCK_KCS_STATE_ERROR  0x3
+
+//
+// Status code returned to GET_STATUS/ABORT after an error.
+//
+#define MOCK_KCS_STATUS_ILLEGAL_CONTROL_CODE  0x03
+
+//
+// Index of the KCS registers.
+//
+#define MOCK_KCS_DATA_REGISTER    0
+#define MOCK_KCS_STATUS_REGISTER  1
+
+//
+// Where the BMC is in a transaction.
+//
+typedef enum {
+  MockKcsPhaseIdle,
+  MockKcsPhaseWrite,
+  MockKcsPhaseWriteEnd,
+  MockKcsPhaseRead,
+  MockKcsPhaseAbort
+} MOCK_KCS_PHASE;
+
+#define MOCK_KCS_NO_WRITE  MAX_UINT32
+
+//
+// Registers and state of the simulated interface. Times are in nanoseconds on
+// the virtual clock.
+//
+STATIC UINT8           mKcsState;
+STATIC MOCK_KCS_PHASE  mKcsPhase;
+STATIC BOOLEAN         mKcsIbf;
+STATIC BOOLEAN         mKcsObf;
+STATIC BOOLEAN         mKcsCommandIn;
+STATIC UINT8           mKcsDataIn;
+STATIC UINT8           mKcsDataOut;
+STATIC UINT64          mKcsIbfClearTime;
+STATIC BOOLEAN         mKcsResponsePending;
+STATIC UINT64          mKcsResponseTime;
+STATIC UINT8           mKcsLastError;
+
+STATIC UINT8   mKcsRequest[sizeof (IPMI_COMMAND) + MOCK_IPMI_BUFFER_SIZE];
+STATIC UINT32  mKcsRequestSize;
+STATIC UINT8   mKcsResponse[sizeof (IPMI_RESPONSE) + MOCK_KCS_MAX_MESSAGE_SIZE];
+STATIC UINT32  mKcsResponseSize;
+STATIC UINT32  mKcsResponseOffset;
+
+//
+// Configured behavior of the BMC.
+//
+STATIC UINT32   mKcsByteLatency;
+STATIC UINT32   mKcsResponseLatency;
+STATIC UINT32   mKcsIoCost;
+STATIC UINT32   mKcsWrites;
+STATIC UINT32   mKcsStallWrite = MOCK_KCS_NO_WRITE;
+STATIC UINT32   mKcsStallTime;
+STATIC UINT32   mKcsErrorWrite = MOCK_KCS_NO_WRITE;
+STATIC BOOLEAN  mKcsFailWrite;
+
+STATIC MOCK_KCS_STATISTICS  mKcsStatistics;
+
+/**
+  Reads the virtual clock.
+
+  @retval   The time in nanoseconds.
+**/
+STATIC
+UINT64
+MockKcsNow (
+  VOID
+  )
+{
+  return GetTimeInNanoSecond (GetPerformanceCounter ());
+}
+
+/**
+  Resets the simulated KCS BMC to the idle state with no latency, stalls or
+  errors, and clears its counters.
+**/
+VOID
+MockKcsReset (
+  VOID
+  )
+{
+  mKcsState           = MOCK_KCS_STATE_IDLE;
+  mKcsPhase           = MockKcsPhaseIdle;
+  mKcsIbf             = FALSE;
+  mKcsObf             = FALSE;
+  mKcsCommandIn       = FALSE;
+  mKcsDataIn          = 0;
+  mKcsDataOut         = 0;
+  mKcsIbfClearTime    = 0;
+  mKcsResponsePending = FALSE;
+  mKcsResponseTime    = 0;
+  mKcsLastError       = 0;
+  mKcsRequestSize     = 0;
+  mKcsResponseSize    = 0;
+  mKcsResponseOffset  = 0;
+  mKcsByteLatency     = 0;
+  mKcsResponseLatency = 0;
+  mKcsIoCost          = 0;
+  mKcsWrites          = 0;
+  mKcsStallWrite      = MOCK_KCS_NO_WRITE;
+  mKcsStallTime       = 0;
+  mKcsErrorWrite      = MOCK_KCS_NO_WRITE;
+  mKcsFailWrite       = FALSE;
+  ZeroMem (&mKcsStatistics, sizeof (mKcsStatistics));
+}
+
+/**
+  Sets how long the BMC takes to handle a write of the host and to start
+  returning a response.
+
+  @param[in]  ByteLatency       The time in microseconds IBF stays set after each
+                                control code or data byte written by the host.
+  @param[in]  ResponseLatency   The time in microseconds from the last byte of a
+                                request to the first byte of the response.
+**/
+VOID
+MockKcsSetLatency (
+  IN UINT32  ByteLatency,
+  IN UINT32  ResponseLatency
+  )
+{
+  mKcsByteLatency     = ByteLatency;
+  mKcsResponseLatency = ResponseLatency;
+}
+
+/**
+  Sets how long each access of the host to a KCS register takes.
+
+  @param[in]  IoCost    The time of a register access in microseconds.
+**/
+VOID
+MockKcsSetIoCost (
+  IN UINT32  IoCost
+  )
+{
+  mKcsIoCost = IoCost;
+}
+
+/**
+  Stalls the BMC once on a later write of the host, holding IBF set for longer
+  than the byte latency.
+
+  @param[in]  Write       The write to stall, 0 for the next write.
+  @param[in]  StallTime   The additional time in microseconds.
+**/
+VOID
+MockKcsSetStall (
+  IN UINT32  Write,
+  IN UINT32  StallTime
+  )
+{
+  mKcsStallWrite = mKcsWrites + Write;
+  mKcsStallTime  = StallTime;
+}
+
+/**
+  Makes the BMC answer a later write of the host with the error state once,
+  instead of taking it.
+
+  @param[in]  Write       The write to fail, 0 for the next write.
+**/
+VOID
+MockKcsSetError (
+  IN UINT32  Write
+  )
+{
+  mKcsErrorWrite = mKcsWrites + Write;
+}
+
+/**
+  Retrieves the counters of the simulated KCS interface.
+
+  @param[out]  Statistics   The counters since the last reset.
+**/
+VOID
+MockKcsGetStatistics (
+  OUT MOCK_KCS_STATISTICS  *Statistics
+  )
+{
+  CopyMem (Statistics, &mKcsStatistics, sizeof (*Statistics));
+}
+
+/**
+  Puts the interface in the error state, abandoning the transaction.
+
+  @param[in]  ErrorCode   The status code reported to the next GET_STATUS.
+**/
+STATIC
+VOID
+MockKcsError (
+  IN UINT8  ErrorCode
+  )
+{
+  mKcsState           = MOCK_KCS_STATE_ERROR;
+  mKcsPhase           = MockKcsPhaseIdle;
+  mKcsResponsePending = FALSE;
+  mKcsLastError       = ErrorCode;
+  mKcsStatistics.Errors++;
+}
+
+/**
+  Queues the next byte of the response to be placed in the data register.
+
+  @param[in]  Delay   The time in microseconds before the byte is available.
+**/
+STATIC
+VOID
+MockKcsQueueResponse (
+  IN UINT32  Delay
+  )
+{
+  mKcsResponsePending = TRUE;
+  mKcsResponseTime    = MockKcsNow () + MultU64x32 (Delay, 1000);
+}
+
+/**
+  Hands the complete request to the mock IPMI handlers and queues the first
+  byte of the response.
+**/
+STATIC
+VOID
+MockKcsDispatch (
+  VOID
+  )
+{
+  UINT8  Size;
+
+  if (mKcsRequestSize < sizeof (IPMI_COMMAND)) {
+    MockKcsError (MOCK_KCS_STATUS_ILLEGAL_CONTROL_CODE);
+    return;
+  }
+
+  mKcsStatistics.Requests++;
+  MockIpmiCommand ((IPMI_COMMAND *)mKcsRequest, (UINT8)mKcsRequestSize);
+  //
+  // The mock handlers answer at most MAX_UINT8 bytes.
+  //
+  Size = (UINT8)MIN (sizeof (mKcsResponse), MAX_UINT8);
+  MockIpmiResponse ((IPMI_RESPONSE *)mKcsResponse, &Size);
+
+  mKcsResponseSize   = Size;
+  mKcsResponseOffset = 0;
+  mKcsState          = MOCK_KCS_STATE_READ;
+  mKcsPhase          = MockKcsPhaseRead;
+  MockKcsQueueResponse (mKcsResponseLatency);
+}
+
+/**
+  Takes the control code or data byte last written by the host, as the BMC
+  does once it clears IBF.
+**/
+STATIC
+VOID
+MockKcsTakeWrite (
+  VOID
+  )
+{
+  if (mKcsFailWrite) {
+    mKcsFailWrite = FALSE;
+    if (!mKcsCommandIn || (mKcsDataIn != MOCK_KCS_GET_STATUS)) {
+      MockKcsError (MOCK_KCS_STATUS_ILLEGAL_CONTROL_CODE);
+      return;
+    }
+  }
+
+  if (mKcsCommandIn) {
+    switch (mKcsDataIn) {
+      case MOCK_KCS_WRITE_START:
+        mKcsState       = MOCK_KCS_STATE_WRITE;
+        mKcsPhase       = MockKcsPhaseWrite;
+        mKcsRequestSize = 0;
+        break;
+
+      case MOCK_KCS_WRITE_END:
+        if (mKcsPhase != MockKcsPhaseWrite) {
+          MockKcsError (MOCK_KCS_STATUS_ILLEGAL_CONTROL_CODE);
+          break;
+        }
+
+        mKcsPhase = MockKcsPhaseWriteEnd;
+        break;
+
+      case MOCK_KCS_GET_STATUS:
+        mKcsStatistics.Aborts++;
+        mKcsState           = MOCK_KCS_STATE_WRITE;
+        mKcsPhase           = MockKcsPhaseAbort;
+        mKcsResponsePending = FALSE;
+        break;
+
+      default:
+        MockKcsError (MOCK_KCS_STATUS_ILLEGAL_CONTROL_CODE);
+        break;
+    }
+
+    return;
+  }
+
+  switch (mKcsPhase) {
+    case MockKcsPhaseWrite:
+    case MockKcsPhaseWriteEnd:
+      if (mKcsRequestSize >= sizeof (mKcsRequest)) {
+        MockKcsError (MOCK_KCS_STATUS_ILLEGAL_CONTROL_CODE);
+        break;
+      }
+
+      mKcsRequest[mKcsRequestSize++] = mKcsDataIn;
+      if (mKcsPhase == MockKcsPhaseWriteEnd) {
+        MockKcsDispatch ();
+      }
+
+      break;
+
+    case MockKcsPhaseAbort:
+      //
+      // The status code is returned as a one byte response.
+      //
+      mKcsResponse[0]    = mKcsLastError;
+      mKcsResponseSize   = 1;
+      mKcsResponseOffset = 0;
+      mKcsLastError      = 0;
+      mKcsState          = MOCK_KCS_STATE_READ;
+      mKcsPhase          = MockKcsPhaseRead;
+      MockKcsQueueResponse (0);
+      break;
+
+    case MockKcsPhaseRead:
+      if (mKcsDataIn != MOCK_KCS_READ) {
+        MockKcsError (MOCK_KCS_STATUS_ILLEGAL_CONTROL_CODE);
+        break;
+      }
+
+      if (mKcsResponseOffset < mKcsResponseSize) {
+        MockKcsQueueResponse (0);
+        break;
+      }
+
+      //
+      // The response has been read, a dummy byte ends the transaction.
+      //
+      mKcsState   = MOCK_KCS_STATE_IDLE;
+      mKcsPhase   = MockKcsPhaseIdle;
+      mKcsDataOut = 0;
+      mKcsObf     = TRUE;
+      break;
+
+    default:
+      MockKcsError (MOCK_KCS_STATUS_ILLEGAL_CONTROL_CODE);
+      break;
+  }
+}
+
+/**
+  Advances the BMC to the virtual time, taking the last write of the host and
+  placing the next response byte once they are due.
+**/
+STATIC
+VOID
+MockKcsUpdate (
+  VOID
+  )
+{
+  UINT64  Now;
+
+  Now = MockKcsNow ();
+  if (mKcsIbf && (Now >= mKcsIbfClearTime)) {
+    mKcsIbf = FALSE;
+    MockKcsTakeWrite ();
+  }
+
+  if (!mKcsIbf && mKcsResponsePending && (Now >= mKcsResponseTime)) {
+    mKcsResponsePending = FALSE;
+    mKcsDataOut         = mKcsResponse[mKcsResponseOffset++];
+    mKcsObf             = TRUE;
+  }
+}
+
+/**
+  Reads a simulated KCS register, after the time the access takes.
+
+  @param[in]  Register    The index of the KCS register.
+
+  @retval   The value read.
+**/
+STATIC
+UINT8
+MockKcsRead (
+  IN UINT8  Register
+  )
+{
+  UINT8  Value;
+
+  MicroSecondDelay (mKcsIoCost);
+  MockKcsUpdate ();
+  mKcsStatistics.IoReads++;
+  if (Register == MOCK_KCS_STATUS_REGISTER) {
+    mKcsStatistics.StatusReads++;
+    Value = (UINT8)(mKcsState << 6);
+    Value = (UINT8)(Value | (mKcsCommandIn ? MOCK_KCS_STATUS_CD : 0));
+    Value = (UINT8)(Value | (mKcsIbf ? MOCK_KCS_STATUS_IBF : 0));
+    Value = (UINT8)(Value | (mKcsObf ? MOCK_KCS_STATUS_OBF : 0));
+    return Value;
+  }
+
+  mKcsObf = FALSE;
+  return mKcsDataOut;
+}
+
+/**
+  Writes a simulated KCS register, after the time the access takes. The BMC
+  takes the write once the byte latency, and any stall set for it, has passed.
+
+  @param[in]  Register    The index of the KCS register.
+  @param[in]  Value       The value to write.
+**/
+STATIC
+VOID
+MockKcsWrite (
+  IN UINT8  Register,
+  IN UINT8  Value
+  )
+{
+  UINT64  Delay;
+
+  MicroSecondDelay (mKcsIoCost);
+  MockKcsUpdate ();
+  mKcsStatistics.IoWrites++;
+
+  Delay = mKcsByteLatency;
+  if (mKcsWrites == mKcsStallWrite) {
+    Delay += mKcsStallTime;
+  }
+
+  mKcsFailWrite = (BOOLEAN)(mKcsWrites == mKcsErrorWrite);
+  mKcsWrites++;
+
+  mKcsCommandIn    = (BOOLEAN)(Register == MOCK_KCS_STATUS_REGISTER);
+  mKcsDataIn       = Value;
+  mKcsIbf          = TRUE;
+  mKcsIbfClearTime = MockKcsNow () + MultU64x32 (Delay, 1000);
+}
+
+/**
+  Reads an 8-bit I/O port.
+
+  @param[in]  Port    The I/O port to read.
+
+  @retval   The value read, 0xFF for ports without a KCS register.
+**/
+UINT8
+EFIAPI
+IoRead8 (
+  IN UINTN  Port
+  )
+{
+  if (Port == PcdGet16 (PcdIpmiIoCmdRegister)) {
+    return MockKcsRead (MOCK_KCS_STATUS_REGISTER);
+  }
+
+  if (Port == PcdGet16 (PcdIpmiIoBaseAddress)) {
+    return MockKcsRead (MOCK_KCS_DATA_REGISTER);
+  }
+
+  return 0xFF;
+}
+
+/**
+  Writes an 8-bit I/O port.
+
+  @param[in]  Port    The I/O port to write.
+  @param[in]  Value   The value to write.
+
+  @retval   The value written.
+**/
+UINT8
+EFIAPI
+IoWrite8 (
+  IN UINTN  Port,
+  IN UINT8  Value
+  )
+{
+  if (Port == PcdGet16 (PcdIpmiIoCmdRegister)) {
+    MockKcsWrite (MOCK_KCS_STATUS_REGISTER, Value);
+  } else if (Port == PcdGet16 (PcdIpmiIoBaseAddress)) {
+    MockKcsWrite (MOCK_KCS_DATA_REGISTER, Value);
+  }
+
+  return Value;
+}
+
+/**
+  Reads an 8-bit MMIO register.
+
+  @param[in]  Address   The MMIO register to read.
+
+  @retval   The value read.
+**/
+UINT8
+EFIAPI
+MmioRead8 (
+  IN UINTN  Address
+  )
+{
+  mKcsStatistics.MmioAccesses++;
+  return MockKcsRead ((UINT8)((Address - PcdGet64 (PcdIpmiAddress)) / MAX (PcdGet8 (PcdIpmiRegisterBitWidth) / 8, 1)));
+}
+
+/**
+  Writes an 8-bit MMIO register.
+
+  @param[in]  Address   The MMIO register to write.
+  @param[in]  Value     The value to write.
+
+  @retval   The value written.
+**/
+UINT8
+EFIAPI
+MmioWrite8 (
+  IN UINTN  Address,
+  IN UINT8  Value
+  )
+{
+  mKcsStatistics.MmioAccesses++;
+  MockKcsWrite ((UINT8)((Address - PcdGet64 (PcdIpmiAddress)) / MAX (PcdGet8 (PcdIpmiRegisterBitWidth) / 8, 1)), Value);
+  return Value;
+}
@@ -8,6 +8,24 @@
 
 #include <MockIpmi.h>
 #include <Library/IpmiTransportLib.h>
+#include <Library/IpmiTransportExLib.h>
+
+STATIC IPMI_RESPONSE_DATA  mMockMessage;
+STATIC EFI_STATUS          mMockTransportStatus = EFI_SUCCESS;
+
+/**
+  Sets the status returned by the mock transport, simulating a BMC that does
+  not respond when an error is set.
+
+  @param[in]  Status    The status to return, EFI_SUCCESS for normal operation.
+**/
+VOID
+MockIpmiSetTransportStatus (
+  IN EFI_STATUS  Status
+  )
+{
+  mMockTransportStatus = Status;
+}
 
 /**
   Mock implementation of SendDataToBmcPort.
@@ -47,6 +65,165 @@ ReceiveBmcDataFromPort (
   return MockIpmiResponse ((IPMI_RESPONSE *)Data, DataSize);
 }
 
+/**
+  Mock implementation of SendDataToBmcPortEx.
+
+  @param[in]  TimeoutUs             UNUSED.
+  @param[in]  Header                The header to send to the mock BMC.
+  @param[in]  HeaderSize            The size of the header.
+  @param[in]  Data                  The data to send to the mock BMC.
+  @param[in]  DataSize              The size of the data.
+
+  @retval   EFI_SUCCESS             The data was sent.
+  @retval   Other                   The status set by MockIpmiSetTransportStatus.
+**/
+EFI_STATUS
+SendDataToBmcPortEx (
+  UINT64  TimeoutUs,
+  UINT8   *Header,
+  UINT8   HeaderSize,
+  UINT8   *Data,
+  UINT32  DataSize
+  )
+{
+  UINT8  *Message;
+
+  if (EFI_ERROR (mMockTransportStatus)) {
+    return mMockTransportStatus;
+  }
+
+  if ((UINTN)HeaderSize + DataSize > sizeof (mMockMessage)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  //
+  // The mock BMC consumes a contiguous message.
+  //
+
+  Message = (UINT8 *)&mMockMessage;
+  CopyMem (Message, Header, HeaderSize);
+  CopyMem (Message + HeaderSize, Data, DataSize);
+  return MockIpmiCommand ((IPMI_COMMAND *)Message, (UINT8)(HeaderSize + DataSize));
+}
+
+/**
+  Mock implementation of ReceiveBmcDataFromPortEx.
+
+  @param[in]      TimeoutUs           UNUSED.
+  @param[out]     Header              The header received from the mock BMC.
+  @param[in]      HeaderSize          The size of the header.
+  @param[out]     Data                The data received from the mock BMC.
+  @param[in,out]  DataSize            The size of the data.
+
+  @retval   EFI_SUCCESS             The response was received.
+  @retval   EFI_BUFFER_TOO_SMALL    The data did not fit in the buffer.
+  @retval   Other                   The status set by MockIpmiSetTransportStatus.
+**/
+EFI_STATUS
+ReceiveBmcDataFromPortEx (
+  UINT64  TimeoutUs,
+  UINT8   *Header,
+  UINT8   HeaderSize,
+  UINT8   *Data,
+  UINT32  *DataSize
+  )
+{
+  EFI_STATUS  Status;
+  UINT8       *Message;
+  UINT8       MessageSize;
+  UINT32      BodySize;
+
+  if (EFI_ERROR (mMockTransportStatus)) {
+    return mMockTransportStatus;
+  }
+
+  Message     = (UINT8 *)&mMockMessage;
+  MessageSize = sizeof (mMockMessage);
+  Status      = MockIpmiResponse ((IPMI_RESPONSE *)Message, &MessageSize);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  CopyMem (Header, Message, MIN (HeaderSize, MessageSize));
+  BodySize = (MessageSize > HeaderSize) ? (UINT32)(MessageSize - HeaderSize) : 0;
+  CopyMem (Data, Message + HeaderSize, MIN (BodySize, *DataSize));
+  if (BodySize > *DataSize) {
+    *DataSize = BodySize;
+    return EFI_BUFFER_TOO_SMALL;
+  }
+
+  *DataSize = BodySize;
+  return EFI_SUCCESS;
+}
+
+/**
+  Mock implementation of GetBmcMaxMessageSize, limited by the message buffer
+  of the mock BMC.
+
+  @param[out]  MaxRequestSize     The largest request body in bytes.
+  @param[out]  MaxResponseSize    The largest response body in bytes.
+**/
+VOID
+GetBmcMaxMessageSize (
+  OUT UINT32  *MaxRequestSize,
+  OUT UINT32  *MaxResponseSize
+  )
+{
+  *MaxRequestSize  = sizeof (mMockMessage) - sizeof (IPMI_COMMAND);
+  *MaxResponseSize = sizeof (mMockMessage) - sizeof (IPMI_RESPONSE);
+}
+
+/**
+  Mock implementation of CheckBmcResponseReady. The mock BMC prepares the
+  response as soon as the request is sent.
+
+  @retval   EFI_SUCCESS   Always.
+**/
+EFI_STATUS
+CheckBmcResponseReady (
+  VOID
+  )
+{
+  return EFI_SUCCESS;
+}
+
+/**
+  Mock implementation of IpmiTransportBeginSession. The mock BMC has no
+  connection to keep.
+**/
+VOID
+IpmiTransportBeginSession (
+  VOID
+  )
+{
+}
+
+/**
+  Mock implementation of IpmiTransportEndSession.
+**/
+VOID
+IpmiTransportEndSession (
+  VOID
+  )
+{
+}
+
+/**
+  Mock implementation of IpmiTransportSetCapabilities.
+
+  @param[in]  InterfaceType         UNUSED.
+  @param[in]  Capabilities          UNUSED.
+  @param[in]  CapabilitiesSize      UNUSED.
+**/
+VOID
+IpmiTransportSetCapabilities (
+  IN UINT8   InterfaceType,
+  IN UINT8   *Capabilities,
+  IN UINT32  CapabilitiesSize
+  )
+{
+}
+
 /**
   Mock implementation of InitializeIpmiTransportHardware.
 
@@ -16,19 +16,23 @@
 
 MOCK_IPMI_HANDLER_ENTRY  MockHandlers[] =
 {
-  { IPMI_NETFN_APP,     IPMI_APP_GET_DEVICE_ID,               MockIpmiGetDeviceId          },
-  { IPMI_NETFN_APP,     IPMI_APP_GET_SELFTEST_RESULTS,        MockIpmiGetSelfTest          },
-  { IPMI_NETFN_STORAGE, IPMI_STORAGE_GET_SEL_INFO,            MockIpmiSelGetInfo           },
-  { IPMI_NETFN_STORAGE, IPMI_STORAGE_ADD_SEL_ENTRY,           MockIpmiSelAddEntry          },
-  { IPMI_NETFN_STORAGE, IPMI_STORAGE_GET_SEL_TIME,            MockIpmiSelGetTime           },
-  { IPMI_NETFN_STORAGE, IPMI_STORAGE_SET_SEL_TIME,            MockIpmiSelSetTime           },
-  { IPMI_NETFN_STORAGE, IPMI_STORAGE_CLEAR_SEL,               MockIpmiSelClear             },
-  { IPMI_NETFN_STORAGE, IPMI_STORAGE_GET_SEL_ENTRY,           MockIpmiSelGetEntry          },
-  { IPMI_NETFN_APP,     IPMI_APP_GET_WATCHDOG_TIMER,          MockIpmiGetWatchdog          },
-  { IPMI_NETFN_APP,     IPMI_APP_SET_WATCHDOG_TIMER,          MockIpmiSetWatchdog          },
-  { IPMI_NETFN_APP,     IPMI_APP_RESET_WATCHDOG_TIMER,        MockIpmiResetWatchdog        },
-  { IPMI_NETFN_CHASSIS, IPMI_CHASSIS_SET_SYSTEM_BOOT_OPTIONS, MockIpmiSetSystemBootOptions },
-  { IPMI_NETFN_CHASSIS, IPMI_CHASSIS_GET_SYSTEM_BOOT_OPTIONS, MockIpmiGetSystemBootOptions },
+  { IPMI_NETFN_APP,     IPMI_APP_GET_DEVICE_ID,                     MockIpmiGetDeviceId                    },
+  { IPMI_NETFN_APP,     IPMI_APP_GET_SELFTEST_RESULTS,              MockIpmiGetSelfTest                    },
+  { IPMI_NETFN_APP,     IPMI_APP_GET_SYSTEM_GUID,                   MockIpmiGetSystemGuid                  },
+  { IPMI_NETFN_APP,     IPMI_APP_GET_SYSTEM_INTERFACE_CAPABILITIES, MockIpmiGetSystemInterfaceCapabilities },
+  { IPMI_NETFN_APP,     IPMI_APP_MASTER_WRITE_READ,                 MockIpmiMasterWriteRead                },
+  { IPMI_NETFN_STORAGE, IPMI_STORAGE_GET_SEL_INFO,                  MockIpmiSelGetInfo                     },
+  { IPMI_NETFN_STORAGE, IPMI_STORAGE_ADD_SEL_ENTRY,                 MockIpmiSelAddEntry                    },
+  { IPMI_NETFN_STORAGE, IPMI_STORAGE_GET_SEL_TIME,                  MockIpmiSelGetTime                     },
+  { IPMI_NETFN_STORAGE, IPMI_STORAGE_SET_SEL_TIME,                  MockIpmiSelSetTime                     },
+  { IPMI_NETFN_STORAGE, IPMI_STORAGE_CLEAR_SEL,                     MockIpmiSelClear                       },
+  { IPMI_NETFN_STORAGE, IPMI_STORAGE_GET_SEL_ENTRY,                 MockIpmiSelGetEntry                    },
+  { IPMI_NETFN_STORAGE, IPMI_STORAGE_RESERVE_SEL,                   MockIpmiSelReserve                     },
+  { IPMI_NETFN_APP,     IPMI_APP_GET_WATCHDOG_TIMER,                MockIpmiGetWatchdog                    },
+  { IPMI_NETFN_APP,     IPMI_APP_SET_WATCHDOG_TIMER,                MockIpmiSetWatchdog                    },
+  { IPMI_NETFN_APP,     IPMI_APP_RESET_WATCHDOG_TIMER,              MockIpmiResetWatchdog                  },
+  { IPMI_NETFN_CHASSIS, IPMI_CHASSIS_SET_SYSTEM_BOOT_OPTIONS,       MockIpmiSetSystemBootOptions           },
+  { IPMI_NETFN_CHASSIS, IPMI_CHASSIS_GET_SYSTEM_BOOT_OPTIONS,       MockIpmiGetSystemBootOptions           },
 };
 
 //
@@ -38,6 +42,9 @@ MOCK_IPMI_HANDLER_ENTRY  MockHandlers[] =
 STATIC BOOLEAN             mResponseValid;
 STATIC IPMI_RESPONSE_DATA  mResponse;
 STATIC UINT8               mResponseSize;
+STATIC UINT8               mBusyCompletionCode;
+STATIC UINT8               mBusyCount;
+STATIC UINT32              mCommandCount;
 
 //
 // Generic routines for handling top level IPMI commands and responses.
@@ -64,6 +71,8 @@ MockIpmiCommand (
   ASSERT (Command != NULL);
   ASSERT (Size >= sizeof (IPMI_COMMAND));
 
+  mCommandCount++;
+
   //
   // Generic response handling. Add the 0 bit value to indicate this is a
   // response.
@@ -74,6 +83,18 @@ MockIpmiCommand (
   mResponse.ResponseData[0]    = IPMI_COMP_CODE_INVALID_COMMAND;
   mResponseSize                = sizeof (IPMI_RESPONSE);
 
+  //
+  // Fail the command without handling it while the BMC is set busy.
+  //
+
+  if (mBusyCount > 0) {
+    mBusyCount--;
+    mResponse.ResponseData[0] = mBusyCompletionCode;
+    mResponseSize             = sizeof (IPMI_RESPONSE) + sizeof (mResponse.ResponseData[0]);
+    mResponseValid            = TRUE;
+    return EFI_SUCCESS;
+  }
+
   //
   // Search for a specific handler.
   //
@@ -107,6 +128,36 @@ MockIpmiCommand (
   return EFI_SUCCESS;
 }
 
+/**
+  Answers the next IPMI requests with a completion code instead of handling
+  them, simulating a BMC that is busy.
+
+  @param[in]  CompletionCode    The completion code to respond with.
+  @param[in]  Count             The number of requests to answer, 0 to stop.
+**/
+VOID
+MockIpmiSetBusy (
+  IN UINT8  CompletionCode,
+  IN UINT8  Count
+  )
+{
+  mBusyCompletionCode = CompletionCode;
+  mBusyCount          = Count;
+}
+
+/**
+  Retrieves the number of IPMI requests the mock BMC has received.
+
+  @retval   The number of requests since the start of the test.
+**/
+UINT32
+MockIpmiGetCommandCount (
+  VOID
+  )
+{
+  return mCommandCount;
+}
+
 /**
   Provides the prepared response to the last IPMI request.
 
@@ -205,3 +256,114 @@ MockIpmiGetDeviceId (
 
   *ResponseSize = sizeof (IPMI_GET_DEVICE_ID_RESPONSE);
 }
+
+/**
+  Mocks the result of IPMI_APP_GET_SYSTEM_GUID.
+
+  @param[in]       Data           The IPMI request data.
+  @param[in]       DataSize       The size of the IPMI request data.
+  @param[out]      Response       The response data buffer.
+  @param[in, out]  ResponseSize   On input, the available size of buffer.
+                                  On output, the size of written data in the buffer.
+**/
+VOID
+MockIpmiGetSystemGuid (
+  IN VOID       *Data,
+  IN UINT8      DataSize,
+  OUT VOID      *Response,
+  IN OUT UINT8  *ResponseSize
+  )
+{
+  IPMI_GET_SYSTEM_GUID_RESPONSE  *SystemGuid;
+
+  ASSERT (*ResponseSize >= sizeof (IPMI_GET_SYSTEM_GUID_RESPONSE));
+
+  SystemGuid                 = Response;
+  SystemGuid->CompletionCode = IPMI_COMP_CODE_NORMAL;
+  SystemGuid->Guid.Data1     = 0x12345678;
+  SystemGuid->Guid.Data2     = 0x9ABC;
+  SystemGuid->Guid.Data3     = 0xDEF0;
+  SetMem (SystemGuid->Guid.Data4, sizeof (SystemGuid->Guid.Data4), 0xA5);
+
+  *ResponseSize = sizeof (IPMI_GET_SYSTEM_GUID_RESPONSE);
+}
+
+/**
+  Mocks the result of IPMI_APP_GET_SYSTEM_INTERFACE_CAPABILITIES.
+
+  @param[in]       Data           The IPMI request data.
+  @param[in]       DataSize       The size of the IPMI request data.
+  @param[out]      Response       The response data buffer.
+  @param[in, out]  ResponseSize   On input, the available size of buffer.
+                                  On output, the size of written data in the buffer.
+**/
+VOID
+MockIpmiGetSystemInterfaceCapabilities (
+  IN VOID       *Data,
+  IN UINT8      DataSize,
+  OUT VOID      *Response,
+  IN OUT UINT8  *ResponseSize
+  )
+{
+  IPMI_GET_SYSTEM_INTERFACE_CAPABILITY_REQUEST   *Request;
+  IPMI_GET_SYSTEM_INTERFACE_CAPABILITY_RESPONSE  *Capability;
+
+  ASSERT (*ResponseSize >= sizeof (IPMI_GET_SYSTEM_INTERFACE_CAPABILITY_RESPONSE));
+
+  Request    = Data;
+  Capability = Response;
+  ZeroMem (Capability, sizeof (*Capability));
+
+  if ((DataSize < sizeof (*Request)) || (Request->SystemInterfaceType != GetSystemInterfaceTypeKcs)) {
+    Capability->KcsInterface.CompletionCode = IPMI_COMP_CODE_INVALID_DATA_FIELD;
+    *ResponseSize                           = 1;
+    return;
+  }
+
+  Capability->KcsInterface.CompletionCode = IPMI_COMP_CODE_NORMAL;
+  Capability->KcsInterface.MaxMessageSize = MOCK_IPMI_BUFFER_SIZE;
+
+  *ResponseSize = sizeof (IPMI_GET_SYSTEM_INTERFACE_CAPABILITY_RESPONSE_KCS);
+}
+
+/**
+  Mocks the result of IPMI_APP_MASTER_WRITE_READ. The mock device on the bus
+  ignores the write data and returns a counting pattern of the requested size,
+  which allows requests and responses of any size to be exercised.
+
+  @param[in]       Data           The IPMI request data.
+  @param[in]       DataSize       The size of the IPMI request data.
+  @param[out]      Response       The response data buffer.
+  @param[in, out]  ResponseSize   On input, the available size of buffer.
+                                  On output, the size of written data in the buffer.
+**/
+VOID
+MockIpmiMasterWriteRead (
+  IN VOID       *Data,
+  IN UINT8      DataSize,
+  OUT VOID      *Response,
+  IN OUT UINT8  *ResponseSize
+  )
+{
+  IPMI_MASTER_WRITE_READ_REQUEST   *Request;
+  IPMI_MASTER_WRITE_READ_RESPONSE  *ReadData;
+  UINT8                            Index;
+
+  Request  = Data;
+  ReadData = Response;
+
+  if ((DataSize < OFFSET_OF (IPMI_MASTER_WRITE_READ_REQUEST, WriteData)) ||
+      (Request->ReadCount > *ResponseSize - OFFSET_OF (IPMI_MASTER_WRITE_READ_RESPONSE, RawData)))
+  {
+    ReadData->CompletionCode = IPMI_COMP_CODE_INVALID_DATA_FIELD;
+    *ResponseSize            = 1;
+    return;
+  }
+
+  ReadData->CompletionCode = IPMI_COMP_CODE_NORMAL;
+  for (Index = 0; Index < Request->ReadCount; Index++) {
+    ReadData->RawData[Index] = Index;
+  }
+
+  *ResponseSize = (UINT8)(OFFSET_OF (IPMI_MASTER_WRITE_READ_RESPONSE, RawData) + Request->ReadCount);
+}
@@ -14,6 +14,7 @@
 #include <Library/DebugLib.h>
 #include <Library/BaseMemoryLib.h>
 #include <IndustryStandard/Ipmi.h>
+#include <IpmiFeature.h>
 
 #define MOCK_IPMI_BUFFER_SIZE  250
 
@@ -91,6 +92,40 @@ MockIpmiResponse (
   IN OUT UINT8       *Size
   );
 
+/**
+  Sets the status returned by the mock transport, simulating a BMC that does
+  not respond when an error is set.
+
+  @param[in]  Status    The status to return, EFI_SUCCESS for normal operation.
+**/
+VOID
+MockIpmiSetTransportStatus (
+  IN EFI_STATUS  Status
+  );
+
+/**
+  Answers the next IPMI requests with a completion code instead of handling
+  them, simulating a BMC that is busy.
+
+  @param[in]  CompletionCode    The completion code to respond with.
+  @param[in]  Count             The number of requests to answer, 0 to stop.
+**/
+VOID
+MockIpmiSetBusy (
+  IN UINT8  CompletionCode,
+  IN UINT8  Count
+  );
+
+/**
+  Retrieves the number of IPMI requests the mock BMC has received.
+
+  @retval   The number of requests since the start of the test.
+**/
+UINT32
+MockIpmiGetCommandCount (
+  VOID
+  );
+
 //
 // Mock IPMI routines.
 //
@@ -129,6 +164,59 @@ MockIpmiGetDeviceId (
   IN OUT UINT8  *ResponseSize
   );
 
+/**
+  Mocks the result of IPMI_APP_GET_SYSTEM_GUID.
+
+  @param[in]       Data           The IPMI request data.
+  @param[in]       DataSize       The size of the IPMI request data.
+  @param[out]      Response       The response data buffer.
+  @param[in, out]  ResponseSize   On input, the available size of buffer.
+                                  On output, the size of written data in the buffer.
+**/
+VOID
+MockIpmiGetSystemGuid (
+  IN VOID       *Data,
+  IN UINT8      DataSize,
+  OUT VOID      *Response,
+  IN OUT UINT8  *ResponseSize
+  );
+
+/**
+  Mocks the result of IPMI_APP_GET_SYSTEM_INTERFACE_CAPABILITIES.
+
+  @param[in]       Data           The IPMI request data.
+  @param[in]       DataSize       The size of the IPMI request data.
+  @param[out]      Response       The response data buffer.
+  @param[in, out]  ResponseSize   On input, the available size of buffer.
+                                  On output, the size of written data in the buffer.
+**/
+VOID
+MockIpmiGetSystemInterfaceCapabilities (
+  IN VOID       *Data,
+  IN UINT8      DataSize,
+  OUT VOID      *Response,
+  IN OUT UINT8  *ResponseSize
+  );
+
+/**
+  Mocks the result of IPMI_APP_MASTER_WRITE_READ. The mock device on the bus
+  ignores the write data and returns a counting pattern of the requested size,
+  which allows requests and responses of any size to be exercised.
+
+  @param[in]       Data           The IPMI request data.
+  @param[in]       DataSize       The size of the IPMI request data.
+  @param[out]      Response       The response data buffer.
+  @param[in, out]  ResponseSize   On input, the available size of buffer.
+                                  On output, the size of written data in the buffer.
+**/
+VOID
+MockIpmiMasterWriteRead (
+  IN VOID       *Data,
+  IN UINT8      DataSize,
+  OUT VOID      *Response,
+  IN OUT UINT8  *ResponseSize
+  );
+
 /**
   Mocks the result of IPMI_STORAGE_GET_SEL_INFO.
 
@@ -231,6 +319,23 @@ MockIpmiSelGetEntry (
   IN OUT UINT8  *ResponseSize
   );
 
+/**
+  Mocks the result of IPMI_STORAGE_RESERVE_SEL.
+
+  @param[in]       Data           The IPMI request data.
+  @param[in]       DataSize       The size of the IPMI request data.
+  @param[out]      Response       The response data buffer.
+  @param[in, out]  ResponseSize   On input, the available size of buffer.
+                                  On output, the size of written data in the buffer.
+**/
+VOID
+MockIpmiSelReserve (
+  IN VOID       *Data,
+  IN UINT8      DataSize,
+  OUT VOID      *Response,
+  IN OUT UINT8  *ResponseSize
+  );
+
 /**
   Mocks the result of IPMI_APP_GET_WATCHDOG_TIMER.
 
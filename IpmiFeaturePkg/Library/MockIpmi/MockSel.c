@@ -27,8 +27,11 @@ STATIC_ASSERT (sizeof (SEL_GENERIC_EVENT) == 16, "Bad generic SEL event size");
 
 #define SEL_COUNT  (100)
 STATIC SEL_GENERIC_EVENT  mSel[SEL_COUNT];
-STATIC UINT16             mNextRecordId = 0;
-STATIC UINT32             mSelTime      = 0;
+STATIC UINT16             mNextRecordId    = 0;
+STATIC UINT32             mSelTime         = 0;
+STATIC UINT16             mReservationId   = 0;
+STATIC UINT32             mRecentAddTime   = 0;
+STATIC UINT32             mRecentEraseTime = 0;
 
 #define CURRENT_SEL_TIME  (++mSelTime)
 
@@ -58,8 +61,8 @@ MockIpmiSelGetInfo (
   SelInfo->Version              = 0x51; // Per IPMI v2
   SelInfo->NoOfEntries          = mNextRecordId;
   SelInfo->FreeSpace            = (UINT16)(sizeof (mSel) - (sizeof (mSel[0]) * mNextRecordId));
-  SelInfo->RecentAddTimeStamp   = 0;
-  SelInfo->RecentEraseTimeStamp = 0;
+  SelInfo->RecentAddTimeStamp   = mRecentAddTime;
+  SelInfo->RecentEraseTimeStamp = mRecentEraseTime;
   SelInfo->OperationSupport     = 0;
 
   if (mNextRecordId >= SEL_COUNT) {
@@ -105,6 +108,7 @@ MockIpmiSelAddEntry (
     }
 
     mNextRecordId++;
+    mRecentAddTime              = CURRENT_SEL_TIME;
     SelResponse->CompletionCode = IPMI_COMP_CODE_NORMAL;
   } else {
     DEBUG ((DEBUG_ERROR, "Mock SEL is full!\n"));
@@ -206,6 +210,8 @@ MockIpmiSelClear (
   ClearResponse                 = Response;
   ClearResponse->CompletionCode = IPMI_COMP_CODE_NORMAL;
   mNextRecordId                 = 0;
+  mReservationId                = 0;
+  mRecentEraseTime              = CURRENT_SEL_TIME;
   if (ClearRequest->Erase == IPMI_CLEAR_SEL_REQUEST_INITIALIZE_ERASE) {
     ClearResponse->ErasureProgress = IPMI_CLEAR_SEL_RESPONSE_ERASURE_IN_PROGRESS;
   } else if (ClearRequest->Erase == IPMI_CLEAR_SEL_REQUEST_GET_ERASE_STATUS) {
@@ -237,6 +243,7 @@ MockIpmiSelGetEntry (
   IPMI_GET_SEL_ENTRY_REQUEST   *GetRequest;
   IPMI_GET_SEL_ENTRY_RESPONSE  *GetResponse;
   UINT16                       RecordId;
+  UINT16                       ReservationId;
 
   ASSERT (DataSize >= sizeof (IPMI_GET_SEL_ENTRY_REQUEST));
   ASSERT (*ResponseSize >= sizeof (IPMI_GET_SEL_ENTRY_RESPONSE));
@@ -246,9 +253,13 @@ MockIpmiSelGetEntry (
   ZeroMem (GetResponse, sizeof (IPMI_GET_SEL_ENTRY_RESPONSE));
   *ResponseSize = sizeof (IPMI_GET_SEL_ENTRY_RESPONSE);
 
-  if ((GetRequest->ReserveId[0] != 0) ||
-      (GetRequest->ReserveId[1] != 0) ||
-      (GetRequest->Offset != 0) ||
+  ReservationId = GetRequest->ReserveId[0] | (GetRequest->ReserveId[1] << 8);
+  if ((ReservationId != 0) && (ReservationId != mReservationId)) {
+    GetResponse->CompletionCode = IPMI_COMP_CODE_RESERVATION_CANCELED_OR_INVALID;
+    return;
+  }
+
+  if ((GetRequest->Offset != 0) ||
       (GetRequest->BytesToRead != 0xFF))
   {
     DEBUG ((DEBUG_ERROR, "%a: Mock SEL does not support partial entry reads!\n", __FUNCTION__));
@@ -273,3 +284,38 @@ MockIpmiSelGetEntry (
   CopyMem (&GetResponse->RecordData, &mSel[RecordId], sizeof (mSel[0]));
   GetResponse->CompletionCode = IPMI_COMP_CODE_NORMAL;
 }
+
+/**
+  Mocks the result of IPMI_STORAGE_RESERVE_SEL. Every reservation cancels the
+  previous one, and clearing the SEL cancels the current one.
+
+  @param[in]       Data           The IPMI request data.
+  @param[in]       DataSize       The size of the IPMI request data.
+  @param[out]      Response       The response data buffer.
+  @param[in, out]  ResponseSize   On input, the available size of buffer.
+                                  On output, the size of written data in the buffer.
+**/
+VOID
+MockIpmiSelReserve (
+  IN VOID       *Data,
+  IN UINT8      DataSize,
+  OUT VOID      *Response,
+  IN OUT UINT8  *ResponseSize
+  )
+{
+  UINT8  *ReserveResponse;
+
+  ASSERT (*ResponseSize >= 3);
+
+  mReservationId++;
+  if (mReservationId == 0) {
+    mReservationId++;
+  }
+
+  ReserveResponse    = Response;
+  ReserveResponse[0] = IPMI_COMP_CODE_NORMAL;
+  ReserveResponse[1] = (UINT8)(mReservationId & 0xFF);
+  ReserveResponse[2] = (UINT8)((mReservationId >> 8) & 0xFF);
+
+  *ResponseSize = 3;
+}
@@ -34,7 +34,6 @@ IpmiReportStatusCode (
 
 {
   EFI_STATUS            Status;
-  UINT16                RecordId;
   SEL_STATUS_CODE_DATA  EntryData;
 
   //
@@ -50,11 +49,12 @@ IpmiReportStatusCode (
 
   //
   // It might be desired to cache status codes if the IPMI protocol is not yet
-  // available
+  // available. The record ID is not requested so the SEL library may queue
+  // the entry instead of waiting for the BMC at TPL_HIGH_LEVEL.
   //
 
   Status = SelAddOemEntry (
-             &RecordId,
+             NULL,
              0, // TODO: Platform specific Record Type code.
              (UINT8 *)&EntryData
              );
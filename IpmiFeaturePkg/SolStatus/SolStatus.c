@@ -16,7 +16,14 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include <Library/IpmiCommandLib.h>
 #include <IndustryStandard/Ipmi.h>
 
+//
+// Transient completion codes are retried by the IPMI transport under its
+// retry policy. Transport errors are retried here, a bounded number of times.
+//
 #define SOL_CMD_RETRY_COUNT  10
+#define SOL_CMD_RETRY_DELAY  100000
+
+#define SOL_CMD_RETRY_STATUS(Status)  (((Status) == EFI_TIMEOUT) || ((Status) == EFI_DEVICE_ERROR))
 
 /*++
 
@@ -60,11 +67,11 @@ GetSOLStatus (
                  &DataSize
                  );
 
-    if (Status == EFI_SUCCESS) {
+    if (!SOL_CMD_RETRY_STATUS (Status)) {
       break;
-    } else {
-      gBS->Stall (100000);
     }
+
+    gBS->Stall (SOL_CMD_RETRY_DELAY);
   }
 
   if (Status == EFI_SUCCESS) {
@@ -115,11 +122,11 @@ SetSOLParams (
                &CompletionCode
                );
 
-    if (Status == EFI_SUCCESS) {
+    if (!SOL_CMD_RETRY_STATUS (Status)) {
       break;
-    } else {
-      gBS->Stall (100000);
     }
+
+    gBS->Stall (SOL_CMD_RETRY_DELAY);
   }
 
   return Status;
@@ -0,0 +1,265 @@
+/** @file
+  Host based benchmark of the KCS transport library against the simulated KCS
+  BMC. Each scenario runs a mix of IPMI commands against a BMC with a given
+  latency, stall or error behavior and reports the I/O operations, virtual
+  time and retries each command cost.
+
+  Copyright (c) Microsoft Corporation
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/DebugLib.h>
+#include <Library/TimerLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/UnitTestLib.h>
+#include <Library/IpmiTransportLib.h>
+#include <Library/IpmiTransportExLib.h>
+#include <IndustryStandard/Ipmi.h>
+#include <MockKcsBmc.h>
+
+#define UNIT_TEST_NAME     "KCS Benchmark"
+#define UNIT_TEST_VERSION  "1.0"
+
+//
+// Commands run by each scenario, attempts made for each command and the time
+// budget of each send and receive in microseconds.
+//
+#define KCS_BENCHMARK_COMMANDS  48
+#define KCS_BENCHMARK_ATTEMPTS  3
+#define KCS_BENCHMARK_TIMEOUT   (5 * 1000 * 1000)
+
+//
+// The write of each command the scenario stalls or fails, counting WRITE_START
+// as write 0.
+//
+#define KCS_BENCHMARK_FAULT_WRITE  3
+
+//
+// Behavior of the simulated BMC in a scenario.
+//
+typedef struct {
+  CHAR8      *Name;
+  UINT32     ByteLatency;       // Microseconds IBF stays set after each write.
+  UINT32     ResponseLatency;   // Microseconds before the first response byte.
+  UINT32     StallTime;         // Microseconds each command is stalled, or 0.
+  BOOLEAN    Error;             // TRUE to fail the first attempt of each command.
+} KCS_BENCHMARK_SCENARIO;
+
+//
+// A command of the benchmark mix.
+//
+typedef struct {
+  UINT8    NetFunction;
+  UINT8    Command;
+  UINT8    DataSize;
+  UINT8    Data[8];
+} KCS_BENCHMARK_COMMAND;
+
+STATIC KCS_BENCHMARK_COMMAND  mCommands[] = {
+  { IPMI_NETFN_APP,     IPMI_APP_GET_DEVICE_ID,      0, { 0 }                                      },
+  { IPMI_NETFN_STORAGE, IPMI_STORAGE_GET_SEL_INFO,   0, { 0 }                                      },
+  { IPMI_NETFN_APP,     IPMI_APP_SET_WATCHDOG_TIMER, 6, { 0x04, 0x01, 0x00, 0x10, 0x58, 0x02 }     },
+};
+
+STATIC KCS_BENCHMARK_SCENARIO  mIdealBmc   = { "Ideal BMC", 0, 0, 0, FALSE };
+STATIC KCS_BENCHMARK_SCENARIO  mTypicalBmc = { "Typical BMC", 2, 200, 0, FALSE };
+STATIC KCS_BENCHMARK_SCENARIO  mSlowBmc    = { "Slow BMC", 20, 2000, 0, FALSE };
+STATIC KCS_BENCHMARK_SCENARIO  mStalledBmc = { "Stalled BMC", 2, 200, 5000, FALSE };
+STATIC KCS_BENCHMARK_SCENARIO  mFaultyBmc  = { "Faulty BMC", 2, 200, 0, TRUE };
+
+/**
+  Runs one command through the KCS transport, retrying it when the send or
+  receive fails.
+
+  @param[in]   Command      The command to run.
+  @param[out]  Retries      Incremented for every attempt after the first.
+
+  @retval   EFI_SUCCESS     The command completed normally.
+  @retval   Other           The last attempt failed or the BMC returned an
+                            unexpected response.
+**/
+STATIC
+EFI_STATUS
+KcsBenchmarkCommand (
+  IN  KCS_BENCHMARK_COMMAND  *Command,
+  OUT UINT32                 *Retries
+  )
+{
+  UINT8       Header[2];
+  UINT8       ResponseHeader[2];
+  UINT8       Response[64];
+  UINT32      ResponseSize;
+  UINT32      Attempt;
+  EFI_STATUS  Status;
+
+  Header[0] = (UINT8)(Command->NetFunction << 2);
+  Header[1] = Command->Command;
+
+  Status = EFI_DEVICE_ERROR;
+  for (Attempt = 0; Attempt < KCS_BENCHMARK_ATTEMPTS; Attempt++) {
+    if (Attempt > 0) {
+      (*Retries)++;
+    }
+
+    Status = SendDataToBmcPortEx (KCS_BENCHMARK_TIMEOUT, Header, sizeof (Header), Command->Data, Command->DataSize);
+    if (EFI_ERROR (Status)) {
+      continue;
+    }
+
+    ResponseSize = sizeof (Response);
+    Status       = ReceiveBmcDataFromPortEx (KCS_BENCHMARK_TIMEOUT, ResponseHeader, sizeof (ResponseHeader), Response, &ResponseSize);
+    if (!EFI_ERROR (Status)) {
+      break;
+    }
+  }
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if ((ResponseHeader[0] != (UINT8)((Command->NetFunction | 1) << 2)) ||
+      (ResponseHeader[1] != Command->Command) ||
+      (ResponseSize == 0) || (Response[0] != IPMI_COMP_CODE_NORMAL))
+  {
+    return EFI_DEVICE_ERROR;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Runs the command mix against the simulated BMC of a scenario and reports the
+  cost of each command.
+
+  @param[in]  Context   The KCS_BENCHMARK_SCENARIO to run.
+
+  @retval  UNIT_TEST_PASSED             Every command completed and the
+                                        retries match the scenario.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A test case assertion has failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+KcsBenchmarkScenario (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  KCS_BENCHMARK_SCENARIO  *Scenario;
+  MOCK_KCS_STATISTICS     Statistics;
+  UINT32                  Index;
+  UINT32                  Retries;
+  UINT64                  Start;
+  UINT64                  Elapsed;
+  EFI_STATUS              Status;
+
+  Scenario = (KCS_BENCHMARK_SCENARIO *)Context;
+
+  MockKcsReset ();
+  MockKcsSetLatency (Scenario->ByteLatency, Scenario->ResponseLatency);
+
+  Retries = 0;
+  Start   = GetTimeInNanoSecond (GetPerformanceCounter ());
+  for (Index = 0; Index < KCS_BENCHMARK_COMMANDS; Index++) {
+    if (Scenario->StallTime != 0) {
+      MockKcsSetStall (KCS_BENCHMARK_FAULT_WRITE, Scenario->StallTime);
+    }
+
+    if (Scenario->Error) {
+      MockKcsSetError (KCS_BENCHMARK_FAULT_WRITE);
+    }
+
+    Status = KcsBenchmarkCommand (&mCommands[Index % ARRAY_SIZE (mCommands)], &Retries);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+  }
+
+  Elapsed = GetTimeInNanoSecond (GetPerformanceCounter ()) - Start;
+  MockKcsGetStatistics (&Statistics);
+
+  DEBUG ((
+    DEBUG_INFO,
+    "%a: per command %d I/O operations, %d status reads, %ldus, %d.%02d retries, %d aborts\n",
+    Scenario->Name,
+    (Statistics.IoReads + Statistics.IoWrites) / KCS_BENCHMARK_COMMANDS,
+    Statistics.StatusReads / KCS_BENCHMARK_COMMANDS,
+    DivU64x32 (Elapsed, 1000 * KCS_BENCHMARK_COMMANDS),
+    Retries / KCS_BENCHMARK_COMMANDS,
+    (Retries * 100 / KCS_BENCHMARK_COMMANDS) % 100,
+    Statistics.Aborts
+    ));
+
+  UT_ASSERT_EQUAL (Statistics.Requests, KCS_BENCHMARK_COMMANDS);
+  UT_ASSERT_EQUAL (Retries, Scenario->Error ? KCS_BENCHMARK_COMMANDS : 0);
+  UT_ASSERT_TRUE (Elapsed >= MultU64x32 (Scenario->ResponseLatency + Scenario->StallTime, 1000 * KCS_BENCHMARK_COMMANDS));
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Initializes and runs the KCS benchmarks.
+
+  @retval  EFI_SUCCESS           All test cases were dispatched.
+  @retval  EFI_OUT_OF_RESOURCES  There are not enough resources available to
+                                 initialize the unit tests.
+**/
+EFI_STATUS
+EFIAPI
+KcsBenchmarkMain (
+  VOID
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+  UNIT_TEST_SUITE_HANDLE      KcsBenchmarks;
+
+  Framework = NULL;
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_NAME, UNIT_TEST_VERSION));
+
+  //
+  // Start setting up the test framework for running the benchmarks.
+  //
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_NAME, gEfiCallerBaseName, UNIT_TEST_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  //
+  // Populate the KCS Benchmark Suite.
+  //
+  Status = CreateUnitTestSuite (&KcsBenchmarks, Framework, "KCS Transport Benchmarks", "IPMI.KCS.Benchmark", NULL, NULL);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for KcsBenchmarks\n"));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  AddTestCase (KcsBenchmarks, "Benchmarks a BMC that answers at once", "IdealBmc", KcsBenchmarkScenario, NULL, NULL, &mIdealBmc);
+  AddTestCase (KcsBenchmarks, "Benchmarks a BMC with typical latency", "TypicalBmc", KcsBenchmarkScenario, NULL, NULL, &mTypicalBmc);
+  AddTestCase (KcsBenchmarks, "Benchmarks a slow BMC", "SlowBmc", KcsBenchmarkScenario, NULL, NULL, &mSlowBmc);
+  AddTestCase (KcsBenchmarks, "Benchmarks a BMC that stalls every request", "StalledBmc", KcsBenchmarkScenario, NULL, NULL, &mStalledBmc);
+  AddTestCase (KcsBenchmarks, "Benchmarks a BMC that fails every first attempt", "FaultyBmc", KcsBenchmarkScenario, NULL, NULL, &mFaultyBmc);
+
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return Status;
+}
+
+/**
+  Standard POSIX C entry point for host based benchmark execution.
+**/
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+{
+  return KcsBenchmarkMain ();
+}
@@ -0,0 +1,309 @@
+/** @file
+  Host based benchmark of the SSIF transport library against the simulated SSIF
+  BMC. Each scenario sends messages of increasing size over an SMBus of a given
+  speed, with or without SMBALERT# and bus errors, and reports the SMBus
+  transactions, virtual time and retries each command cost.
+
+  Copyright (c) Microsoft Corporation
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/DebugLib.h>
+#include <Library/TimerLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/UnitTestLib.h>
+#include <Library/IpmiTransportLib.h>
+#include <Library/IpmiTransportExLib.h>
+#include <IndustryStandard/Ipmi.h>
+#include <Ssif.h>
+#include <MockSsifBmc.h>
+
+#define UNIT_TEST_NAME     "SSIF Benchmark"
+#define UNIT_TEST_VERSION  "1.0"
+
+//
+// Commands run for each message size, attempts made for each command and the
+// time budget of each send and receive in microseconds.
+//
+#define SSIF_BENCHMARK_COMMANDS  16
+#define SSIF_BENCHMARK_ATTEMPTS  3
+#define SSIF_BENCHMARK_TIMEOUT   (5 * 1000 * 1000)
+
+//
+// Header of the Master Write-Read request before the write data, and of the
+// response before the read data.
+//
+#define SSIF_BENCHMARK_REQUEST_OVERHEAD   (2 + 3)
+#define SSIF_BENCHMARK_RESPONSE_OVERHEAD  (2 + 1)
+
+//
+// Behavior of the simulated bus and BMC in a scenario.
+//
+typedef struct {
+  CHAR8      *Name;
+  UINT32     TransactionTime;   // Microseconds of every SMBus transaction.
+  UINT32     ByteTime;          // Microseconds of every byte on the bus.
+  UINT32     ResponseLatency;   // Microseconds before the response is ready.
+  BOOLEAN    Alert;             // TRUE if the platform supports SMBALERT#.
+  BOOLEAN    Error;             // TRUE to fail a read block of each command.
+} SSIF_BENCHMARK_SCENARIO;
+
+//
+// Sizes of the request and response messages, including the NetFn/LUN and
+// command header. They cover single-part messages, the smallest multi-part
+// messages and the largest response of the mock BMC.
+//
+STATIC UINT8  mMessageSizes[] = { 8, 32, 33, 64, 128, 192, 252 };
+
+STATIC SSIF_BENCHMARK_SCENARIO  mStandardBus = { "100 kHz", 10, 90, 500, FALSE, FALSE };
+STATIC SSIF_BENCHMARK_SCENARIO  mFastBus     = { "400 kHz", 3, 23, 500, FALSE, FALSE };
+STATIC SSIF_BENCHMARK_SCENARIO  mAlertBus    = { "100 kHz SMBALERT#", 10, 90, 500, TRUE, FALSE };
+STATIC SSIF_BENCHMARK_SCENARIO  mLossyBus    = { "100 kHz lossy", 10, 90, 500, FALSE, TRUE };
+
+/**
+  Finds the block of a command the lossy scenario fails. That is the first
+  middle or end block of a multi-part response, which the transport reads
+  again with a retry, or else the only block of the response.
+
+  @param[in]  MessageSize   The size of the request and response messages.
+
+  @retval   The block to fail, counting the first write block as 0.
+**/
+STATIC
+UINT32
+SsifBenchmarkFaultBlock (
+  IN UINT8  MessageSize
+  )
+{
+  if (MessageSize <= SSIF_MAX_WRITE_SIZE) {
+    return 1;
+  }
+
+  return (MessageSize + SSIF_MAX_WRITE_SIZE - 1) / SSIF_MAX_WRITE_SIZE + 1;
+}
+
+/**
+  Runs one Master Write-Read command through the SSIF transport, retrying it
+  when the send or receive fails. The mock BMC answers with a counting pattern
+  of the requested size.
+
+  @param[in]   MessageSize  The size of the request and response messages.
+  @param[out]  Retries      Incremented for every attempt after the first.
+
+  @retval   EFI_SUCCESS     The command completed normally.
+  @retval   Other           The last attempt failed or the BMC returned an
+                            unexpected response.
+**/
+STATIC
+EFI_STATUS
+SsifBenchmarkCommand (
+  IN  UINT8   MessageSize,
+  OUT UINT32  *Retries
+  )
+{
+  UINT8       Header[2];
+  UINT8       Request[MAX_UINT8];
+  UINT8       ResponseHeader[2];
+  UINT8       Response[MAX_UINT8];
+  UINT32      ResponseSize;
+  UINT8       ReadCount;
+  UINT32      Attempt;
+  UINT32      Index;
+  EFI_STATUS  Status;
+
+  Header[0] = (UINT8)(IPMI_NETFN_APP << 2);
+  Header[1] = IPMI_APP_MASTER_WRITE_READ;
+
+  //
+  // Bus, slave address and read count, followed by the write data.
+  //
+  ReadCount = (UINT8)(MessageSize - SSIF_BENCHMARK_RESPONSE_OVERHEAD);
+  SetMem (Request, sizeof (Request), 0x5A);
+  Request[0] = 0;
+  Request[1] = 0xA0;
+  Request[2] = ReadCount;
+
+  Status = EFI_DEVICE_ERROR;
+  for (Attempt = 0; Attempt < SSIF_BENCHMARK_ATTEMPTS; Attempt++) {
+    if (Attempt > 0) {
+      (*Retries)++;
+    }
+
+    Status = SendDataToBmcPortEx (SSIF_BENCHMARK_TIMEOUT, Header, sizeof (Header), Request, MessageSize - sizeof (Header));
+    if (EFI_ERROR (Status)) {
+      continue;
+    }
+
+    ResponseSize = sizeof (Response);
+    Status       = ReceiveBmcDataFromPortEx (SSIF_BENCHMARK_TIMEOUT, ResponseHeader, sizeof (ResponseHeader), Response, &ResponseSize);
+    if (!EFI_ERROR (Status)) {
+      break;
+    }
+  }
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if ((ResponseHeader[0] != (UINT8)((IPMI_NETFN_APP | 1) << 2)) ||
+      (ResponseHeader[1] != IPMI_APP_MASTER_WRITE_READ) ||
+      (ResponseSize != ReadCount + 1U) || (Response[0] != IPMI_COMP_CODE_NORMAL))
+  {
+    return EFI_DEVICE_ERROR;
+  }
+
+  for (Index = 0; Index < ReadCount; Index++) {
+    if (Response[Index + 1] != (UINT8)Index) {
+      return EFI_DEVICE_ERROR;
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Runs commands of every message size against the simulated BMC of a scenario
+  and reports the cost of each command.
+
+  @param[in]  Context   The SSIF_BENCHMARK_SCENARIO to run.
+
+  @retval  UNIT_TEST_PASSED             Every command completed and the
+                                        counters match the scenario.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A test case assertion has failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+SsifBenchmarkScenario (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  SSIF_BENCHMARK_SCENARIO  *Scenario;
+  MOCK_SSIF_STATISTICS     Statistics;
+  UINT32                   SizeIndex;
+  UINT32                   Index;
+  UINT32                   Retries;
+  UINT64                   Start;
+  UINT64                   Elapsed;
+  EFI_STATUS               Status;
+
+  Scenario = (SSIF_BENCHMARK_SCENARIO *)Context;
+
+  for (SizeIndex = 0; SizeIndex < ARRAY_SIZE (mMessageSizes); SizeIndex++) {
+    MockSsifReset ();
+    MockSsifSetLatency (Scenario->TransactionTime, Scenario->ByteTime, Scenario->ResponseLatency);
+    MockSsifSetAlert (Scenario->Alert);
+
+    Retries = 0;
+    Start   = GetTimeInNanoSecond (GetPerformanceCounter ());
+    for (Index = 0; Index < SSIF_BENCHMARK_COMMANDS; Index++) {
+      if (Scenario->Error) {
+        MockSsifSetError (SsifBenchmarkFaultBlock (mMessageSizes[SizeIndex]));
+      }
+
+      Status = SsifBenchmarkCommand (mMessageSizes[SizeIndex], &Retries);
+      UT_ASSERT_NOT_EFI_ERROR (Status);
+    }
+
+    Elapsed = GetTimeInNanoSecond (GetPerformanceCounter ()) - Start;
+    MockSsifGetStatistics (&Statistics);
+
+    DEBUG ((
+      DEBUG_INFO,
+      "%a: %d byte messages, per command %d writes, %d reads, %d NAKs, %ldus, %d.%02d retries, %d.%02d block retries\n",
+      Scenario->Name,
+      mMessageSizes[SizeIndex],
+      Statistics.Writes / SSIF_BENCHMARK_COMMANDS,
+      Statistics.Reads / SSIF_BENCHMARK_COMMANDS,
+      Statistics.Naks / SSIF_BENCHMARK_COMMANDS,
+      DivU64x32 (Elapsed, 1000 * SSIF_BENCHMARK_COMMANDS),
+      Retries / SSIF_BENCHMARK_COMMANDS,
+      (Retries * 100 / SSIF_BENCHMARK_COMMANDS) % 100,
+      Statistics.ReadRetries / SSIF_BENCHMARK_COMMANDS,
+      (Statistics.ReadRetries * 100 / SSIF_BENCHMARK_COMMANDS) % 100
+      ));
+
+    UT_ASSERT_EQUAL (Statistics.Requests, SSIF_BENCHMARK_COMMANDS);
+    UT_ASSERT_EQUAL (Statistics.Errors, Scenario->Error ? SSIF_BENCHMARK_COMMANDS : 0);
+    UT_ASSERT_TRUE (Elapsed >= MultU64x32 (Scenario->ResponseLatency, 1000 * SSIF_BENCHMARK_COMMANDS));
+
+    if (Scenario->Alert) {
+      UT_ASSERT_TRUE (Statistics.Alerts > 0);
+    }
+
+    if (Scenario->Error && (mMessageSizes[SizeIndex] > SSIF_MAX_READ_SIZE)) {
+      UT_ASSERT_EQUAL (Statistics.ReadRetries, SSIF_BENCHMARK_COMMANDS);
+    }
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Initializes and runs the SSIF benchmarks.
+
+  @retval  EFI_SUCCESS           All test cases were dispatched.
+  @retval  EFI_OUT_OF_RESOURCES  There are not enough resources available to
+                                 initialize the unit tests.
+**/
+EFI_STATUS
+EFIAPI
+SsifBenchmarkMain (
+  VOID
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+  UNIT_TEST_SUITE_HANDLE      SsifBenchmarks;
+
+  Framework = NULL;
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_NAME, UNIT_TEST_VERSION));
+
+  //
+  // Start setting up the test framework for running the benchmarks.
+  //
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_NAME, gEfiCallerBaseName, UNIT_TEST_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  //
+  // Populate the SSIF Benchmark Suite.
+  //
+  Status = CreateUnitTestSuite (&SsifBenchmarks, Framework, "SSIF Transport Benchmarks", "IPMI.SSIF.Benchmark", NULL, NULL);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for SsifBenchmarks\n"));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  AddTestCase (SsifBenchmarks, "Benchmarks a standard mode SMBus", "StandardBus", SsifBenchmarkScenario, NULL, NULL, &mStandardBus);
+  AddTestCase (SsifBenchmarks, "Benchmarks a fast mode SMBus", "FastBus", SsifBenchmarkScenario, NULL, NULL, &mFastBus);
+  AddTestCase (SsifBenchmarks, "Benchmarks a platform with SMBALERT#", "AlertBus", SsifBenchmarkScenario, NULL, NULL, &mAlertBus);
+  AddTestCase (SsifBenchmarks, "Benchmarks a bus failing a transaction of every command", "LossyBus", SsifBenchmarkScenario, NULL, NULL, &mLossyBus);
+
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return Status;
+}
+
+/**
+  Standard POSIX C entry point for host based benchmark execution.
+**/
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+{
+  return SsifBenchmarkMain ();
+}
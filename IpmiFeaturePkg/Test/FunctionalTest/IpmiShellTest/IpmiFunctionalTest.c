@@ -12,8 +12,11 @@
 #include <Library/BaseLib.h>
 #include <Library/DebugLib.h>
 #include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/UefiBootServicesTableLib.h>
 #include <Library/UnitTestLib.h>
 #include <Library/IpmiCommandLib.h>
+#include <Protocol/IpmiTraceProtocol.h>
 
 #define UNIT_TEST_NAME     "IPMI Functional Test"
 #define UNIT_TEST_VERSION  "1.0"
@@ -197,6 +200,138 @@ SelAddEntryTest (
   return UNIT_TEST_PASSED;
 }
 
+//
+// Trace Tests
+//
+
+/**
+  Dumps the IPMI latency histograms, most total time first, and the most
+  recent IPMI transactions. Runs after the other tests so their commands are
+  included.
+
+  @param[in]  Context             UNUSED
+
+  @retval  UNIT_TEST_PASSED             The Unit test has completed and the test
+                                        case was successful.
+  @retval  UNIT_TEST_SKIPPED            The IPMI trace protocol is not present.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A test case assertion has failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+IpmiTraceDumpTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS              Status;
+  IPMI_TRACE_PROTOCOL     *Trace;
+  IPMI_LATENCY_HISTOGRAM  *Histograms;
+  IPMI_LATENCY_HISTOGRAM  Histogram;
+  IPMI_TRACE_RECORD       *Records;
+  UINTN                   Count;
+  UINT64                  TotalCount;
+  UINT64                  OverflowCount;
+  UINTN                   Index;
+  UINTN                   Sorted;
+  UINTN                   Bucket;
+
+  Status = gBS->LocateProtocol (&gIpmiTraceProtocolGuid, NULL, (VOID **)&Trace);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_INFO, "IPMI trace protocol not found. %r\n", Status));
+    return UNIT_TEST_SKIPPED;
+  }
+
+  //
+  // Dump the histograms, sorted so the commands that took the most time are
+  // first.
+  //
+  Count  = 0;
+  Status = Trace->GetHistograms (Trace, NULL, &Count, NULL);
+  UT_ASSERT_TRUE ((Status == EFI_SUCCESS) || (Status == EFI_BUFFER_TOO_SMALL));
+
+  Histograms = AllocatePool (MAX (Count, 1) * sizeof (*Histograms));
+  UT_ASSERT_NOT_NULL (Histograms);
+  Status = Trace->GetHistograms (Trace, Histograms, &Count, &OverflowCount);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  for (Index = 1; Index < Count; Index++) {
+    CopyMem (&Histogram, &Histograms[Index], sizeof (Histogram));
+    for (Sorted = Index; (Sorted > 0) && (Histograms[Sorted - 1].TotalTime < Histogram.TotalTime); Sorted--) {
+      CopyMem (&Histograms[Sorted], &Histograms[Sorted - 1], sizeof (Histogram));
+    }
+
+    CopyMem (&Histograms[Sorted], &Histogram, sizeof (Histogram));
+  }
+
+  DEBUG ((DEBUG_INFO, "************ IPMI LATENCY ***********\n"));
+  DEBUG ((DEBUG_INFO, "NetFn Cmd   Count   Total(us)  Avg(us)  Max(us)\n"));
+  for (Index = 0; Index < Count; Index++) {
+    DEBUG ((
+      DEBUG_INFO,
+      "0x%02x  0x%02x  %6d  %10ld  %7ld  %7ld\n",
+      Histograms[Index].NetFunction,
+      Histograms[Index].Command,
+      Histograms[Index].Count,
+      DivU64x32 (Histograms[Index].TotalTime, 1000),
+      DivU64x32 (DivU64x32 (Histograms[Index].TotalTime, MAX (Histograms[Index].Count, 1)), 1000),
+      DivU64x32 (Histograms[Index].MaxTime, 1000)
+      ));
+
+    for (Bucket = 0; Bucket < IPMI_LATENCY_BUCKET_COUNT; Bucket++) {
+      if (Histograms[Index].Buckets[Bucket] == 0) {
+        continue;
+      }
+
+      if (Bucket == IPMI_LATENCY_BUCKET_COUNT - 1) {
+        DEBUG ((DEBUG_INFO, "    >= %ldus: %d\n", LShiftU64 (1, Bucket - 1), Histograms[Index].Buckets[Bucket]));
+      } else {
+        DEBUG ((DEBUG_INFO, "    <  %ldus: %d\n", LShiftU64 (1, Bucket), Histograms[Index].Buckets[Bucket]));
+      }
+    }
+  }
+
+  if (OverflowCount != 0) {
+    DEBUG ((DEBUG_INFO, "%ld transactions of other NetFn/Cmd pairs not in a histogram\n", OverflowCount));
+  }
+
+  FreePool (Histograms);
+
+  //
+  // Dump the most recent transactions.
+  //
+  Count  = 0;
+  Status = Trace->GetRecords (Trace, NULL, &Count, &TotalCount);
+  UT_ASSERT_TRUE ((Status == EFI_SUCCESS) || (Status == EFI_BUFFER_TOO_SMALL));
+
+  Records = AllocatePool (MAX (Count, 1) * sizeof (*Records));
+  UT_ASSERT_NOT_NULL (Records);
+  Status = Trace->GetRecords (Trace, Records, &Count, &TotalCount);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  DEBUG ((DEBUG_INFO, "************ IPMI TRACE *************\n"));
+  DEBUG ((DEBUG_INFO, "Last %d of %ld transactions\n", Count, TotalCount));
+  DEBUG ((DEBUG_INFO, "Start(us)   Time(us)  NetFn Cmd   CC    Retries Req Resp Status\n"));
+  for (Index = 0; Index < Count; Index++) {
+    DEBUG ((
+      DEBUG_INFO,
+      "%10ld  %8ld  0x%02x  0x%02x  0x%02x  %7d %3d %4d %r\n",
+      DivU64x32 (Records[Index].StartTime, 1000),
+      DivU64x32 (Records[Index].EndTime - Records[Index].StartTime, 1000),
+      Records[Index].NetFunction,
+      Records[Index].Command,
+      Records[Index].CompletionCode,
+      Records[Index].Retries,
+      Records[Index].RequestSize,
+      Records[Index].ResponseSize,
+      Records[Index].Status
+      ));
+  }
+
+  DEBUG ((DEBUG_INFO, "*************************************\n"));
+
+  FreePool (Records);
+  return UNIT_TEST_PASSED;
+}
+
 //
 // Test Orchestration
 //
@@ -212,6 +347,7 @@ IpmiTestEntryPoint (
   UNIT_TEST_FRAMEWORK_HANDLE  Framework;
   UNIT_TEST_SUITE_HANDLE      CommandTests;
   UNIT_TEST_SUITE_HANDLE      SelTests;
+  UNIT_TEST_SUITE_HANDLE      TraceTests;
 
   Framework = NULL;
 
@@ -253,6 +389,18 @@ IpmiTestEntryPoint (
   AddTestCase (SelTests, "", "SelGetTimeTest", SelGetTimeTest, NULL, NULL, NULL);
   AddTestCase (SelTests, "", "SelAddEntryTest", SelAddEntryTest, NULL, NULL, NULL);
 
+  //
+  // Populate the trace suite last so it includes the commands sent above.
+  //
+  Status = CreateUnitTestSuite (&TraceTests, Framework, "IPMI Trace", "IPMI.Trace", NULL, NULL);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for TraceTests\n"));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  AddTestCase (TraceTests, "", "IpmiTraceDumpTest", IpmiTraceDumpTest, NULL, NULL, NULL);
+
   //
   // Execute the tests.
   //
@@ -12,7 +12,7 @@
 #include <Library/BaseMemoryLib.h>
 #include <Library/UnitTestLib.h>
 #include <Library/UefiBootServicesTableLib.h>
-#include <Protocol/IpmiSelProtocol.h>
+#include <Protocol/IpmiSel2Protocol.h>
 
 #define UNIT_TEST_NAME     "SEL Protocol Test"
 #define UNIT_TEST_VERSION  "1.0"
@@ -124,6 +124,75 @@ SelAddEntryTest (
   return UNIT_TEST_PASSED;
 }
 
+#define SEL_ITERATOR_WINDOW  (16)
+
+/**
+  Tests walking the SEL with an iterator, comparing it to following the record
+  IDs one entry at a time.
+
+  @param[in]  Context             UNUSED
+
+  @retval  UNIT_TEST_PASSED             The Unit test has completed and the test
+                                        case was successful.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A test case assertion has failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+SelIteratorTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  IPMI_SEL2_PROTOCOL  *SelProtocol;
+  EFI_STATUS          Status;
+  SEL_ITERATOR        Iterator;
+  SEL_RECORD          Window[SEL_ITERATOR_WINDOW];
+  SEL_RECORD          Record;
+  SEL_RECORD          Expected;
+  UINT16              RecordId;
+  UINT16              NextId;
+  UINT32              Count;
+
+  Status = gBS->LocateProtocol (
+                  &gIpmiSel2ProtocolGuid,
+                  NULL,
+                  (VOID **)&SelProtocol
+                  );
+
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_TRUE (SelProtocol->Revision >= IPMI_SEL2_PROTOCOL_REVISION_1);
+
+  Status = SelProtocol->StartRecordIterator (&Iterator, 0, Window, SEL_ITERATOR_WINDOW);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  // The entries added by the previous test are present.
+  Count    = 0;
+  RecordId = 0;
+  while (TRUE) {
+    Status = SelProtocol->GetNextRecordEntry (&Iterator, &Record);
+    if (Status == EFI_NOT_FOUND) {
+      break;
+    }
+
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+    Status = SelProtocol->GetRecordEntry (RecordId, &Expected, &NextId);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+    UT_ASSERT_MEM_EQUAL ((VOID *)&Record, (VOID *)&Expected, sizeof (SEL_RECORD));
+
+    Count++;
+    if (NextId == SEL_LAST_RECORD_ID) {
+      break;
+    }
+
+    RecordId = NextId;
+  }
+
+  UT_ASSERT_TRUE (Count >= NUM_SEL_ENTRIES);
+  Status = SelProtocol->GetNextRecordEntry (&Iterator, &Record);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_NOT_FOUND);
+
+  return UNIT_TEST_PASSED;
+}
+
 //
 // Test Orchestration
 //
@@ -164,6 +233,7 @@ SelProtocolTestEntryPoint (
 
   AddTestCase (Suite, "", "SelAddEntryTestBad", SelAddEntryTestBad, NULL, NULL, NULL);
   AddTestCase (Suite, "", "SelAddEntryTest", SelAddEntryTest, NULL, NULL, NULL);
+  AddTestCase (Suite, "", "SelIteratorTest", SelIteratorTest, NULL, NULL, NULL);
 
   //
   // Execute the tests.
@@ -104,6 +104,44 @@ struct MockIpmiSelLib {
      OUT UINT16      *NextRecordId OPTIONAL
     )
     );
+
+  MOCK_FUNCTION_DECLARATION (
+    EFI_STATUS,
+    SelStartIterator,
+    (
+     OUT SEL_ITERATOR  *Iterator,
+     IN UINT16         RecordId,
+     IN SEL_RECORD     *Window,
+     IN UINT16         WindowSize
+    )
+    );
+
+  MOCK_FUNCTION_DECLARATION (
+    EFI_STATUS,
+    SelGetNextEntry,
+    (
+     IN OUT SEL_ITERATOR  *Iterator,
+     OUT SEL_RECORD       *Record
+    )
+    );
+
+  MOCK_FUNCTION_DECLARATION (
+    EFI_STATUS,
+    SelFlush,
+    ()
+    );
+
+  MOCK_FUNCTION_DECLARATION (
+    UINT32,
+    SelGetDroppedEntries,
+    ()
+    );
+
+  MOCK_FUNCTION_DECLARATION (
+    UINT32,
+    SelGetFailedEntries,
+    ()
+    );
 };
 
 #endif
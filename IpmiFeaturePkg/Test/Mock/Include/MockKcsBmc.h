@@ -0,0 +1,102 @@
+/** @file
+  Control interface of the simulated KCS BMC. The simulation is an I/O library
+  that models the KCS registers and state machine of a BMC on the virtual clock
+  of the timer library, answering requests with the mock IPMI handlers. It lets
+  the KCS transport be run and measured on the host.
+
+  Copyright (c) Microsoft Corporation
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef _MOCK_KCS_BMC_H_
+#define _MOCK_KCS_BMC_H_
+
+//
+// Largest message the simulated BMC returns, the large-message limit of the
+// KCS transport.
+//
+#define MOCK_KCS_MAX_MESSAGE_SIZE  SIZE_4KB
+
+//
+// Counters of the simulated KCS interface since the last reset.
+//
+typedef struct {
+  UINT32    IoReads;        // Reads of the data and status registers.
+  UINT32    IoWrites;       // Writes of the data and command registers.
+  UINT32    StatusReads;    // Reads of the status register.
+  UINT32    MmioAccesses;   // Register reads and writes made through MMIO.
+  UINT32    Requests;       // Requests handed to the mock IPMI handlers.
+  UINT32    Errors;         // Transitions the BMC answered with the error state.
+  UINT32    Aborts;         // Aborts written by the host.
+} MOCK_KCS_STATISTICS;
+
+/**
+  Resets the simulated KCS BMC to the idle state with no latency, stalls or
+  errors, and clears its counters.
+**/
+VOID
+MockKcsReset (
+  VOID
+  );
+
+/**
+  Sets how long the BMC takes to handle a write of the host and to start
+  returning a response.
+
+  @param[in]  ByteLatency       The time in microseconds IBF stays set after each
+                                control code or data byte written by the host.
+  @param[in]  ResponseLatency   The time in microseconds from the last byte of a
+                                request to the first byte of the response.
+**/
+VOID
+MockKcsSetLatency (
+  IN UINT32  ByteLatency,
+  IN UINT32  ResponseLatency
+  );
+
+/**
+  Sets how long each access of the host to a KCS register takes.
+
+  @param[in]  IoCost    The time of a register access in microseconds.
+**/
+VOID
+MockKcsSetIoCost (
+  IN UINT32  IoCost
+  );
+
+/**
+  Stalls the BMC once on a later write of the host, holding IBF set for longer
+  than the byte latency.
+
+  @param[in]  Write       The write to stall, 0 for the next write.
+  @param[in]  StallTime   The additional time in microseconds.
+**/
+VOID
+MockKcsSetStall (
+  IN UINT32  Write,
+  IN UINT32  StallTime
+  );
+
+/**
+  Makes the BMC answer a later write of the host with the error state once,
+  instead of taking it.
+
+  @param[in]  Write       The write to fail, 0 for the next write.
+**/
+VOID
+MockKcsSetError (
+  IN UINT32  Write
+  );
+
+/**
+  Retrieves the counters of the simulated KCS interface.
+
+  @param[out]  Statistics   The counters since the last reset.
+**/
+VOID
+MockKcsGetStatistics (
+  OUT MOCK_KCS_STATISTICS  *Statistics
+  );
+
+#endif
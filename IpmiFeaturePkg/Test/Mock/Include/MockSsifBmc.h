@@ -0,0 +1,91 @@
+/** @file
+  Control interface of the simulated SSIF BMC. The simulation is an SMBus
+  library that models the SSIF endpoint of a BMC on the virtual clock of the
+  timer library, framing single and multi-part transactions and answering
+  requests with the mock IPMI handlers. It lets the SSIF transport be run and
+  measured on the host.
+
+  Copyright (c) Microsoft Corporation
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef _MOCK_SSIF_BMC_H_
+#define _MOCK_SSIF_BMC_H_
+
+//
+// Counters of the simulated SMBus endpoint since the last reset.
+//
+typedef struct {
+  UINT32    Writes;         // Block writes of the host.
+  UINT32    Reads;          // Block reads of the host, including refused ones.
+  UINT32    Naks;           // Reads refused because no response was ready.
+  UINT32    ReadRetries;    // Multi-part read blocks the host asked for again.
+  UINT32    Alerts;         // Waits of the host for SMBALERT#.
+  UINT32    Requests;       // Requests handed to the mock IPMI handlers.
+  UINT32    Errors;         // Blocks failed and transactions breaking the framing.
+} MOCK_SSIF_STATISTICS;
+
+/**
+  Resets the simulated SSIF BMC to the idle state with no latency, errors or
+  SMBALERT# support, and clears its counters.
+**/
+VOID
+MockSsifReset (
+  VOID
+  );
+
+/**
+  Sets how long SMBus transactions take on the bus and how long the BMC takes
+  to prepare a response.
+
+  @param[in]  TransactionTime   The time in microseconds of every transaction.
+  @param[in]  ByteTime          The additional time in microseconds of every
+                                byte on the bus, including the address,
+                                command and count bytes.
+  @param[in]  ResponseLatency   The time in microseconds from the last block of
+                                a request until the response can be read.
+**/
+VOID
+MockSsifSetLatency (
+  IN UINT32  TransactionTime,
+  IN UINT32  ByteTime,
+  IN UINT32  ResponseLatency
+  );
+
+/**
+  Fails a later block transferred on the bus once. Blocks are counted across
+  writes and reads, but reads refused because no response is ready transfer no
+  block and are not counted. A failed write block is not taken by the BMC. A
+  failed read block is lost on the bus, so a start block is read again and a
+  multi-part read block is resent on a retry.
+
+  @param[in]  Block   The block to fail, 0 for the next one.
+**/
+VOID
+MockSsifSetError (
+  IN UINT32  Block
+  );
+
+/**
+  Sets whether the platform supports waiting for SMBALERT#, which the BMC
+  asserts once a response is ready.
+
+  @param[in]  Supported   TRUE to support SMBALERT#.
+**/
+VOID
+MockSsifSetAlert (
+  IN BOOLEAN  Supported
+  );
+
+/**
+  Retrieves the counters of the simulated SMBus endpoint.
+
+  @param[out]  Statistics   The counters since the last reset.
+**/
+VOID
+MockSsifGetStatistics (
+  OUT MOCK_SSIF_STATISTICS  *Statistics
+  );
+
+#endif
@@ -0,0 +1,62 @@
+/** @file
+  Control interface of the virtual clock timer library for host based tests and
+  benchmarks. Delays advance the virtual clock instead of waiting, so flows
+  with long delays run at once and the time they would cost can be measured
+  exactly.
+
+  Copyright (c) Microsoft Corporation
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef _VIRTUAL_TIMER_H_
+#define _VIRTUAL_TIMER_H_
+
+//
+// Frequency of the virtual performance counter, one tick per nanosecond.
+//
+#define VIRTUAL_TIMER_FREQUENCY  1000000000
+
+/**
+  Resets the virtual clock and the accumulated delay to 0.
+**/
+VOID
+VirtualTimerReset (
+  VOID
+  );
+
+/**
+  Reads the virtual clock without advancing it.
+
+  @retval   The time in nanoseconds since the last reset.
+**/
+UINT64
+VirtualTimerGetTime (
+  VOID
+  );
+
+/**
+  Advances the virtual clock by time spent outside of a delay, such as by a
+  simulated device. The time is not counted as delay.
+
+  @param[in]  NanoSeconds   The time to advance the clock by.
+**/
+VOID
+VirtualTimerAdvance (
+  IN UINT64  NanoSeconds
+  );
+
+/**
+  Retrieves the delay accumulated through MicroSecondDelay and NanoSecondDelay
+  since the last reset.
+
+  @param[out]  Count    If provided, receives the number of delays.
+
+  @retval   The accumulated delay in nanoseconds.
+**/
+UINT64
+VirtualTimerGetDelay (
+  OUT UINT32  *Count OPTIONAL
+  );
+
+#endif
@@ -17,3 +17,8 @@ MOCK_FUNCTION_DEFINITION (MockIpmiSelLib, SelGetTime, 1, EFIAPI);
 MOCK_FUNCTION_DEFINITION (MockIpmiSelLib, SelSetTime, 1, EFIAPI);
 MOCK_FUNCTION_DEFINITION (MockIpmiSelLib, SelGetInfo, 1, EFIAPI);
 MOCK_FUNCTION_DEFINITION (MockIpmiSelLib, SelGetEntry, 3, EFIAPI);
+MOCK_FUNCTION_DEFINITION (MockIpmiSelLib, SelStartIterator, 4, EFIAPI);
+MOCK_FUNCTION_DEFINITION (MockIpmiSelLib, SelGetNextEntry, 2, EFIAPI);
+MOCK_FUNCTION_DEFINITION (MockIpmiSelLib, SelFlush, 0, EFIAPI);
+MOCK_FUNCTION_DEFINITION (MockIpmiSelLib, SelGetDroppedEntries, 0, EFIAPI);
+MOCK_FUNCTION_DEFINITION (MockIpmiSelLib, SelGetFailedEntries, 0, EFIAPI);
@@ -0,0 +1,171 @@
+/** @file
+  Implements a virtual clock timer library for host based tests and benchmarks.
+  Delays advance the clock instead of waiting, so timeouts and the time spent
+  in delays can be measured exactly.
+
+  Copyright (c) Microsoft Corporation
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/TimerLib.h>
+#include <VirtualTimer.h>
+
+STATIC UINT64  mVirtualTime   = 0;
+STATIC UINT64  mVirtualDelay  = 0;
+STATIC UINT32  mVirtualDelays = 0;
+
+/**
+  Resets the virtual clock and the accumulated delay to 0.
+**/
+VOID
+VirtualTimerReset (
+  VOID
+  )
+{
+  mVirtualTime   = 0;
+  mVirtualDelay  = 0;
+  mVirtualDelays = 0;
+}
+
+/**
+  Reads the virtual clock without advancing it.
+
+  @retval   The time in nanoseconds since the last reset.
+**/
+UINT64
+VirtualTimerGetTime (
+  VOID
+  )
+{
+  return mVirtualTime;
+}
+
+/**
+  Advances the virtual clock by time spent outside of a delay, such as by a
+  simulated device. The time is not counted as delay.
+
+  @param[in]  NanoSeconds   The time to advance the clock by.
+**/
+VOID
+VirtualTimerAdvance (
+  IN UINT64  NanoSeconds
+  )
+{
+  mVirtualTime += NanoSeconds;
+}
+
+/**
+  Retrieves the delay accumulated through MicroSecondDelay and NanoSecondDelay
+  since the last reset.
+
+  @param[out]  Count    If provided, receives the number of delays.
+
+  @retval   The accumulated delay in nanoseconds.
+**/
+UINT64
+VirtualTimerGetDelay (
+  OUT UINT32  *Count OPTIONAL
+  )
+{
+  if (Count != NULL) {
+    *Count = mVirtualDelays;
+  }
+
+  return mVirtualDelay;
+}
+
+/**
+  Advances the virtual clock by the given number of microseconds.
+
+  @param[in]  MicroSeconds  The number of microseconds to delay.
+
+  @retval   The value of MicroSeconds.
+**/
+UINTN
+EFIAPI
+MicroSecondDelay (
+  IN UINTN  MicroSeconds
+  )
+{
+  NanoSecondDelay ((UINTN)MultU64x32 (MicroSeconds, 1000));
+  return MicroSeconds;
+}
+
+/**
+  Advances the virtual clock by the given number of nanoseconds.
+
+  @param[in]  NanoSeconds   The number of nanoseconds to delay.
+
+  @retval   The value of NanoSeconds.
+**/
+UINTN
+EFIAPI
+NanoSecondDelay (
+  IN UINTN  NanoSeconds
+  )
+{
+  mVirtualTime  += NanoSeconds;
+  mVirtualDelay += NanoSeconds;
+  mVirtualDelays++;
+  return NanoSeconds;
+}
+
+/**
+  Retrieves the virtual clock in nanoseconds. Each read advances the clock by
+  a nanosecond so that successive reads differ, as they do on hardware.
+
+  @retval   The current value of the virtual performance counter.
+**/
+UINT64
+EFIAPI
+GetPerformanceCounter (
+  VOID
+  )
+{
+  return mVirtualTime++;
+}
+
+/**
+  Retrieves the properties of the virtual performance counter.
+
+  @param[out]  StartValue   The value the counter starts with.
+  @param[out]  EndValue     The value the counter ends with.
+
+  @retval   The frequency of the counter in Hz.
+**/
+UINT64
+EFIAPI
+GetPerformanceCounterProperties (
+  OUT UINT64  *StartValue OPTIONAL,
+  OUT UINT64  *EndValue OPTIONAL
+  )
+{
+  if (StartValue != NULL) {
+    *StartValue = 0;
+  }
+
+  if (EndValue != NULL) {
+    *EndValue = MAX_UINT64;
+  }
+
+  return VIRTUAL_TIMER_FREQUENCY;
+}
+
+/**
+  Converts a virtual performance counter value to nanoseconds.
+
+  @param[in]  Ticks     The number of elapsed ticks.
+
+  @retval   The elapsed time in nanoseconds.
+**/
+UINT64
+EFIAPI
+GetTimeInNanoSecond (
+  IN UINT64  Ticks
+  )
+{
+  return Ticks;
+}
@@ -0,0 +1,344 @@
+/** @file
+  Host based unit tests for the BT transport library.
+
+  Copyright (c) Microsoft Corporation
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "BtUnitTest.h"
+
+#define UNIT_TEST_NAME     "BT Unit Test"
+#define UNIT_TEST_VERSION  "1.0"
+
+//
+// Time budget used by the tests, in microseconds.
+//
+#define BT_TEST_TIMEOUT  (5 * 1000 * 1000)
+
+//
+// Delay between BT_CTRL reads in microseconds, matching the transport.
+//
+#define BT_TEST_POLL_DELAY  50
+
+//
+// Allowance in nanoseconds for the virtual counter advancing on each read.
+//
+#define BT_TEST_COUNTER_SLACK  1000
+
+//
+// BT_CTRL accesses of a transaction besides the buffer. A send reads BT_CTRL
+// once, clears the write pointer and sets H2B_ATN. A receive reads BT_CTRL
+// once, sets H_BUSY, clears B2H_ATN, clears the read pointer and releases
+// H_BUSY.
+//
+#define BT_TEST_SEND_CONTROL_ACCESSES     3
+#define BT_TEST_RECEIVE_CONTROL_ACCESSES  5
+
+/**
+  Clears the state of the test libraries.
+
+  @param[in]  Context    UNUSED
+**/
+VOID
+EFIAPI
+ResetTestState (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  BtTestIoReset ();
+  VirtualTimerReset ();
+}
+
+/**
+  Tests that a request and its response each move through the BT buffer with a
+  single handshake and without any poll delay.
+
+  @param[in]  Context             UNUSED
+
+  @retval  UNIT_TEST_PASSED             The Unit test has completed and the test
+                                        case was successful.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A test case assertion has failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+TestBtRoundTrip (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS  Status;
+  UINT8       Header[2];
+  UINT8       Request[3];
+  UINT8       Response[8];
+  UINT8       *Message;
+  UINT32      ResponseSize;
+  UINT32      IoOperations;
+
+  Header[0]  = 0x18;
+  Header[1]  = 0x01;
+  Request[0] = 0xA5;
+  Request[1] = 0x5A;
+  Request[2] = 0x3C;
+
+  Status = SendDataToBmcPortEx (BT_TEST_TIMEOUT, Header, sizeof (Header), Request, sizeof (Request));
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  //
+  // Length, NetFn/LUN, sequence, command and the body.
+  //
+  Message = BtTestGetRequest ();
+  UT_ASSERT_EQUAL (Message[0], BT_MESSAGE_HEADER_SIZE + sizeof (Request));
+  UT_ASSERT_EQUAL (Message[1], Header[0]);
+  UT_ASSERT_EQUAL (Message[3], Header[1]);
+  UT_ASSERT_MEM_EQUAL (&Message[4], Request, sizeof (Request));
+
+  IoOperations = BtTestGetIoOperations ();
+  UT_ASSERT_EQUAL (IoOperations, Message[0] + 1 + BT_TEST_SEND_CONTROL_ACCESSES);
+
+  ZeroMem (Header, sizeof (Header));
+  ResponseSize = sizeof (Response);
+  Status       = ReceiveBmcDataFromPortEx (BT_TEST_TIMEOUT, Header, sizeof (Header), Response, &ResponseSize);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  UT_ASSERT_EQUAL (Header[0], 0x1C);
+  UT_ASSERT_EQUAL (Header[1], 0x01);
+  UT_ASSERT_EQUAL (ResponseSize, sizeof (Request) + 1);
+  UT_ASSERT_EQUAL (Response[0], 0x00);
+  UT_ASSERT_MEM_EQUAL (&Response[1], Request, sizeof (Request));
+
+  //
+  // The response adds the completion code to the message.
+  //
+  UT_ASSERT_EQUAL (BtTestGetIoOperations () - IoOperations, Message[0] + 2 + BT_TEST_RECEIVE_CONTROL_ACCESSES);
+  UT_ASSERT_EQUAL (BtTestGetControlReads (), 2);
+  UT_ASSERT_EQUAL (VirtualTimerGetDelay (NULL), 0);
+
+  DEBUG ((DEBUG_INFO, "%d byte round trip: %d I/O operations\n", Message[0] + 1, BtTestGetIoOperations ()));
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Tests that responses carrying the sequence number of an earlier request are
+  discarded and the response to the last request is returned.
+
+  @param[in]  Context             UNUSED
+
+  @retval  UNIT_TEST_PASSED             The Unit test has completed and the test
+                                        case was successful.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A test case assertion has failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+TestBtStaleResponse (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS  Status;
+  UINT8       Header[2];
+  UINT8       Request[1];
+  UINT8       Response[4];
+  UINT32      ResponseSize;
+
+  BtTestSetStaleResponses (1);
+
+  Header[0]  = 0x18;
+  Header[1]  = 0x04;
+  Request[0] = 0x77;
+
+  Status = SendDataToBmcPortEx (BT_TEST_TIMEOUT, Header, sizeof (Header), Request, sizeof (Request));
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  ResponseSize = sizeof (Response);
+  Status       = ReceiveBmcDataFromPortEx (BT_TEST_TIMEOUT, Header, sizeof (Header), Response, &ResponseSize);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (ResponseSize, 2);
+  UT_ASSERT_EQUAL (Response[0], 0x00);
+  UT_ASSERT_EQUAL (Response[1], Request[0]);
+
+  //
+  // One read for the send, one for the stale response and one for the real
+  // response.
+  //
+  UT_ASSERT_EQUAL (BtTestGetControlReads (), 3);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Tests that a send to a BMC that stays busy, and a receive from a BMC that
+  never posts a response, time out within the budget, including when the
+  register reads themselves take time.
+
+  @param[in]  Context             UNUSED
+
+  @retval  UNIT_TEST_PASSED             The Unit test has completed and the test
+                                        case was successful.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A test case assertion has failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+TestBtTimeout (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS  Status;
+  UINT8       Header[2];
+  UINT8       Response[4];
+  UINT32      ResponseSize;
+  UINT64      Budget;
+  UINT64      Bound;
+
+  Budget = MultU64x32 (BT_TEST_TIMEOUT, 1000);
+  Bound  = Budget + BT_TEST_POLL_DELAY * 1000 + BT_TEST_COUNTER_SLACK;
+
+  BtTestSetBusy (TRUE);
+  Header[0] = 0x18;
+  Header[1] = 0x01;
+
+  Status = SendDataToBmcPortEx (BT_TEST_TIMEOUT, Header, sizeof (Header), NULL, 0);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_TIMEOUT);
+  UT_ASSERT_TRUE (VirtualTimerGetTime () >= Budget);
+  UT_ASSERT_TRUE (VirtualTimerGetTime () <= Bound);
+  UT_ASSERT_EQUAL (BtTestGetRequest ()[0], 0);
+
+  VirtualTimerReset ();
+  BtTestSetBusy (FALSE);
+
+  ResponseSize = sizeof (Response);
+  Status       = ReceiveBmcDataFromPortEx (BT_TEST_TIMEOUT, Header, sizeof (Header), Response, &ResponseSize);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_TIMEOUT);
+  UT_ASSERT_TRUE (VirtualTimerGetTime () >= Budget);
+  UT_ASSERT_TRUE (VirtualTimerGetTime () <= Bound);
+  UT_ASSERT_STATUS_EQUAL (CheckBmcResponseReady (), EFI_NOT_READY);
+
+  //
+  // Slow register reads use up the budget too.
+  //
+  VirtualTimerReset ();
+  BtTestSetBusy (TRUE);
+  BtTestSetIoCost (BT_TEST_POLL_DELAY);
+
+  Status = SendDataToBmcPortEx (BT_TEST_TIMEOUT, Header, sizeof (Header), NULL, 0);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_TIMEOUT);
+  UT_ASSERT_TRUE (VirtualTimerGetTime () >= Budget);
+  UT_ASSERT_TRUE (VirtualTimerGetTime () <= Bound + BT_TEST_POLL_DELAY * 1000);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Tests the message size limits of the BT transport.
+
+  @param[in]  Context             UNUSED
+
+  @retval  UNIT_TEST_PASSED             The Unit test has completed and the test
+                                        case was successful.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A test case assertion has failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+TestBtMessageLimits (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS  Status;
+  UINT8       Header[2];
+  UINT8       Request[BT_MAX_BODY_SIZE + 1];
+  UINT8       Response[2];
+  UINT32      MaxRequestSize;
+  UINT32      MaxResponseSize;
+  UINT32      ResponseSize;
+
+  GetBmcMaxMessageSize (&MaxRequestSize, &MaxResponseSize);
+  UT_ASSERT_EQUAL (MaxRequestSize, BT_MAX_BODY_SIZE);
+  UT_ASSERT_EQUAL (MaxResponseSize, BT_MAX_BODY_SIZE);
+
+  Header[0] = 0x18;
+  Header[1] = 0x01;
+  ZeroMem (Request, sizeof (Request));
+
+  Status = SendDataToBmcPortEx (BT_TEST_TIMEOUT, Header, sizeof (Header), Request, sizeof (Request));
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_INVALID_PARAMETER);
+  Status = SendDataToBmcPortEx (BT_TEST_TIMEOUT, Header, 1, NULL, 0);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_INVALID_PARAMETER);
+  UT_ASSERT_EQUAL (BtTestGetIoOperations (), 0);
+
+  //
+  // A response that does not fit is still read from the BMC to report its
+  // size.
+  //
+  Status = SendDataToBmcPortEx (BT_TEST_TIMEOUT, Header, sizeof (Header), Request, 3);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  ResponseSize = sizeof (Response);
+  Status       = ReceiveBmcDataFromPortEx (BT_TEST_TIMEOUT, Header, sizeof (Header), Response, &ResponseSize);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_BUFFER_TOO_SMALL);
+  UT_ASSERT_EQUAL (ResponseSize, 4);
+  UT_ASSERT_STATUS_EQUAL (CheckBmcResponseReady (), EFI_NOT_READY);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Initializes and configures the BT transport tests.
+
+  @retval  EFI_SUCCESS           All test cases were dispatched.
+  @retval  EFI_OUT_OF_RESOURCES  There are not enough resources available to
+                                 initialize the unit tests.
+**/
+EFI_STATUS
+EFIAPI
+BtTestMain (
+  VOID
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+  UNIT_TEST_SUITE_HANDLE      BtTests;
+
+  Framework = NULL;
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_NAME, UNIT_TEST_VERSION));
+
+  //
+  // Start setting up the test framework for running the tests.
+  //
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_NAME, gEfiCallerBaseName, UNIT_TEST_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  //
+  // Populate the BT Unit Test Suite.
+  //
+  Status = CreateUnitTestSuite (&BtTests, Framework, "BT Transport Tests", "IPMI.BT", NULL, NULL);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for BtTests\n"));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  AddTestCase (BtTests, "Tests a request and response with one handshake each", "TestBtRoundTrip", TestBtRoundTrip, NULL, ResetTestState, NULL);
+  AddTestCase (BtTests, "Tests stale responses are discarded by sequence number", "TestBtStaleResponse", TestBtStaleResponse, NULL, ResetTestState, NULL);
+  AddTestCase (BtTests, "Tests the timeout of a send and a receive", "TestBtTimeout", TestBtTimeout, NULL, ResetTestState, NULL);
+  AddTestCase (BtTests, "Tests the BT message size limits", "TestBtMessageLimits", TestBtMessageLimits, NULL, ResetTestState, NULL);
+
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return Status;
+}
+
+/**
+  Standard POSIX C entry point for host based unit test execution.
+**/
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+{
+  return BtTestMain ();
+}
@@ -0,0 +1,64 @@
+/** @file
+  Definitions for the BT transport unit tests.
+
+  Copyright (c) Microsoft Corporation
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef _BT_UNIT_TEST_H
+#define _BT_UNIT_TEST_H
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/DebugLib.h>
+#include <Library/TimerLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/UnitTestLib.h>
+#include <Library/IpmiTransportLib.h>
+#include <Library/IpmiTransportExLib.h>
+#include <BtBmc.h>
+#include <VirtualTimer.h>
+
+//
+// BT test I/O library functions.
+//
+
+#define BT_TEST_BUFFER_SIZE  (256)
+
+VOID
+BtTestIoReset (
+  VOID
+  );
+
+VOID
+BtTestSetBusy (
+  BOOLEAN  Busy
+  );
+
+VOID
+BtTestSetIoCost (
+  UINTN  MicroSeconds
+  );
+
+VOID
+BtTestSetStaleResponses (
+  UINT32  Count
+  );
+
+UINT8 *
+BtTestGetRequest (
+  VOID
+  );
+
+UINT32
+BtTestGetIoOperations (
+  VOID
+  );
+
+UINT32
+BtTestGetControlReads (
+  VOID
+  );
+
+#endif
@@ -0,0 +1,314 @@
+/** @file
+  Implements a test version of the I/O library for the BT transport tests. It
+  models the BT registers of a BMC that answers every request at once with the
+  request body echoed after a normal completion code. The BMC can be held busy
+  and can be made to post stale responses before the real one, and BT_CTRL
+  reads can be made to take time.
+
+  Copyright (c) Microsoft Corporation
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "BtUnitTest.h"
+
+UINT8    mBtControl = 0;
+UINT8    mBtHostToBmc[BT_TEST_BUFFER_SIZE];
+UINT8    mBtBmcToHost[BT_TEST_BUFFER_SIZE];
+UINT8    mBtPending[BT_TEST_BUFFER_SIZE];
+UINT32   mBtWritePointer    = 0;
+UINT32   mBtReadPointer     = 0;
+UINT32   mBtStaleResponses  = 0;
+BOOLEAN  mBtPendingResponse = FALSE;
+BOOLEAN  mBtStuckBusy       = FALSE;
+UINT32   mBtIoOperations    = 0;
+UINT32   mBtControlReads    = 0;
+UINTN    mBtIoCost          = 0;
+
+/**
+  Resets the state of the simulated BT interface.
+**/
+VOID
+BtTestIoReset (
+  VOID
+  )
+{
+  mBtControl         = 0;
+  mBtWritePointer    = 0;
+  mBtReadPointer     = 0;
+  mBtStaleResponses  = 0;
+  mBtPendingResponse = FALSE;
+  mBtStuckBusy       = FALSE;
+  mBtIoOperations    = 0;
+  mBtControlReads    = 0;
+  mBtIoCost          = 0;
+  ZeroMem (mBtHostToBmc, sizeof (mBtHostToBmc));
+  ZeroMem (mBtBmcToHost, sizeof (mBtBmcToHost));
+  ZeroMem (mBtPending, sizeof (mBtPending));
+}
+
+/**
+  Holds B_BUSY set so the BMC never takes a request.
+
+  @param[in]  Busy    TRUE to hold the BMC busy.
+**/
+VOID
+BtTestSetBusy (
+  BOOLEAN  Busy
+  )
+{
+  mBtStuckBusy = Busy;
+}
+
+/**
+  Sets the time each read of BT_CTRL takes. The time advances the virtual clock
+  without being counted as a delay.
+
+  @param[in]  MicroSeconds    The time of each read in microseconds.
+**/
+VOID
+BtTestSetIoCost (
+  UINTN  MicroSeconds
+  )
+{
+  mBtIoCost = MicroSeconds;
+}
+
+/**
+  Sets the number of responses to earlier requests the BMC posts before the
+  response to the next request.
+
+  @param[in]  Count   The number of stale responses.
+**/
+VOID
+BtTestSetStaleResponses (
+  UINT32  Count
+  )
+{
+  mBtStaleResponses = Count;
+}
+
+/**
+  Retrieves the last request the host handed to the BMC, starting with the
+  length byte.
+
+  @retval   The host to BMC buffer.
+**/
+UINT8 *
+BtTestGetRequest (
+  VOID
+  )
+{
+  return mBtHostToBmc;
+}
+
+/**
+  Retrieves the number of accesses to the BT registers.
+
+  @retval   The number of register reads and writes since the last reset.
+**/
+UINT32
+BtTestGetIoOperations (
+  VOID
+  )
+{
+  return mBtIoOperations;
+}
+
+/**
+  Retrieves the number of reads of the BT_CTRL register.
+
+  @retval   The number of BT_CTRL reads since the last reset.
+**/
+UINT32
+BtTestGetControlReads (
+  VOID
+  )
+{
+  return mBtControlReads;
+}
+
+/**
+  Builds the response to the request in the host to BMC buffer and posts it.
+  While stale responses remain, a response with the previous sequence number
+  is posted first and the real one is held until the host releases H_BUSY.
+**/
+STATIC
+VOID
+BtTestAnswerRequest (
+  VOID
+  )
+{
+  UINT8  Length;
+
+  Length = mBtHostToBmc[0];
+
+  //
+  // Length, NetFn/LUN of the response, sequence, command, completion code and
+  // the request body.
+  //
+  mBtPending[0] = (UINT8)(Length + 1);
+  mBtPending[1] = (UINT8)(mBtHostToBmc[1] + BIT2);
+  mBtPending[2] = mBtHostToBmc[2];
+  mBtPending[3] = mBtHostToBmc[3];
+  mBtPending[4] = 0x00;
+  CopyMem (&mBtPending[5], &mBtHostToBmc[4], Length - BT_MESSAGE_HEADER_SIZE);
+
+  CopyMem (mBtBmcToHost, mBtPending, sizeof (mBtBmcToHost));
+  if (mBtStaleResponses > 0) {
+    mBtStaleResponses--;
+    mBtBmcToHost[2]--;
+    mBtPendingResponse = TRUE;
+  }
+
+  mBtControl &= (UINT8)~BT_CTRL_H2B_ATN;
+  mBtControl |= BT_CTRL_B2H_ATN;
+}
+
+/**
+  Reads a simulated BT register.
+
+  @param[in]  Register    The index of the BT register.
+
+  @retval   The value read.
+**/
+STATIC
+UINT8
+BtTestRead (
+  IN UINT8  Register
+  )
+{
+  mBtIoOperations++;
+  switch (Register) {
+    case BT_CTRL_REGISTER:
+      VirtualTimerAdvance (MultU64x32 (mBtIoCost, 1000));
+      mBtControlReads++;
+      return (UINT8)(mBtControl | (mBtStuckBusy ? BT_CTRL_B_BUSY : 0));
+
+    case BT_BUFFER_REGISTER:
+      return mBtBmcToHost[mBtReadPointer++ % BT_TEST_BUFFER_SIZE];
+
+    default:
+      return 0;
+  }
+}
+
+/**
+  Writes a simulated BT register.
+
+  @param[in]  Register    The index of the BT register.
+  @param[in]  Value       The value to write.
+**/
+STATIC
+VOID
+BtTestWrite (
+  IN UINT8  Register,
+  IN UINT8  Value
+  )
+{
+  mBtIoOperations++;
+  if (Register == BT_BUFFER_REGISTER) {
+    mBtHostToBmc[mBtWritePointer++ % BT_TEST_BUFFER_SIZE] = Value;
+    return;
+  }
+
+  if (Register != BT_CTRL_REGISTER) {
+    return;
+  }
+
+  if ((Value & BT_CTRL_CLR_WR_PTR) != 0) {
+    mBtWritePointer = 0;
+  }
+
+  if ((Value & BT_CTRL_CLR_RD_PTR) != 0) {
+    mBtReadPointer = 0;
+  }
+
+  if ((Value & BT_CTRL_B2H_ATN) != 0) {
+    mBtControl &= (UINT8)~BT_CTRL_B2H_ATN;
+  }
+
+  if ((Value & BT_CTRL_H_BUSY) != 0) {
+    mBtControl ^= BT_CTRL_H_BUSY;
+    if (((mBtControl & BT_CTRL_H_BUSY) == 0) && mBtPendingResponse) {
+      mBtPendingResponse = FALSE;
+      CopyMem (mBtBmcToHost, mBtPending, sizeof (mBtBmcToHost));
+      mBtControl |= BT_CTRL_B2H_ATN;
+    }
+  }
+
+  if (((Value & BT_CTRL_H2B_ATN) != 0) && !mBtStuckBusy) {
+    mBtControl |= BT_CTRL_H2B_ATN;
+    BtTestAnswerRequest ();
+  }
+}
+
+/**
+  Reads an 8-bit I/O port.
+
+  @param[in]  Port    The I/O port to read.
+
+  @retval   The value read.
+**/
+UINT8
+EFIAPI
+IoRead8 (
+  IN UINTN  Port
+  )
+{
+  return BtTestRead ((UINT8)(Port - PcdGet16 (PcdIpmiIoBaseAddress)));
+}
+
+/**
+  Writes an 8-bit I/O port.
+
+  @param[in]  Port    The I/O port to write.
+  @param[in]  Value   The value to write.
+
+  @retval   The value written.
+**/
+UINT8
+EFIAPI
+IoWrite8 (
+  IN UINTN  Port,
+  IN UINT8  Value
+  )
+{
+  BtTestWrite ((UINT8)(Port - PcdGet16 (PcdIpmiIoBaseAddress)), Value);
+  return Value;
+}
+
+/**
+  Reads an 8-bit MMIO register.
+
+  @param[in]  Address   The MMIO register to read.
+
+  @retval   The value read.
+**/
+UINT8
+EFIAPI
+MmioRead8 (
+  IN UINTN  Address
+  )
+{
+  return BtTestRead ((UINT8)((Address - PcdGet64 (PcdIpmiAddress)) / MAX (PcdGet8 (PcdIpmiRegisterBitWidth) / 8, 1)));
+}
+
+/**
+  Writes an 8-bit MMIO register.
+
+  @param[in]  Address   The MMIO register to write.
+  @param[in]  Value     The value to write.
+
+  @retval   The value written.
+**/
+UINT8
+EFIAPI
+MmioWrite8 (
+  IN UINTN  Address,
+  IN UINT8  Value
+  )
+{
+  BtTestWrite ((UINT8)((Address - PcdGet64 (PcdIpmiAddress)) / MAX (PcdGet8 (PcdIpmiRegisterBitWidth) / 8, 1)), Value);
+  return Value;
+}
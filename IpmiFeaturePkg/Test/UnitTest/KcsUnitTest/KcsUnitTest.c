@@ -0,0 +1,416 @@
+/** @file
+  Host based unit tests for the KCS transport library.
+
+  Copyright (c) Microsoft Corporation
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "KcsUnitTest.h"
+
+#define UNIT_TEST_NAME     "KCS Unit Test"
+#define UNIT_TEST_VERSION  "1.0"
+
+//
+// Stall in microseconds of a BMC that never clears IBF again.
+//
+#define KCS_TEST_STALL_FOREVER  MAX_UINT32
+
+//
+// Time budget used by the timeout tests, in microseconds.
+//
+#define KCS_TEST_TIMEOUT  (5 * 1000 * 1000)
+
+//
+// Number of status polls a transaction may make after its budget and the
+// budget of its abort sequence have been used: the polls that detect each
+// timeout, plus one for rounding.
+//
+#define KCS_TEST_OVERRUN_POLLS  3
+
+//
+// Allowance in nanoseconds for the virtual counter advancing on each read.
+//
+#define KCS_TEST_COUNTER_SLACK  1000
+
+//
+// Delay between KCS status polls in microseconds, matching the transport.
+//
+#define KCS_TEST_POLL_DELAY  50
+
+//
+// Value of PcdIpmiKcsPollPolicy for the fixed polling policy.
+//
+#define KCS_TEST_POLL_POLICY_FIXED  0
+
+//
+// Value of PcdIpmiAddressSpaceId for MMIO access to the KCS registers.
+//
+#define KCS_TEST_ADDRESS_SPACE_MEMORY  0
+
+/**
+  Clears the state of the test libraries.
+
+  @param[in]  Context    UNUSED
+**/
+VOID
+EFIAPI
+ResetTestState (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  MockKcsReset ();
+  VirtualTimerReset ();
+}
+
+/**
+  Sends a Get Device ID request to the simulated BMC, leaving the response
+  ready to be received.
+
+  @retval  EFI_SUCCESS   The request was sent.
+  @retval  Others        The send failed.
+**/
+EFI_STATUS
+KcsTestSendRequest (
+  VOID
+  )
+{
+  UINT8  Header[2];
+
+  Header[0] = 0x18;
+  Header[1] = 0x01;
+  return SendDataToBmcPortEx (KCS_TEST_TIMEOUT, Header, sizeof (Header), NULL, 0);
+}
+
+/**
+  Sends or receives with the simulated BMC stalled on the first write of the
+  transfer. A receive follows a successful send, so the stall hits the first
+  READ control code after the BMC has answered.
+
+  @param[in]   StallTime   The stall in microseconds.
+  @param[in]   Send        TRUE to stall a send, FALSE to stall a receive.
+  @param[out]  Elapsed     The time in nanoseconds the stalled transfer took.
+
+  @retval  The status of the stalled transfer.
+**/
+EFI_STATUS
+KcsTestStalledTransfer (
+  IN  UINT32   StallTime,
+  IN  BOOLEAN  Send,
+  OUT UINT64   *Elapsed
+  )
+{
+  EFI_STATUS  Status;
+  UINT8       Data[8];
+  UINT32      DataSize;
+  UINT64      Start;
+
+  if (!Send) {
+    Status = KcsTestSendRequest ();
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  MockKcsSetStall (0, StallTime);
+  Start = VirtualTimerGetTime ();
+  if (Send) {
+    Status = KcsTestSendRequest ();
+  } else {
+    DataSize = sizeof (Data);
+    Status   = ReceiveBmcDataFromPortEx (KCS_TEST_TIMEOUT, NULL, 0, Data, &DataSize);
+  }
+
+  *Elapsed = VirtualTimerGetTime () - Start;
+  return Status;
+}
+
+/**
+  Checks that a timed out transaction took at least its time budget and at
+  most the budget of the transaction and of its abort sequence plus the polls
+  allowed after they expired.
+
+  @param[in]  IoCost    The time of each register access in microseconds.
+  @param[in]  Send      TRUE to time a send, FALSE to time a receive.
+
+  @retval  UNIT_TEST_PASSED             The timeout was within the bound.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A test case assertion has failed.
+**/
+UNIT_TEST_STATUS
+CheckTimeoutBound (
+  IN UINT32   IoCost,
+  IN BOOLEAN  Send
+  )
+{
+  EFI_STATUS  Status;
+  UINT64      Elapsed;
+  UINT64      Budget;
+  UINT64      Bound;
+
+  MockKcsReset ();
+  VirtualTimerReset ();
+  MockKcsSetIoCost (IoCost);
+
+  Status = KcsTestStalledTransfer (KCS_TEST_STALL_FOREVER, Send, &Elapsed);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_DEVICE_ERROR);
+
+  Budget = MultU64x32 (KCS_TEST_TIMEOUT, 1000);
+  Bound  = 2 * Budget + MultU64x32 (KCS_TEST_OVERRUN_POLLS * (KCS_TEST_POLL_DELAY + IoCost), 1000) + KCS_TEST_COUNTER_SLACK;
+  DEBUG ((DEBUG_INFO, "IoCost %dus: timed out after %ldns, bound %ldns\n", IoCost, Elapsed, Bound));
+
+  UT_ASSERT_TRUE (Elapsed >= Budget);
+  UT_ASSERT_TRUE (Elapsed <= Bound);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Tests that a send to a BMC that never clears IBF times out within the budget
+  regardless of how long each status poll takes.
+
+  @param[in]  Context             UNUSED
+
+  @retval  UNIT_TEST_PASSED             The Unit test has completed and the test
+                                        case was successful.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A test case assertion has failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+TestKcsSendTimeoutBound (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UT_ASSERT_EQUAL (CheckTimeoutBound (0, TRUE), UNIT_TEST_PASSED);
+  UT_ASSERT_EQUAL (CheckTimeoutBound (200, TRUE), UNIT_TEST_PASSED);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Tests that a receive from a BMC that never clears IBF times out within the
+  budget regardless of how long each status poll takes.
+
+  @param[in]  Context             UNUSED
+
+  @retval  UNIT_TEST_PASSED             The Unit test has completed and the test
+                                        case was successful.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A test case assertion has failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+TestKcsReceiveTimeoutBound (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UT_ASSERT_EQUAL (CheckTimeoutBound (0, FALSE), UNIT_TEST_PASSED);
+  UT_ASSERT_EQUAL (CheckTimeoutBound (200, FALSE), UNIT_TEST_PASSED);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Checks that a transaction timed out by a BMC that only clears IBF after the
+  time budget is aborted.
+
+  @param[in]  Send      TRUE to time out a send, FALSE to time out a receive.
+
+  @retval  UNIT_TEST_PASSED             The transaction was aborted.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A test case assertion has failed.
+**/
+UNIT_TEST_STATUS
+CheckTimeoutAbort (
+  IN BOOLEAN  Send
+  )
+{
+  EFI_STATUS           Status;
+  UINT64               Elapsed;
+  MOCK_KCS_STATISTICS  Statistics;
+
+  MockKcsReset ();
+  VirtualTimerReset ();
+
+  Status = KcsTestStalledTransfer (KCS_TEST_TIMEOUT + KCS_TEST_POLL_DELAY, Send, &Elapsed);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_DEVICE_ERROR);
+
+  MockKcsGetStatistics (&Statistics);
+  UT_ASSERT_TRUE (Statistics.Aborts > 0);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Tests that a send and a receive that time out write ABORT to the command
+  register once the BMC clears IBF, even though their own budget has been used.
+
+  @param[in]  Context             UNUSED
+
+  @retval  UNIT_TEST_PASSED             The Unit test has completed and the test
+                                        case was successful.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A test case assertion has failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+TestKcsTimeoutAbort (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UT_ASSERT_EQUAL (CheckTimeoutAbort (TRUE), UNIT_TEST_PASSED);
+  UT_ASSERT_EQUAL (CheckTimeoutAbort (FALSE), UNIT_TEST_PASSED);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Tests the port accesses and time taken to send a request to a BMC that
+  accepts every byte at once. Each byte and control code takes one status read
+  and one write. The adaptive polling policy must not delay at all, the fixed
+  policy delays before every status read.
+
+  @param[in]  Context             UNUSED
+
+  @retval  UNIT_TEST_PASSED             The Unit test has completed and the test
+                                        case was successful.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A test case assertion has failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+TestKcsSendStatusReads (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS           Status;
+  UINT8                Header[2];
+  UINT8                Data[18];
+  UINT32               Transitions;
+  MOCK_KCS_STATISTICS  Statistics;
+
+  Header[0] = 0x18;
+  Header[1] = 0x01;
+  ZeroMem (Data, sizeof (Data));
+
+  Status = SendDataToBmcPortEx (KCS_TEST_TIMEOUT, Header, sizeof (Header), Data, sizeof (Data));
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  MockKcsGetStatistics (&Statistics);
+  DEBUG ((
+    DEBUG_INFO,
+    "%d byte send: %d status reads, %d I/O operations in %ldns\n",
+    (UINT32)(sizeof (Header) + sizeof (Data)),
+    Statistics.StatusReads,
+    Statistics.IoReads + Statistics.IoWrites,
+    VirtualTimerGetTime ()
+    ));
+
+  //
+  // The bytes plus WRITE_START and WRITE_END.
+  //
+  Transitions = sizeof (Header) + sizeof (Data) + 2;
+  UT_ASSERT_EQUAL (Statistics.StatusReads, Transitions);
+  UT_ASSERT_EQUAL (Statistics.IoReads + Statistics.IoWrites, 2 * Transitions);
+  if (PcdGet8 (PcdIpmiKcsPollPolicy) == KCS_TEST_POLL_POLICY_FIXED) {
+    UT_ASSERT_TRUE (VirtualTimerGetTime () >= MultU64x32 (Statistics.StatusReads, KCS_TEST_POLL_DELAY * 1000));
+  } else {
+    UT_ASSERT_TRUE (VirtualTimerGetTime () < KCS_TEST_POLL_DELAY * 1000);
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Tests that the KCS registers are accessed through the bus selected by
+  PcdIpmiAddressSpaceId.
+
+  @param[in]  Context             UNUSED
+
+  @retval  UNIT_TEST_PASSED             The Unit test has completed and the test
+                                        case was successful.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A test case assertion has failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+TestKcsAccessMode (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS           Status;
+  UINT32               IoOperations;
+  MOCK_KCS_STATISTICS  Statistics;
+
+  Status = KcsTestSendRequest ();
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  MockKcsGetStatistics (&Statistics);
+  IoOperations = Statistics.IoReads + Statistics.IoWrites;
+  UT_ASSERT_TRUE (IoOperations > 0);
+
+  if (PcdGet8 (PcdIpmiAddressSpaceId) == KCS_TEST_ADDRESS_SPACE_MEMORY) {
+    UT_ASSERT_EQUAL (Statistics.MmioAccesses, IoOperations);
+  } else {
+    UT_ASSERT_EQUAL (Statistics.MmioAccesses, 0);
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Initializes and configures the KCS transport tests.
+
+  @retval  EFI_SUCCESS           All test cases were dispatched.
+  @retval  EFI_OUT_OF_RESOURCES  There are not enough resources available to
+                                 initialize the unit tests.
+**/
+EFI_STATUS
+EFIAPI
+KcsTestMain (
+  VOID
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+  UNIT_TEST_SUITE_HANDLE      KcsTests;
+
+  Framework = NULL;
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_NAME, UNIT_TEST_VERSION));
+
+  //
+  // Start setting up the test framework for running the tests.
+  //
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_NAME, gEfiCallerBaseName, UNIT_TEST_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  //
+  // Populate the KCS Unit Test Suite.
+  //
+  Status = CreateUnitTestSuite (&KcsTests, Framework, "KCS Transport Tests", "IPMI.KCS", NULL, NULL);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for KcsTests\n"));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  AddTestCase (KcsTests, "Tests the worst case time of a send to an unresponsive BMC", "TestKcsSendTimeoutBound", TestKcsSendTimeoutBound, NULL, ResetTestState, NULL);
+  AddTestCase (KcsTests, "Tests the worst case time of a receive from an unresponsive BMC", "TestKcsReceiveTimeoutBound", TestKcsReceiveTimeoutBound, NULL, ResetTestState, NULL);
+  AddTestCase (KcsTests, "Tests a timed out transfer is aborted", "TestKcsTimeoutAbort", TestKcsTimeoutAbort, NULL, ResetTestState, NULL);
+  AddTestCase (KcsTests, "Tests the status reads needed to send to a responsive BMC", "TestKcsSendStatusReads", TestKcsSendStatusReads, NULL, ResetTestState, NULL);
+  AddTestCase (KcsTests, "Tests the KCS registers are accessed through the configured bus", "TestKcsAccessMode", TestKcsAccessMode, NULL, ResetTestState, NULL);
+
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return Status;
+}
+
+/**
+  Standard POSIX C entry point for host based unit test execution.
+**/
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+{
+  return KcsTestMain ();
+}
@@ -0,0 +1,23 @@
+/** @file
+  Definitions for the KCS transport unit tests.
+
+  Copyright (c) Microsoft Corporation
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef _KCS_UNIT_TEST_H
+#define _KCS_UNIT_TEST_H
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/DebugLib.h>
+#include <Library/TimerLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/UnitTestLib.h>
+#include <Library/IpmiTransportLib.h>
+#include <Library/IpmiTransportExLib.h>
+#include <MockKcsBmc.h>
+#include <VirtualTimer.h>
+
+#endif
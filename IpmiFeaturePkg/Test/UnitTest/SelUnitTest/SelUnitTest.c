@@ -11,12 +11,27 @@
 #include <Library/DebugLib.h>
 #include <Library/BaseMemoryLib.h>
 #include <Library/UnitTestLib.h>
+#include <Library/IpmiBaseLib.h>
 #include <Library/IpmiSelLib.h>
 #include <IndustryStandard/Ipmi.h>
+#include <VirtualTimer.h>
 
 #define UNIT_TEST_NAME     "SEL Unit Test"
 #define UNIT_TEST_VERSION  "1.0"
 
+/**
+  Answers the next IPMI requests with a completion code instead of handling
+  them. Implemented by the mock BMC.
+
+  @param[in]  CompletionCode    The completion code to respond with.
+  @param[in]  Count             The number of requests to answer, 0 to stop.
+**/
+VOID
+MockIpmiSetBusy (
+  IN UINT8  CompletionCode,
+  IN UINT8  Count
+  );
+
 /**
   Tests retrieving the SEL information.
 
@@ -190,6 +205,343 @@ TestSelTime (
   return UNIT_TEST_PASSED;
 }
 
+/**
+  Tests clearing the SEL and waiting for the erasure to complete.
+
+  @param[in]  Context             UNUSED
+
+  @retval  UNIT_TEST_PASSED             The Unit test has completed and the test
+                                        case was successful.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A test case assertion has failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+TestSelClear (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+
+{
+  EFI_STATUS  Status;
+  UINT32      Delays;
+
+  //
+  // The mock BMC reports the erasure in progress once, so waiting for it
+  // costs a single 10 millisecond poll.
+  //
+  VirtualTimerReset ();
+  Status = SelClear (TRUE);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (VirtualTimerGetDelay (&Delays), 10 * 1000 * 1000);
+  UT_ASSERT_EQUAL (Delays, 1);
+
+  VirtualTimerReset ();
+  Status = SelClear (FALSE);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (VirtualTimerGetDelay (NULL), 0);
+
+  return UNIT_TEST_PASSED;
+}
+
+#define SEL_TEST_ITERATOR_ENTRIES  10
+#define SEL_TEST_ITERATOR_WINDOW   4
+
+/**
+  Tests walking the SEL with an iterator smaller than the SEL.
+
+  @param[in]  Context             UNUSED
+
+  @retval  UNIT_TEST_PASSED             The Unit test has completed and the test
+                                        case was successful.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A test case assertion has failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+TestSelIterator (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+
+{
+  EFI_STATUS    Status;
+  SEL_ITERATOR  Iterator;
+  SEL_RECORD    Window[SEL_TEST_ITERATOR_WINDOW];
+  SEL_RECORD    Record;
+  UINT8         Data[13] = { 0 };
+  UINT16        RecordIds[SEL_TEST_ITERATOR_ENTRIES];
+  UINT8         ReserveResponse[3];
+  UINT32        Size;
+  UINT8         Index;
+
+  Status = SelClear (TRUE);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+
+  //
+  // An empty SEL ends the walk at once.
+  //
+  Status = SelStartIterator (&Iterator, 0, Window, ARRAY_SIZE (Window));
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  Status = SelGetNextEntry (&Iterator, &Record);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_NOT_FOUND);
+
+  for (Index = 0; Index < SEL_TEST_ITERATOR_ENTRIES; Index++) {
+    Data[0] = Index;
+    Status  = SelAddOemEntryNoTimestamp (&RecordIds[Index], 0xE0, Data);
+    UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  }
+
+  //
+  // The whole SEL is returned in order across several windows.
+  //
+  Status = SelStartIterator (&Iterator, 0, Window, ARRAY_SIZE (Window));
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  for (Index = 0; Index < SEL_TEST_ITERATOR_ENTRIES; Index++) {
+    Status = SelGetNextEntry (&Iterator, &Record);
+    UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+    UT_ASSERT_EQUAL (Record.RecordId, RecordIds[Index]);
+    UT_ASSERT_EQUAL (Record.Record.OemNonTimestamped.Data[0], Index);
+  }
+
+  Status = SelGetNextEntry (&Iterator, &Record);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_NOT_FOUND);
+  Status = SelGetNextEntry (&Iterator, &Record);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_NOT_FOUND);
+
+  //
+  // A walk can start in the middle of the SEL.
+  //
+  Status = SelStartIterator (&Iterator, RecordIds[7], Window, ARRAY_SIZE (Window));
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  for (Index = 7; Index < SEL_TEST_ITERATOR_ENTRIES; Index++) {
+    Status = SelGetNextEntry (&Iterator, &Record);
+    UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+    UT_ASSERT_EQUAL (Record.RecordId, RecordIds[Index]);
+  }
+
+  Status = SelGetNextEntry (&Iterator, &Record);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_NOT_FOUND);
+
+  //
+  // A BMC refusing a read for a canceled reservation is given a new one, and
+  // the walk resumes at the same record. Another requester reserving the SEL
+  // cancels the reservation again.
+  //
+  Status = SelStartIterator (&Iterator, 0, Window, ARRAY_SIZE (Window));
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  MockIpmiSetBusy (IPMI_COMP_CODE_RESERVATION_CANCELED_OR_INVALID, 1);
+  for (Index = 0; Index < SEL_TEST_ITERATOR_WINDOW; Index++) {
+    Status = SelGetNextEntry (&Iterator, &Record);
+    UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+    UT_ASSERT_EQUAL (Record.RecordId, RecordIds[Index]);
+  }
+
+  Size   = sizeof (ReserveResponse);
+  Status = IpmiSubmitCommand (
+             IPMI_NETFN_STORAGE,
+             IPMI_STORAGE_RESERVE_SEL,
+             NULL,
+             0,
+             ReserveResponse,
+             &Size
+             );
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+
+  for ( ; Index < SEL_TEST_ITERATOR_ENTRIES; Index++) {
+    Status = SelGetNextEntry (&Iterator, &Record);
+    UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+    UT_ASSERT_EQUAL (Record.RecordId, RecordIds[Index]);
+  }
+
+  Status = SelGetNextEntry (&Iterator, &Record);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_NOT_FOUND);
+
+  //
+  // Clearing the SEL stops the walk once the window is consumed.
+  //
+  Status = SelStartIterator (&Iterator, 0, Window, ARRAY_SIZE (Window));
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  Status = SelGetNextEntry (&Iterator, &Record);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+
+  Status = SelClear (TRUE);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+
+  for (Index = 1; Index < SEL_TEST_ITERATOR_WINDOW; Index++) {
+    Status = SelGetNextEntry (&Iterator, &Record);
+    UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+    UT_ASSERT_EQUAL (Record.RecordId, RecordIds[Index]);
+  }
+
+  Status = SelGetNextEntry (&Iterator, &Record);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_NOT_FOUND);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Reads the last entry of the SEL by following the next record IDs.
+
+  @param[out]  Record   Receives the last entry.
+
+  @retval   EFI_SUCCESS   The entry was read.
+  @retval   Other         The SEL could not be read.
+**/
+EFI_STATUS
+GetLastEntry (
+  OUT SEL_RECORD  *Record
+  )
+{
+  EFI_STATUS  Status;
+  UINT16      RecordId;
+
+  RecordId = 0;
+  do {
+    Status = SelGetEntry (RecordId, Record, &RecordId);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  } while (RecordId != SEL_LAST_RECORD_ID);
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Tests that duplicate system events are counted into a summary record and
+  that events over the rate limit of their sensor type are dropped.
+
+  @param[in]  Context             UNUSED
+
+  @retval  UNIT_TEST_PASSED             The Unit test has completed and the test
+                                        case was successful.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A test case assertion has failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+TestSelCoalesce (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+
+{
+  EFI_STATUS            Status;
+  SEL_INFO              SelInfo;
+  SEL_RECORD            Record;
+  SEL_COALESCE_SUMMARY  *Summary;
+  UINT8                 Index;
+
+  Summary = (SEL_COALESCE_SUMMARY *)Record.Record.Oem.Data;
+
+  Status = SelFlush ();
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  Status = SelClear (TRUE);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+
+  //
+  // Only the first of a burst of events differing at most in event data 2 and
+  // 3 is added.
+  //
+  for (Index = 0; Index < 20; Index++) {
+    Status = SelAddSystemEntry (NULL, 0x07, 1, 0x6F, 0, Index, Index);
+    UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  }
+
+  Status = SelGetInfo (&SelInfo);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (SelInfo.NumberOfEntries, 1);
+
+  //
+  // Once the window is over, the next event adds the summary first.
+  //
+  VirtualTimerAdvance ((UINT64)FixedPcdGet8 (PcdIpmiSelCoalesceSeconds) * 1000 * 1000 * 1000);
+  Status = SelAddSystemEntry (NULL, 0x07, 1, 0x6F, 0, 0, 0);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+
+  Status = SelGetInfo (&SelInfo);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (SelInfo.NumberOfEntries, 3);
+
+  Status = SelGetEntry (0, &Record, &Record.RecordId);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  Status = SelGetEntry (Record.RecordId, &Record, NULL);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (Record.RecordType, FixedPcdGet8 (PcdIpmiSelCoalesceRecordType));
+  UT_ASSERT_EQUAL (Summary->SensorType, 0x07);
+  UT_ASSERT_EQUAL (Summary->SensorNumber, 1);
+  UT_ASSERT_EQUAL (Summary->Count, 19);
+
+  //
+  // Events asking for their record ID are always added.
+  //
+  Status = SelAddSystemEntry (&Record.RecordId, 0x07, 1, 0x6F, 0, 0, 0);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  Status = SelGetInfo (&SelInfo);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (SelInfo.NumberOfEntries, 4);
+
+  //
+  // Flushing adds the count of the open window.
+  //
+  Status = SelAddSystemEntry (NULL, 0x07, 1, 0x6F, 0, 0, 0);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  Status = SelFlush ();
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  Status = GetLastEntry (&Record);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (Record.RecordType, FixedPcdGet8 (PcdIpmiSelCoalesceRecordType));
+  UT_ASSERT_EQUAL (Summary->Count, 1);
+
+  //
+  // A window that is over is summarized by the next event of any kind.
+  //
+  Status = SelClear (TRUE);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  for (Index = 0; Index < 5; Index++) {
+    Status = SelAddSystemEntry (NULL, 0x07, 1, 0x6F, 0, 0, 0);
+    UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  }
+
+  VirtualTimerAdvance ((UINT64)FixedPcdGet8 (PcdIpmiSelCoalesceSeconds) * 1000 * 1000 * 1000);
+  Status = SelAddSystemEntry (NULL, 0x08, 3, 0x6F, 0, 0, 0);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+
+  Status = SelGetInfo (&SelInfo);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (SelInfo.NumberOfEntries, 3);
+
+  Status = SelGetEntry (0, &Record, &Record.RecordId);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  Status = SelGetEntry (Record.RecordId, &Record, NULL);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (Record.RecordType, FixedPcdGet8 (PcdIpmiSelCoalesceRecordType));
+  UT_ASSERT_EQUAL (Summary->SensorType, 0x07);
+  UT_ASSERT_EQUAL (Summary->Count, 4);
+
+  Status = SelFlush ();
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+
+  //
+  // Distinct memory events are limited by the default rate limit of 16.
+  //
+  Status = SelClear (TRUE);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  for (Index = 0; Index < 20; Index++) {
+    Status = SelAddSystemEntry (NULL, 0x0C, 2, 0x6F, Index, 0, 0);
+    UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  }
+
+  Status = SelGetInfo (&SelInfo);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (SelInfo.NumberOfEntries, 16);
+
+  Status = SelFlush ();
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  Status = GetLastEntry (&Record);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (Record.RecordType, FixedPcdGet8 (PcdIpmiSelCoalesceRecordType));
+  UT_ASSERT_EQUAL (Summary->SensorType, 0x0C);
+  UT_ASSERT_EQUAL (Summary->SensorNumber, SEL_COALESCE_RATE_LIMITED);
+  UT_ASSERT_EQUAL (Summary->Count, 4);
+
+  return UNIT_TEST_PASSED;
+}
+
 /**
   Initializes and configures the SEL library tests.
 
@@ -235,6 +587,9 @@ SelTestMain (
   AddTestCase (SelTests, "Tests adding an OEM event to the SEL", "TestSelAddOemEntry", TestSelAddOemEntry, NULL, NULL, NULL);
   AddTestCase (SelTests, "Tests adding an OEM non-timestamped event to the SEL", "TestSelAddOemNoTimestampEntry", TestSelAddOemNoTimestampEntry, NULL, NULL, NULL);
   AddTestCase (SelTests, "Tests setting/getting SEL time", "TestSelTime", TestSelTime, NULL, NULL, NULL);
+  AddTestCase (SelTests, "Tests clearing the SEL", "TestSelClear", TestSelClear, NULL, NULL, NULL);
+  AddTestCase (SelTests, "Tests walking the SEL with an iterator", "TestSelIterator", TestSelIterator, NULL, NULL, NULL);
+  AddTestCase (SelTests, "Tests coalescing and rate limiting system events", "TestSelCoalesce", TestSelCoalesce, NULL, NULL, NULL);
 
   Status = RunAllTestSuites (Framework);
 
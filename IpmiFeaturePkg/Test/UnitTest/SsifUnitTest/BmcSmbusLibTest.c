@@ -14,17 +14,55 @@ UINT32  RxOffset = 0;
 UINT32  RxSize   = 0;
 UINT32  TxSize   = 0;
 UINT8   RxBlock  = 0xFF;
+UINT32  Writes   = 0;
+
+//
+// The last middle or end block, resent on SMBUS_CMD_MULT_READ_RETRY, and the
+// faults injected into reads of a block.
+//
+UINT8    LastBlock[SSIF_MAX_READ_BUFFER_SIZE];
+UINT8    LastBlockLength = 0;
+UINT8    FaultBlock      = 0;
+UINT32   FaultCount      = 0;
+BOOLEAN  FaultOutOfOrder = FALSE;
+UINT32   RetryReads      = 0;
+
+//
+// Whether the connection is open and how many times it has been opened.
+//
+BOOLEAN  BusOpen   = FALSE;
+UINT32   OpenCount = 0;
+
+//
+// Virtual time in microseconds from which the response can be read, and
+// whether the BMC asserts SMBALERT# once it can.
+//
+UINT64   RxReadyTime    = 0;
+BOOLEAN  AlertSupported = FALSE;
+
+//
+// The number of first writes of a request that are NAKed as the BMC is busy.
+//
+UINT32  BusyWrites = 0;
 
 /**
   Opens the SMBus connection if needed.
 
   @retval   EFI_SUCCESS           Them SMBus connection was successfully opened.
+  @retval   EFI_ALREADY_STARTED   The connection was not closed since it was
+                                  last opened.
 **/
 EFI_STATUS
 BmcSmbusOpen (
   VOID
   )
 {
+  if (BusOpen) {
+    return EFI_ALREADY_STARTED;
+  }
+
+  BusOpen = TRUE;
+  OpenCount++;
   return EFI_SUCCESS;
 }
 
@@ -38,6 +76,7 @@ BmcSmbusClose (
   VOID
   )
 {
+  BusOpen = FALSE;
   return EFI_SUCCESS;
 }
 
@@ -55,6 +94,16 @@ SmbusTestLibReset (
   RxBlock  = 0xFF;
   ZeroMem (&RxBuffer[0], TEST_BUFFER_SIZE);
   ZeroMem (&TxBuffer[0], TEST_BUFFER_SIZE);
+
+  LastBlockLength = 0;
+  FaultCount      = 0;
+  FaultOutOfOrder = FALSE;
+  RetryReads      = 0;
+  OpenCount       = 0;
+  RxReadyTime     = 0;
+  AlertSupported  = FALSE;
+  Writes          = 0;
+  BusyWrites      = 0;
 }
 
 /**
@@ -69,6 +118,7 @@ SmbusTestLibReset (
   @retval   EFI_INVALID_PARAMETER Unexpected write command.
   @retval   EFI_ALREADY_STARTED   Unexpected first write command.
   @retval   EFI_NOT_STARTED       Unexpected middle or last write.
+  @retval   EFI_DEVICE_ERROR      The BMC is busy and NAKs the first write.
 **/
 EFI_STATUS
 BmcSmbusBlockWrite (
@@ -103,8 +153,76 @@ BmcSmbusBlockWrite (
     return EFI_NOT_STARTED;
   }
 
+  if ((TxSize == 0) && (BusyWrites > 0)) {
+    BusyWrites--;
+    return EFI_DEVICE_ERROR;
+  }
+
   CopyMem (&TxBuffer[TxSize], WriteBlock, WriteSize);
   TxSize += WriteSize;
+  Writes++;
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Injects the configured fault into a read of a middle or end block.
+
+  @param[in,out]  ReadBlock       The block read.
+
+  @retval   EFI_SUCCESS           The block is returned, possibly with a wrong
+                                  block number.
+  @retval   EFI_DEVICE_ERROR      The read fails.
+**/
+STATIC
+EFI_STATUS
+InjectReadFault (
+  IN OUT UINT8  *ReadBlock
+  )
+{
+  if ((FaultCount == 0) || (ReadBlock[0] != FaultBlock)) {
+    return EFI_SUCCESS;
+  }
+
+  FaultCount--;
+  if (FaultOutOfOrder) {
+    ReadBlock[0] = FaultBlock + 1;
+    return EFI_SUCCESS;
+  }
+
+  return EFI_DEVICE_ERROR;
+}
+
+/**
+  Waits on the virtual clock until the response is ready, if the BMC asserts
+  SMBALERT#.
+
+  @param[in]  Timeout             The longest time to wait in microseconds.
+
+  @retval   EFI_SUCCESS           The response is ready.
+  @retval   EFI_TIMEOUT           The response was not ready within Timeout.
+  @retval   EFI_UNSUPPORTED       The BMC does not assert SMBALERT#.
+**/
+EFI_STATUS
+BmcSmbusWaitForAlert (
+  UINTN  Timeout
+  )
+{
+  UINT64  ReadyTime;
+
+  if (!AlertSupported) {
+    return EFI_UNSUPPORTED;
+  }
+
+  ReadyTime = MultU64x32 (RxReadyTime, 1000);
+  if (ReadyTime > VirtualTimerGetTime () + MultU64x32 (Timeout, 1000)) {
+    MicroSecondDelay (Timeout);
+    return EFI_TIMEOUT;
+  }
+
+  if (ReadyTime > VirtualTimerGetTime ()) {
+    VirtualTimerAdvance (ReadyTime - VirtualTimerGetTime ());
+  }
 
   return EFI_SUCCESS;
 }
@@ -138,6 +256,11 @@ BmcSmbusBlockRead (
     return EFI_NOT_FOUND;
   }
 
+  // The BMC NAKs the read until the response is ready.
+  if ((Command == SMBUS_CMD_READ) && (VirtualTimerGetTime () < MultU64x32 (RxReadyTime, 1000))) {
+    return EFI_DEVICE_ERROR;
+  }
+
   if (Command == SMBUS_CMD_READ) {
     // Make sure this is a clean state.
     if (RxOffset != 0) {
@@ -166,11 +289,28 @@ BmcSmbusBlockRead (
     ReadSize = ((RxSize - RxOffset) < (SSIF_MAX_READ_SIZE - 1)) ?
                (UINT8)(RxSize - RxOffset) : (SSIF_MAX_READ_SIZE - 1);
 
-    ReadBlock[0] = RxBlock;
+    //
+    // The block holding the rest of the message is the end block.
+    //
+    ReadBlock[0] = ((RxSize - RxOffset) <= (SSIF_MAX_READ_SIZE - 1)) ? SSIF_READ_END_BLOCK : RxBlock;
     CopyMem (&ReadBlock[1], &RxBuffer[RxOffset], ReadSize);
     RxBlock     += 1;
     RxOffset    += ReadSize;
     *BlockLength = ReadSize + 1;
+
+    CopyMem (&LastBlock[0], ReadBlock, *BlockLength);
+    LastBlockLength = *BlockLength;
+    return InjectReadFault (ReadBlock);
+  } else if (Command == SMBUS_CMD_MULT_READ_RETRY) {
+    // Only a middle or end block can be read again.
+    if (LastBlockLength == 0) {
+      return EFI_NOT_STARTED;
+    }
+
+    CopyMem (ReadBlock, &LastBlock[0], LastBlockLength);
+    *BlockLength = LastBlockLength;
+    RetryReads++;
+    return InjectReadFault (ReadBlock);
   } else {
     return EFI_INVALID_PARAMETER;
   }
@@ -200,6 +340,100 @@ CheckTxBuffer (
   return (CompareMem (Data, &TxBuffer[0], DataSize) == 0);
 }
 
+/**
+  Makes reads of a middle or end block fail.
+
+  @param[in]  Block       The number of the block to fail, 0xFF for the end
+                          block.
+  @param[in]  Count       The number of reads to fail.
+  @param[in]  OutOfOrder  TRUE to return the block with a wrong block number,
+                          FALSE to fail the SMBus read.
+**/
+VOID
+SmbusTestSetReadFault (
+  UINT8    Block,
+  UINT32   Count,
+  BOOLEAN  OutOfOrder
+  )
+{
+  FaultBlock      = Block;
+  FaultCount      = Count;
+  FaultOutOfOrder = OutOfOrder;
+}
+
+/**
+  Gets the number of SMBUS_CMD_MULT_READ_RETRY reads.
+
+  @retval   The number of retried block reads since the last reset.
+**/
+UINT32
+SmbusTestGetRetryReads (
+  VOID
+  )
+{
+  return RetryReads;
+}
+
+/**
+  Holds the response back until a point on the virtual clock.
+
+  @param[in]  ReadyTime   The virtual time in microseconds from which the
+                          response can be read.
+  @param[in]  Alert       TRUE if the BMC asserts SMBALERT# once the response
+                          is ready.
+**/
+VOID
+SmbusTestSetResponseDelay (
+  UINT64   ReadyTime,
+  BOOLEAN  Alert
+  )
+{
+  RxReadyTime    = ReadyTime;
+  AlertSupported = Alert;
+}
+
+/**
+  Makes the BMC NAK the first write of requests as if it was busy.
+
+  @param[in]  Count       The number of first writes to NAK.
+**/
+VOID
+SmbusTestSetBusyWrites (
+  UINT32  Count
+  )
+{
+  BusyWrites = Count;
+}
+
+/**
+  Gets the number of block writes since the last reset.
+
+  @retval   The number of block writes.
+**/
+UINT32
+SmbusTestGetWriteCount (
+  VOID
+  )
+{
+  return Writes;
+}
+
+/**
+  Gets the state of the SMBus connection.
+
+  @param[out]  Open     TRUE if the connection is open.
+
+  @retval   The number of times the connection was opened since the last reset.
+**/
+UINT32
+SmbusTestGetOpenCount (
+  OUT BOOLEAN  *Open
+  )
+{
+  *Open = BusOpen;
+  return OpenCount;
+}
+
 /**
   Copy the provided data into the Rx buffer.
 
@@ -23,6 +23,8 @@ ResetTestState (
   )
 {
   SmbusTestLibReset ();
+  VirtualTimerReset ();
+  IpmiTransportSetCapabilities (GetSystemInterfaceTypeSsif, NULL, 0);
 }
 
 /**
@@ -126,6 +128,409 @@ TestSsifSimpleRead (
   return UNIT_TEST_PASSED;
 }
 
+/**
+  Tests reading a multi-part message larger than 255 bytes through the SSIF
+  interface.
+
+  @param[in]  Context             UNUSED
+
+  @retval  UNIT_TEST_PASSED             The Unit test has completed and the test
+                                        case was successful.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A test case assertion has failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+TestSsifLargeRead (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+
+{
+  UINT8       TestData[600];
+  UINT8       Header[2];
+  UINT8       ReadData[600];
+  UINT32      ReadSize;
+  UINT8       LegacyReadSize;
+  EFI_STATUS  Status;
+
+  PatternBuffer (&TestData[0], sizeof (TestData));
+  SetRxBuffer (&TestData[0], sizeof (TestData));
+  ReadSize = sizeof (ReadData);
+  Status   = ReceiveBmcDataFromPortEx (0, &Header[0], sizeof (Header), &ReadData[0], &ReadSize);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (ReadSize, sizeof (TestData) - sizeof (Header));
+  UT_ASSERT_MEM_EQUAL (&TestData[0], &Header[0], sizeof (Header));
+  UT_ASSERT_MEM_EQUAL (&TestData[sizeof (Header)], &ReadData[0], ReadSize);
+
+  //
+  // The UINT8 interface cannot report the size of the message.
+  //
+  SmbusTestLibReset ();
+  SetRxBuffer (&TestData[0], sizeof (TestData));
+  LegacyReadSize = MAX_UINT8;
+  Status         = ReceiveBmcDataFromPort (0, &ReadData[0], &LegacyReadSize);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_BUFFER_TOO_SMALL);
+  UT_ASSERT_EQUAL (LegacyReadSize, MAX_UINT8);
+  UT_ASSERT_MEM_EQUAL (&TestData[0], &ReadData[0], LegacyReadSize);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Tests that a failed or out of order block of a multi-part read is read again
+  with the retry command, and that the response fails once the retries of a
+  block are used up.
+
+  @param[in]  Context             UNUSED
+
+  @retval  UNIT_TEST_PASSED             The Unit test has completed and the test
+                                        case was successful.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A test case assertion has failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+TestSsifReadRetry (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+
+{
+  UINT8       TestData[600];
+  UINT8       Header[2];
+  UINT8       ReadData[600];
+  UINT32      ReadSize;
+  EFI_STATUS  Status;
+
+  PatternBuffer (&TestData[0], sizeof (TestData));
+
+  //
+  // SMBus errors on a middle block.
+  //
+  SetRxBuffer (&TestData[0], sizeof (TestData));
+  SmbusTestSetReadFault (2, 2, FALSE);
+  ReadSize = sizeof (ReadData);
+  Status   = ReceiveBmcDataFromPortEx (0, &Header[0], sizeof (Header), &ReadData[0], &ReadSize);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (SmbusTestGetRetryReads (), 2);
+  UT_ASSERT_EQUAL (ReadSize, sizeof (TestData) - sizeof (Header));
+  UT_ASSERT_MEM_EQUAL (&TestData[0], &Header[0], sizeof (Header));
+  UT_ASSERT_MEM_EQUAL (&TestData[sizeof (Header)], &ReadData[0], ReadSize);
+
+  //
+  // A block with the wrong block number.
+  //
+  SmbusTestLibReset ();
+  SetRxBuffer (&TestData[0], sizeof (TestData));
+  SmbusTestSetReadFault (1, 1, TRUE);
+  ReadSize = sizeof (ReadData);
+  Status   = ReceiveBmcDataFromPortEx (0, &Header[0], sizeof (Header), &ReadData[0], &ReadSize);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (SmbusTestGetRetryReads (), 1);
+  UT_ASSERT_MEM_EQUAL (&TestData[sizeof (Header)], &ReadData[0], ReadSize);
+
+  //
+  // The end block keeps failing.
+  //
+  SmbusTestLibReset ();
+  SetRxBuffer (&TestData[0], sizeof (TestData));
+  SmbusTestSetReadFault (SSIF_READ_END_BLOCK, SSIF_MULT_READ_RETRY_COUNT + 1, FALSE);
+  ReadSize = sizeof (ReadData);
+  Status   = ReceiveBmcDataFromPortEx (0, &Header[0], sizeof (Header), &ReadData[0], &ReadSize);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_DEVICE_ERROR);
+  UT_ASSERT_EQUAL (SmbusTestGetRetryReads (), SSIF_MULT_READ_RETRY_COUNT);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Tests that the SMBus connection is opened once for all the sends and
+  receives of a transport session, and around each of them otherwise.
+
+  @param[in]  Context             UNUSED
+
+  @retval  UNIT_TEST_PASSED             The Unit test has completed and the test
+                                        case was successful.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A test case assertion has failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+TestSsifSession (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+
+{
+  UINT8       TestData[8];
+  UINT8       ReadData[8];
+  UINT8       ReadSize;
+  BOOLEAN     Open;
+  EFI_STATUS  Status;
+
+  PatternBuffer (&TestData[0], sizeof (TestData));
+
+  //
+  // Outside a session.
+  //
+  Status = SendDataToBmcPort (0, &TestData[0], sizeof (TestData));
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  SetRxBuffer (&TestData[0], sizeof (TestData));
+  ReadSize = sizeof (ReadData);
+  Status   = ReceiveBmcDataFromPort (0, &ReadData[0], &ReadSize);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (SmbusTestGetOpenCount (&Open), 2);
+  UT_ASSERT_FALSE (Open);
+
+  //
+  // Nested sessions keep the connection open until the outermost one ends.
+  //
+  SmbusTestLibReset ();
+  IpmiTransportBeginSession ();
+  Status = SendDataToBmcPort (0, &TestData[0], sizeof (TestData));
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  IpmiTransportBeginSession ();
+  SetRxBuffer (&TestData[0], sizeof (TestData));
+  ReadSize = sizeof (ReadData);
+  Status   = ReceiveBmcDataFromPort (0, &ReadData[0], &ReadSize);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  IpmiTransportEndSession ();
+  UT_ASSERT_EQUAL (SmbusTestGetOpenCount (&Open), 1);
+  UT_ASSERT_TRUE (Open);
+  IpmiTransportEndSession ();
+  UT_ASSERT_EQUAL (SmbusTestGetOpenCount (&Open), 1);
+  UT_ASSERT_FALSE (Open);
+
+  //
+  // An SMBus error closes the connection, and the next transaction in the
+  // session opens it again.
+  //
+  SmbusTestLibReset ();
+  IpmiTransportBeginSession ();
+  ReadSize = sizeof (ReadData);
+  Status   = ReceiveBmcDataFromPort (0, &ReadData[0], &ReadSize);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_NOT_FOUND);
+  UT_ASSERT_EQUAL (SmbusTestGetOpenCount (&Open), 1);
+  UT_ASSERT_FALSE (Open);
+  Status = SendDataToBmcPort (0, &TestData[0], sizeof (TestData));
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (SmbusTestGetOpenCount (&Open), 2);
+  UT_ASSERT_TRUE (Open);
+  IpmiTransportEndSession ();
+  UT_ASSERT_EQUAL (SmbusTestGetOpenCount (&Open), 2);
+  UT_ASSERT_FALSE (Open);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Tests that a response the BMC is not ready to return is polled for with a
+  doubling delay, is picked up at once when the BMC asserts SMBALERT#, and
+  fails once the time budget is used.
+
+  @param[in]  Context             UNUSED
+
+  @retval  UNIT_TEST_PASSED             The Unit test has completed and the test
+                                        case was successful.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A test case assertion has failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+TestSsifResponsePolling (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+
+{
+  UINT8       TestData[8];
+  UINT8       ReadData[8];
+  UINT8       ReadSize;
+  EFI_STATUS  Status;
+
+  PatternBuffer (&TestData[0], sizeof (TestData));
+
+  //
+  // Reads at 0, 100, 300 and 700us are refused, the one at 1500us succeeds.
+  //
+  SetRxBuffer (&TestData[0], sizeof (TestData));
+  SmbusTestSetResponseDelay (1000, FALSE);
+  ReadSize = sizeof (ReadData);
+  Status   = ReceiveBmcDataFromPort ((1000 * 1000) / IPMI_TRANSPORT_DELAY_UNIT, &ReadData[0], &ReadSize);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (ReadSize, sizeof (TestData));
+  UT_ASSERT_MEM_EQUAL (&TestData[0], &ReadData[0], ReadSize);
+  UT_ASSERT_EQUAL (VirtualTimerGetDelay (NULL), 1500 * 1000);
+
+  //
+  // SMBALERT# ends the wait as soon as the response is ready.
+  //
+  SmbusTestLibReset ();
+  VirtualTimerReset ();
+  SetRxBuffer (&TestData[0], sizeof (TestData));
+  SmbusTestSetResponseDelay (1000, TRUE);
+  ReadSize = sizeof (ReadData);
+  Status   = ReceiveBmcDataFromPort ((1000 * 1000) / IPMI_TRANSPORT_DELAY_UNIT, &ReadData[0], &ReadSize);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_MEM_EQUAL (&TestData[0], &ReadData[0], ReadSize);
+  UT_ASSERT_EQUAL (DivU64x32 (VirtualTimerGetTime (), 1000), 1000);
+
+  //
+  // The receive fails once the budget is used.
+  //
+  SmbusTestLibReset ();
+  VirtualTimerReset ();
+  SetRxBuffer (&TestData[0], sizeof (TestData));
+  SmbusTestSetResponseDelay (MAX_UINT32, FALSE);
+  ReadSize = sizeof (ReadData);
+  Status   = ReceiveBmcDataFromPort ((50 * 1000) / IPMI_TRANSPORT_DELAY_UNIT, &ReadData[0], &ReadSize);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_DEVICE_ERROR);
+  UT_ASSERT_TRUE (VirtualTimerGetTime () >= 50 * 1000 * 1000);
+  UT_ASSERT_TRUE (VirtualTimerGetDelay (NULL) <= (50 * 1000 + SSIF_POLL_MAX_DELAY) * 1000);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Tests that the first write of a request NAKed by a busy BMC is tried again
+  until the time budget of the send is used.
+
+  @param[in]  Context             UNUSED
+
+  @retval  UNIT_TEST_PASSED             The Unit test has completed and the test
+                                        case was successful.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A test case assertion has failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+TestSsifBusyWrite (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UINT8       TestData[48];
+  EFI_STATUS  Status;
+
+  PatternBuffer (&TestData[0], sizeof (TestData));
+
+  //
+  // Writes at 0, 100 and 300us are NAKed, the one at 700us succeeds.
+  //
+  SmbusTestSetBusyWrites (3);
+  Status = SendDataToBmcPort ((1000 * 1000) / IPMI_TRANSPORT_DELAY_UNIT, &TestData[0], sizeof (TestData));
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_TRUE (CheckTxBuffer (&TestData[0], sizeof (TestData)));
+  UT_ASSERT_EQUAL (SmbusTestGetWriteCount (), 2);
+  UT_ASSERT_EQUAL (VirtualTimerGetDelay (NULL), 700 * 1000);
+
+  //
+  // Without a time budget the first NAK fails the send.
+  //
+  SmbusTestLibReset ();
+  VirtualTimerReset ();
+  SmbusTestSetBusyWrites (1);
+  Status = SendDataToBmcPort (0, &TestData[0], sizeof (TestData));
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_DEVICE_ERROR);
+  UT_ASSERT_EQUAL (SmbusTestGetWriteCount (), 0);
+  UT_ASSERT_EQUAL (VirtualTimerGetDelay (NULL), 0);
+
+  //
+  // The send fails once the budget is used.
+  //
+  SmbusTestLibReset ();
+  VirtualTimerReset ();
+  SmbusTestSetBusyWrites (MAX_UINT32);
+  Status = SendDataToBmcPort ((50 * 1000) / IPMI_TRANSPORT_DELAY_UNIT, &TestData[0], sizeof (TestData));
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_DEVICE_ERROR);
+  UT_ASSERT_EQUAL (SmbusTestGetWriteCount (), 0);
+  UT_ASSERT_TRUE (VirtualTimerGetTime () >= 50 * 1000 * 1000);
+  UT_ASSERT_TRUE (VirtualTimerGetDelay (NULL) <= (50 * 1000 + SSIF_POLL_MAX_DELAY) * 1000);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Tests that the capabilities reported by the BMC bound the message sizes and
+  select the framing, and that capabilities of other interfaces are ignored.
+
+  @param[in]  Context             UNUSED
+
+  @retval  UNIT_TEST_PASSED             The Unit test has completed and the test
+                                        case was successful.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A test case assertion has failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+TestSsifCapabilities (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+
+{
+  IPMI_GET_SYSTEM_INTERFACE_CAPABILITY_RESPONSE_SSIF  Capabilities;
+  UINT8                                               TestData[80];
+  UINT8                                               ReadData[80];
+  UINT8                                               ReadSize;
+  UINT32                                              MaxRequestSize;
+  UINT32                                              MaxResponseSize;
+  EFI_STATUS                                          Status;
+
+  //
+  // A BMC supporting only start and end transactions takes two writes.
+  //
+  ZeroMem (&Capabilities, sizeof (Capabilities));
+  Capabilities.TransactionSupport = IPMI_SSIF_TRANSACTION_START_END;
+  Capabilities.InputMessageSize   = 64;
+  Capabilities.MaxMessageSize     = 61;
+  IpmiTransportSetCapabilities (GetSystemInterfaceTypeSsif, (UINT8 *)&Capabilities, sizeof (Capabilities));
+  GetBmcMaxMessageSize (&MaxRequestSize, &MaxResponseSize);
+  UT_ASSERT_EQUAL (MaxRequestSize, 62);
+  UT_ASSERT_EQUAL (MaxResponseSize, 59);
+
+  PatternBuffer (&TestData[0], 64);
+  Status = SendDataToBmcPort (0, &TestData[0], 64);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_TRUE (CheckTxBuffer (&TestData[0], 64));
+  UT_ASSERT_EQUAL (SmbusTestGetWriteCount (), 2);
+
+  SmbusTestLibReset ();
+  Status = SendDataToBmcPort (0, &TestData[0], 65);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_INVALID_PARAMETER);
+  UT_ASSERT_EQUAL (SmbusTestGetWriteCount (), 0);
+
+  //
+  // A single-part BMC never starts a multi-part read, so a response starting
+  // with the multi-part marker is taken as it is.
+  //
+  Capabilities.TransactionSupport = IPMI_SSIF_TRANSACTION_SINGLE_PART;
+  Capabilities.InputMessageSize   = 0xFF;
+  Capabilities.MaxMessageSize     = 0xFF;
+  IpmiTransportSetCapabilities (GetSystemInterfaceTypeSsif, (UINT8 *)&Capabilities, sizeof (Capabilities));
+  GetBmcMaxMessageSize (&MaxRequestSize, &MaxResponseSize);
+  UT_ASSERT_EQUAL (MaxRequestSize, SSIF_MAX_WRITE_SIZE - SSIF_MESSAGE_HEADER_SIZE);
+  UT_ASSERT_EQUAL (MaxResponseSize, SSIF_MAX_READ_SIZE - SSIF_MESSAGE_HEADER_SIZE);
+
+  SmbusTestLibReset ();
+  PatternBuffer (&TestData[0], 20);
+  TestData[0] = 0;
+  TestData[1] = 1;
+  SetRxBuffer (&TestData[0], 20);
+  ReadSize = sizeof (ReadData);
+  Status   = ReceiveBmcDataFromPort (0, &ReadData[0], &ReadSize);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_SUCCESS);
+  UT_ASSERT_EQUAL (ReadSize, 20);
+  UT_ASSERT_MEM_EQUAL (&TestData[0], &ReadData[0], ReadSize);
+
+  //
+  // Capabilities of another interface or with an error are ignored, and NULL
+  // returns to the defaults.
+  //
+  Capabilities.TransactionSupport = IPMI_SSIF_TRANSACTION_START_MIDDLE_END;
+  IpmiTransportSetCapabilities (GetSystemInterfaceTypeKcs, (UINT8 *)&Capabilities, sizeof (Capabilities));
+  Capabilities.CompletionCode = IPMI_COMP_CODE_INVALID_COMMAND;
+  IpmiTransportSetCapabilities (GetSystemInterfaceTypeSsif, (UINT8 *)&Capabilities, sizeof (Capabilities));
+  GetBmcMaxMessageSize (&MaxRequestSize, &MaxResponseSize);
+  UT_ASSERT_EQUAL (MaxRequestSize, SSIF_MAX_WRITE_SIZE - SSIF_MESSAGE_HEADER_SIZE);
+
+  IpmiTransportSetCapabilities (GetSystemInterfaceTypeSsif, NULL, 0);
+  GetBmcMaxMessageSize (&MaxRequestSize, &MaxResponseSize);
+  UT_ASSERT_EQUAL (MaxRequestSize, SSIF_MAX_WRITE_MESSAGE_SIZE - SSIF_MESSAGE_HEADER_SIZE);
+  UT_ASSERT_EQUAL (MaxResponseSize, SSIF_MAX_READ_MESSAGE_SIZE - SSIF_MESSAGE_HEADER_SIZE);
+
+  return UNIT_TEST_PASSED;
+}
+
 /**
   Initializes and configures the SSIF transport tests.
 
@@ -168,6 +573,12 @@ SsifTestMain (
 
   AddTestCase (SsifTests, "Tests writing messages of different sizes through SSIF", "TestSsifSimpleWrite", TestSsifSimpleWrite, NULL, ResetTestState, NULL);
   AddTestCase (SsifTests, "Tests reading messages of different sizes through SSIF", "TestSsifSimpleRead", TestSsifSimpleRead, NULL, ResetTestState, NULL);
+  AddTestCase (SsifTests, "Tests reading a message larger than 255 bytes through SSIF", "TestSsifLargeRead", TestSsifLargeRead, NULL, ResetTestState, NULL);
+  AddTestCase (SsifTests, "Tests retrying a failed block of a multi-part read", "TestSsifReadRetry", TestSsifReadRetry, NULL, ResetTestState, NULL);
+  AddTestCase (SsifTests, "Tests the SMBus connection is kept open within a session", "TestSsifSession", TestSsifSession, NULL, ResetTestState, NULL);
+  AddTestCase (SsifTests, "Tests polling for a response that is not ready", "TestSsifResponsePolling", TestSsifResponsePolling, NULL, ResetTestState, NULL);
+  AddTestCase (SsifTests, "Tests retrying a write NAKed by a busy BMC", "TestSsifBusyWrite", TestSsifBusyWrite, NULL, ResetTestState, NULL);
+  AddTestCase (SsifTests, "Tests the limits negotiated with the BMC", "TestSsifCapabilities", TestSsifCapabilities, NULL, ResetTestState, NULL);
 
   Status = RunAllTestSuites (Framework);
 
@@ -17,7 +17,10 @@
 #include <Library/UnitTestLib.h>
 #include <Library/BmcSmbusLib.h>
 #include <Library/IpmiTransportLib.h>
+#include <Library/IpmiTransportExLib.h>
+#include <IpmiFeature.h>
 #include <Ssif.h>
+#include <VirtualTimer.h>
 
 //
 // SMBus test library functions.
@@ -42,4 +45,37 @@ SetRxBuffer (
   UINT32  DataSize
   );
 
+VOID
+SmbusTestSetReadFault (
+  UINT8    Block,
+  UINT32   Count,
+  BOOLEAN  OutOfOrder
+  );
+
+UINT32
+SmbusTestGetRetryReads (
+  VOID
+  );
+
+UINT32
+SmbusTestGetOpenCount (
+  OUT BOOLEAN  *Open
+  );
+
+UINT32
+SmbusTestGetWriteCount (
+  VOID
+  );
+
+VOID
+SmbusTestSetBusyWrites (
+  UINT32  Count
+  );
+
+VOID
+SmbusTestSetResponseDelay (
+  UINT64   ReadyTime,
+  BOOLEAN  Alert
+  );
+
 #endif